@@ -0,0 +1,255 @@
+#include "AabbTree.h"
+#include <algorithm>
+
+namespace {
+
+ObjectBounds unite(const ObjectBounds& a, const ObjectBounds& b) {
+    return { Vec3(std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y), std::min(a.min.z, b.min.z)),
+             Vec3(std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y), std::max(a.max.z, b.max.z)) };
+}
+
+// Half the surface area: what a box costs a query passing at random
+float area(const ObjectBounds& box) {
+    const Vec3 d = box.max - box.min;
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+bool contains(const ObjectBounds& outer, const ObjectBounds& inner) {
+    return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z
+           && outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+}
+
+ObjectBounds grow(const ObjectBounds& box, float margin) {
+    const Vec3 m(margin, margin, margin);
+    return { box.min - m, box.max + m };
+}
+
+float axisOf(const Vec3& v, int axis) {
+    return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+}
+
+} // namespace
+
+void AabbTree::clear() {
+    nodes.clear();
+    root = NULL_NODE;
+    freeList = NULL_NODE;
+    leafCount = 0;
+}
+
+// ===============================
+// Static build
+// ===============================
+void AabbTree::build(const std::vector<ObjectBounds>& boxes, std::vector<int>* proxies) {
+    clear();
+    if (proxies) proxies->assign(boxes.size(), NULL_NODE);
+    if (boxes.empty()) return;
+    nodes.reserve(boxes.size() * 2 - 1);
+    std::vector<uint32_t> order(boxes.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = static_cast<uint32_t>(i);
+    root = buildRange(order, boxes, 0, order.size(), NULL_NODE, proxies);
+    leafCount = boxes.size();
+}
+
+int AabbTree::buildRange(std::vector<uint32_t>& order, const std::vector<ObjectBounds>& boxes, size_t begin,
+                         size_t end, int parent, std::vector<int>* proxies) {
+    const int index = allocate();
+    nodes[index].parent = parent;
+    if (end - begin == 1) {
+        nodes[index].box = boxes[order[begin]];
+        nodes[index].userData = order[begin];
+        if (proxies) (*proxies)[order[begin]] = index;
+        return index;
+    }
+
+    // Split at the median centre along the axis the centres spread most
+    Vec3 lo = boxes[order[begin]].min + boxes[order[begin]].max;
+    Vec3 hi = lo;
+    for (size_t i = begin + 1; i < end; i++) {
+        const Vec3 c = boxes[order[i]].min + boxes[order[i]].max;
+        lo = Vec3(std::min(lo.x, c.x), std::min(lo.y, c.y), std::min(lo.z, c.z));
+        hi = Vec3(std::max(hi.x, c.x), std::max(hi.y, c.y), std::max(hi.z, c.z));
+    }
+    const Vec3 spread = hi - lo;
+    const int axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : spread.y >= spread.z ? 1 : 2;
+    const size_t middle = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+                     [&](uint32_t a, uint32_t b) {
+                         return axisOf(boxes[a].min + boxes[a].max, axis) < axisOf(boxes[b].min + boxes[b].max, axis);
+                     });
+
+    // Children first: allocate() may grow `nodes`
+    const int left = buildRange(order, boxes, begin, middle, index, proxies);
+    const int right = buildRange(order, boxes, middle, end, index, proxies);
+    Node& node = nodes[index];
+    node.left = left;
+    node.right = right;
+    refit(index);
+    return index;
+}
+
+// ===============================
+// Incremental updates
+// ===============================
+int AabbTree::insert(const ObjectBounds& box, uint32_t userData, float margin) {
+    const int leaf = allocate();
+    nodes[leaf].box = grow(box, margin);
+    nodes[leaf].userData = userData;
+    insertLeaf(leaf);
+    leafCount++;
+    return leaf;
+}
+
+void AabbTree::remove(int proxy) {
+    removeLeaf(proxy);
+    release(proxy);
+    leafCount--;
+}
+
+bool AabbTree::move(int proxy, const ObjectBounds& box, float margin) {
+    if (contains(nodes[proxy].box, box)) return false;
+    removeLeaf(proxy);
+    nodes[proxy].box = grow(box, margin);
+    insertLeaf(proxy);
+    return true;
+}
+
+int AabbTree::allocate() {
+    int index;
+    if (freeList != NULL_NODE) {
+        index = freeList;
+        freeList = nodes[index].parent;
+    } else {
+        index = static_cast<int>(nodes.size());
+        nodes.emplace_back();
+    }
+    Node& node = nodes[index];
+    node.parent = NULL_NODE;
+    node.left = node.right = NULL_NODE;
+    node.userData = 0;
+    node.height = 0;
+    return index;
+}
+
+void AabbTree::release(int node) {
+    nodes[node].parent = freeList;
+    nodes[node].height = -1;
+    freeList = node;
+}
+
+void AabbTree::refit(int index) {
+    Node& node = nodes[index];
+    node.box = unite(nodes[node.left].box, nodes[node.right].box);
+    node.height = 1 + std::max(nodes[node.left].height, nodes[node.right].height);
+}
+
+void AabbTree::insertLeaf(int leaf) {
+    if (root == NULL_NODE) {
+        root = leaf;
+        nodes[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    // Walk down to the sibling that adds the least area: pairing with a
+    // node costs the box they make together, and every ancestor grows by
+    // what the leaf adds to it
+    const ObjectBounds box = nodes[leaf].box;
+    int index = root;
+    while (!nodes[index].isLeaf()) {
+        const Node& node = nodes[index];
+        const float combined = area(unite(node.box, box));
+        const float here = 2.0f * combined;
+        const float inherited = 2.0f * (combined - area(node.box));
+        auto descendCost = [&](int child) {
+            const float joined = area(unite(nodes[child].box, box));
+            return nodes[child].isLeaf() ? joined + inherited : joined - area(nodes[child].box) + inherited;
+        };
+        const float leftCost = descendCost(node.left);
+        const float rightCost = descendCost(node.right);
+        if (here < leftCost && here < rightCost) break;
+        index = leftCost < rightCost ? node.left : node.right;
+    }
+
+    const int sibling = index;
+    const int oldParent = nodes[sibling].parent;
+    const int newParent = allocate();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].left = sibling;
+    nodes[newParent].right = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+    if (oldParent == NULL_NODE) {
+        root = newParent;
+    } else if (nodes[oldParent].left == sibling) {
+        nodes[oldParent].left = newParent;
+    } else {
+        nodes[oldParent].right = newParent;
+    }
+
+    for (index = newParent; index != NULL_NODE; index = nodes[index].parent) {
+        index = balance(index);
+        refit(index);
+    }
+}
+
+void AabbTree::removeLeaf(int leaf) {
+    if (leaf == root) {
+        root = NULL_NODE;
+        return;
+    }
+
+    // The sibling takes the parent's place
+    const int parent = nodes[leaf].parent;
+    const int grandParent = nodes[parent].parent;
+    const int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+    release(parent);
+    nodes[sibling].parent = grandParent;
+    if (grandParent == NULL_NODE) {
+        root = sibling;
+        return;
+    }
+    if (nodes[grandParent].left == parent) nodes[grandParent].left = sibling;
+    else nodes[grandParent].right = sibling;
+
+    for (int index = grandParent; index != NULL_NODE; index = nodes[index].parent) {
+        index = balance(index);
+        refit(index);
+    }
+}
+
+int AabbTree::balance(int a) {
+    if (nodes[a].isLeaf() || nodes[a].height < 2) return a;
+
+    const int b = nodes[a].left;
+    const int c = nodes[a].right;
+    const int skew = nodes[c].height - nodes[b].height;
+    if (skew >= -1 && skew <= 1) return a;
+
+    // The taller child `up` replaces `a`; of its children the taller stays
+    // with it and the other moves down to `a` in place of `up`
+    const int up = skew > 0 ? c : b;
+    const int f = nodes[up].left;
+    const int g = nodes[up].right;
+
+    nodes[up].left = a;
+    nodes[up].parent = nodes[a].parent;
+    nodes[a].parent = up;
+    if (nodes[up].parent == NULL_NODE) {
+        root = up;
+    } else if (nodes[nodes[up].parent].left == a) {
+        nodes[nodes[up].parent].left = up;
+    } else {
+        nodes[nodes[up].parent].right = up;
+    }
+
+    const int keep = nodes[f].height > nodes[g].height ? f : g;
+    const int give = keep == f ? g : f;
+    nodes[up].right = keep;
+    if (skew > 0) nodes[a].right = give;
+    else nodes[a].left = give;
+    nodes[give].parent = a;
+
+    refit(a);
+    refit(up);
+    return up;
+}
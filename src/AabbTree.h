@@ -0,0 +1,114 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Frustum.h"
+#include "Vec3.h"
+
+// Bounding volume hierarchy over boxes, for collision broad phases (the
+// dynamic tree of Box2D and Bullet). Two ways to fill it:
+//
+//  - build() takes a static set in one go, splitting top-down at the
+//    median of the longest axis. Its leaves can still be moved or removed
+//    one at a time afterwards through the proxies it hands back.
+//  - insert(), move() and remove() keep it up to date one box at a time.
+//    Leaves are stored enlarged by a margin, so a box that moves a little
+//    stays inside its leaf and costs nothing; one that leaves it is
+//    reinserted next to the sibling that grows the tree's surface least,
+//    and AVL rotations on the way back up keep the tree balanced.
+//
+// Either way a query walks O(log n) nodes plus those it overlaps, however
+// many boxes there are.
+class AabbTree {
+public:
+    static constexpr int NULL_NODE = -1;
+
+    // Replaces the contents; box i gets user data i and, with `proxies`,
+    // proxy (*proxies)[i]
+    void build(const std::vector<ObjectBounds>& boxes, std::vector<int>* proxies = nullptr);
+    void clear();
+
+    // Adds `box` grown by `margin` on every side. Returns its proxy.
+    int insert(const ObjectBounds& box, uint32_t userData, float margin = 0.0f);
+    void remove(int proxy);
+    // Moves a proxy to `box`; only reinserts (and returns true) when the
+    // box has left the proxy's enlarged one
+    bool move(int proxy, const ObjectBounds& box, float margin);
+
+    // f(userData) for every box that overlaps `box`
+    template <class F>
+    void query(const ObjectBounds& box, F&& f) const;
+
+    const ObjectBounds& getBox(int proxy) const { return nodes[proxy].box; }
+    uint32_t getUserData(int proxy) const { return nodes[proxy].userData; }
+    size_t size() const { return leafCount; }
+    // Edges from the root to the deepest leaf, 0 for a single leaf
+    int getHeight() const { return root == NULL_NODE ? 0 : nodes[root].height; }
+
+private:
+    struct Node {
+        ObjectBounds box;
+        int parent;
+        int left, right; // NULL_NODE in leaves
+        uint32_t userData;
+        int height;      // 0 for leaves
+        bool isLeaf() const { return left == NULL_NODE; }
+    };
+
+    int allocate();
+    void release(int node);
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    // Rotates `node` up if its children's heights differ by more than one;
+    // returns the node now at its place
+    int balance(int node);
+    void refit(int node);
+    int buildRange(std::vector<uint32_t>& order, const std::vector<ObjectBounds>& boxes, size_t begin, size_t end,
+                   int parent, std::vector<int>* proxies);
+
+    std::vector<Node> nodes;
+    int root = NULL_NODE;
+    int freeList = NULL_NODE; // linked through `parent`
+    size_t leafCount = 0;
+};
+
+inline bool overlaps(const ObjectBounds& a, const ObjectBounds& b) {
+    return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y
+           && a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+// ===============================
+// Template Definitions
+// ===============================
+template <class F>
+void AabbTree::query(const ObjectBounds& box, F&& f) const {
+    if (root == NULL_NODE) return;
+    // A balanced tree needs one slot per level; the spill only matters
+    // past that. Kept per call so queries can nest (instances, then the
+    // triangles of each).
+    int stack[64];
+    int top = 0;
+    std::vector<int> spill;
+    auto push = [&](int index) {
+        if (top < 64) stack[top++] = index;
+        else spill.push_back(index);
+    };
+    push(root);
+    while (top > 0 || !spill.empty()) {
+        int index;
+        if (!spill.empty()) {
+            index = spill.back();
+            spill.pop_back();
+        } else {
+            index = stack[--top];
+        }
+        const Node& node = nodes[index];
+        if (!overlaps(node.box, box)) continue;
+        if (node.isLeaf()) {
+            f(node.userData);
+        } else {
+            push(node.left);
+            push(node.right);
+        }
+    }
+}
@@ -0,0 +1,198 @@
+#include "AnimationClip.h"
+#include "Log.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Smallest-three components lie within +-1/sqrt(2)
+const float SQRT_HALF = 0.70710678f;
+const float ROTATION_STEPS = 32767.0f; // 15 bits
+const float TRANSLATION_STEPS = 65535.0f;
+
+float angleBetween(const Quat& a, const Quat& b) {
+    return 2.0f * std::acos(std::min(std::fabs(a.dot(b)), 1.0f));
+}
+
+float distance(const Vec3& a, const Vec3& b) {
+    return (a - b).length();
+}
+
+Vec3 lerp(const Vec3& a, const Vec3& b, float t) {
+    return a + (b - a) * t;
+}
+
+// The largest component goes; its index takes the top bit of the first two
+// words and it is stored positive (q and -q are the same rotation)
+void encodeRotation(Quat q, uint16_t* out) {
+    float c[4] = { q.x, q.y, q.z, q.w };
+    int largest = 0;
+    for (int i = 1; i < 4; i++) {
+        if (std::fabs(c[i]) > std::fabs(c[largest])) largest = i;
+    }
+    const float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+    int k = 0;
+    for (int i = 0; i < 4; i++) {
+        if (i == largest) continue;
+        const float unit = std::min(std::max(sign * c[i] / SQRT_HALF * 0.5f + 0.5f, 0.0f), 1.0f);
+        out[k++] = static_cast<uint16_t>(std::lround(unit * ROTATION_STEPS));
+    }
+    out[0] = static_cast<uint16_t>(out[0] | (largest & 1) << 15);
+    out[1] = static_cast<uint16_t>(out[1] | (largest >> 1) << 15);
+}
+
+Quat decodeRotation(const uint16_t* in) {
+    const int largest = (in[0] >> 15) | (in[1] >> 15) << 1;
+    float c[4];
+    float sum = 0.0f;
+    int k = 0;
+    for (int i = 0; i < 4; i++) {
+        if (i == largest) continue;
+        c[i] = ((in[k++] & 0x7fff) / ROTATION_STEPS * 2.0f - 1.0f) * SQRT_HALF;
+        sum += c[i] * c[i];
+    }
+    c[largest] = std::sqrt(std::max(1.0f - sum, 0.0f));
+    return Quat(c[0], c[1], c[2], c[3]);
+}
+
+void encodeTranslation(const Vec3& t, const Vec3& min, const Vec3& extent, uint16_t* out) {
+    const float v[3] = { t.x - min.x, t.y - min.y, t.z - min.z };
+    const float e[3] = { extent.x, extent.y, extent.z };
+    for (int i = 0; i < 3; i++) {
+        const float unit = e[i] > 0.0f ? std::min(std::max(v[i] / e[i], 0.0f), 1.0f) : 0.0f;
+        out[i] = static_cast<uint16_t>(std::lround(unit * TRANSLATION_STEPS));
+    }
+}
+
+Vec3 decodeTranslation(const uint16_t* in, const Vec3& min, const Vec3& extent) {
+    return Vec3(min.x + in[0] / TRANSLATION_STEPS * extent.x, min.y + in[1] / TRANSLATION_STEPS * extent.y,
+                min.z + in[2] / TRANSLATION_STEPS * extent.z);
+}
+
+// Frames of a track worth keeping: the first, then each furthest frame
+// that interpolating from the previous kept one still reproduces every
+// frame in between within `tolerance`. `error(a, b, t, m)` is how far
+// interpolating frames a and b by t lands from frame m.
+template <class Error>
+std::vector<uint16_t> reduceKeys(size_t frameCount, float tolerance, Error error) {
+    std::vector<uint16_t> kept(1, 0);
+    // A track that never leaves its first frame needs nothing else
+    bool constant = true;
+    for (size_t m = 1; m < frameCount && constant; m++) constant = error(0, 0, 0.0f, m) <= tolerance;
+    if (constant) return kept;
+
+    size_t from = 0;
+    while (from + 1 < frameCount) {
+        size_t to = from + 1;
+        while (to + 1 < frameCount) {
+            const size_t next = to + 1;
+            bool fits = true;
+            for (size_t m = from + 1; m < next && fits; m++) {
+                fits = error(from, next, static_cast<float>(m - from) / (next - from), m) <= tolerance;
+            }
+            if (!fits) break;
+            to = next;
+        }
+        kept.push_back(static_cast<uint16_t>(to));
+        from = to;
+    }
+    return kept;
+}
+
+// Index of the last key at or before `frame` in a track's key frames
+size_t keyBefore(const uint16_t* frames, size_t count, float frame) {
+    const uint16_t* after = std::upper_bound(frames, frames + count, frame,
+                                             [](float f, uint16_t key) { return f < key; });
+    return after == frames ? 0 : static_cast<size_t>(after - frames) - 1;
+}
+
+} // namespace
+
+AnimationClip::AnimationClip(const RawClip& raw, const ClipCompression& settings)
+    : name(raw.name), frameRate(raw.frameRate) {
+    const size_t frameCount = std::min<size_t>(raw.frameCount(), 65536);
+    const size_t joints = raw.jointCount;
+    duration = frameCount > 1 ? (frameCount - 1) / frameRate : 0.0f;
+    if (frameCount == 0) return;
+    auto pose = [&raw, joints](size_t frame, size_t joint) -> const JointPose& {
+        return raw.frames[frame * joints + joint];
+    };
+
+    for (size_t j = 0; j < joints; j++) {
+        const std::vector<uint16_t> rotations = reduceKeys(
+            frameCount, settings.rotationTolerance, [&](size_t a, size_t b, float t, size_t m) {
+                return angleBetween(nlerp(pose(a, j).rotation, pose(b, j).rotation, t), pose(m, j).rotation);
+            });
+        rotationTracks.push_back({ static_cast<uint32_t>(rotationFrames.size()),
+                                   static_cast<uint32_t>(rotations.size()) });
+        for (uint16_t frame : rotations) {
+            rotationFrames.push_back(frame);
+            uint16_t key[3];
+            encodeRotation(pose(frame, j).rotation, key);
+            rotationKeys.insert(rotationKeys.end(), key, key + 3);
+        }
+
+        const std::vector<uint16_t> translations = reduceKeys(
+            frameCount, settings.translationTolerance, [&](size_t a, size_t b, float t, size_t m) {
+                return distance(lerp(pose(a, j).translation, pose(b, j).translation, t), pose(m, j).translation);
+            });
+        Vec3 min = pose(translations[0], j).translation, max = min;
+        for (uint16_t frame : translations) {
+            const Vec3& t = pose(frame, j).translation;
+            min = Vec3(std::min(min.x, t.x), std::min(min.y, t.y), std::min(min.z, t.z));
+            max = Vec3(std::max(max.x, t.x), std::max(max.y, t.y), std::max(max.z, t.z));
+        }
+        translationRanges.push_back({ min, max - min });
+        translationTracks.push_back({ static_cast<uint32_t>(translationFrames.size()),
+                                      static_cast<uint32_t>(translations.size()) });
+        for (uint16_t frame : translations) {
+            translationFrames.push_back(frame);
+            uint16_t key[3];
+            encodeTranslation(pose(frame, j).translation, min, max - min, key);
+            translationKeys.insert(translationKeys.end(), key, key + 3);
+        }
+    }
+
+    LOG_DEBUG("Clip " << name << ": " << getKeyCount() << " of " << 2 * frameCount * joints << " keys, "
+              << getMemoryBytes() << " bytes (raw " << raw.frames.size() * sizeof(JointPose) << ")");
+}
+
+size_t AnimationClip::getMemoryBytes() const {
+    return sizeof(*this) + (rotationTracks.size() + translationTracks.size()) * sizeof(Track)
+           + translationRanges.size() * sizeof(Range)
+           + (rotationFrames.size() + translationFrames.size()) * sizeof(uint16_t)
+           + (rotationKeys.size() + translationKeys.size()) * sizeof(uint16_t);
+}
+
+void AnimationClip::sample(float time, JointPose* out) const {
+    const float frame = std::min(std::max(time, 0.0f), duration) * frameRate;
+    for (size_t j = 0; j < rotationTracks.size(); j++) {
+        const Track& r = rotationTracks[j];
+        const size_t a = r.firstKey + keyBefore(&rotationFrames[r.firstKey], r.keyCount, frame);
+        const Quat qa = decodeRotation(&rotationKeys[3 * a]);
+        if (a + 1 < r.firstKey + r.keyCount) {
+            const float t = (frame - rotationFrames[a]) / (rotationFrames[a + 1] - rotationFrames[a]);
+            out[j].rotation = nlerp(qa, decodeRotation(&rotationKeys[3 * (a + 1)]), t);
+        } else {
+            out[j].rotation = qa;
+        }
+
+        const Track& p = translationTracks[j];
+        const Range& range = translationRanges[j];
+        const size_t b = p.firstKey + keyBefore(&translationFrames[p.firstKey], p.keyCount, frame);
+        const Vec3 ta = decodeTranslation(&translationKeys[3 * b], range.min, range.extent);
+        if (b + 1 < p.firstKey + p.keyCount) {
+            const float t = (frame - translationFrames[b]) / (translationFrames[b + 1] - translationFrames[b]);
+            out[j].translation = lerp(ta, decodeTranslation(&translationKeys[3 * (b + 1)], range.min, range.extent), t);
+        } else {
+            out[j].translation = ta;
+        }
+    }
+}
+
+void blendPoses(const JointPose* a, const JointPose* b, float t, size_t jointCount, JointPose* out) {
+    for (size_t j = 0; j < jointCount; j++) {
+        out[j].rotation = nlerp(a[j].rotation, b[j].rotation, t);
+        out[j].translation = lerp(a[j].translation, b[j].translation, t);
+    }
+}
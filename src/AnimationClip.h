@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Skeleton.h"
+
+// A clip as authored or generated: every joint's local pose at every frame
+struct RawClip {
+    std::string name;
+    float frameRate = 30.0f;
+    size_t jointCount = 0;
+    std::vector<JointPose> frames; // frame by frame, jointCount poses each
+
+    size_t frameCount() const { return jointCount ? frames.size() / jointCount : 0; }
+};
+
+// How far a compressed clip may stray from its RawClip
+struct ClipCompression {
+    float rotationTolerance = 0.002f;    // radians
+    float translationTolerance = 0.001f; // metres
+};
+
+// A compressed clip. Each joint has a rotation track and a translation
+// track, and each track keeps only the keys it needs: a key goes when
+// interpolating its neighbours reproduces the frames between them within
+// tolerance, so constant tracks shrink to one key and smooth motion to a
+// few. The keys that stay are quantized, rotations to 48 bits ("smallest
+// three": the largest component is dropped and rebuilt from the unit
+// length) and translations to 16 bits per axis over the track's range.
+class AnimationClip {
+public:
+    AnimationClip() = default;
+    explicit AnimationClip(const RawClip& raw, const ClipCompression& settings = ClipCompression());
+
+    const std::string& getName() const { return name; }
+    float getDuration() const { return duration; }
+    size_t getJointCount() const { return rotationTracks.size(); }
+
+    // Local pose of every joint `time` seconds in, clamped to the clip
+    void sample(float time, JointPose* out) const;
+
+    // Keys kept, out of frames x joints x 2 before compression
+    size_t getKeyCount() const { return rotationFrames.size() + translationFrames.size(); }
+    size_t getMemoryBytes() const;
+
+private:
+    struct Track {
+        uint32_t firstKey;
+        uint32_t keyCount;
+    };
+    // Translation keys are fractions of the track's box
+    struct Range {
+        Vec3 min, extent;
+    };
+
+    std::string name;
+    float frameRate = 30.0f;
+    float duration = 0.0f;
+    std::vector<Track> rotationTracks, translationTracks; // one per joint
+    std::vector<Range> translationRanges;
+    std::vector<uint16_t> rotationFrames, translationFrames; // frame of each key
+    std::vector<uint16_t> rotationKeys, translationKeys;     // three per key
+};
+
+// `a` towards `b` by `t`, joint by joint
+void blendPoses(const JointPose* a, const JointPose* b, float t, size_t jointCount, JointPose* out);
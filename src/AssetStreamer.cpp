@@ -0,0 +1,118 @@
+#include "AssetStreamer.h"
+#include "Profiler.h"
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+AssetStreamer::AssetStreamer(unsigned workerCount) {
+    if (workerCount == 0) workerCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    for (unsigned i = 0; i < workerCount; i++) workers.emplace_back(&AssetStreamer::workerLoop, this);
+
+    // Pixel buffer objects are core in 2.1
+    usePbo = GLEW_VERSION_2_1 || GLEW_ARB_pixel_buffer_object;
+    LOG_INFO("Asset streaming on " << workerCount << " worker threads"
+             << (usePbo ? ", textures through PBOs" : ""));
+}
+
+AssetStreamer::~AssetStreamer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        loadQueue.clear();
+    }
+    wake.notify_all();
+    for (auto& worker : workers) worker.join();
+    // Dropped here rather than on the workers: half-uploaded jobs own GL objects
+    uploadQueue.clear();
+    if (pbo) glDeleteBuffers(1, &pbo);
+}
+
+void AssetStreamer::submit(std::function<void()> load, UploadStep upload) {
+    Job job;
+    job.load = std::move(load);
+    job.upload = std::move(upload);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        loadQueue.push_back(std::move(job));
+    }
+    wake.notify_one();
+}
+
+void AssetStreamer::workerLoop() {
+    PROFILE_THREAD("Asset worker");
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !loadQueue.empty(); });
+            if (stopping) return;
+            job = std::move(loadQueue.front());
+            loadQueue.pop_front();
+            loading++;
+        }
+
+        job.load();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        loading--;
+        uploadQueue.push_back(std::move(job));
+    }
+}
+
+bool AssetStreamer::idle() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !uploading && loading == 0 && loadQueue.empty() && uploadQueue.empty();
+}
+
+// ===============================
+// GL Uploads
+// ===============================
+void AssetStreamer::update(double budgetMs, size_t budgetBytes) {
+    PROFILE_SCOPE("AssetStreamer::update");
+    auto start = std::chrono::steady_clock::now();
+    size_t bytes = 0;
+    for (;;) {
+        if (!uploading) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (uploadQueue.empty()) break;
+            current = std::move(uploadQueue.front());
+            uploadQueue.pop_front();
+            uploading = true;
+        }
+
+        if (current.upload(bytes)) {
+            current = Job();
+            uploading = false;
+        }
+
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (ms >= budgetMs || bytes >= budgetBytes) break;
+    }
+    uploadedBytes += bytes;
+}
+
+void AssetStreamer::uploadTextureRows(int level, int y, int rows, int width, GLenum format, int channels,
+                                      const unsigned char* pixels) {
+    if (!usePbo) {
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, y, width, rows, format, GL_UNSIGNED_BYTE, pixels);
+        return;
+    }
+
+    const size_t bytes = static_cast<size_t>(width) * rows * channels;
+    if (!pbo) glGenBuffers(1, &pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    // Orphan the previous storage so mapping never waits for the driver to
+    // finish reading the last chunk
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    void* staging = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+    if (staging) {
+        std::memcpy(staging, pixels, bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, y, width, rows, format, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    } else {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, y, width, rows, format, GL_UNSIGNED_BYTE, pixels);
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <GL/glew.h>
+
+// Background asset loading. Jobs have a CPU half (`load`), run on a pool of
+// worker threads, and a GL half (`upload`), run on the GL thread from
+// update() in small steps so one frame never pays for a whole asset.
+//
+// Destroy the streamer before the objects its jobs point to: pending
+// uploads are dropped and the workers finish their current job and exit.
+class AssetStreamer {
+public:
+    // One upload step: adds the bytes it sent to the GPU to `bytes` and
+    // returns true once the asset is complete
+    typedef std::function<bool(size_t& bytes)> UploadStep;
+    // Largest piece of data one upload step should send
+    static constexpr size_t CHUNK_BYTES = 1 << 20;
+
+    // workerCount = 0 uses one thread per core minus the GL thread
+    explicit AssetStreamer(unsigned workerCount = 0);
+    ~AssetStreamer();
+
+    void submit(std::function<void()> load, UploadStep upload);
+
+    // GL thread, once per frame: runs upload steps until either budget is
+    // spent. At least one step runs per call so a large asset still progresses.
+    void update(double budgetMs, size_t budgetBytes);
+
+    // True when every submitted job has been loaded and uploaded
+    bool idle() const;
+    size_t getUploadedBytes() const { return uploadedBytes; }
+
+    // Copies `rows` rows of tightly packed pixels into mip `level` of the
+    // bound 2D texture at row y through a pixel buffer object, so the driver can DMA from it
+    // instead of copying from client memory. Falls back to a plain
+    // glTexSubImage2D without PBO support.
+    void uploadTextureRows(int level, int y, int rows, int width, GLenum format, int channels, const unsigned char* pixels);
+
+private:
+    struct Job {
+        std::function<void()> load;
+        UploadStep upload;
+    };
+
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Job> loadQueue;   // waiting for a worker
+    std::deque<Job> uploadQueue; // loaded, waiting for the GL thread
+    size_t loading = 0;          // jobs a worker is running right now
+    bool stopping = false;
+
+    // Owned by the GL thread: the job whose upload is part way through
+    Job current;
+    bool uploading = false;
+
+    GLuint pbo = 0;
+    bool usePbo;
+
+    size_t uploadedBytes = 0;
+};
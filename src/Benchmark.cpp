@@ -0,0 +1,337 @@
+#include <GL/glew.h>
+#include <GL/glut.h>
+#include "Benchmark.h"
+#include "AssetStreamer.h"
+#include "Camera.h"
+#include "Character.h"
+#include "EntitySystems.h"
+#include "GlState.h"
+#include "Herd.h"
+#include "Horse.h"
+#include "Rider.h"
+#include "ObjectModel.h"
+#include "OffscreenContext.h"
+#include "RenderQueue.h"
+#include "ResourceManager.h"
+#include "Terrain.h"
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#ifdef __unix__
+#include <sys/resource.h>
+#endif
+
+// ===============================
+// Script
+// ===============================
+bool BenchScript::load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        LOG_ERROR("Could not open benchmark script " << path);
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string command;
+        if (!(words >> command)) continue;
+
+        bool ok = true;
+        if (command == "resolution") {
+            ok = static_cast<bool>(words >> width >> height) && width > 0 && height > 0;
+        } else if (command == "props") {
+            ok = static_cast<bool>(words >> props) && props >= 0;
+        } else if (command == "seed") {
+            ok = static_cast<bool>(words >> seed);
+        } else if (command == "horses") {
+            ok = static_cast<bool>(words >> horses) && horses >= 0;
+        } else if (command == "riders") {
+            ok = static_cast<bool>(words >> riders) && riders >= 0;
+        } else if (command == "warmup") {
+            ok = static_cast<bool>(words >> warmupFrames) && warmupFrames >= 0;
+        } else if (command == "frames") {
+            ok = static_cast<bool>(words >> frames) && frames >= 0;
+        } else if (command == "step") {
+            ok = static_cast<bool>(words >> step) && step > 0.0;
+        } else if (command == "key") {
+            BenchKey key;
+            ok = static_cast<bool>(words >> key.time >> key.player.x >> key.player.y >> key.player.z
+                                   >> key.eye.x >> key.eye.y >> key.eye.z
+                                   >> key.target.x >> key.target.y >> key.target.z);
+            if (ok) keys.push_back(key);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            LOG_ERROR(path << ":" << lineNumber << ": bad line: " << line);
+            return false;
+        }
+    }
+
+    if (keys.empty()) {
+        LOG_ERROR(path << ": no 'key' lines, nothing to fly through");
+        return false;
+    }
+    std::stable_sort(keys.begin(), keys.end(),
+                     [](const BenchKey& a, const BenchKey& b) { return a.time < b.time; });
+    if (frames == 0) frames = static_cast<int>(keys.back().time / step) + 1;
+    return true;
+}
+
+BenchKey BenchScript::sample(double time) const {
+    if (time <= keys.front().time) return keys.front();
+    if (time >= keys.back().time) return keys.back();
+
+    auto next = std::upper_bound(keys.begin(), keys.end(), time,
+                                 [](double t, const BenchKey& key) { return t < key.time; });
+    const BenchKey& a = *(next - 1);
+    const BenchKey& b = *next;
+    float t = static_cast<float>((time - a.time) / (b.time - a.time));
+
+    BenchKey blended;
+    blended.time = time;
+    blended.player = a.player + (b.player - a.player) * t;
+    blended.eye = a.eye + (b.eye - a.eye) * t;
+    blended.target = a.target + (b.target - a.target) * t;
+    return blended;
+}
+
+namespace {
+
+// ===============================
+// Statistics
+// ===============================
+struct Summary {
+    double mean = 0.0, p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0;
+};
+
+Summary summarize(std::vector<double> values) {
+    Summary s;
+    if (values.empty()) return s;
+    std::sort(values.begin(), values.end());
+    // Nearest rank
+    auto rank = [&values](double p) {
+        size_t index = static_cast<size_t>(std::ceil(p * values.size()));
+        return values[std::min(std::max<size_t>(index, 1), values.size()) - 1];
+    };
+    for (double v : values) s.mean += v;
+    s.mean /= values.size();
+    s.p50 = rank(0.50);
+    s.p95 = rank(0.95);
+    s.p99 = rank(0.99);
+    s.max = values.back();
+    return s;
+}
+
+std::string toJson(const Summary& s) {
+    std::ostringstream out;
+    out << "{\"mean\": " << s.mean << ", \"p50\": " << s.p50 << ", \"p95\": " << s.p95
+        << ", \"p99\": " << s.p99 << ", \"max\": " << s.max << "}";
+    return out.str();
+}
+
+std::string quoted(const std::string& s) {
+    std::string q = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') q += '\\';
+        q += c;
+    }
+    return q + '"';
+}
+
+// Peak resident set size, in kilobytes on Linux
+long peakResidentKb() {
+#ifdef __unix__
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) return usage.ru_maxrss;
+#endif
+    return -1;
+}
+
+// Half the side of the herd's square, as in Game
+const float HERD_AREA = 45.0f;
+
+double elapsedMs(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+} // namespace
+
+// ===============================
+// Benchmark
+// ===============================
+int runBenchmark(const std::string& scriptPath, const std::string& outPath) {
+    BenchScript script;
+    if (!script.load(scriptPath)) return 1;
+
+    OffscreenContext gl;
+    if (!gl.create(script.width, script.height)) return 1;
+    LOG_INFO("Benchmark on " << glGetString(GL_RENDERER) << " (" << glGetString(GL_VERSION) << ", "
+             << gl.getApi() << "), " << script.width << "x" << script.height);
+
+    // Same fixed-function state as the game (setup_opengl in main.cpp)
+    const float aspect = static_cast<float>(script.width) / script.height;
+    glClearColor(0.5f, 0.7f, 1.0f, 1.0f);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_LIGHTING);
+    glEnable(GL_LIGHT0);
+    glEnable(GL_COLOR_MATERIAL);
+    glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
+    GLfloat lightPosition[] = { 1.0f, 1.0f, 1.0f, 0.0f };
+    glLightfv(GL_LIGHT0, GL_POSITION, lightPosition);
+
+    // Everything is resident before the first measured frame, loaded
+    // through the same streaming path as the game
+    auto loadStart = std::chrono::steady_clock::now();
+    AssetStreamer* streamer = new AssetStreamer();
+    Character* player = new Character(streamer);
+    World world;
+    Terrain* terrain = new Terrain(world, script.props - script.props / 3, script.props / 3, streamer, script.seed);
+    // The terrain queues its height field resample once the ground is in
+    for (;;) {
+        streamer->update(1e9, SIZE_MAX);
+        terrain->update();
+        if (streamer->idle()) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const double loadMs = elapsedMs(loadStart);
+
+    Herd herd;
+    herd.setArea(Vec3(-HERD_AREA, 0.0f, -HERD_AREA), Vec3(HERD_AREA, 0.0f, HERD_AREA));
+    HorseRenderer horseRenderer;
+    spawnHerd(world, script.horses, Vec3(0.0f, 0.0f, 5.0f), HERD_AREA, herd.getParams().grazeSpeed);
+    Riders riders;
+    mountRiders(world, script.riders);
+    auto groundHeights = [terrain](const std::vector<Vec3>& points, std::vector<float>& heights) {
+        terrain->getHeights(points, heights);
+    };
+
+    Camera camera(nullptr);
+    camera.setProjection(45.0f, aspect, 0.1f, 1000.0f);
+
+    RenderQueue queue;
+    GlState& glState = GlState::get();
+    std::vector<double> frameMs, drawCalls, triangles, stateRequested, stateIssued, queueItems;
+    frameMs.reserve(script.frames);
+    drawCalls.reserve(script.frames);
+    triangles.reserve(script.frames);
+    stateRequested.reserve(script.frames);
+    stateIssued.reserve(script.frames);
+    queueItems.reserve(script.frames);
+    for (int frame = -script.warmupFrames; frame < script.frames; frame++) {
+        // Warm-up frames hold the first view
+        BenchKey at = script.sample(std::max(frame, 0) * script.step);
+        auto start = std::chrono::steady_clock::now();
+        ObjModel::resetDrawStats();
+        glState.resetStats();
+
+        // As Simulation::tick and Game::update, at the path's pace: tiles
+        // page in around the player and props waiting on them settle; the
+        // herd flees the player
+        terrain->updatePaging(at.player, Vec3());
+        terrain->update();
+        if (script.horses > 0) {
+            const float dt = static_cast<float>(script.step);
+            herd.update(world, at.player, dt);
+            integrateMotion(world, dt);
+            updateHorses(world, groundHeights);
+            updateHorseColliders(world, terrain->getCollision());
+            riders.update(world, dt);
+        }
+
+        // As Game::render
+        glState.enable(GL_DEPTH_TEST);
+        glState.enable(GL_CULL_FACE);
+        glState.cullFace(GL_BACK);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glMatrixMode(GL_MODELVIEW);
+        glLoadIdentity();
+        camera.setView(at.eye, at.target);
+        camera.apply();
+        if (script.horses > 0) {
+            CullStats entityCull;
+            cullEntities(world, camera.getFrustum(), entityCull);
+        }
+        terrain->enqueue(camera, queue);
+        if (script.horses > 0) {
+            horseRenderer.enqueue(world, queue);
+            riders.enqueue(world, queue);
+        }
+        player->enqueue(queue, camera, at.player);
+        const size_t items = queue.size();
+        queue.sort();
+        queue.submit();
+
+        // No swap to wait on: finishing the frame is what makes the time
+        // include the GPU's (or llvmpipe's) share
+        glFinish();
+        if (frame < 0) continue;
+        frameMs.push_back(elapsedMs(start));
+        drawCalls.push_back(static_cast<double>(ObjModel::getDrawStats().drawCalls));
+        triangles.push_back(static_cast<double>(ObjModel::getDrawStats().triangles));
+        stateRequested.push_back(static_cast<double>(glState.getStats().requested));
+        stateIssued.push_back(static_cast<double>(glState.getStats().issued));
+        queueItems.push_back(static_cast<double>(items));
+    }
+
+    const Summary frameSummary = summarize(frameMs);
+    const Summary drawSummary = summarize(drawCalls);
+    const Summary triangleSummary = summarize(triangles);
+    const ResourceManager::Stats resources = ResourceManager::get().getStats();
+
+    std::ostringstream json;
+    json << "{\n"
+         << "  \"script\": " << quoted(scriptPath) << ",\n"
+         << "  \"renderer\": " << quoted(reinterpret_cast<const char*>(glGetString(GL_RENDERER))) << ",\n"
+         << "  \"gl_version\": " << quoted(reinterpret_cast<const char*>(glGetString(GL_VERSION))) << ",\n"
+         << "  \"context\": " << quoted(gl.getApi()) << ",\n"
+         << "  \"mesh_path\": " << quoted(ObjModel::usingDisplayLists() ? "display lists" : "indexed VBO") << ",\n"
+         << "  \"terrain_path\": " << quoted(terrain->usingCdlod() ? "cdlod" : "full mesh") << ",\n"
+         << "  \"resolution\": [" << script.width << ", " << script.height << "],\n"
+         << "  \"props\": " << script.props << ",\n"
+         << "  \"horses\": " << script.horses << ",\n"
+         << "  \"riders\": " << std::min(script.riders, script.horses) << ",\n"
+         << "  \"frames\": " << frameMs.size() << ",\n"
+         << "  \"load_ms\": " << loadMs << ",\n"
+         << "  \"frame_ms\": " << toJson(frameSummary) << ",\n"
+         << "  \"fps\": " << (frameSummary.mean > 0.0 ? 1000.0 / frameSummary.mean : 0.0) << ",\n"
+         << "  \"draw_calls\": " << toJson(drawSummary) << ",\n"
+         << "  \"triangles\": " << toJson(triangleSummary) << ",\n"
+         << "  \"queue_items\": " << toJson(summarize(queueItems)) << ",\n"
+         // Without the state cache every requested call would reach GL
+         << "  \"state_cache\": " << (glState.isCaching() ? "true" : "false") << ",\n"
+         << "  \"state_changes_requested\": " << toJson(summarize(stateRequested)) << ",\n"
+         << "  \"state_changes_issued\": " << toJson(summarize(stateIssued)) << ",\n"
+         << "  \"peak_rss_kb\": " << peakResidentKb() << ",\n"
+         << "  \"gpu_mesh_kb\": " << ObjModel::getGpuMeshBytes() / 1024 << ",\n"
+         << "  \"texture_kb\": " << resources.residentBytes / 1024 << "\n"
+         << "}\n";
+
+    delete streamer;
+    delete player;
+    delete terrain;
+
+    if (outPath.empty()) {
+        // After everything logged so far, so the JSON comes out in one piece
+        Log::flush();
+        std::cout << json.str();
+    } else {
+        std::ofstream out(outPath);
+        if (!(out << json.str())) {
+            LOG_ERROR("Could not write " << outPath);
+            return 1;
+        }
+        LOG_INFO("Benchmark results written to " << outPath);
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Vec3.h"
+
+// One point on a benchmark path. The player, eye and target are blended
+// linearly between keys.
+struct BenchKey {
+    double time;
+    Vec3 player, eye, target;
+};
+
+// A benchmark script, one command per line ('#' starts a comment):
+//
+//   resolution 1280 720   offscreen framebuffer size
+//   props 300             trees and rocks, split 2:1 as with FALLAGA_PROPS
+//   seed 1                prop layout (0 picks a new one each run)
+//   horses 0              herd simulated and drawn, as with FALLAGA_HORSES
+//   riders 0              animated riders on that many of the horses
+//   warmup 30             frames drawn before measuring
+//   frames 600            measured frames; default covers the whole path
+//   step 0.0166667        path seconds per frame, whatever the real frame time
+//   key <time> <player xyz> <eye xyz> <target xyz>
+//
+// Games run with FALLAGA_RECORD=<file> write their path in this format.
+struct BenchScript {
+    int width = 1280, height = 720;
+    int props = 30;
+    unsigned seed = 1;
+    int horses = 0;
+    int riders = 0;
+    int warmupFrames = 30;
+    int frames = 0;
+    double step = 1.0 / 60.0;
+    std::vector<BenchKey> keys;
+
+    // False (with a message) if the file can't be read or has no keys
+    bool load(const std::string& path);
+    BenchKey sample(double time) const;
+};
+
+// Headless mode behind `--bench <script> [--out <file>]`: renders the
+// script's path offscreen as fast as possible and prints frame time
+// statistics as JSON (to `outPath` if given). Returns the exit code.
+int runBenchmark(const std::string& scriptPath, const std::string& outPath);
@@ -0,0 +1,273 @@
+#include "Bvh.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const int SAH_BINS = 16;
+const uint32_t MAX_LEAF_SIZE = 4;
+const int MAX_DEPTH = 64;          // also the traversal stack size
+// Rays per parallelFor chunk in the batched queries
+const size_t RAYS_PER_JOB = 64;
+
+struct Aabb {
+    Vec3 lo, hi;
+    Aabb() : lo(1e30f, 1e30f, 1e30f), hi(-1e30f, -1e30f, -1e30f) {}
+    void grow(const Vec3& p) {
+        lo.x = std::min(lo.x, p.x); lo.y = std::min(lo.y, p.y); lo.z = std::min(lo.z, p.z);
+        hi.x = std::max(hi.x, p.x); hi.y = std::max(hi.y, p.y); hi.z = std::max(hi.z, p.z);
+    }
+    void grow(const Aabb& b) { grow(b.lo); grow(b.hi); }
+    float area() const {
+        Vec3 d = hi - lo;
+        if (d.x < 0.0f) return 0.0f;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+};
+
+inline float axisOf(const Vec3& v, int axis) {
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+inline int binOf(float c, float lo, float scale) {
+    return std::min(SAH_BINS - 1, std::max(0, static_cast<int>((c - lo) * scale)));
+}
+
+} // namespace
+
+struct Bvh::BuildPrim {
+    Aabb bounds;
+    Vec3 centroid;
+    uint32_t face;
+};
+
+// ===============================
+// Build
+// ===============================
+void Bvh::clear() {
+    nodes.clear();
+    triangleIds.clear();
+    triangles.clear();
+}
+
+void Bvh::build(const std::vector<Vec3>& vertices, const std::vector<Face>& faces) {
+    clear();
+
+    const int vertexCount = static_cast<int>(vertices.size());
+    std::vector<BuildPrim> prims;
+    prims.reserve(faces.size());
+    for (size_t i = 0; i < faces.size(); i++) {
+        const Face& f = faces[i];
+        bool valid = true;
+        for (int k = 0; k < 3; k++)
+            if (f.v[k] < 0 || f.v[k] >= vertexCount) valid = false;
+        if (!valid) continue;
+
+        BuildPrim p;
+        for (int k = 0; k < 3; k++) p.bounds.grow(vertices[f.v[k]]);
+        p.centroid = (p.bounds.lo + p.bounds.hi) * 0.5f;
+        p.face = static_cast<uint32_t>(i);
+        prims.push_back(p);
+    }
+    if (prims.empty()) return;
+
+    nodes.reserve(prims.size() / 2 + 1);
+    buildNode(prims, 0, static_cast<uint32_t>(prims.size()), 0);
+    nodes.shrink_to_fit();
+
+    // Store triangles in leaf order so each leaf reads one contiguous range
+    triangleIds.resize(prims.size());
+    triangles.resize(prims.size());
+    for (size_t i = 0; i < prims.size(); i++) {
+        const Face& f = faces[prims[i].face];
+        triangleIds[i] = prims[i].face;
+        triangles.set(i, vertices[f.v[0]], vertices[f.v[1]], vertices[f.v[2]]);
+    }
+}
+
+uint32_t Bvh::buildNode(std::vector<BuildPrim>& prims, uint32_t begin, uint32_t end, int depth) {
+    const uint32_t index = static_cast<uint32_t>(nodes.size());
+    nodes.push_back(Node());
+
+    Aabb bounds, centroidBounds;
+    for (uint32_t i = begin; i < end; i++) {
+        bounds.grow(prims[i].bounds);
+        centroidBounds.grow(prims[i].centroid);
+    }
+    nodes[index].boundsMin[0] = bounds.lo.x; nodes[index].boundsMin[1] = bounds.lo.y; nodes[index].boundsMin[2] = bounds.lo.z;
+    nodes[index].boundsMax[0] = bounds.hi.x; nodes[index].boundsMax[1] = bounds.hi.y; nodes[index].boundsMax[2] = bounds.hi.z;
+
+    const uint32_t count = end - begin;
+    auto makeLeaf = [&]() {
+        nodes[index].first = begin;
+        nodes[index].count = count;
+        return index;
+    };
+    if (count <= MAX_LEAF_SIZE || depth >= MAX_DEPTH - 1) return makeLeaf();
+
+    // Binned SAH over centroids on every axis
+    int bestAxis = -1, bestSplit = 0;
+    float bestCost = 1e30f;
+    for (int axis = 0; axis < 3; axis++) {
+        float lo = axisOf(centroidBounds.lo, axis), hi = axisOf(centroidBounds.hi, axis);
+        if (hi - lo <= 1e-12f) continue;
+        float scale = SAH_BINS / (hi - lo);
+
+        Aabb binBounds[SAH_BINS];
+        uint32_t binCount[SAH_BINS] = {};
+        for (uint32_t i = begin; i < end; i++) {
+            int b = binOf(axisOf(prims[i].centroid, axis), lo, scale);
+            binCount[b]++;
+            binBounds[b].grow(prims[i].bounds);
+        }
+
+        // Right-to-left sweep for suffix areas, then left-to-right for the cost
+        float rightArea[SAH_BINS];
+        uint32_t rightCount[SAH_BINS];
+        Aabb acc;
+        uint32_t n = 0;
+        for (int b = SAH_BINS - 1; b > 0; b--) {
+            acc.grow(binBounds[b]);
+            n += binCount[b];
+            rightArea[b] = acc.area();
+            rightCount[b] = n;
+        }
+        acc = Aabb();
+        n = 0;
+        for (int b = 0; b < SAH_BINS - 1; b++) {
+            acc.grow(binBounds[b]);
+            n += binCount[b];
+            if (n == 0 || rightCount[b + 1] == 0) continue;
+            float cost = acc.area() * n + rightArea[b + 1] * rightCount[b + 1];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b + 1;
+            }
+        }
+    }
+
+    // Leaves are capped at MAX_LEAF_SIZE; SAH only decides where to split.
+    // (Letting SAH also stop early made larger leaves and slower traversal.)
+    uint32_t mid;
+    if (bestAxis >= 0) {
+        float lo = axisOf(centroidBounds.lo, bestAxis);
+        float scale = SAH_BINS / (axisOf(centroidBounds.hi, bestAxis) - lo);
+        auto it = std::partition(prims.begin() + begin, prims.begin() + end, [&](const BuildPrim& p) {
+            return binOf(axisOf(p.centroid, bestAxis), lo, scale) < bestSplit;
+        });
+        mid = static_cast<uint32_t>(it - prims.begin());
+    } else {
+        // Every centroid coincides; split down the middle
+        mid = begin + count / 2;
+    }
+    if (mid == begin || mid == end) mid = begin + count / 2;
+
+    // Left child lands at index + 1, right child after the whole left subtree
+    buildNode(prims, begin, mid, depth + 1);
+    uint32_t right = buildNode(prims, mid, end, depth + 1);
+    nodes[index].first = right;
+    nodes[index].count = 0;
+    return index;
+}
+
+// ===============================
+// Traversal
+// ===============================
+namespace {
+
+// Slab test; returns the entry distance or a huge value on a miss
+inline float rayBoxDistance(const float lo[3], const float hi[3], const Vec3& origin,
+                            const Vec3& invDir, float maxT) {
+    float tx1 = (lo[0] - origin.x) * invDir.x, tx2 = (hi[0] - origin.x) * invDir.x;
+    float tmin = std::min(tx1, tx2), tmax = std::max(tx1, tx2);
+    float ty1 = (lo[1] - origin.y) * invDir.y, ty2 = (hi[1] - origin.y) * invDir.y;
+    tmin = std::max(tmin, std::min(ty1, ty2)); tmax = std::min(tmax, std::max(ty1, ty2));
+    float tz1 = (lo[2] - origin.z) * invDir.z, tz2 = (hi[2] - origin.z) * invDir.z;
+    tmin = std::max(tmin, std::min(tz1, tz2)); tmax = std::min(tmax, std::max(tz1, tz2));
+    return (tmax >= tmin && tmax > 0.0f && tmin <= maxT) ? tmin : 1e30f;
+}
+
+inline float safeInverse(float d) {
+    return (std::fabs(d) > 1e-20f) ? 1.0f / d : (d < 0.0f ? -1e30f : 1e30f);
+}
+
+} // namespace
+
+template <bool AnyHit>
+bool Bvh::traverse(const Ray& ray, RayHit& out) const {
+    if (nodes.empty()) return false;
+
+    const Vec3 invDir(safeInverse(ray.dir.x), safeInverse(ray.dir.y), safeInverse(ray.dir.z));
+    float bestT = ray.maxT;
+    bool found = false;
+
+    uint32_t stack[MAX_DEPTH];
+    int top = 0;
+    uint32_t current = 0;
+    if (rayBoxDistance(nodes[0].boundsMin, nodes[0].boundsMax, ray.origin, invDir, bestT) >= 1e30f) return false;
+
+    while (true) {
+        const Node& node = nodes[current];
+        if (node.count > 0) {
+            if (AnyHit) {
+                if (soaAnyHit(triangles, node.first, node.first + node.count, ray.origin, ray.dir, bestT)) {
+                    out.hit = true;
+                    return true;
+                }
+            } else {
+                float t;
+                size_t index;
+                if (soaClosestHit(triangles, node.first, node.first + node.count, ray.origin, ray.dir, bestT, t, index)) {
+                    bestT = t;
+                    out.t = t;
+                    out.triangle = triangleIds[index];
+                    out.hit = true;
+                    found = true;
+                }
+            }
+        } else {
+            // Visit the nearer child first and push the other one
+            uint32_t left = current + 1, right = node.first;
+            float dl = rayBoxDistance(nodes[left].boundsMin, nodes[left].boundsMax, ray.origin, invDir, bestT);
+            float dr = rayBoxDistance(nodes[right].boundsMin, nodes[right].boundsMax, ray.origin, invDir, bestT);
+            if (dl > dr) {
+                std::swap(dl, dr);
+                std::swap(left, right);
+            }
+            if (dl < 1e30f) {
+                if (dr < 1e30f) stack[top++] = right;
+                current = left;
+                continue;
+            }
+        }
+        if (top == 0) break;
+        current = stack[--top];
+    }
+    return found;
+}
+
+bool Bvh::closestHit(const Ray& ray, RayHit& out) const {
+    out = RayHit();
+    return traverse<false>(ray, out);
+}
+
+bool Bvh::anyHit(const Ray& ray) const {
+    RayHit scratch;
+    return traverse<true>(ray, scratch);
+}
+
+void Bvh::closestHits(const std::vector<Ray>& rays, std::vector<RayHit>& out) const {
+    out.resize(rays.size());
+    JobSystem::get().parallelFor(rays.size(), RAYS_PER_JOB, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) closestHit(rays[i], out[i]);
+    });
+}
+
+void Bvh::anyHits(const std::vector<Ray>& rays, std::vector<uint8_t>& out) const {
+    out.resize(rays.size());
+    JobSystem::get().parallelFor(rays.size(), RAYS_PER_JOB, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) out[i] = anyHit(rays[i]) ? 1 : 0;
+    });
+}
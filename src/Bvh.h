@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "MeshData.h"
+#include "TriangleSoA.h"
+
+struct Ray {
+    Vec3 origin;
+    Vec3 dir;
+    float maxT;
+    Ray() : maxT(1e30f) {}
+    Ray(const Vec3& origin, const Vec3& dir, float maxT = 1e30f) : origin(origin), dir(dir), maxT(maxT) {}
+};
+
+struct RayHit {
+    float t;
+    uint32_t triangle; // index into the face list the BVH was built from
+    bool hit;
+    RayHit() : t(0.0f), triangle(0), hit(false) {}
+};
+
+// Bounding volume hierarchy over a triangle mesh, built with the surface area
+// heuristic and stored as a flat depth-first node array (32 bytes per node).
+// Triangles are reordered so every leaf covers a contiguous range.
+class Bvh {
+public:
+    void build(const std::vector<Vec3>& vertices, const std::vector<Face>& faces);
+    void clear();
+    bool empty() const { return nodes.empty(); }
+
+    // Nearest hit along the ray within (0, ray.maxT]
+    bool closestHit(const Ray& ray, RayHit& out) const;
+    // True as soon as any triangle is hit within (0, ray.maxT]; for occlusion
+    bool anyHit(const Ray& ray) const;
+
+    // Batched queries, split across the job system's threads (see JobSystem.h)
+    void closestHits(const std::vector<Ray>& rays, std::vector<RayHit>& out) const;
+    void anyHits(const std::vector<Ray>& rays, std::vector<uint8_t>& out) const;
+
+    size_t nodeCount() const { return nodes.size(); }
+    size_t triangleCount() const { return triangleIds.size(); }
+    // Every triangle in leaf order, for callers that want a plain linear scan
+    const TriangleSoA& getTriangles() const { return triangles; }
+
+private:
+    // Leaves have count > 0 and cover [first, first + count) of the reordered
+    // triangles; interior nodes have count == 0, their left child directly
+    // follows them and `first` is the right child's index
+    struct Node {
+        float boundsMin[3];
+        uint32_t first;
+        float boundsMax[3];
+        uint32_t count;
+    };
+
+    struct BuildPrim;
+    uint32_t buildNode(std::vector<BuildPrim>& prims, uint32_t begin, uint32_t end, int depth);
+
+    template <bool AnyHit>
+    bool traverse(const Ray& ray, RayHit& out) const;
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> triangleIds; // original face index per reordered triangle
+    TriangleSoA triangles;             // reordered triangles, tested with the SIMD kernel
+};
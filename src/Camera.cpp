@@ -3,6 +3,7 @@
 #include <GL/glut.h>
 #include "Camera.h"
 #include "Character.h"
+#include "Profiler.h"
 #include <cmath>
 #include <iostream> // For debugging
 #include"Vec3.h"
@@ -57,19 +58,51 @@ void Camera::update() {
     position.z = targetPos.z + distance * cos(radPitch) * cos(radYaw);
 }
 
+void Camera::clampDistance(float maxDistance) {
+    if (maxDistance >= distance) return;
+    if (maxDistance < 0.5f) maxDistance = 0.5f;
+
+    float scale = maxDistance / distance;
+    position.x = targetPos.x + (position.x - targetPos.x) * scale;
+    position.y = targetPos.y + (position.y - targetPos.y) * scale;
+    position.z = targetPos.z + (position.z - targetPos.z) * scale;
+}
+
+void Camera::setView(const Vec3& eye, const Vec3& target) {
+    position = eye;
+    targetPos = target;
+}
+
 void Camera::apply() {
+    PROFILE_SCOPE("Camera::apply");
+    view = Mat4::lookAt(position, targetPos, Vec3(0.0f, 1.0f, 0.0f));
+    glMatrixMode(GL_PROJECTION);
+    glLoadMatrixf(projection.m);
     glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-    
-    // Calculate the camera's up vector
-    Vec3 up(0.0f, 1.0f, 0.0f);
-    
-    // Call gluLookAt to set the camera's view
-    gluLookAt(
-        position.x, position.y, position.z,
-        targetPos.x, targetPos.y, targetPos.z,
-        up.x, up.y, up.z
-    );
+    glLoadMatrixf(view.m);
+}
+
+void Camera::setProjection(float fovY, float aspect, float zNear, float zFar) {
+    this->fovY = fovY;
+    this->aspect = aspect;
+    this->zNear = zNear;
+    this->zFar = zFar;
+    projection = Mat4::perspective(fovY, aspect, zNear, zFar);
+}
+
+Frustum Camera::getFrustum() const {
+    // From the current position rather than the last apply(), for callers
+    // that cull before drawing
+    const Mat4 clip = projection * Mat4::lookAt(position, targetPos, Vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum;
+    frustum.fromMatrix(clip.m);
+    return frustum;
+}
+
+float Camera::screenSize(const Vec3& center, float radius) const {
+    float distance = (center - position).length();
+    float halfHeight = distance * std::tan(fovY * 3.14159265f / 360.0f);
+    return halfHeight > 1e-6f ? radius / halfHeight : 1e6f;
 }
 
 Vec3 Camera::getForward() const {
@@ -3,6 +3,8 @@
 #include <map>
 #include <GL/glut.h>
 #include "Vec3.h" 
+#include "Frustum.h"
+#include "Mat4.h"
 
 // Forward declaration to break the circular dependency
 class Character; 
@@ -11,13 +13,31 @@ class Camera {
 public:
     Camera(Character* target);
     void update();
+    // Builds the view matrix and loads it and the projection into GL
     void apply();
+    // Perspective projection that apply() loads; culling uses the same
+    void setProjection(float fovY, float aspect, float zNear, float zFar);
+    const Mat4& getProjection() const { return projection; }
+    // As of the last apply()
+    const Mat4& getView() const { return view; }
+    // View frustum of the camera as set up by apply()
+    Frustum getFrustum() const;
+    // Radius of a sphere at `center` relative to half the view height;
+    // 1 means it fills the screen vertically. Used for LOD selection.
+    float screenSize(const Vec3& center, float radius) const;
     void handleMouse(double xpos, double ypos);
+    // Moves the camera toward the target so it is at most maxDistance away
+    // (used when something blocks the view of the player)
+    void clampDistance(float maxDistance);
+    // Places the camera directly, for a view camera that follows
+    // interpolated simulation state instead of a target
+    void setView(const Vec3& eye, const Vec3& target);
     
     // Add these methods to allow the character to move relative to the camera
     Vec3 getForward() const;
     Vec3 getRight() const;
     Vec3 getPosition() const;
+    Vec3 getTarget() const { return targetPos; }
 
 private:
     Character* target;
@@ -29,6 +49,12 @@ private:
     double lastX;
     double lastY;
     bool firstMouse;
+    float fovY = 45.0f;
+    float aspect = 4.0f / 3.0f;
+    float zNear = 0.1f;
+    float zFar = 1000.0f;
+    Mat4 projection = Mat4::perspective(fovY, aspect, zNear, zFar);
+    Mat4 view = Mat4::identity();
 };
 
 #endif
@@ -0,0 +1,389 @@
+#include "CdlodTerrain.h"
+#include "Camera.h"
+#include "GlState.h"
+#include "ObjectModel.h"
+#include "Profiler.h"
+#include "Log.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <string>
+
+namespace {
+
+// Finest sample grid resampleHeightField makes, per side
+const int MAX_CELLS = 2048;
+// Range of the finest level, in leaf node sizes; each level doubles it
+const float NEAR_RANGE_NODES = 2.0f;
+// Fraction of a level's range band after which it morphs into the next
+const float MORPH_START = 0.7f;
+
+const int QUADRANT_QUADS = CdlodTerrain::PATCH_QUADS / 2;
+const GLsizei QUADRANT_INDICES = QUADRANT_QUADS * QUADRANT_QUADS * 6;
+
+// Patch vertices are (x, z) in [0, 1] as gl_Vertex.xy. Height, normal and
+// texture coordinate all come from the world position.
+const char* VERTEX_SHADER = R"(
+#version 120
+uniform sampler2D heightMap;
+uniform vec4 heightMapTransform; // origin x, origin z, 1 / spacing, 1 / resolution
+uniform vec4 node;               // min x, min z, size
+uniform vec2 morph;              // distance the morph starts at, 1 / its length
+uniform vec3 eye;
+uniform vec4 textureTransform;   // min x, min z, 1 / width, 1 / depth
+varying vec4 litColor;
+varying vec2 texCoord;
+
+float heightAt(vec2 p) {
+    vec2 uv = ((p - heightMapTransform.xy) * heightMapTransform.z + 0.5) * heightMapTransform.w;
+    return texture2DLod(heightMap, uv, 0.0).r;
+}
+
+void main() {
+    vec2 grid = gl_Vertex.xy;
+    vec2 p = node.xy + grid * node.z;
+    float k = clamp((distance(eye, vec3(p.x, heightAt(p), p.y)) - morph.x) * morph.y, 0.0, 1.0);
+    // Odd vertices slide onto the midpoint of their even neighbours, which
+    // is where the next coarser level has its edge
+    vec2 odd = fract(grid * (PATCH_QUADS * 0.5)) * (2.0 / PATCH_QUADS);
+    p -= odd * node.z * k;
+
+    float h = heightAt(p);
+    float d = 1.0 / heightMapTransform.z;
+    vec3 n = vec3(heightAt(p - vec2(d, 0.0)) - heightAt(p + vec2(d, 0.0)), 2.0 * d,
+                  heightAt(p - vec2(0.0, d)) - heightAt(p + vec2(0.0, d)));
+
+    vec3 eyeNormal = normalize(gl_NormalMatrix * n);
+    vec3 lightDir = normalize(gl_LightSource[0].position.xyz);
+    float diffuse = max(dot(eyeNormal, lightDir), 0.0);
+    vec4 ambient = gl_LightModel.ambient + gl_LightSource[0].ambient;
+    litColor = gl_Color * ambient + gl_Color * gl_LightSource[0].diffuse * diffuse;
+    litColor.a = gl_Color.a;
+
+    texCoord = (p - textureTransform.xy) * textureTransform.zw;
+    gl_Position = gl_ModelViewProjectionMatrix * vec4(p.x, h, p.y, 1.0);
+}
+)";
+
+const char* FRAGMENT_SHADER = R"(
+#version 120
+uniform sampler2D diffuseMap;
+uniform bool useTexture;
+varying vec4 litColor;
+varying vec2 texCoord;
+
+void main() {
+    vec4 color = litColor;
+    if (useTexture) color *= texture2D(diffuseMap, texCoord);
+    gl_FragColor = color;
+}
+)";
+
+GLuint compileShader(GLenum type, const std::string& source) {
+    GLuint shader = glCreateShader(type);
+    const char* text = source.c_str();
+    glShaderSource(shader, 1, &text, nullptr);
+    glCompileShader(shader);
+
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        LOG_ERROR("Terrain shader failed to compile: " << log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+bool sphereIntersectsBox(const Vec3& center, float radius, const Vec3& lo, const Vec3& hi) {
+    const float dx = std::max(std::max(lo.x - center.x, 0.0f), center.x - hi.x);
+    const float dy = std::max(std::max(lo.y - center.y, 0.0f), center.y - hi.y);
+    const float dz = std::max(std::max(lo.z - center.z, 0.0f), center.z - hi.z);
+    return dx * dx + dy * dy + dz * dz <= radius * radius;
+}
+
+} // namespace
+
+// ===============================
+// Height Field
+// ===============================
+bool resampleHeightField(const ObjModel& ground, HeightField& out) {
+    // A failed load leaves the fallback cube, which has nothing to sample
+    if (!ground.isLoaded() || ground.temp_faces.empty()) return false;
+
+    Vec3 lo, hi;
+    ground.getBounds(lo, hi);
+    return resampleHeightField(lo, hi, meshSampleSpacing(lo, hi, ground.temp_faces.size()), CdlodTerrain::PATCH_QUADS,
+                               MAX_CELLS,
+                               [&ground](const std::vector<Vec3>& points, std::vector<float>& heights) {
+                                   ground.getHeightsAt(points, heights);
+                               },
+                               out);
+}
+
+// ===============================
+// Setup
+// ===============================
+CdlodTerrain::CdlodTerrain() {
+    // Float textures in the vertex shader; GL 3.0 guarantees both
+    if (!GLEW_VERSION_3_0 || !compileProgram()) {
+        LOG_INFO("CDLOD terrain unavailable, drawing the ground mesh whole");
+        return;
+    }
+    buildPatch();
+}
+
+CdlodTerrain::~CdlodTerrain() {
+    GlState& state = GlState::get();
+    if (program) state.deleteProgram(program);
+    if (heightTexture) state.deleteTextures(1, &heightTexture);
+    if (vao) state.deleteVertexArrays(1, &vao);
+    if (vbo) glDeleteBuffers(1, &vbo);
+    if (ibo) glDeleteBuffers(1, &ibo);
+}
+
+bool CdlodTerrain::compileProgram() {
+    const std::string defines = "#define PATCH_QUADS " + std::to_string(PATCH_QUADS) + ".0\n";
+    // #version has to stay the first line
+    std::string vertexSource = VERTEX_SHADER;
+    vertexSource.insert(vertexSource.find('\n', 1) + 1, defines);
+    GLuint vs = compileShader(GL_VERTEX_SHADER, vertexSource);
+    GLuint fs = compileShader(GL_FRAGMENT_SHADER, FRAGMENT_SHADER);
+    if (!vs || !fs) {
+        if (vs) glDeleteShader(vs);
+        if (fs) glDeleteShader(fs);
+        return false;
+    }
+
+    program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+        LOG_ERROR("Terrain shader failed to link: " << log);
+        glDeleteProgram(program);
+        program = 0;
+        return false;
+    }
+
+    GlState::get().useProgram(program);
+    glUniform1i(glGetUniformLocation(program, "diffuseMap"), 0);
+    glUniform1i(glGetUniformLocation(program, "heightMap"), 1);
+    heightMapLocation = glGetUniformLocation(program, "heightMapTransform");
+    nodeLocation = glGetUniformLocation(program, "node");
+    morphLocation = glGetUniformLocation(program, "morph");
+    eyeLocation = glGetUniformLocation(program, "eye");
+    textureTransformLocation = glGetUniformLocation(program, "textureTransform");
+    useTextureLocation = glGetUniformLocation(program, "useTexture");
+    return true;
+}
+
+// The shared patch. Indices are laid out a quadrant at a time, so a node
+// can draw any of its quarters with one range.
+void CdlodTerrain::buildPatch() {
+    const int side = PATCH_QUADS + 1;
+    std::vector<float> vertices;
+    vertices.reserve(side * side * 2);
+    for (int z = 0; z < side; z++) {
+        for (int x = 0; x < side; x++) {
+            vertices.push_back(static_cast<float>(x) / PATCH_QUADS);
+            vertices.push_back(static_cast<float>(z) / PATCH_QUADS);
+        }
+    }
+
+    std::vector<GLushort> indices;
+    indices.reserve(QUADRANT_INDICES * 4);
+    for (int q = 0; q < 4; q++) {
+        const int x0 = (q & 1) * QUADRANT_QUADS, z0 = (q >> 1) * QUADRANT_QUADS;
+        for (int z = z0; z < z0 + QUADRANT_QUADS; z++) {
+            for (int x = x0; x < x0 + QUADRANT_QUADS; x++) {
+                // Counter-clockwise seen from above, as the mesh is
+                const GLushort i = static_cast<GLushort>(z * side + x);
+                const GLushort quad[6] = { i, static_cast<GLushort>(i + side), static_cast<GLushort>(i + 1),
+                                           static_cast<GLushort>(i + 1), static_cast<GLushort>(i + side),
+                                           static_cast<GLushort>(i + side + 1) };
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+        }
+    }
+
+    glGenVertexArrays(1, &vao);
+    GlState::get().bindVertexArray(vao);
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 0, nullptr);
+    glGenBuffers(1, &ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+    GlState::get().bindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void CdlodTerrain::setHeightField(HeightField&& heights, const Vec3& groundMin, const Vec3& groundMax) {
+    if (!program) return;
+    field = std::move(heights);
+    textureMin = groundMin;
+    textureMax = groundMax;
+
+    // Level 0 nodes are one patch of samples; each level up halves the count
+    levelCount = 1;
+    while ((PATCH_QUADS << (levelCount - 1)) < field.cells) levelCount++;
+    const int leaves = field.cells / PATCH_QUADS;
+    nodeMinY.assign(levelCount, std::vector<float>());
+    nodeMaxY.assign(levelCount, std::vector<float>());
+    nodeMinY[0].resize(static_cast<size_t>(leaves) * leaves);
+    nodeMaxY[0].resize(static_cast<size_t>(leaves) * leaves);
+    for (int nz = 0; nz < leaves; nz++) {
+        for (int nx = 0; nx < leaves; nx++) {
+            float lo = FLT_MAX, hi = -FLT_MAX;
+            for (int z = nz * PATCH_QUADS; z <= (nz + 1) * PATCH_QUADS; z++) {
+                for (int x = nx * PATCH_QUADS; x <= (nx + 1) * PATCH_QUADS; x++) {
+                    lo = std::min(lo, field.at(x, z));
+                    hi = std::max(hi, field.at(x, z));
+                }
+            }
+            nodeMinY[0][nz * leaves + nx] = lo;
+            nodeMaxY[0][nz * leaves + nx] = hi;
+        }
+    }
+    for (int level = 1; level < levelCount; level++) {
+        const int n = leaves >> level, below = n * 2;
+        nodeMinY[level].resize(static_cast<size_t>(n) * n);
+        nodeMaxY[level].resize(static_cast<size_t>(n) * n);
+        for (int z = 0; z < n; z++) {
+            for (int x = 0; x < n; x++) {
+                float lo = FLT_MAX, hi = -FLT_MAX;
+                for (int q = 0; q < 4; q++) {
+                    const size_t child = static_cast<size_t>(z * 2 + (q >> 1)) * below + x * 2 + (q & 1);
+                    lo = std::min(lo, nodeMinY[level - 1][child]);
+                    hi = std::max(hi, nodeMaxY[level - 1][child]);
+                }
+                nodeMinY[level][z * n + x] = lo;
+                nodeMaxY[level][z * n + x] = hi;
+            }
+        }
+    }
+
+    ranges.resize(levelCount);
+    morphStarts.resize(levelCount);
+    const float leafSize = PATCH_QUADS * field.spacing;
+    for (int level = 0; level < levelCount; level++) {
+        ranges[level] = NEAR_RANGE_NODES * leafSize * static_cast<float>(1 << level);
+        const float previous = level ? ranges[level - 1] : 0.0f;
+        morphStarts[level] = previous + (ranges[level] - previous) * MORPH_START;
+    }
+
+    if (!heightTexture) glGenTextures(1, &heightTexture);
+    GlState::get().bindTexture(1, heightTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, field.resolution(), field.resolution(), 0, GL_RED, GL_FLOAT,
+                 field.heights.data());
+
+    LOG_INFO("CDLOD terrain: " << field.resolution() << "x" << field.resolution() << " heights, "
+             << field.spacing << " apart, " << levelCount << " levels, finest range " << ranges[0]);
+}
+
+// ===============================
+// Selection
+// ===============================
+Vec3 CdlodTerrain::nodeMin(int level, int x, int z) const {
+    const float size = PATCH_QUADS * field.spacing * static_cast<float>(1 << level);
+    const int n = (field.cells / PATCH_QUADS) >> level;
+    return Vec3(field.originX + x * size, nodeMinY[level][z * n + x], field.originZ + z * size);
+}
+
+Vec3 CdlodTerrain::nodeMax(int level, int x, int z) const {
+    const float size = PATCH_QUADS * field.spacing * static_cast<float>(1 << level);
+    const int n = (field.cells / PATCH_QUADS) >> level;
+    return Vec3(field.originX + (x + 1) * size, nodeMaxY[level][z * n + x], field.originZ + (z + 1) * size);
+}
+
+// False when the node is out of its level's range, so its parent has to
+// cover the area at the coarser level
+bool CdlodTerrain::selectNode(int level, int x, int z, const Vec3& eye, const Frustum& frustum) const {
+    const Vec3 lo = nodeMin(level, x, z), hi = nodeMax(level, x, z);
+    if (!sphereIntersectsBox(eye, ranges[level], lo, hi)) return false;
+    if (!frustum.intersectsBox(lo, hi)) return true;
+
+    if (level == 0 || !sphereIntersectsBox(eye, ranges[level - 1], lo, hi)) {
+        selected.push_back({ level, x, z, 0xF });
+        return true;
+    }
+    unsigned ownQuadrants = 0;
+    for (int q = 0; q < 4; q++) {
+        if (!selectNode(level - 1, x * 2 + (q & 1), z * 2 + (q >> 1), eye, frustum)) ownQuadrants |= 1u << q;
+    }
+    if (ownQuadrants) selected.push_back({ level, x, z, ownQuadrants });
+    return true;
+}
+
+// ===============================
+// Rendering
+// ===============================
+void CdlodTerrain::render(const Camera& camera, GLuint texture) const {
+    trianglesDrawn = nodesDrawn = 0;
+    if (!isReady()) return;
+    PROFILE_SCOPE("CdlodTerrain::render");
+
+    const Vec3 eye = camera.getPosition();
+    const Frustum frustum = camera.getFrustum();
+    selected.clear();
+    // Beyond the root's range (far above or outside the world) the root
+    // is drawn anyway, at the coarsest level
+    const int root = levelCount - 1;
+    if (!selectNode(root, 0, 0, eye, frustum) && frustum.intersectsBox(nodeMin(root, 0, 0), nodeMax(root, 0, 0)))
+        selected.push_back({ root, 0, 0, 0xF });
+    if (selected.empty()) return;
+
+    GlState& state = GlState::get();
+    state.useProgram(program);
+    state.bindTexture(1, heightTexture);
+    state.bindTexture(0, texture);
+    glUniform1i(useTextureLocation, texture ? 1 : 0);
+    glUniform4f(heightMapLocation, field.originX, field.originZ, 1.0f / field.spacing, 1.0f / field.resolution());
+    glUniform3f(eyeLocation, eye.x, eye.y, eye.z);
+    glUniform4f(textureTransformLocation, textureMin.x, textureMin.z,
+                1.0f / std::max(textureMax.x - textureMin.x, 1e-6f), 1.0f / std::max(textureMax.z - textureMin.z, 1e-6f));
+
+    state.bindVertexArray(vao);
+    for (const Selection& node : selected) {
+        const float size = PATCH_QUADS * field.spacing * static_cast<float>(1 << node.level);
+        glUniform4f(nodeLocation, field.originX + node.x * size, field.originZ + node.z * size, size, 0.0f);
+        // The coarsest level has nothing to morph into
+        if (node.level == root) {
+            glUniform2f(morphLocation, FLT_MAX, 0.0f);
+        } else {
+            glUniform2f(morphLocation, morphStarts[node.level], 1.0f / (ranges[node.level] - morphStarts[node.level]));
+        }
+
+        if (node.quadrants == 0xF) {
+            glDrawElements(GL_TRIANGLES, QUADRANT_INDICES * 4, GL_UNSIGNED_SHORT, nullptr);
+            trianglesDrawn += QUADRANT_INDICES * 4 / 3;
+            ObjModel::addDrawStats(1, QUADRANT_INDICES * 4 / 3);
+        } else {
+            for (int q = 0; q < 4; q++) {
+                if (!(node.quadrants & (1u << q))) continue;
+                glDrawElements(GL_TRIANGLES, QUADRANT_INDICES, GL_UNSIGNED_SHORT,
+                               reinterpret_cast<const void*>(q * QUADRANT_INDICES * sizeof(GLushort)));
+                trianglesDrawn += QUADRANT_INDICES / 3;
+                ObjModel::addDrawStats(1, QUADRANT_INDICES / 3);
+            }
+        }
+        nodesDrawn++;
+    }
+}
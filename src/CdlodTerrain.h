@@ -0,0 +1,89 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <GL/glew.h>
+#include "Frustum.h"
+#include "HeightField.h"
+#include "Vec3.h"
+
+class Camera;
+class ObjModel;
+
+// Samples a loaded ground model over its XZ bounds, at about its own
+// triangle density, onto PATCH_QUADS times a power of two cells so the
+// CDLOD quadtree divides it evenly. Points past the edges of the mesh
+// take the height at the nearest edge. GL-free, so it can run on a
+// streamer worker.
+bool resampleHeightField(const ObjModel& ground, HeightField& out);
+
+// Continuous distance-dependent LOD (CDLOD, F. Strugar 2009) terrain. One
+// shared grid patch of PATCH_QUADS x PATCH_QUADS quads is drawn for each
+// quadtree node picked around the camera; nodes twice as far away are
+// twice as large, so the triangle count depends on the view distance and
+// not on the size of the world. A vertex shader reads the heights from a
+// float texture and morphs each vertex towards the next coarser grid over
+// the outer part of its level's range, so levels meet without cracks or
+// popping. Lighting matches the fixed-function scene, as in
+// InstancedRenderer.
+//
+// Needs GL 3.0 (float textures read in the vertex shader); isSupported()
+// is false otherwise and the caller keeps drawing the full mesh.
+class CdlodTerrain {
+public:
+    static const int PATCH_QUADS = 32;
+
+    CdlodTerrain();
+    ~CdlodTerrain();
+    CdlodTerrain(const CdlodTerrain&) = delete;
+    CdlodTerrain& operator=(const CdlodTerrain&) = delete;
+
+    bool isSupported() const { return program != 0; }
+    GLuint getProgram() const { return program; }
+    // True once a height field has been handed over
+    bool isReady() const { return heightTexture != 0; }
+
+    // GL thread. Takes the heights, builds the node bounds and uploads the
+    // height texture. `textureMin/Max` is the XZ area the ground texture is
+    // stretched over (the original mesh's bounds).
+    void setHeightField(HeightField&& field, const Vec3& textureMin, const Vec3& textureMax);
+
+    // Draws the nodes selected for this camera, with `texture` (0 for none)
+    // on the ground. Adds to ObjModel's draw stats.
+    void render(const Camera& camera, GLuint texture) const;
+
+    size_t getTrianglesDrawn() const { return trianglesDrawn; }
+    size_t getNodesDrawn() const { return nodesDrawn; }
+    int getLevelCount() const { return levelCount; }
+
+private:
+    // A node, or some of its quadrants, to draw at `level`
+    struct Selection {
+        int level, x, z;
+        unsigned quadrants; // bit q is the quadrant at (q & 1, q >> 1)
+    };
+
+    bool compileProgram();
+    void buildPatch();
+    Vec3 nodeMin(int level, int x, int z) const;
+    Vec3 nodeMax(int level, int x, int z) const;
+    bool selectNode(int level, int x, int z, const Vec3& eye, const Frustum& frustum) const;
+
+    HeightField field;
+    int levelCount = 0;
+    // Per level, finest first: height range of every node, row-major
+    std::vector<std::vector<float>> nodeMinY, nodeMaxY;
+    std::vector<float> ranges;      // a node of level l is drawn within ranges[l] of the eye
+    std::vector<float> morphStarts; // and starts turning into level l + 1 at morphStarts[l]
+    Vec3 textureMin, textureMax;
+
+    GLuint program = 0;
+    GLint nodeLocation = -1, morphLocation = -1, eyeLocation = -1;
+    GLint heightMapLocation = -1, textureTransformLocation = -1, useTextureLocation = -1;
+    GLuint heightTexture = 0;
+    GLuint vao = 0, vbo = 0, ibo = 0;
+
+    mutable std::vector<Selection> selected;
+    mutable size_t trianglesDrawn = 0;
+    mutable size_t nodesDrawn = 0;
+};
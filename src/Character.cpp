@@ -4,18 +4,31 @@
 #include "Character.h"
 #include "Camera.h"
 #include "ObjectModel.h"
-#include <iostream>
+#include "Terrain.h"
+#include "Profiler.h"
+#include "Log.h"
 
-Character::Character() {
+namespace {
+
+// What the player collides as: about the model's shoulders and height
+const Capsule BODY = { 0.3f, 1.8f };
+// Props lower than this are stepped onto rather than walked around
+const float STEP_HEIGHT = 0.35f;
+// Feet above the ground, to prevent z-fighting with it
+const float GROUND_OFFSET = 0.1f;
+
+} // namespace
+
+Character::Character(AssetStreamer* streamer) {
     position = Vec3(0, 0, 0);
-    model = new ObjModel("assets/character01/2nrtbod1out.obj");
+    model = new ObjModel("assets/character01/2nrtbod1out.obj", 4, streamer);
 }
 
 Character::~Character() {
     delete model;
 }
 
-void Character::update(Camera* camera, float deltaTime, ObjModel* terrainModel) {
+void Character::update(Camera* camera, float deltaTime, const Terrain* terrain) {
     Vec3 moveDir(0,0,0);
 
     if (keys['z']|| keys['Z']) moveDir += camera->getForward();
@@ -23,28 +36,56 @@ void Character::update(Camera* camera, float deltaTime, ObjModel* terrainModel)
     if (keys['q']|| keys['Q']) moveDir -= camera->getRight();
     if (keys['d']|| keys['D']) moveDir += camera->getRight();
 
+    velocity = Vec3(0, 0, 0);
     if (moveDir.length() > 0.0f) {
         moveDir.normalize();
-        position += moveDir * speed * deltaTime;
+        velocity = moveDir * speed;
     }
-    float terrainHeight = terrainModel->getHeightAt(position.x, position.z);
-    std::cout << "Character position: (" << position.x << ", " << position.y << ", " << position.z << "), Terrain height: " << terrainHeight << std::endl;
-    // Set the character's y position to be on top of the terrain
-    // Add a small offset to prevent z-fighting with the ground
-    position.y = terrainHeight + 0.1f; 
+    // Walk around props and horses, up onto low ones, and stay on the
+    // terrain everywhere else
+    auto groundAt = [terrain](float x, float z) { return terrain->getHeight(x, z) + GROUND_OFFSET; };
+    position = terrain->getCollision().moveCharacter(BODY, position, velocity * deltaTime, groundAt, STEP_HEIGHT);
+    LOG_TRACE("Character position: (" << position.x << ", " << position.y << ", " << position.z << ")");
 }
 
-void Character::render() {
-    glPushMatrix();
-    glTranslatef(position.x, position.y, position.z);
-    glScalef(0.01f, 0.01f, 0.01f);
-glRotatef(-90.0f, 1.0f, 0.0f, 0.0f);
+void Character::enqueue(RenderQueue& queue, const Camera& camera, const Vec3& drawPosition) {
+    const float scale = 0.01f;
     if (model) {
-        model->render();
+        Vec3 center;
+        float radius;
+        model->getBoundingSphere(center, radius);
+        // Close enough for LOD: the model's -90 degree X rotation is ignored
+        lod = model->selectLod(camera.screenSize(drawPosition + center * scale, radius * scale), lod);
+    }
+    // Scaled down and turned from Z up to Y up
+    placement = Mat4::translation(drawPosition) * Mat4::scale(scale) * Mat4::rotationX(-0.5f * 3.14159265f);
+    const float depth = (drawPosition - camera.getPosition()).length();
+    queue.push(queue.makeKey(RenderPass::FixedFunction, 0, 0, 0, depth), submit, this);
+}
+
+void Character::submit(const void* owner, uint32_t) {
+    const Character& self = *static_cast<const Character*>(owner);
+    PROFILE_GPU_SCOPE("Character::render");
+    glPushMatrix();
+    glMultMatrixf(self.placement.m);
+    if (self.model) {
+        self.model->render(self.lod);
     }
     glPopMatrix();
 }
 
+void Character::getBounds(const Vec3& drawPosition, Bounds& out) const {
+    const float scale = 0.01f;
+    Vec3 center;
+    float radius = 0.0f;
+    if (model) model->getBoundingSphere(center, radius);
+    // The -90 degree X rotation enqueue() applies takes (x, y, z) to (x, z, -y)
+    const Vec3 c = drawPosition + Vec3(center.x, center.z, -center.y) * scale;
+    const Vec3 r(radius * scale, radius * scale, radius * scale);
+    out.min = c - r;
+    out.max = c + r;
+}
+
 void Character::keyDown(unsigned char key) {
     keys[key] = true;
 
@@ -1,26 +1,45 @@
 #ifndef CHARACTER_H
 #define CHARACTER_H
-#include <map>
 #include <GL/glut.h>
 #include "Vec3.h" // Include the external Vec3.h header
 #include "Camera.h"
+#include "Mat4.h"
 #include "ObjectModel.h" // Include the ObjectModel header
+#include "Components.h"
+#include "RenderQueue.h"
+
+class AssetStreamer;
+class Terrain;
 
 class Character {
 public:
-    Character();
+    // With a streamer the model loads in the background
+    Character(AssetStreamer* streamer = nullptr);
     ~Character(); // Add destructor
 
-    void update(Camera* camera, float deltaTime, ObjModel* terrainModel); // character logic
-    void render(); // draw character
+    // Character logic; runs on the simulation thread, which owns the
+    // position and keys
+    void update(Camera* camera, float deltaTime, const Terrain* terrain);
+    // Queue the character's draw at `drawPosition` (interpolated between
+    // simulation ticks) at the detail its screen size needs
+    void enqueue(RenderQueue& queue, const Camera& camera, const Vec3& drawPosition);
     Vec3 getPosition() const { return position; }
+    // Ground-plane velocity of the last update, for prefetching terrain
+    Vec3 getVelocity() const { return velocity; }
+    // World box of the model drawn at `drawPosition`, for the player entity
+    void getBounds(const Vec3& drawPosition, Bounds& out) const;
     void keyDown(unsigned char key);
     void keyUp(unsigned char key);
     
 private:
+    static void submit(const void* owner, uint32_t data);
+
     Vec3 position;
+    Vec3 velocity;
     float speed = 0.5f; // movement speed
-    std::map<unsigned char, bool> keys; // track pressed keys
+    bool keys[256] = {}; // track pressed keys
     ObjModel* model; // 3D model of the character
+    int lod = -1;    // detail level drawn last frame
+    Mat4 placement;  // model matrix of the last enqueue()
 };
 #endif
\ No newline at end of file
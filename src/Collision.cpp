@@ -0,0 +1,349 @@
+#include "Collision.h"
+#include "Intersect.h"
+#include "Mat4.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Closer than this counts as touching, metres (in a mesh's own units
+// once scaled, which is close enough for props near unit scale)
+const float CONTACT = 0.001f;
+// Gap a character keeps from what it stops against, so the next sweep
+// doesn't start in contact
+const float SKIN = 0.01f;
+// Conservative advancement steps before a sweep gives up and reports the
+// contact where it stands; only grazing motions get anywhere near it
+const int MAX_ADVANCE_STEPS = 32;
+// Walls a character slides along in one move before it stops
+const int MAX_SLIDES = 4;
+// How far a body can drift before its leaf in the body tree is redone
+const float BODY_MARGIN = 0.5f;
+
+// The instance rotation of InstancedRenderer's shader, and its inverse
+Vec3 rotateYaw(const Vec3& v, float c, float s) {
+    return Vec3(c * v.x + s * v.z, v.y, -s * v.x + c * v.z);
+}
+
+Vec3 unrotateYaw(const Vec3& v, float c, float s) {
+    return Vec3(c * v.x - s * v.z, v.y, s * v.x + c * v.z);
+}
+
+void extend(ObjectBounds& box, const Vec3& p) {
+    box.min = Vec3(std::min(box.min.x, p.x), std::min(box.min.y, p.y), std::min(box.min.z, p.z));
+    box.max = Vec3(std::max(box.max.x, p.x), std::max(box.max.y, p.y), std::max(box.max.z, p.z));
+}
+
+// Box around segment a-b swept by `motion`, grown by `radius`
+ObjectBounds sweptBounds(const Vec3& a, const Vec3& b, const Vec3& motion, float radius) {
+    ObjectBounds box = { a, a };
+    extend(box, b);
+    extend(box, a + motion);
+    extend(box, b + motion);
+    const Vec3 r(radius, radius, radius);
+    box.min -= r;
+    box.max += r;
+    return box;
+}
+
+// Direction from the triangle to the capsule at their closest points; the
+// face normal against the motion when they already meet
+Vec3 separatingNormal(const Vec3& onSegment, const Vec3& onTriangle, float distance, const Vec3& p0, const Vec3& p1,
+                      const Vec3& p2, const Vec3& motion) {
+    if (distance > 1e-6f) return (onSegment - onTriangle) * (1.0f / distance);
+    Vec3 n = (p1 - p0).cross(p2 - p0);
+    n.normalize();
+    return n.dot(motion) > 0.0f ? n * -1.0f : n;
+}
+
+// First time in [0, limit] at which a capsule (axis a-b, `radius`) moving
+// by `motion` touches triangle p0-p1-p2, by conservative advancement: the
+// capsule can't close a gap faster than it moves, so it can always travel
+// gap / |motion| of the motion without touching.
+bool sweepCapsuleTriangle(const Vec3& a, const Vec3& b, float radius, const Vec3& motion, const Vec3& p0,
+                          const Vec3& p1, const Vec3& p2, float limit, float& outT, Vec3& outNormal) {
+    const float length = motion.length();
+    float t = 0.0f;
+    Vec3 onSegment, onTriangle;
+    float distance = std::sqrt(closestPointsSegmentTriangle(a, b, p0, p1, p2, onSegment, onTriangle));
+    for (int step = 0;; step++) {
+        const float gap = distance - radius;
+        if (gap <= CONTACT || step == MAX_ADVANCE_STEPS) {
+            const Vec3 normal = separatingNormal(onSegment, onTriangle, distance, p0, p1, p2, motion);
+            // Already touching and on the way out
+            if (t == 0.0f && normal.dot(motion) >= 0.0f) return false;
+            outT = t;
+            outNormal = normal;
+            return true;
+        }
+        if (length <= 0.0f) return false;
+        t += (gap - 0.5f * CONTACT) / length;
+        if (t > limit) return false;
+        const Vec3 offset = motion * t;
+        distance = std::sqrt(
+            closestPointsSegmentTriangle(a + offset, b + offset, p0, p1, p2, onSegment, onTriangle));
+    }
+}
+
+} // namespace
+
+// ===============================
+// CollisionMesh
+// ===============================
+CollisionMesh CollisionMesh::fromTriangles(const TriangleSoA& triangles) {
+    CollisionMesh mesh;
+    mesh.corners.reserve(triangles.size() * 3);
+    for (size_t i = 0; i < triangles.size(); i++) {
+        const Vec3 v0(triangles.v0x[i], triangles.v0y[i], triangles.v0z[i]);
+        mesh.corners.push_back(v0);
+        mesh.corners.push_back(v0 + Vec3(triangles.e1x[i], triangles.e1y[i], triangles.e1z[i]));
+        mesh.corners.push_back(v0 + Vec3(triangles.e2x[i], triangles.e2y[i], triangles.e2z[i]));
+    }
+    mesh.finish();
+    return mesh;
+}
+
+CollisionMesh CollisionMesh::box(const Vec3& size) {
+    const Vec3 lo(-0.5f * size.x, 0.0f, -0.5f * size.z);
+    const Vec3 hi(0.5f * size.x, size.y, 0.5f * size.z);
+    auto corner = [&](int i) { return Vec3(i & 1 ? hi.x : lo.x, i & 2 ? hi.y : lo.y, i & 4 ? hi.z : lo.z); };
+    // Two triangles per face, as corner indices (bit 0 x, bit 1 y, bit 2 z)
+    const int faces[12][3] = { { 0, 2, 3 }, { 0, 3, 1 }, { 4, 5, 7 }, { 4, 7, 6 }, { 0, 1, 5 }, { 0, 5, 4 },
+                               { 2, 6, 7 }, { 2, 7, 3 }, { 0, 4, 6 }, { 0, 6, 2 }, { 1, 3, 7 }, { 1, 7, 5 } };
+    CollisionMesh mesh;
+    for (const auto& face : faces) {
+        for (int i : face) mesh.corners.push_back(corner(i));
+    }
+    mesh.finish();
+    return mesh;
+}
+
+void CollisionMesh::finish() {
+    std::vector<ObjectBounds> boxes(triangleCount());
+    for (size_t i = 0; i < boxes.size(); i++) {
+        boxes[i] = { corners[3 * i], corners[3 * i] };
+        extend(boxes[i], corners[3 * i + 1]);
+        extend(boxes[i], corners[3 * i + 2]);
+    }
+    tree.build(boxes);
+    bounds = ObjectBounds();
+    if (!corners.empty()) bounds = { corners[0], corners[0] };
+    for (const Vec3& p : corners) extend(bounds, p);
+}
+
+// ===============================
+// Meshes and instances
+// ===============================
+int CollisionWorld::addMesh(const std::string& name, CollisionMesh mesh) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < meshNames.size(); i++) {
+        if (meshNames[i] == name) {
+            meshes[i] = std::move(mesh);
+            return static_cast<int>(i);
+        }
+    }
+    meshes.push_back(std::move(mesh));
+    meshNames.push_back(name);
+    return static_cast<int>(meshes.size()) - 1;
+}
+
+int CollisionWorld::findMesh(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < meshNames.size(); i++) {
+        if (meshNames[i] == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+// World box of a mesh's box under an instance transform
+ObjectBounds CollisionWorld::instanceBounds(int mesh, const Transform& t) const {
+    const Mat4 placement = Mat4::fromTransform(t);
+    ObjectBounds box;
+    transformBounds(meshes[mesh].getBounds(), &placement, 1, &box);
+    return box;
+}
+
+void CollisionWorld::setStatics(const std::vector<CollisionInstance>& instances) {
+    PROFILE_SCOPE("CollisionWorld::setStatics");
+    std::vector<ObjectBounds> boxes(instances.size());
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < instances.size(); i++) {
+            if (instances[i].mesh >= 0) boxes[i] = instanceBounds(instances[i].mesh, instances[i].transform);
+        }
+    }
+    // Built unlocked and swapped in, so the player never waits on a build;
+    // statics without a mesh leave the tree straight away
+    AabbTree tree;
+    std::vector<int> proxies;
+    tree.build(boxes, &proxies);
+    for (size_t i = 0; i < instances.size(); i++) {
+        if (instances[i].mesh >= 0) continue;
+        tree.remove(proxies[i]);
+        proxies[i] = AabbTree::NULL_NODE;
+    }
+    std::vector<CollisionInstance> copy = instances;
+    std::lock_guard<std::mutex> lock(mutex);
+    statics.swap(copy);
+    staticProxies.swap(proxies);
+    staticTree = std::move(tree);
+}
+
+void CollisionWorld::updateStatics(const uint32_t* indices, const CollisionInstance* instances, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < count; i++) {
+        const uint32_t index = indices[i];
+        int& proxy = staticProxies[index];
+        if (proxy != AabbTree::NULL_NODE) staticTree.remove(proxy);
+        proxy = AabbTree::NULL_NODE;
+        statics[index] = instances[i];
+        if (instances[i].mesh >= 0)
+            proxy = staticTree.insert(instanceBounds(instances[i].mesh, instances[i].transform), index);
+    }
+}
+
+size_t CollisionWorld::staticCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return staticTree.size();
+}
+
+int CollisionWorld::addBody(int mesh, const Transform& transform) {
+    std::lock_guard<std::mutex> lock(mutex);
+    int body;
+    if (!freeBodies.empty()) {
+        body = freeBodies.back();
+        freeBodies.pop_back();
+    } else {
+        body = static_cast<int>(bodies.size());
+        bodies.emplace_back();
+    }
+    bodies[body].mesh = mesh;
+    bodies[body].transform = transform;
+    bodies[body].proxy = bodyTree.insert(instanceBounds(mesh, transform), static_cast<uint32_t>(body), BODY_MARGIN);
+    return body;
+}
+
+void CollisionWorld::moveBody(int body, const Transform& transform) {
+    moveBodies(&body, &transform, 1);
+}
+
+void CollisionWorld::moveBodies(const int* ids, const Transform* transforms, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < count; i++) {
+        Body& body = bodies[ids[i]];
+        body.transform = transforms[i];
+        bodyTree.move(body.proxy, instanceBounds(body.mesh, body.transform), BODY_MARGIN);
+    }
+}
+
+void CollisionWorld::removeBody(int body) {
+    std::lock_guard<std::mutex> lock(mutex);
+    bodyTree.remove(bodies[body].proxy);
+    bodies[body].mesh = -1;
+    freeBodies.push_back(body);
+}
+
+size_t CollisionWorld::bodyCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bodyTree.size();
+}
+
+// ===============================
+// Queries
+// ===============================
+bool CollisionWorld::sweep(const Capsule& capsule, const Vec3& feet, const Vec3& motion, SweepHit& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return sweepLocked(capsule, feet, motion, out);
+}
+
+bool CollisionWorld::sweepLocked(const Capsule& capsule, const Vec3& feet, const Vec3& motion, SweepHit& out) const {
+    const Vec3 a = feet + Vec3(0.0f, capsule.radius, 0.0f);
+    const Vec3 b = feet + Vec3(0.0f, std::max(capsule.height - capsule.radius, capsule.radius), 0.0f);
+    const ObjectBounds swept = sweptBounds(a, b, motion, capsule.radius);
+
+    SweepHit best = { 1.0f, Vec3() };
+    bool hit = false;
+    staticTree.query(swept, [&](uint32_t i) {
+        const CollisionInstance& instance = statics[i];
+        hit |= sweepInstance(meshes[instance.mesh], instance.transform, a, b, capsule.radius, motion, best);
+    });
+    bodyTree.query(swept, [&](uint32_t i) {
+        const Body& body = bodies[i];
+        hit |= sweepInstance(meshes[body.mesh], body.transform, a, b, capsule.radius, motion, best);
+    });
+    if (hit) out = best;
+    return hit;
+}
+
+// The capsule goes into the mesh's space instead of the mesh into the
+// world's; with a uniform scale and a yaw the capsule stays a capsule
+bool CollisionWorld::sweepInstance(const CollisionMesh& mesh, const Transform& t, const Vec3& a, const Vec3& b,
+                                   float radius, const Vec3& motion, SweepHit& best) const {
+    const float c = std::cos(t.yaw), s = std::sin(t.yaw);
+    const float inverseScale = 1.0f / t.scale;
+    const Vec3 position(t.x, t.y, t.z);
+    const Vec3 localA = unrotateYaw(a - position, c, s) * inverseScale;
+    const Vec3 localB = unrotateYaw(b - position, c, s) * inverseScale;
+    const Vec3 localMotion = unrotateYaw(motion, c, s) * inverseScale;
+    const float localRadius = radius * inverseScale;
+
+    bool hit = false;
+    mesh.query(sweptBounds(localA, localB, localMotion, localRadius), [&](const Vec3& p0, const Vec3& p1,
+                                                                        const Vec3& p2) {
+        float fraction;
+        Vec3 normal;
+        if (sweepCapsuleTriangle(localA, localB, localRadius, localMotion, p0, p1, p2, best.fraction, fraction,
+                                 normal)) {
+            best.fraction = fraction;
+            best.normal = rotateYaw(normal, c, s);
+            hit = true;
+        }
+    });
+    return hit;
+}
+
+Vec3 CollisionWorld::moveCharacter(const Capsule& capsule, const Vec3& feet, const Vec3& motion,
+                                   const GroundHeight& groundAt, float stepHeight) const {
+    Vec3 position = feet;
+    SweepHit hit;
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // Up, as far as a step or the first thing overhead
+    float lift = stepHeight;
+    if (sweepLocked(capsule, position, Vec3(0.0f, stepHeight, 0.0f), hit))
+        lift = std::max(hit.fraction * stepHeight - SKIN, 0.0f);
+    position.y += lift;
+
+    // Across, sliding along what's in the way: each contact takes away the
+    // part of the remaining motion that goes into it
+    Vec3 remaining(motion.x, 0.0f, motion.z);
+    for (int slide = 0; slide < MAX_SLIDES; slide++) {
+        const float length = remaining.length();
+        if (length < 1e-5f) break;
+        if (!sweepLocked(capsule, position, remaining, hit)) {
+            position += remaining;
+            break;
+        }
+        const float travel = std::max(hit.fraction * length - SKIN, 0.0f) / length;
+        position += remaining * travel;
+        remaining = remaining * (1.0f - travel);
+        Vec3 wall(hit.normal.x, 0.0f, hit.normal.z);
+        if (wall.length() < 1e-4f) break;
+        wall.normalize();
+        const float into = remaining.dot(wall);
+        if (into < 0.0f) remaining -= wall * into;
+    }
+
+    // Down by the lift and a step more, so the character follows a prop's
+    // top down as well as up; then onto the ground if that's higher
+    const float drop = lift + stepHeight;
+    if (sweepLocked(capsule, position, Vec3(0.0f, -drop, 0.0f), hit))
+        position.y -= std::max(hit.fraction * drop - SKIN, 0.0f);
+    else
+        position.y -= drop;
+    // The ground may take locks of its own
+    lock.unlock();
+    position.y = std::max(position.y, groundAt(position.x, position.z));
+    return position;
+}
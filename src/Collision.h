@@ -0,0 +1,130 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "AabbTree.h"
+#include "Components.h"
+#include "TriangleSoA.h"
+#include "Vec3.h"
+
+// Triangles of one model in its own space, with a tree over them so a
+// query only visits the few near a moving body. Built once per model and
+// shared by every instance of it.
+class CollisionMesh {
+public:
+    // A loaded model's triangles, as its Bvh keeps them
+    static CollisionMesh fromTriangles(const TriangleSoA& triangles);
+    // A box `size` across, standing on the origin like InstancedRenderer's
+    static CollisionMesh box(const Vec3& size);
+
+    const ObjectBounds& getBounds() const { return bounds; }
+    size_t triangleCount() const { return corners.size() / 3; }
+
+    // f(a, b, c) for each triangle whose box overlaps `box`
+    template <class F>
+    void query(const ObjectBounds& box, F&& f) const {
+        tree.query(box, [&](uint32_t i) { f(corners[3 * i], corners[3 * i + 1], corners[3 * i + 2]); });
+    }
+
+private:
+    void finish();
+
+    std::vector<Vec3> corners; // three per triangle
+    AabbTree tree;
+    ObjectBounds bounds = {};
+};
+
+// An upright capsule standing on its lowest point
+struct Capsule {
+    float radius;
+    float height; // overall, end caps included; at least 2 * radius
+};
+
+// Where a sweep first touches something
+struct SweepHit {
+    float fraction; // of the motion travelled, 0 to 1
+    Vec3 normal;    // world space, pointing back at the capsule
+};
+
+// Ground height at (x, z) that a character stands on when no prop holds
+// it up
+typedef std::function<float(float x, float z)> GroundHeight;
+
+// One placement of a mesh; a static with mesh -1 holds its place but
+// collides with nothing
+struct CollisionInstance {
+    int mesh;
+    Transform transform;
+};
+
+// Everything a character can bump into, in two broad phases: the props,
+// which stand still, in an AabbTree built in one pass when they are placed
+// and patched when a few of them are re-placed; and moving bodies (horses), in a second tree whose leaves are
+// updated one at a time and only when a body leaves its margin. A query
+// walks both trees down to the few instances near it, so its cost follows
+// what is nearby rather than how many props the world holds. The narrow
+// phase sweeps a capsule against each nearby instance's triangles in the
+// mesh's own space.
+//
+// The GL thread places props and moves bodies while the simulation thread
+// moves the player, so every call takes the world's lock.
+class CollisionWorld {
+public:
+    // Registers a mesh under `name`, replacing one of that name; returns
+    // its index for instances and bodies
+    int addMesh(const std::string& name, CollisionMesh mesh);
+    int findMesh(const std::string& name) const; // -1 if absent
+
+    // Replaces every static instance and rebuilds their tree
+    void setStatics(const std::vector<CollisionInstance>& instances);
+    // Replaces statics[indices[i]] by instances[i] under a single lock,
+    // moving only their leaves
+    void updateStatics(const uint32_t* indices, const CollisionInstance* instances, size_t count);
+    size_t staticCount() const; // with a mesh
+
+    int addBody(int mesh, const Transform& transform);
+    void moveBody(int body, const Transform& transform);
+    // The same for many bodies under a single lock
+    void moveBodies(const int* bodies, const Transform* transforms, size_t count);
+    void removeBody(int body);
+    size_t bodyCount() const;
+
+    // Sweeps `capsule` standing at `feet` along `motion`; true with the
+    // first contact in `out`, false if the whole motion is clear. Contacts
+    // the capsule already overlaps and is moving out of are ignored, so a
+    // body that ends up inside something can always leave.
+    bool sweep(const Capsule& capsule, const Vec3& feet, const Vec3& motion, SweepHit& out) const;
+
+    // Character controller: moves a capsule standing at `feet` by `motion`
+    // and returns where its feet end up. It lifts by `stepHeight`, slides
+    // along whatever it meets on the way across, then settles back down
+    // onto a prop or onto `groundAt`, whichever is higher; so it climbs
+    // anything lower than a step and walks around the rest.
+    Vec3 moveCharacter(const Capsule& capsule, const Vec3& feet, const Vec3& motion, const GroundHeight& groundAt,
+                       float stepHeight) const;
+
+private:
+    struct Body {
+        int mesh; // -1 once removed
+        Transform transform;
+        int proxy;
+    };
+
+    bool sweepLocked(const Capsule& capsule, const Vec3& feet, const Vec3& motion, SweepHit& out) const;
+    // Narrows `best` to the first contact with one instance
+    bool sweepInstance(const CollisionMesh& mesh, const Transform& transform, const Vec3& a, const Vec3& b,
+                       float radius, const Vec3& motion, SweepHit& best) const;
+    ObjectBounds instanceBounds(int mesh, const Transform& transform) const;
+
+    mutable std::mutex mutex; // guards everything below
+    std::vector<CollisionMesh> meshes;
+    std::vector<std::string> meshNames;
+    std::vector<CollisionInstance> statics;
+    std::vector<int> staticProxies; // per static, AabbTree::NULL_NODE without a mesh
+    AabbTree staticTree;
+    std::vector<Body> bodies;
+    std::vector<int> freeBodies;
+    AabbTree bodyTree;
+};
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include "Frustum.h"
+#include "Vec3.h"
+
+class ObjModel;
+
+// Component types stored in the World (see World.h). Plain data only.
+
+// Placement in the world. Same layout as InstanceData, so instanced
+// batches can take transforms straight from the array.
+struct Transform {
+    float x, y, z;
+    float scale;
+    float yaw;
+};
+
+// Units per second, for things that move on their own
+struct Velocity {
+    Vec3 value;
+};
+
+// World-space axis-aligned box, kept in step with Transform by whoever
+// moves the entity; culling reads only this
+typedef ObjectBounds Bounds;
+
+// Written by cullEntities() each frame for entities that have one
+struct Visibility {
+    uint8_t visible;
+};
+
+// Drawn instanced with this model, at the detail level picked last frame
+struct RenderMesh {
+    const ObjModel* model;
+    int8_t lod; // -1 before the first frame
+};
+
+// A horse carrying an NPC rider (see Rider.h), this far through the
+// rider's stride, from 0 to 1
+struct Rider {
+    float phase;
+};
+
+// A moving body in the CollisionWorld (see Collision.h), -1 until added
+struct Collider {
+    int32_t body;
+};
+
+// What an entity is
+struct TreeTag {};
+struct RockTag {};
+struct PlayerTag {};
+struct HorseTag {};
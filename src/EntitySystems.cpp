@@ -0,0 +1,41 @@
+#include "EntitySystems.h"
+#include "Components.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <atomic>
+
+namespace {
+
+// Boxes per job when culling
+const size_t BOXES_PER_JOB = 4096;
+
+} // namespace
+
+void integrateMotion(World& world, float dt) {
+    PROFILE_SCOPE("integrateMotion");
+    world.eachChunk<Transform, Velocity, Bounds>(
+        [dt](size_t count, const Entity*, Transform* transforms, Velocity* velocities, Bounds* bounds) {
+            for (size_t i = 0; i < count; i++) {
+                const Vec3 step = velocities[i].value * dt;
+                transforms[i].x += step.x;
+                transforms[i].y += step.y;
+                transforms[i].z += step.z;
+                bounds[i].min += step;
+                bounds[i].max += step;
+            }
+        });
+}
+
+void cullEntities(World& world, const Frustum& frustum, CullStats& stats) {
+    PROFILE_SCOPE("cullEntities");
+    static_assert(sizeof(Visibility) == 1, "cullBoxes writes one byte per entity");
+    JobSystem& jobs = JobSystem::get();
+    world.eachChunk<Bounds, Visibility>([&](size_t count, const Entity*, Bounds* bounds, Visibility* visibility) {
+        std::atomic<size_t> visible{0};
+        jobs.parallelFor(count, BOXES_PER_JOB, [&](size_t begin, size_t end) {
+            visible += frustum.cullBoxes(bounds + begin, end - begin, reinterpret_cast<uint8_t*>(visibility + begin));
+        });
+        stats.drawn += visible;
+        stats.culled += count - visible;
+    });
+}
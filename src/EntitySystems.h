@@ -0,0 +1,15 @@
+#pragma once
+#include "Frustum.h"
+#include "World.h"
+
+// Systems that run over the World's component arrays once per frame. Each
+// is a straight pass over every matching archetype's arrays.
+
+// Moves every entity that has a Transform, Velocity and Bounds by its
+// velocity over `dt`, bounds included
+void integrateMotion(World& world, float dt);
+
+// Tests the Bounds of every entity that has a Visibility against the
+// frustum and stores the result there, in parallel over the job system;
+// adds to `stats`
+void cullEntities(World& world, const Frustum& frustum, CullStats& stats);
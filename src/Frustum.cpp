@@ -0,0 +1,103 @@
+#include "Frustum.h"
+#include "Mat4.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
+
+void Frustum::fromCamera(const Vec3& eye, const Vec3& target, const Vec3& up,
+                         float fovYDegrees, float aspect, float zNear, float zFar) {
+    const Mat4 clip = Mat4::perspective(fovYDegrees, aspect, zNear, zFar) * Mat4::lookAt(eye, target, up);
+    fromMatrix(clip.m);
+}
+
+void Frustum::fromMatrix(const float m[16]) {
+    // Gribb/Hartmann: each plane is row 3 plus or minus one of rows 0..2
+    auto row = [&](int r, int c) { return m[c * 4 + r]; };
+    for (int i = 0; i < 6; i++) {
+        const int axis = i / 2;
+        const float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+        Plane& p = planes[i];
+        p.normal = Vec3(row(3, 0) + sign * row(axis, 0),
+                        row(3, 1) + sign * row(axis, 1),
+                        row(3, 2) + sign * row(axis, 2));
+        p.d = row(3, 3) + sign * row(axis, 3);
+
+        float length = p.normal.length();
+        if (length > 0.0f) {
+            p.normal = p.normal * (1.0f / length);
+            p.d /= length;
+        }
+    }
+}
+
+Frustum::Result Frustum::classifyBox(const Vec3& boxMin, const Vec3& boxMax) const {
+    Result result = INSIDE;
+    for (const Plane& p : planes) {
+        // Corner furthest along the plane normal, and the one furthest behind it
+        Vec3 positive(p.normal.x >= 0.0f ? boxMax.x : boxMin.x,
+                      p.normal.y >= 0.0f ? boxMax.y : boxMin.y,
+                      p.normal.z >= 0.0f ? boxMax.z : boxMin.z);
+        if (p.normal.dot(positive) + p.d < 0.0f) return OUTSIDE;
+
+        Vec3 negative(p.normal.x >= 0.0f ? boxMin.x : boxMax.x,
+                      p.normal.y >= 0.0f ? boxMin.y : boxMax.y,
+                      p.normal.z >= 0.0f ? boxMin.z : boxMax.z);
+        if (p.normal.dot(negative) + p.d < 0.0f) result = INTERSECTS;
+    }
+    return result;
+}
+
+size_t Frustum::cullBoxes(const ObjectBounds* boxes, size_t count, uint8_t* visible) const {
+    // Centre/half-extent form: a box is outside a plane when its centre is
+    // further behind it than the box's projected radius
+    size_t visibleCount = 0;
+#ifdef FALLAGA_SSE
+    // Planes across the lanes (0-3 and 4-5), one box at a time
+    alignas(16) float n[7][8];
+    for (int p = 0; p < 8; p++) {
+        const Plane& plane = planes[p < 6 ? p : 5]; // lanes 6, 7 repeat plane 5
+        n[0][p] = plane.normal.x;
+        n[1][p] = plane.normal.y;
+        n[2][p] = plane.normal.z;
+        n[3][p] = std::fabs(plane.normal.x);
+        n[4][p] = std::fabs(plane.normal.y);
+        n[5][p] = std::fabs(plane.normal.z);
+        n[6][p] = plane.d;
+    }
+    __m128 lo[7], hi[7];
+    for (int k = 0; k < 7; k++) {
+        lo[k] = _mm_load_ps(n[k]);
+        hi[k] = _mm_load_ps(n[k] + 4);
+    }
+    for (size_t i = 0; i < count; i++) {
+        const ObjectBounds& b = boxes[i];
+        const __m128 cx = _mm_set1_ps((b.min.x + b.max.x) * 0.5f), ex = _mm_set1_ps((b.max.x - b.min.x) * 0.5f);
+        const __m128 cy = _mm_set1_ps((b.min.y + b.max.y) * 0.5f), ey = _mm_set1_ps((b.max.y - b.min.y) * 0.5f);
+        const __m128 cz = _mm_set1_ps((b.min.z + b.max.z) * 0.5f), ez = _mm_set1_ps((b.max.z - b.min.z) * 0.5f);
+        auto distance = [&](const __m128* plane) {
+            __m128 d = _mm_add_ps(_mm_mul_ps(plane[0], cx), plane[6]);
+            d = _mm_add_ps(d, _mm_mul_ps(plane[1], cy));
+            d = _mm_add_ps(d, _mm_mul_ps(plane[2], cz));
+            d = _mm_add_ps(d, _mm_mul_ps(plane[3], ex));
+            d = _mm_add_ps(d, _mm_mul_ps(plane[4], ey));
+            return _mm_add_ps(d, _mm_mul_ps(plane[5], ez));
+        };
+        const __m128 nearest = _mm_min_ps(distance(lo), distance(hi));
+        const uint8_t inside = _mm_movemask_ps(_mm_cmplt_ps(nearest, _mm_setzero_ps())) == 0;
+        visible[i] = inside;
+        visibleCount += inside;
+    }
+#else
+    for (size_t i = 0; i < count; i++) {
+        const ObjectBounds& b = boxes[i];
+        const Vec3 c = (b.min + b.max) * 0.5f, e = (b.max - b.min) * 0.5f;
+        uint8_t inside = 1;
+        for (const Plane& p : planes)
+            inside &= p.normal.dot(c) + p.d + std::fabs(p.normal.x) * e.x + std::fabs(p.normal.y) * e.y +
+                      std::fabs(p.normal.z) * e.z >= 0.0f;
+        visible[i] = inside;
+        visibleCount += inside;
+    }
+#endif
+    return visibleCount;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "Vec3.h"
+
+struct ObjectBounds {
+    Vec3 min, max;
+};
+
+// Counters from one visibility query
+struct CullStats {
+    size_t drawn = 0;
+    size_t culled = 0;
+    size_t nodesVisited = 0;
+};
+
+// View frustum as six inward-facing planes (left, right, bottom, top, near,
+// far). Points with dot(normal, p) + d >= 0 are on the inside of a plane.
+class Frustum {
+public:
+    enum Result { OUTSIDE, INTERSECTS, INSIDE };
+
+    // Camera setup equivalent to gluLookAt(eye, target, up) followed by
+    // gluPerspective(fovY, aspect, zNear, zFar)
+    void fromCamera(const Vec3& eye, const Vec3& target, const Vec3& up,
+                    float fovYDegrees, float aspect, float zNear, float zFar);
+
+    // Planes of a column-major clip matrix (projection * modelview), as
+    // laid out by glGetFloatv
+    void fromMatrix(const float m[16]);
+
+    // Axis-aligned box test; INSIDE means every corner is in the frustum
+    Result classifyBox(const Vec3& boxMin, const Vec3& boxMax) const;
+    bool intersectsBox(const Vec3& boxMin, const Vec3& boxMax) const {
+        return classifyBox(boxMin, boxMax) != OUTSIDE;
+    }
+
+    // Batched intersectsBox: visible[i] = 1 for each of the boxes that is
+    // not OUTSIDE, else 0. SSE tests all six planes of a box at once, with
+    // a scalar loop where SSE is missing; returns how many are visible.
+    size_t cullBoxes(const ObjectBounds* boxes, size_t count, uint8_t* visible) const;
+
+private:
+    struct Plane {
+        Vec3 normal;
+        float d;
+    };
+    Plane planes[6];
+};
@@ -5,34 +5,187 @@
 #include "Character.h"
 #include "Camera.h"
 #include "Terrain.h"
+#include "Horse.h"
+#include "EntitySystems.h"
+#include "GlState.h"
+#include "ObjectModel.h"
+#include "ResourceManager.h"
+#include "Profiler.h"
+#include "Log.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 
-Game::Game() : lastFrameTime(0.0), deltaTime(0.0f) {
-    player = new Character();
-    camera = new Camera(player);
-    terrain = new Terrain();
+namespace {
+
+// GL upload work allowed per frame while assets stream in
+const double STREAM_BUDGET_MS = 2.0;
+const size_t STREAM_BUDGET_BYTES = 4 << 20;
+// Half the side of the square the herd is kept on, about the props' area
+const float HERD_AREA = 45.0f;
+// Frame time past this is dropped rather than stepped (a hitch, or a
+// debugger break), as the simulation thread does
+const float MAX_HERD_CATCH_UP = 0.25f;
+
+} // namespace
+
+Game::Game() : herdTime(0.0f), lastFrameTime(0.0), deltaTime(0.0f), statsTime(0.0f), statsFrames(0), statsWorstFrame(0.0f),
+               firstFrameDrawn(false), streamingDone(false), mouseX(0.0), mouseY(0.0), mouseMoved(false),
+               statsTick(0), showProfiler(true), recordStart(-1.0),
+               lastRecorded(0.0) {
+    PROFILE_THREAD("Main");
+    startTime = glfwGetTime();
+
+    // Assets load on worker threads and are drawn as placeholders until
+    // they arrive; FALLAGA_SYNC_LOAD=1 blocks here instead, as before
+    const char* syncLoad = std::getenv("FALLAGA_SYNC_LOAD");
+    streamer = (syncLoad && std::strcmp(syncLoad, "0") != 0) ? nullptr : new AssetStreamer();
+
+    world = new World();
+    player = new Character(streamer);
+    playerEntity = world->create(Transform{ 0.0f, 0.0f, 0.0f, 1.0f, 0.0f }, Bounds(), Visibility{ 1 }, PlayerTag());
+    camera = new Camera(nullptr);
+    // FALLAGA_PROPS=<n> scatters n props (2/3 trees, 1/3 rocks) for stress tests
+    int propCount = 30;
+    if (const char* props = std::getenv("FALLAGA_PROPS")) propCount = std::max(0, std::atoi(props));
+    terrain = new Terrain(*world, propCount - propCount / 3, propCount / 3, streamer);
+    // FALLAGA_HORSES=<n> grazes a herd of n on a square just ahead of the
+    // player, packed closer when it is large so it stays on the map
+    herd = new Herd();
+    herd->setArea(Vec3(-HERD_AREA, 0.0f, -HERD_AREA), Vec3(HERD_AREA, 0.0f, HERD_AREA));
+    horseRenderer = new HorseRenderer();
+    if (const char* horses = std::getenv("FALLAGA_HORSES"))
+        spawnHerd(*world, std::max(0, std::atoi(horses)), Vec3(0.0f, 0.0f, 5.0f), HERD_AREA, herd->getParams().grazeSpeed);
+    // FALLAGA_RIDERS=<n> puts animated riders on the first n of them
+    riders = new Riders();
+    if (const char* count = std::getenv("FALLAGA_RIDERS")) mountRiders(*world, std::max(0, std::atoi(count)));
+
+    if (const char* record = std::getenv("FALLAGA_RECORD")) {
+        recording.open(record);
+        if (recording) {
+            recording << "# Recorded with FALLAGA_RECORD; replay with --bench " << record << "\n"
+                      << "props " << propCount << "\n"
+                      << "# key <time> <player xyz> <eye xyz> <target xyz>\n";
+        } else {
+            LOG_WARN("Could not open " << record << " to record the path");
+        }
+    }
+
+    // Player movement and the follow camera tick on their own thread from
+    // here on; FALLAGA_SIM_HZ=<n> changes the rate
+    double tickRate = 60.0;
+    if (const char* hz = std::getenv("FALLAGA_SIM_HZ")) tickRate = std::max(1.0, std::atof(hz));
+    simulation = new Simulation(player, terrain, tickRate);
+    simulation->start();
     
     lastFrameTime = glfwGetTime();
 }
 
 Game::~Game() {
+    // The simulation thread reads the player and terrain
+    delete simulation;
+#ifdef FALLAGA_PROFILE
+    // FALLAGA_TRACE=<file> saves the last few seconds as a Chrome trace
+    if (const char* trace = std::getenv("FALLAGA_TRACE")) Profiler::exportChromeTrace(trace);
+#endif
+    // Stops the workers before the models their jobs point to go away
+    delete streamer;
     delete player;
     delete camera;
     delete terrain;
+    delete riders;
+    delete horseRenderer;
+    delete herd;
+    delete world;
 }
 
 void Game::update() {
+    PROFILE_SCOPE("Game::update");
     double currentTime = glfwGetTime();
     deltaTime = static_cast<float>(currentTime - lastFrameTime);
     lastFrameTime = currentTime;
-    
-    player->update(camera, deltaTime, terrain->getModel());
-    camera->update();
+
+    // Average frame time every few seconds, to compare render paths
+    statsTime += deltaTime;
+    statsFrames++;
+    statsWorstFrame = std::max(statsWorstFrame, deltaTime);
+    if (statsTime >= 5.0f) {
+        const CullStats& cull = terrain->getCullStats();
+        const WorldSnapshot& snapshot = simulation->latest();
+        const GlState::Stats& glStats = GlState::get().getStats();
+        LOG_INFO("Frame time: " << statsTime * 1000.0f / statsFrames << " ms ("
+                 << statsFrames / statsTime << " fps, worst " << statsWorstFrame * 1000.0f
+                 << " ms), objects drawn " << cull.drawn
+                 << ", culled " << cull.culled << ", nodes visited " << cull.nodesVisited
+                 << ", triangles " << terrain->getTrianglesSubmitted() << " (without LOD "
+                 << terrain->getTrianglesWithoutLod() << "), simulation " << (snapshot.tick - statsTick) / statsTime
+                 << " Hz (last step " << snapshot.stepMs << " ms), state changes per frame "
+                 << glStats.issued / statsFrames << " (requested " << glStats.requested / statsFrames << ")");
+        GlState::get().resetStats();
+        statsTick = snapshot.tick;
+        statsTime = 0.0f;
+        statsFrames = 0;
+        statsWorstFrame = 0.0f;
+    }
+
+    // Finish a bounded amount of streamed uploads, then let the terrain
+    // pick up whatever models became resident (it may queue more work)
+    if (streamer) streamer->update(STREAM_BUDGET_MS, STREAM_BUDGET_BYTES);
+    terrain->update();
+    stepHerd();
+    if (!streamingDone && (!streamer || streamer->idle())) {
+        streamingDone = true;
+        LOG_INFO("Assets resident after " << (currentTime - startTime) * 1000.0 << " ms. Mesh path: "
+                 << (ObjModel::usingDisplayLists() ? "display lists" : "indexed VBO")
+                 << ", ground: " << (terrain->usingCdlod() ? "CDLOD" : "full mesh")
+                 << ", mesh data on GPU: " << ObjModel::getGpuMeshBytes() / 1024 << " KB");
+        ResourceManager::Stats resources = ResourceManager::get().getStats();
+        LOG_INFO("Resources: " << resources.residentTextures << " textures (" << resources.residentBytes / 1024
+                 << " KB), " << resources.liveMaterials << " materials; texture cache " << resources.textureHits
+                 << " hits / " << resources.textureMisses << " misses, material cache " << resources.materialHits
+                 << " hits / " << resources.materialMisses << " misses");
+    }
+
+    // Only the newest cursor position matters to the camera, so one event
+    // a frame keeps a fast mouse from filling the input queue
+    if (mouseMoved) {
+        InputEvent event = { InputEvent::MOUSE_MOVE, 0, mouseX, mouseY };
+        if (simulation->pushInput(event)) mouseMoved = false;
+    }
+}
+
+// As many fixed steps as the frame covers, each with one batched height
+// query, so the herd moves the same at any frame rate and a long frame is
+// a few normal steps rather than one large one
+void Game::stepHerd() {
+    PROFILE_SCOPE("Game::stepHerd");
+    const float step = static_cast<float>(1.0 / simulation->getTickRate());
+    herdTime += std::min(deltaTime, MAX_HERD_CATCH_UP);
+    if (herdTime < step) return;
+
+    // Back from where the last frame drew them to where they are
+    blendHorsePoses(*world, herdCurrent, herdCurrent, 1.0f);
+    // The herd reacts to where the player was at the last tick
+    const Vec3 threat = simulation->latest().current.playerPosition;
+    auto heights = [this](const std::vector<Vec3>& points, std::vector<float>& out) { terrain->getHeights(points, out); };
+    while (herdTime >= step) {
+        saveHorsePoses(*world, herdPrevious);
+        herd->update(*world, threat, step);
+        integrateMotion(*world, step);
+        updateHorses(*world, heights);
+        riders->update(*world, step);
+        herdTime -= step;
+    }
+    updateHorseColliders(*world, terrain->getCollision());
+    saveHorsePoses(*world, herdCurrent);
 }
 
 void Game::render() {
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
+    PROFILE_SCOPE("Game::render");
+    GlState& glState = GlState::get();
+    glState.enable(GL_DEPTH_TEST);
+    glState.enable(GL_CULL_FACE);
+    glState.cullFace(GL_BACK);
     
     // Clear the screen and depth buffer
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -41,35 +194,100 @@ void Game::render() {
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
 
+    // Place the view between the last two simulation ticks, so motion
+    // stays smooth whatever the frame rate
+    WorldState state = simulation->interpolate(simulation->latest(), Simulation::now());
+    camera->setView(state.cameraPosition, state.cameraTarget);
+
+    // Ten keys a second is plenty: the benchmark interpolates between them
+    if (recording.is_open()) {
+        double now = glfwGetTime();
+        if (recordStart < 0.0 || now - lastRecorded >= 0.1) {
+            if (recordStart < 0.0) recordStart = now;
+            lastRecorded = now;
+            const Vec3& p = state.playerPosition;
+            const Vec3& e = state.cameraPosition;
+            const Vec3& t = state.cameraTarget;
+            recording << "key " << now - recordStart << "  " << p.x << " " << p.y << " " << p.z << "  " << e.x
+                      << " " << e.y << " " << e.z << "  " << t.x << " " << t.y << " " << t.z << "\n";
+        }
+    }
+
     // Apply camera transformation
     camera->apply();
     
-    // Render terrain first (largest object)
-    terrain->render();
-    
-    // Render player last
-    player->render();
+    // The player entity follows the interpolated position, and the horses
+    // are drawn the same fraction of a step behind; they are culled in one
+    // pass over their bounds
+    blendHorsePoses(*world, herdPrevious, herdCurrent,
+                    std::min(herdTime * static_cast<float>(simulation->getTickRate()), 1.0f));
+    Transform& playerTransform = *world->get<Transform>(playerEntity);
+    playerTransform.x = state.playerPosition.x;
+    playerTransform.y = state.playerPosition.y;
+    playerTransform.z = state.playerPosition.z;
+    player->getBounds(state.playerPosition, *world->get<Bounds>(playerEntity));
+    CullStats entityCull;
+    cullEntities(*world, camera->getFrustum(), entityCull);
+
+    // Everything goes through the queue, then is drawn sorted by program,
+    // texture and mesh, so each of them is bound as few times as it can be
+    terrain->enqueue(*camera, renderQueue);
+    horseRenderer->enqueue(*world, renderQueue);
+    riders->enqueue(*world, renderQueue);
+    if (world->get<Visibility>(playerEntity)->visible) player->enqueue(renderQueue, *camera, state.playerPosition);
+    renderQueue.sort();
+    renderQueue.submit();
+
+#ifdef FALLAGA_PROFILE
+    if (showProfiler) Profiler::drawOverlay();
+#endif
+    PROFILE_FRAME();
+
+    if (!firstFrameDrawn) {
+        firstFrameDrawn = true;
+        LOG_INFO("First frame after " << (glfwGetTime() - startTime) * 1000.0 << " ms");
+    }
 }
 
 Camera& Game::getCamera() {
     return *camera;
 }
 
-void Game::keyDown(int key) {
+namespace {
+
+// Movement keys in the character's own key codes
+unsigned char movementKey(int key) {
     switch (key) {
-        case GLFW_KEY_W: player->keyDown('z'); break;
-        case GLFW_KEY_S: player->keyDown('s'); break;
-        case GLFW_KEY_A: player->keyDown('q'); break;
-        case GLFW_KEY_D: player->keyDown('d'); break;
-        case GLFW_KEY_ESCAPE: exit(0);
+        case GLFW_KEY_W: return 'z';
+        case GLFW_KEY_S: return 's';
+        case GLFW_KEY_A: return 'q';
+        case GLFW_KEY_D: return 'd';
+    }
+    return 0;
+}
+
+} // namespace
+
+void Game::keyDown(int key) {
+    // Close through the main loop, so the simulation thread is joined and
+    // the profiler trace gets written
+    if (key == GLFW_KEY_ESCAPE) glfwSetWindowShouldClose(glfwGetCurrentContext(), GLFW_TRUE);
+    if (key == GLFW_KEY_F3) showProfiler = !showProfiler;
+    if (unsigned char code = movementKey(key)) {
+        InputEvent event = { InputEvent::KEY_DOWN, code, 0.0, 0.0 };
+        if (!simulation->pushInput(event)) LOG_WARN("Input queue full, key dropped");
     }
 }
 
 void Game::keyUp(int key) {
-    switch (key) {
-        case GLFW_KEY_W: player->keyUp('z'); break;
-        case GLFW_KEY_S: player->keyUp('s'); break;
-        case GLFW_KEY_A: player->keyUp('q'); break;
-        case GLFW_KEY_D: player->keyUp('d'); break;
+    if (unsigned char code = movementKey(key)) {
+        InputEvent event = { InputEvent::KEY_UP, code, 0.0, 0.0 };
+        if (!simulation->pushInput(event)) LOG_WARN("Input queue full, key dropped");
     }
 }
+
+void Game::mouseMove(double x, double y) {
+    mouseX = x;
+    mouseY = y;
+    mouseMoved = true;
+}
@@ -1,7 +1,15 @@
 #pragma once
+#include <fstream>
 #include "Character.h"
 #include "Camera.h"
 #include "Terrain.h"
+#include "AssetStreamer.h"
+#include "Simulation.h"
+#include "Herd.h"
+#include "Horse.h"
+#include "Rider.h"
+#include "RenderQueue.h"
+#include "World.h"
 
 class Game {
 public:
@@ -12,14 +20,48 @@ public:
     void render();
     void keyDown(int key);
     void keyUp(int key);
+    void mouseMove(double x, double y);
     
     Camera& getCamera();
     
 private:
+    void stepHerd();
+
+    // Props, horses and the player as entities (see World.h)
+    World* world;
+    Entity playerEntity;
+    // The herd steps at the simulation's fixed rate, but here on the render
+    // thread: the World has no locking and this thread changes it every
+    // frame (culling writes Visibility, props gain and lose components),
+    // so steering can't run beside it on the simulation thread. render()
+    // draws the horses between the last two steps, like the player.
+    Herd* herd;                   // steers the horses away from the player
+    float herdTime;               // seconds not yet stepped
+    std::vector<HorsePose> herdPrevious, herdCurrent; // poses around the last step
+    HorseRenderer* horseRenderer;
+    Riders* riders;               // NPC riders on some of the horses
     Character* player;
-    Camera* camera;
+    Camera* camera;   // view camera, placed from simulation snapshots
+    Simulation* simulation;
     Terrain* terrain;
+    AssetStreamer* streamer; // null with FALLAGA_SYNC_LOAD=1
+    RenderQueue renderQueue; // the frame's draws, refilled every render()
     
     float lastFrameTime;
     float deltaTime;
+    float statsTime;  // seconds since the last frame time report
+    int statsFrames;
+    float statsWorstFrame;
+    double startTime;     // when the constructor started, for load timings
+    bool firstFrameDrawn;
+    bool streamingDone;
+    // Latest cursor position, sent to the simulation once per frame
+    double mouseX, mouseY;
+    bool mouseMoved;
+    uint64_t statsTick; // simulation tick at the last frame time report
+    bool showProfiler;  // F3, in FALLAGA_PROFILE builds
+    // FALLAGA_RECORD=<file>: the path flown, as a --bench script
+    std::ofstream recording;
+    double recordStart;   // first recorded frame, -1 before it
+    double lastRecorded;
 };
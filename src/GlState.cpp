@@ -0,0 +1,119 @@
+#include "GlState.h"
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+const GLenum CAPABILITY_NAMES[] = { GL_DEPTH_TEST, GL_CULL_FACE, GL_TEXTURE_2D,
+                                    GL_LIGHTING,   GL_COLOR_MATERIAL, GL_BLEND };
+
+int capabilityIndex(GLenum capability) {
+    for (int i = 0; i < static_cast<int>(sizeof(CAPABILITY_NAMES) / sizeof(CAPABILITY_NAMES[0])); i++) {
+        if (CAPABILITY_NAMES[i] == capability) return i;
+    }
+    return -1;
+}
+
+} // namespace
+
+GlState& GlState::get() {
+    static GlState state;
+    return state;
+}
+
+GlState::GlState() {
+    const char* env = std::getenv("FALLAGA_NO_STATE_CACHE");
+    passThrough = env && std::strcmp(env, "0") != 0;
+    invalidate();
+}
+
+void GlState::invalidate() {
+    for (GLuint& e : enabled) e = UNKNOWN;
+    for (GLuint& t : textures) t = UNKNOWN;
+    cullMode = shadeMode = UNKNOWN;
+    program = vertexArray = UNKNOWN;
+    activeUnit = UNKNOWN;
+}
+
+bool GlState::change(GLuint& current, GLuint value) {
+    stats.requested++;
+    if (current == value && !passThrough) return false;
+    current = value;
+    stats.issued++;
+    return true;
+}
+
+// ===============================
+// Fixed-function state
+// ===============================
+void GlState::set(GLenum capability, bool on) {
+    const int index = capabilityIndex(capability);
+    if (index < 0) {
+        stats.requested++;
+        stats.issued++;
+        if (on) glEnable(capability);
+        else glDisable(capability);
+        return;
+    }
+    // Texturing is enabled per unit; the fixed-function draws use unit 0
+    if (capability == GL_TEXTURE_2D) activeTexture(0);
+    if (!change(enabled[index], on ? 1 : 0)) return;
+    if (on) glEnable(capability);
+    else glDisable(capability);
+}
+
+void GlState::cullFace(GLenum face) {
+    if (change(cullMode, face)) glCullFace(face);
+}
+
+void GlState::shadeModel(GLenum mode) {
+    if (change(shadeMode, mode)) glShadeModel(mode);
+}
+
+// ===============================
+// Bindings
+// ===============================
+void GlState::useProgram(GLuint name) {
+    if (change(program, name)) glUseProgram(name);
+}
+
+void GlState::bindVertexArray(GLuint vao) {
+    if (change(vertexArray, vao)) glBindVertexArray(vao);
+}
+
+void GlState::activeTexture(GLuint unit) {
+    if (change(activeUnit, unit)) glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void GlState::bindTexture(GLuint unit, GLuint texture) {
+    activeTexture(unit);
+    if (unit >= TEXTURE_UNITS) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        return;
+    }
+    if (change(textures[unit], texture)) glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+// GL unbinds deleted vertex arrays and textures, so they are forgotten
+// as 0; a deleted program stays in use until the next one, so that one
+// must go through whatever name it has
+void GlState::deleteProgram(GLuint name) {
+    if (program == name) program = UNKNOWN;
+    glDeleteProgram(name);
+}
+
+void GlState::deleteVertexArrays(GLsizei count, const GLuint* vaos) {
+    for (GLsizei i = 0; i < count; i++) {
+        if (vertexArray == vaos[i]) vertexArray = 0;
+    }
+    glDeleteVertexArrays(count, vaos);
+}
+
+void GlState::deleteTextures(GLsizei count, const GLuint* names) {
+    for (GLsizei i = 0; i < count; i++) {
+        for (GLuint& t : textures) {
+            if (t == names[i]) t = 0;
+        }
+    }
+    glDeleteTextures(count, names);
+}
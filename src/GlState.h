@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <GL/glew.h>
+
+// Shadow copy of the GL state the renderers change: enables, the cull
+// face, the shade model, the program, the vertex array and the 2D texture
+// of each unit. A call that would leave the state as it is never reaches
+// the driver. GL thread only.
+//
+// Binds aren't undone after a draw any more, so whatever was drawn last
+// stays bound. Code that changes this state must go through here. Code
+// that binds GL_ELEMENT_ARRAY_BUFFER outside a VAO of its own must bind
+// vertex array 0 first. Deleting a bound object goes through the delete
+// wrappers, so a recycled name isn't taken for one still bound.
+// invalidate() covers anything else, e.g. a new context.
+//
+// FALLAGA_NO_STATE_CACHE=1 passes every call through, for comparisons.
+class GlState {
+public:
+    static GlState& get();
+
+    // GL_DEPTH_TEST, GL_CULL_FACE, GL_TEXTURE_2D (unit 0, the only one the
+    // fixed-function draws use), GL_LIGHTING, GL_COLOR_MATERIAL, GL_BLEND;
+    // anything else goes straight to GL
+    void enable(GLenum capability) { set(capability, true); }
+    void disable(GLenum capability) { set(capability, false); }
+    void set(GLenum capability, bool on);
+    void cullFace(GLenum face);
+    void shadeModel(GLenum mode);
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    // Leaves `unit` active
+    void bindTexture(GLuint unit, GLuint texture);
+
+    void deleteProgram(GLuint program);
+    void deleteVertexArrays(GLsizei count, const GLuint* vaos);
+    void deleteTextures(GLsizei count, const GLuint* textures);
+
+    // Forgets everything, so the next call of each kind goes through
+    void invalidate();
+    // False with FALLAGA_NO_STATE_CACHE
+    bool isCaching() const { return !passThrough; }
+
+    // Since the last reset: state calls the renderers made, and how many
+    // of them changed something and reached GL. Without the cache every
+    // call would, so the first is the count before it and the second after.
+    struct Stats {
+        size_t requested = 0;
+        size_t issued = 0;
+    };
+    const Stats& getStats() const { return stats; }
+    void resetStats() { stats = Stats(); }
+
+private:
+    GlState();
+
+    static const int CAPABILITIES = 6;
+    static const int TEXTURE_UNITS = 4;
+    static const GLuint UNKNOWN = ~0u;
+
+    // Whether a call setting `current` to `value` has to reach GL; records
+    // the new value if so
+    bool change(GLuint& current, GLuint value);
+    void activeTexture(GLuint unit);
+
+    bool passThrough;
+    GLuint enabled[CAPABILITIES];
+    GLuint cullMode, shadeMode;
+    GLuint program, vertexArray;
+    GLuint activeUnit;
+    GLuint textures[TEXTURE_UNITS];
+    Stats stats;
+};
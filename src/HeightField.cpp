@@ -0,0 +1,43 @@
+#include "HeightField.h"
+#include <algorithm>
+#include <cmath>
+
+float meshSampleSpacing(const Vec3& boundsMin, const Vec3& boundsMax, size_t triangleCount) {
+    const float width = boundsMax.x - boundsMin.x, depth = boundsMax.z - boundsMin.z;
+    const float extent = std::max(width, depth);
+    // A flat sliver of a mesh still gets a sensible spacing
+    const float area = std::max(width * depth, extent * extent * 1e-3f);
+    return std::sqrt(area / (std::max<size_t>(triangleCount, 2) * 0.5f));
+}
+
+bool resampleHeightField(const Vec3& boundsMin, const Vec3& boundsMax, float spacing, int baseCells, int maxCells,
+                         const HeightQuery& heightsAt, HeightField& out) {
+    const float extent = std::max(boundsMax.x - boundsMin.x, boundsMax.z - boundsMin.z);
+    if (!(extent > 0.0f) || !(spacing > 0.0f) || baseCells <= 0) return false;
+
+    int cells = baseCells;
+    while (cells * 2 <= maxCells && cells * spacing < extent) cells *= 2;
+
+    out.cells = cells;
+    out.spacing = extent / cells;
+    out.originX = boundsMin.x;
+    out.originZ = boundsMin.z;
+    const int resolution = out.resolution();
+    out.heights.resize(static_cast<size_t>(resolution) * resolution);
+
+    // A row at a time, clamped just inside the bounds so that samples past
+    // the edges (and float rounding at them) repeat the edge
+    const float inset = out.spacing * 1e-3f;
+    std::vector<Vec3> points(resolution);
+    std::vector<float> row;
+    for (int z = 0; z < resolution; z++) {
+        const float pz = std::min(std::max(boundsMin.z + z * out.spacing, boundsMin.z + inset), boundsMax.z - inset);
+        for (int x = 0; x < resolution; x++) {
+            const float px = std::min(std::max(boundsMin.x + x * out.spacing, boundsMin.x + inset), boundsMax.x - inset);
+            points[x] = Vec3(px, 0.0f, pz);
+        }
+        heightsAt(points, row);
+        std::copy(row.begin(), row.end(), out.heights.begin() + static_cast<size_t>(z) * resolution);
+    }
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include "Vec3.h"
+
+// Heights on a regular (cells + 1)^2 grid of samples, `spacing` apart from
+// `originX, originZ`. Nothing here touches GL, so the baker can use it.
+struct HeightField {
+    int cells = 0;
+    float originX = 0.0f, originZ = 0.0f;
+    float spacing = 1.0f;
+    std::vector<float> heights; // row-major, z then x
+
+    int resolution() const { return cells + 1; }
+    float at(int x, int z) const { return heights[static_cast<size_t>(z) * resolution() + x]; }
+};
+
+// Batched height query: points are read as (x, z), one height per point
+typedef std::function<void(const std::vector<Vec3>& points, std::vector<float>& out)> HeightQuery;
+
+// Grid spacing with about as many samples as a mesh of `triangleCount`
+// triangles over these XZ bounds has vertices (two triangles per cell)
+float meshSampleSpacing(const Vec3& boundsMin, const Vec3& boundsMax, size_t triangleCount);
+
+// Samples `heightsAt` over the square on the XZ bounds' larger side. cells
+// is baseCells times the smallest power of two that brings the spacing
+// down to `spacing`, but at most maxCells. Points past the bounds (the
+// short side of a non-square area) take the height at the nearest edge.
+bool resampleHeightField(const Vec3& boundsMin, const Vec3& boundsMax, float spacing, int baseCells, int maxCells,
+                         const HeightQuery& heightsAt, HeightField& out);
@@ -0,0 +1,139 @@
+#include "HeightGrid.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Hard cap so a degenerate mesh (one huge sliver) can't allocate a giant grid
+const int MAX_CELLS_PER_AXIS = 4096;
+
+// Batched queries per job; each is a cell lookup and a short triangle scan
+const size_t POINTS_PER_JOB = 1024;
+
+} // namespace
+
+void HeightGrid::clear() {
+    cellsX = cellsZ = 0;
+    triangleCount = 0;
+    cellStart.clear();
+    cellTriangles.clear();
+}
+
+int HeightGrid::cellIndexX(float x) const {
+    int i = static_cast<int>(std::floor((x - minX) * invCellX));
+    return std::min(std::max(i, 0), cellsX - 1);
+}
+
+int HeightGrid::cellIndexZ(float z) const {
+    int i = static_cast<int>(std::floor((z - minZ) * invCellZ));
+    return std::min(std::max(i, 0), cellsZ - 1);
+}
+
+void HeightGrid::build(const std::vector<Vec3>& vertices, const std::vector<Face>& faces, float targetPerCell) {
+    clear();
+
+    // Keep only faces with valid indices
+    const int vertexCount = static_cast<int>(vertices.size());
+    std::vector<Vec3> corners;
+    corners.reserve(faces.size() * 3);
+    for (const auto& face : faces) {
+        bool valid = true;
+        for (int i = 0; i < 3; i++)
+            if (face.v[i] < 0 || face.v[i] >= vertexCount) valid = false;
+        if (!valid) continue;
+        for (int i = 0; i < 3; i++) corners.push_back(vertices[face.v[i]]);
+    }
+    triangleCount = corners.size() / 3;
+    if (triangleCount == 0) return;
+
+    float maxX, maxZ;
+    minX = maxX = corners[0].x;
+    minZ = maxZ = corners[0].z;
+    for (const auto& c : corners) {
+        minX = std::min(minX, c.x); maxX = std::max(maxX, c.x);
+        minZ = std::min(minZ, c.z); maxZ = std::max(maxZ, c.z);
+    }
+
+    // Pick roughly square cells so the average cell holds targetPerCell triangles
+    float extentX = std::max(maxX - minX, 1e-3f);
+    float extentZ = std::max(maxZ - minZ, 1e-3f);
+    double cellCount = std::max(1.0, triangleCount / static_cast<double>(std::max(targetPerCell, 0.1f)));
+    double cellSize = std::sqrt(extentX * static_cast<double>(extentZ) / cellCount);
+    cellsX = std::min(MAX_CELLS_PER_AXIS, std::max(1, static_cast<int>(std::ceil(extentX / cellSize))));
+    cellsZ = std::min(MAX_CELLS_PER_AXIS, std::max(1, static_cast<int>(std::ceil(extentZ / cellSize))));
+    invCellX = cellsX / extentX;
+    invCellZ = cellsZ / extentZ;
+
+    // Triangle bounds are padded slightly so a hit that lands a rounding
+    // error outside a triangle's exact footprint is still found in its cell
+    const float padX = 1e-4f / invCellX;
+    const float padZ = 1e-4f / invCellZ;
+
+    auto cellRange = [&](size_t tri, int& x0, int& x1, int& z0, int& z1) {
+        const Vec3* c = &corners[tri * 3];
+        float lo = std::min(c[0].x, std::min(c[1].x, c[2].x)) - padX;
+        float hi = std::max(c[0].x, std::max(c[1].x, c[2].x)) + padX;
+        x0 = cellIndexX(lo); x1 = cellIndexX(hi);
+        lo = std::min(c[0].z, std::min(c[1].z, c[2].z)) - padZ;
+        hi = std::max(c[0].z, std::max(c[1].z, c[2].z)) + padZ;
+        z0 = cellIndexZ(lo); z1 = cellIndexZ(hi);
+    };
+
+    // Two passes: count per cell, then scatter into one flat array
+    cellStart.assign(static_cast<size_t>(cellsX) * cellsZ + 1, 0);
+    for (size_t t = 0; t < triangleCount; t++) {
+        int x0, x1, z0, z1;
+        cellRange(t, x0, x1, z0, z1);
+        for (int z = z0; z <= z1; z++)
+            for (int x = x0; x <= x1; x++)
+                cellStart[static_cast<size_t>(z) * cellsX + x + 1]++;
+    }
+    for (size_t i = 1; i < cellStart.size(); i++) cellStart[i] += cellStart[i - 1];
+
+    cellTriangles.resize(cellStart.back());
+    std::vector<uint32_t> cursor(cellStart.begin(), cellStart.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++) {
+        int x0, x1, z0, z1;
+        cellRange(t, x0, x1, z0, z1);
+        const Vec3* c = &corners[t * 3];
+        for (int z = z0; z <= z1; z++)
+            for (int x = x0; x <= x1; x++)
+                cellTriangles.set(cursor[static_cast<size_t>(z) * cellsX + x]++, c[0], c[1], c[2]);
+    }
+}
+
+bool HeightGrid::heightAt(float x, float z, float rayStartY, float& outHeight) const {
+    if (triangleCount == 0) return false;
+
+    // Points outside the mesh footprint can't hit anything
+    float cx = (x - minX) * invCellX;
+    float cz = (z - minZ) * invCellZ;
+    if (cx < -1e-3f || cz < -1e-3f || cx > cellsX + 1e-3f || cz > cellsZ + 1e-3f) return false;
+
+    const size_t cell = static_cast<size_t>(cellIndexZ(z)) * cellsX + cellIndexX(x);
+    const Vec3 rayOrigin = { x, rayStartY, z };
+    const Vec3 rayDir = { 0.0f, -1.0f, 0.0f };
+
+    // The highest surface point is the nearest hit of the downward ray
+    float t = 0.0f;
+    size_t index = 0;
+    if (!soaClosestHit(cellTriangles, cellStart[cell], cellStart[cell + 1], rayOrigin, rayDir,
+                       std::numeric_limits<float>::max(), t, index))
+        return false;
+
+    outHeight = rayOrigin.y + t * rayDir.y;
+    return true;
+}
+
+void HeightGrid::heightsAt(const std::vector<Vec3>& points, float rayStartY, float missValue,
+                           std::vector<float>& out) const {
+    out.resize(points.size());
+    JobSystem::get().parallelFor(points.size(), POINTS_PER_JOB, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            float h;
+            out[i] = heightAt(points[i].x, points[i].z, rayStartY, h) ? h : missValue;
+        }
+    });
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "MeshData.h"
+#include "TriangleSoA.h"
+
+// Uniform grid over the XZ footprint of a triangle mesh, built once at load.
+// Each cell lists the triangles whose XZ bounds overlap it, so a downward
+// height query only tests the handful of triangles in one cell instead of
+// the whole mesh. Results are identical to testing every triangle.
+class HeightGrid {
+public:
+    // targetPerCell is the average number of triangles per cell to aim for
+    void build(const std::vector<Vec3>& vertices, const std::vector<Face>& faces, float targetPerCell = 2.0f);
+    void clear();
+    bool empty() const { return triangleCount == 0; }
+
+    // Casts a ray straight down from (x, rayStartY, z) and returns the highest hit.
+    // Returns false when no triangle lies under the point.
+    bool heightAt(float x, float z, float rayStartY, float& outHeight) const;
+
+    // Batched form, spread over the job system; points are read as (x, z)
+    // and misses are written as `missValue`
+    void heightsAt(const std::vector<Vec3>& points, float rayStartY, float missValue,
+                   std::vector<float>& out) const;
+
+    int getCellsX() const { return cellsX; }
+    int getCellsZ() const { return cellsZ; }
+
+private:
+    int cellIndexX(float x) const;
+    int cellIndexZ(float z) const;
+
+    float minX = 0.0f, minZ = 0.0f;
+    float invCellX = 0.0f, invCellZ = 0.0f;
+    int cellsX = 0, cellsZ = 0;
+    size_t triangleCount = 0;
+
+    // Triangles are copied into SoA form grouped by cell (a triangle that
+    // spans several cells is stored once per cell), so a query is one
+    // contiguous SIMD scan over [cellStart[c], cellStart[c + 1])
+    std::vector<uint32_t> cellStart; // cellsX * cellsZ + 1 offsets into cellTriangles
+    TriangleSoA cellTriangles;
+};
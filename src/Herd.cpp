@@ -0,0 +1,266 @@
+#include "Herd.h"
+#include "Components.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "Simd.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace {
+
+// Horses steered per job
+const size_t HORSES_PER_JOB = 512;
+// Padding after the sorted arrays so a four-wide load may run past the end
+const size_t PAD = 3;
+// How fast (1/s) a horse eases back towards the grazing speed
+const float SPEED_RESPONSE = 0.8f;
+// Acceleration (m/s^2) per metre outside the area
+const float AREA_PULL = 2.0f;
+
+// Sums of what the neighbours of one horse contribute: count, their
+// velocities, their offsets from it, and the push away from those too
+// close. One partial sum per SIMD lane, added up once per horse.
+struct alignas(16) Neighbourhood {
+    float count[4] = {}, velX[4] = {}, velZ[4] = {};
+    float offsetX[4] = {}, offsetZ[4] = {};
+    float pushX[4] = {}, pushZ[4] = {};
+};
+
+float total(const float lanes[4]) {
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+void gatherScalar(const float* posX, const float* posZ, const float* velX, const float* velZ, uint32_t begin,
+                  uint32_t end, float x, float z, float radius2, float separation2, Neighbourhood& n) {
+    for (uint32_t j = begin; j < end; j++) {
+        const float dx = posX[j] - x, dz = posZ[j] - z;
+        const float d2 = dx * dx + dz * dz;
+        if (d2 >= radius2 || d2 <= 0.0f) continue;
+        n.count[0] += 1.0f;
+        n.velX[0] += velX[j];
+        n.velZ[0] += velZ[j];
+        n.offsetX[0] += dx;
+        n.offsetZ[0] += dz;
+        if (d2 < separation2) {
+            n.pushX[0] -= dx / d2;
+            n.pushZ[0] -= dz / d2;
+        }
+    }
+}
+
+#ifdef FALLAGA_SSE
+// The same four horses at a time; lanes past `end` are masked off
+void gatherSse(const float* posX, const float* posZ, const float* velX, const float* velZ, uint32_t begin,
+               uint32_t end, float x, float z, float radius2, float separation2, Neighbourhood& n) {
+    const __m128 x4 = _mm_set1_ps(x), z4 = _mm_set1_ps(z);
+    const __m128 radius4 = _mm_set1_ps(radius2), separation4 = _mm_set1_ps(separation2);
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128i end4 = _mm_set1_epi32(static_cast<int>(end));
+    const __m128i laneOffsets = _mm_setr_epi32(0, 1, 2, 3);
+    __m128 count = _mm_load_ps(n.count), sumVelX = _mm_load_ps(n.velX), sumVelZ = _mm_load_ps(n.velZ);
+    __m128 sumX = _mm_load_ps(n.offsetX), sumZ = _mm_load_ps(n.offsetZ);
+    __m128 pushX = _mm_load_ps(n.pushX), pushZ = _mm_load_ps(n.pushZ);
+    for (uint32_t j = begin; j < end; j += 4) {
+        const __m128i lanes = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(j)), laneOffsets);
+        const __m128 valid = _mm_castsi128_ps(_mm_cmplt_epi32(lanes, end4));
+        const __m128 dx = _mm_sub_ps(_mm_loadu_ps(posX + j), x4);
+        const __m128 dz = _mm_sub_ps(_mm_loadu_ps(posZ + j), z4);
+        const __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz));
+        const __m128 near = _mm_and_ps(valid, _mm_and_ps(_mm_cmplt_ps(d2, radius4), _mm_cmpgt_ps(d2, zero)));
+        count = _mm_add_ps(count, _mm_and_ps(near, one));
+        sumVelX = _mm_add_ps(sumVelX, _mm_and_ps(near, _mm_loadu_ps(velX + j)));
+        sumVelZ = _mm_add_ps(sumVelZ, _mm_and_ps(near, _mm_loadu_ps(velZ + j)));
+        sumX = _mm_add_ps(sumX, _mm_and_ps(near, dx));
+        sumZ = _mm_add_ps(sumZ, _mm_and_ps(near, dz));
+        // Masked lanes may divide by zero; the result is dropped
+        const __m128 close = _mm_and_ps(near, _mm_cmplt_ps(d2, separation4));
+        const __m128 inverse = _mm_div_ps(one, _mm_max_ps(d2, _mm_set1_ps(1e-12f)));
+        pushX = _mm_sub_ps(pushX, _mm_and_ps(close, _mm_mul_ps(dx, inverse)));
+        pushZ = _mm_sub_ps(pushZ, _mm_and_ps(close, _mm_mul_ps(dz, inverse)));
+    }
+    _mm_store_ps(n.count, count);
+    _mm_store_ps(n.velX, sumVelX);
+    _mm_store_ps(n.velZ, sumVelZ);
+    _mm_store_ps(n.offsetX, sumX);
+    _mm_store_ps(n.offsetZ, sumZ);
+    _mm_store_ps(n.pushX, pushX);
+    _mm_store_ps(n.pushZ, pushZ);
+}
+#endif
+
+} // namespace
+
+Herd::Herd(const HerdParams& params) : params(params), cellSize(params.neighbourRadius) {}
+
+void Herd::setArea(const Vec3& min, const Vec3& max) {
+    hasArea = true;
+    areaMin = min;
+    areaMax = max;
+}
+
+uint32_t Herd::bucketOf(int cellX, int cellZ) const {
+    return (static_cast<uint32_t>(cellX) * 73856093u ^ static_cast<uint32_t>(cellZ) * 19349663u) & bucketMask;
+}
+
+void Herd::update(World& world, const Vec3& threat, float dt) {
+    PROFILE_SCOPE("Herd::update");
+    gatherX.clear();
+    gatherZ.clear();
+    gatherVelX.clear();
+    gatherVelZ.clear();
+    world.eachChunk<Transform, Velocity, HorseTag>(
+        [this](size_t count, const Entity*, Transform* transforms, Velocity* velocities, HorseTag*) {
+            for (size_t i = 0; i < count; i++) {
+                gatherX.push_back(transforms[i].x);
+                gatherZ.push_back(transforms[i].z);
+                gatherVelX.push_back(velocities[i].value.x);
+                gatherVelZ.push_back(velocities[i].value.z);
+            }
+        });
+    stats = Stats();
+    stats.horses = gatherX.size();
+    if (gatherX.empty()) return;
+
+    buildHash();
+
+    std::atomic<size_t> neighbours{0}, candidates{0};
+    JobSystem::get().parallelFor(stats.horses, HORSES_PER_JOB, [&](size_t begin, size_t end) {
+        size_t found = 0, looked = 0;
+        if (vectorized) steer<true>(begin, end, threat, dt, found, looked);
+        else steer<false>(begin, end, threat, dt, found, looked);
+        neighbours += found;
+        candidates += looked;
+    });
+    stats.neighbours = neighbours;
+    stats.candidates = candidates;
+
+    // Same query, same order: nothing was created or destroyed since the gather
+    size_t i = 0;
+    world.eachChunk<Transform, Velocity, HorseTag>(
+        [&](size_t count, const Entity*, Transform*, Velocity* velocities, HorseTag*) {
+            for (size_t row = 0; row < count; row++, i++) {
+                const uint32_t slot = slotOf[i];
+                velocities[row].value = Vec3(newVelX[slot], 0.0f, newVelZ[slot]);
+            }
+        });
+}
+
+// Counting sort by bucket: bucketStart[b] .. bucketStart[b + 1] are the
+// horses whose cell hashes to b. Cells that share a bucket are told apart
+// by the distance test.
+void Herd::buildHash() {
+    const size_t count = gatherX.size();
+    cellSize = params.neighbourRadius;
+    uint32_t buckets = 64;
+    while (buckets < 2 * count) buckets *= 2;
+    bucketMask = buckets - 1;
+
+    bucketStart.assign(buckets + 1, 0);
+    bucketOfHorse.resize(count);
+    const float inverseCell = 1.0f / cellSize;
+    for (size_t i = 0; i < count; i++) {
+        const int cellX = static_cast<int>(std::floor(gatherX[i] * inverseCell));
+        const int cellZ = static_cast<int>(std::floor(gatherZ[i] * inverseCell));
+        bucketOfHorse[i] = bucketOf(cellX, cellZ);
+        bucketStart[bucketOfHorse[i] + 1]++;
+    }
+    for (uint32_t b = 0; b < buckets; b++) bucketStart[b + 1] += bucketStart[b];
+
+    bucketFill.assign(bucketStart.begin(), bucketStart.end() - 1);
+    slotOf.resize(count);
+    for (std::vector<float>* v : { &posX, &posZ, &velX, &velZ }) v->assign(count + PAD, 0.0f);
+    newVelX.resize(count);
+    newVelZ.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const uint32_t slot = bucketFill[bucketOfHorse[i]]++;
+        slotOf[i] = slot;
+        posX[slot] = gatherX[i];
+        posZ[slot] = gatherZ[i];
+        velX[slot] = gatherVelX[i];
+        velZ[slot] = gatherVelZ[i];
+    }
+}
+
+template <bool Simd>
+void Herd::steer(size_t begin, size_t end, const Vec3& threat, float dt, size_t& neighbours, size_t& candidates) {
+    const float radius2 = params.neighbourRadius * params.neighbourRadius;
+    const float separation2 = params.separationRadius * params.separationRadius;
+    const float inverseCell = 1.0f / cellSize;
+#ifdef FALLAGA_SSE
+    auto gather = Simd ? gatherSse : gatherScalar;
+#else
+    auto gather = gatherScalar;
+#endif
+
+    for (size_t s = begin; s < end; s++) {
+        const float x = posX[s], z = posZ[s];
+        const float vx = velX[s], vz = velZ[s];
+        const int cellX = static_cast<int>(std::floor(x * inverseCell));
+        const int cellZ = static_cast<int>(std::floor(z * inverseCell));
+
+        // The 3x3 cells around the horse cover neighbourRadius; a bucket
+        // two of them hash to is scanned once
+        Neighbourhood n;
+        uint32_t seen[9];
+        int seenCount = 0;
+        for (int dz = -1; dz <= 1; dz++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                const uint32_t bucket = bucketOf(cellX + dx, cellZ + dz);
+                if (std::find(seen, seen + seenCount, bucket) != seen + seenCount) continue;
+                seen[seenCount++] = bucket;
+                const uint32_t first = bucketStart[bucket], last = bucketStart[bucket + 1];
+                candidates += last - first;
+                gather(posX.data(), posZ.data(), velX.data(), velZ.data(), first, last, x, z, radius2, separation2, n);
+            }
+        }
+        const float count = total(n.count);
+        neighbours += static_cast<size_t>(count);
+
+        float ax = 0.0f, az = 0.0f;
+        if (count > 0.0f) {
+            const float inverseCount = 1.0f / count;
+            ax += (total(n.velX) * inverseCount - vx) * params.alignmentWeight +
+                  total(n.offsetX) * inverseCount * params.cohesionWeight + total(n.pushX) * params.separationWeight;
+            az += (total(n.velZ) * inverseCount - vz) * params.alignmentWeight +
+                  total(n.offsetZ) * inverseCount * params.cohesionWeight + total(n.pushZ) * params.separationWeight;
+        }
+
+        // Away from the threat, harder the closer it is
+        const float tx = x - threat.x, tz = z - threat.z;
+        const float threat2 = tx * tx + tz * tz;
+        if (threat2 < params.fleeRadius * params.fleeRadius && threat2 > 0.0f) {
+            const float distance = std::sqrt(threat2);
+            const float urgency = params.fleeWeight * (1.0f - distance / params.fleeRadius) / distance;
+            ax += tx * urgency;
+            az += tz * urgency;
+        }
+
+        // Settle back to grazing speed once nothing is pushing
+        const float speed = std::sqrt(vx * vx + vz * vz);
+        if (speed > 1e-4f) {
+            const float ease = (params.grazeSpeed - speed) * SPEED_RESPONSE / speed;
+            ax += vx * ease;
+            az += vz * ease;
+        }
+
+        if (hasArea) {
+            ax += (std::max(areaMin.x - x, 0.0f) - std::max(x - areaMax.x, 0.0f)) * AREA_PULL;
+            az += (std::max(areaMin.z - z, 0.0f) - std::max(z - areaMax.z, 0.0f)) * AREA_PULL;
+        }
+
+        const float acceleration = std::sqrt(ax * ax + az * az);
+        if (acceleration > params.maxAcceleration) {
+            ax *= params.maxAcceleration / acceleration;
+            az *= params.maxAcceleration / acceleration;
+        }
+        float nx = vx + ax * dt, nz = vz + az * dt;
+        const float newSpeed = std::sqrt(nx * nx + nz * nz);
+        if (newSpeed > params.maxSpeed) {
+            nx *= params.maxSpeed / newSpeed;
+            nz *= params.maxSpeed / newSpeed;
+        }
+        newVelX[s] = nx;
+        newVelZ[s] = nz;
+    }
+}
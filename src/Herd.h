@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Vec3.h"
+#include "World.h"
+
+// Tuning of the herd behaviour; distances in metres, speeds in m/s
+struct HerdParams {
+    float neighbourRadius = 4.0f;   // alignment and cohesion look this far
+    float separationRadius = 1.5f;  // and keep at least this much room
+    float separationWeight = 6.0f;
+    float alignmentWeight = 1.0f;
+    float cohesionWeight = 0.4f;
+    float fleeRadius = 12.0f;       // bolt from a threat this close
+    float fleeWeight = 12.0f;
+    float grazeSpeed = 0.6f;        // speed the herd settles back to
+    float maxSpeed = 7.0f;
+    float maxAcceleration = 10.0f;
+};
+
+// Flocking for every horse in a World (boids: separation, alignment and
+// cohesion) plus fleeing from a threat, usually the player. update() only
+// sets each horse's Velocity; integrateMotion() moves them and
+// updateHorses() keeps them on the ground.
+//
+// Neighbours are found through a uniform spatial hash over the XZ plane,
+// rebuilt every tick: the horses are counting-sorted by cell into
+// structure-of-arrays positions and velocities, so the horses near one
+// are the few short runs of the 3x3 cells around it, scanned four at a
+// time with SSE. Steering is spread over the job system.
+class Herd {
+public:
+    explicit Herd(const HerdParams& params = HerdParams());
+
+    // Horses outside the box are turned back in (none by default)
+    void setArea(const Vec3& min, const Vec3& max);
+    // false takes the scalar path, for comparisons
+    void setVectorized(bool enabled) { vectorized = enabled; }
+    const HerdParams& getParams() const { return params; }
+
+    // Steers every entity with a Transform, Velocity and HorseTag away from
+    // `threat` and towards its neighbours over `dt` seconds
+    void update(World& world, const Vec3& threat, float dt);
+
+    struct Stats {
+        size_t horses = 0;
+        size_t neighbours = 0; // within neighbourRadius, summed over the herd
+        size_t candidates = 0; // looked at in the hash cells to find those
+    };
+    const Stats& getStats() const { return stats; }
+
+private:
+    void buildHash();
+    template <bool Simd>
+    void steer(size_t begin, size_t end, const Vec3& threat, float dt, size_t& neighbours, size_t& candidates);
+    uint32_t bucketOf(int cellX, int cellZ) const;
+
+    HerdParams params;
+    bool vectorized = true;
+    bool hasArea = false;
+    Vec3 areaMin, areaMax;
+
+    // Horses in World order, as gathered from the Transform and Velocity arrays
+    std::vector<float> gatherX, gatherZ, gatherVelX, gatherVelZ;
+    std::vector<uint32_t> bucketOfHorse;
+    std::vector<uint32_t> slotOf; // position of each in the hash order
+
+    // The same in hash order, padded by three for four-wide loads
+    std::vector<float> posX, posZ, velX, velZ;
+    std::vector<float> newVelX, newVelZ;
+    std::vector<uint32_t> bucketStart; // bucketMask + 2 offsets into them
+    std::vector<uint32_t> bucketFill;
+    uint32_t bucketMask = 0;
+    float cellSize = 1.0f;
+
+    Stats stats;
+};
@@ -1,21 +1,119 @@
 #define WIN32_LEAN_AND_MEAN
 #include <GL/glew.h>
 #include "Horse.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
 
+namespace {
 
-Horse::Horse() {}
+// The placeholder box a horse is drawn as, and its colour
+const float WIDTH = 0.4f, LENGTH = 0.9f;
+const Vec3 COAT(0.45f, 0.3f, 0.18f);
+// Footprint radius, so the bounds hold at any heading
+const float RADIUS = 0.5f * std::sqrt(WIDTH * WIDTH + LENGTH * LENGTH);
 
-void Horse::update() {}
+Bounds horseBounds(const Transform& t) {
+    Bounds b;
+    b.min = Vec3(t.x - RADIUS, t.y, t.z - RADIUS);
+    b.max = Vec3(t.x + RADIUS, t.y + HORSE_HEIGHT, t.z + RADIUS);
+    return b;
+}
+
+} // namespace
+
+Entity spawnHorse(World& world, const Vec3& position, const Vec3& velocity) {
+    const Transform t = { position.x, position.y, position.z, 1.0f, std::atan2(velocity.x, velocity.z) };
+    return world.create(t, Velocity{ velocity }, horseBounds(t), Visibility{ 1 }, Collider{ -1 }, HorseTag());
+}
+
+void spawnHerd(World& world, int count, const Vec3& origin, float maxSide, float speed) {
+    const int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(count))));
+    const float spacing = std::min(2.0f, maxSide / std::max(side, 1));
+    for (int i = 0; i < count; i++) {
+        const float heading = i * 2.4f; // golden angle apart
+        const Vec3 offset((i % side - 0.5f * (side - 1)) * spacing, 0.0f, (i / side) * spacing);
+        spawnHorse(world, origin + offset, Vec3(std::sin(heading), 0.0f, std::cos(heading)) * speed);
+    }
+}
+
+void updateHorses(World& world, const HeightQuery& heightsAt) {
+    PROFILE_SCOPE("updateHorses");
+    std::vector<Vec3> points;
+    points.reserve(world.count<HorseTag>());
+    world.each<Transform, Velocity, Bounds, HorseTag>(
+        [&points](Transform& t, Velocity&, Bounds&, HorseTag&) { points.push_back(Vec3(t.x, 0.0f, t.z)); });
+    std::vector<float> heights;
+    heightsAt(points, heights);
+
+    size_t i = 0;
+    world.each<Transform, Velocity, Bounds, HorseTag>([&](Transform& t, Velocity& v, Bounds& b, HorseTag&) {
+        t.y = heights[i++];
+        // A standing horse keeps its heading
+        if (v.value.x != 0.0f || v.value.z != 0.0f) t.yaw = std::atan2(v.value.x, v.value.z);
+        b = horseBounds(t);
+    });
+}
+
+void updateHorseColliders(World& world, CollisionWorld& collision) {
+    PROFILE_SCOPE("updateHorseColliders");
+    int mesh = collision.findMesh("horse");
+    if (mesh < 0) mesh = collision.addMesh("horse", CollisionMesh::box(Vec3(WIDTH, HORSE_HEIGHT, LENGTH)));
+    // One lock for the lot rather than one per horse
+    std::vector<int> bodies;
+    std::vector<Transform> transforms;
+    bodies.reserve(world.count<HorseTag>());
+    transforms.reserve(bodies.capacity());
+    world.each<Transform, Collider, HorseTag>([&](Transform& t, Collider& c, HorseTag&) {
+        if (c.body < 0) {
+            c.body = collision.addBody(mesh, t);
+        } else {
+            bodies.push_back(c.body);
+            transforms.push_back(t);
+        }
+    });
+    collision.moveBodies(bodies.data(), transforms.data(), bodies.size());
+}
+
+void saveHorsePoses(World& world, std::vector<HorsePose>& out) {
+    out.clear();
+    world.each<Transform, Bounds, HorseTag>([&out](Transform& t, Bounds& b, HorseTag&) { out.push_back({ t, b }); });
+}
+
+void blendHorsePoses(World& world, const std::vector<HorsePose>& previous, const std::vector<HorsePose>& current,
+                     float alpha) {
+    if (previous.size() != current.size() || current.size() != world.count<HorseTag>()) return;
+    const float PI = 3.14159265f;
+    size_t i = 0;
+    world.each<Transform, Bounds, HorseTag>([&](Transform& t, Bounds& b, HorseTag&) {
+        const Transform& from = previous[i].transform;
+        const Transform& to = current[i].transform;
+        t.x = from.x + (to.x - from.x) * alpha;
+        t.y = from.y + (to.y - from.y) * alpha;
+        t.z = from.z + (to.z - from.z) * alpha;
+        // The short way round
+        float turn = to.yaw - from.yaw;
+        if (turn > PI) turn -= 2.0f * PI;
+        if (turn < -PI) turn += 2.0f * PI;
+        t.yaw = from.yaw + turn * alpha;
+        // The boxes are blended rather than rebuilt so whatever the step
+        // added to them (a rider on top) stays; over one step's turn that
+        // is within a hair of the box around the blended pose
+        const Bounds& start = previous[i].bounds;
+        const Bounds& end = current[i++].bounds;
+        b.min = start.min + (end.min - start.min) * alpha;
+        b.max = start.max + (end.max - start.max) * alpha;
+    });
+}
+
+HorseRenderer::HorseRenderer() : batch(renderer.addBoxBatch(Vec3(WIDTH, HORSE_HEIGHT, LENGTH), COAT)) {}
 
-void Horse::render() {
-    float half = 0.25f;
-    glPushMatrix();
-    glTranslatef(1.0f, 0.0f, 0.0f);
-    glBegin(GL_QUADS);
-        glVertex3f(-half,-half,-half); glVertex3f(half,-half,-half);
-        glVertex3f(half,half,-half); glVertex3f(-half,half,-half);
-        glVertex3f(-half,-half,half); glVertex3f(half,-half,half);
-        glVertex3f(half,half,half); glVertex3f(-half,half,half);
-    glEnd();
-    glPopMatrix();
+void HorseRenderer::enqueue(World& world, RenderQueue& queue) {
+    PROFILE_SCOPE("HorseRenderer::enqueue");
+    visible.clear();
+    world.each<Transform, Visibility, HorseTag>([this](Transform& t, Visibility& v, HorseTag&) {
+        if (v.visible) visible.push_back({ t.x, t.y, t.z, t.scale, t.yaw });
+    });
+    renderer.setInstances(batch, visible, true);
+    renderer.enqueue(queue);
 }
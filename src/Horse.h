@@ -1,11 +1,57 @@
 #pragma once
-#include "Character.h"
+#include <vector>
+#include "Collision.h"
+#include "Components.h"
+#include "HeightField.h"
+#include "InstancedRenderer.h"
+#include "RenderQueue.h"
+#include "World.h"
 
-class Horse {
+// Height of a horse's back above its feet, where a rider sits
+const float HORSE_HEIGHT = 0.5f;
+
+// Horses are entities: Transform, Velocity, Bounds, Visibility, Collider
+// and a HorseTag. Herd (Herd.h) steers them by setting their Velocity,
+// integrateMotion() moves them and updateHorses() puts them back on the
+// ground.
+Entity spawnHorse(World& world, const Vec3& position, const Vec3& velocity = Vec3());
+
+// `count` horses on a square grid starting `origin` and growing along +z,
+// two metres apart or packed closer to fit in `maxSide`, each walking off
+// at `speed` in its own direction
+void spawnHerd(World& world, int count, const Vec3& origin, float maxSide, float speed);
+
+// Drops every horse onto the ground with one batched height query, turns
+// it to face where it is going and refreshes its bounds
+void updateHorses(World& world, const HeightQuery& heightsAt);
+
+// Keeps each horse's box in `collision` where the horse is, adding the
+// ones that have no body yet; call after updateHorses()
+void updateHorseColliders(World& world, CollisionWorld& collision);
+
+// Where a horse was drawn and culled after one fixed step
+struct HorsePose {
+    Transform transform;
+    Bounds bounds; // as the step left it, a rider's height included
+};
+
+// Every horse's pose in World order, to draw between two fixed steps
+void saveHorsePoses(World& world, std::vector<HorsePose>& out);
+// Puts every horse `alpha` of the way from `previous` to `current` (as
+// saved above, from the same horses); alpha = 1 puts them back where the
+// last step left them
+void blendHorsePoses(World& world, const std::vector<HorsePose>& previous, const std::vector<HorsePose>& current,
+                     float alpha);
+
+// Draws every horse that cullEntities() found visible as a box, all of
+// them with a single instanced draw call
+class HorseRenderer {
 public:
-    Horse();
-    void update();
-    void render();
+    HorseRenderer();
+    void enqueue(World& world, RenderQueue& queue);
+
 private:
-    Character dummy;
+    InstancedRenderer renderer;
+    int batch;
+    std::vector<InstanceData> visible;
 };
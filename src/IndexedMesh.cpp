@@ -0,0 +1,129 @@
+#include "IndexedMesh.h"
+
+namespace {
+
+struct CornerKey {
+    int v = -1, vt = -1, vn = -1;
+    bool operator==(const CornerKey& o) const { return v == o.v && vt == o.vt && vn == o.vn; }
+};
+
+inline uint64_t hashCorner(const CornerKey& k) {
+    uint64_t h = static_cast<uint32_t>(k.v) * 0x9E3779B97F4A7C15ull;
+    h ^= static_cast<uint32_t>(k.vt) * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+    h ^= static_cast<uint32_t>(k.vn) * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+    return h ^ (h >> 29);
+}
+
+const uint32_t EMPTY_SLOT = 0xFFFFFFFFu;
+
+// Open-addressed corner -> vertex table with linear probing over flat
+// arrays; several times faster than std::unordered_map for this job
+class CornerTable {
+public:
+    explicit CornerTable(size_t expected) { reset(expected * 2); }
+
+    // Returns the existing vertex for `key`, or stores `next` and returns it
+    uint32_t findOrInsert(const CornerKey& key, uint32_t next, bool& inserted) {
+        if ((used + 1) * 2 > values.size()) grow();
+        size_t slot = find(key);
+        inserted = values[slot] == EMPTY_SLOT;
+        if (inserted) {
+            keys[slot] = key;
+            values[slot] = next;
+            used++;
+        }
+        return values[slot];
+    }
+
+private:
+    void reset(size_t minCapacity) {
+        size_t capacity = 16;
+        while (capacity < minCapacity) capacity <<= 1;
+        mask = capacity - 1;
+        used = 0;
+        keys.assign(capacity, CornerKey());
+        values.assign(capacity, EMPTY_SLOT);
+    }
+
+    size_t find(const CornerKey& key) const {
+        size_t slot = hashCorner(key) & mask;
+        while (values[slot] != EMPTY_SLOT && !(keys[slot] == key)) slot = (slot + 1) & mask;
+        return slot;
+    }
+
+    void grow() {
+        std::vector<CornerKey> oldKeys;
+        std::vector<uint32_t> oldValues;
+        oldKeys.swap(keys);
+        oldValues.swap(values);
+        reset(oldValues.size() * 2);
+        for (size_t i = 0; i < oldValues.size(); i++) {
+            if (oldValues[i] == EMPTY_SLOT) continue;
+            size_t slot = find(oldKeys[i]);
+            keys[slot] = oldKeys[i];
+            values[slot] = oldValues[i];
+            used++;
+        }
+    }
+
+    size_t mask = 0;
+    size_t used = 0;
+    std::vector<CornerKey> keys;
+    std::vector<uint32_t> values;
+};
+
+} // namespace
+
+void buildIndexedMesh(const std::vector<Vec3>& positions, const std::vector<Vec3>& normals,
+                      const std::vector<Vec2>& texcoords,
+                      const std::map<std::string, std::vector<Face>>& materialFaces,
+                      IndexedMesh& out) {
+    out.vertices.clear();
+    out.indices.clear();
+    out.subMeshes.clear();
+
+    const int positionCount = static_cast<int>(positions.size());
+    const int normalCount = static_cast<int>(normals.size());
+    const int texcoordCount = static_cast<int>(texcoords.size());
+
+    size_t faceCount = 0;
+    for (const auto& group : materialFaces) faceCount += group.second.size();
+    out.indices.reserve(faceCount * 3);
+
+    // Corners are usually shared, so expect about one unique vertex per position
+    CornerTable lookup(positionCount);
+
+    for (const auto& group : materialFaces) {
+        SubMesh sub;
+        sub.material = group.first;
+        sub.firstIndex = static_cast<uint32_t>(out.indices.size());
+
+        for (const auto& face : group.second) {
+            bool valid = true;
+            for (int i = 0; i < 3; i++)
+                if (face.v[i] < 0 || face.v[i] >= positionCount) valid = false;
+            if (!valid) continue;
+
+            for (int i = 0; i < 3; i++) {
+                // Out-of-range attributes all collapse onto one "missing" key
+                CornerKey key;
+                key.v = face.v[i];
+                key.vt = (face.vt[i] >= 0 && face.vt[i] < texcoordCount) ? face.vt[i] : -1;
+                key.vn = (face.vn[i] >= 0 && face.vn[i] < normalCount) ? face.vn[i] : -1;
+
+                bool inserted;
+                uint32_t index = lookup.findOrInsert(key, static_cast<uint32_t>(out.vertices.size()), inserted);
+                if (inserted) {
+                    const Vec3& p = positions[key.v];
+                    Vec3 n = key.vn >= 0 ? normals[key.vn] : Vec3(0.0f, 1.0f, 0.0f);
+                    Vec2 t = key.vt >= 0 ? texcoords[key.vt] : Vec2(0.0f, 0.0f);
+                    out.vertices.push_back({ p.x, p.y, p.z, n.x, n.y, n.z, t.u, t.v });
+                }
+                out.indices.push_back(index);
+            }
+        }
+
+        sub.indexCount = static_cast<uint32_t>(out.indices.size()) - sub.firstIndex;
+        if (sub.indexCount > 0) out.subMeshes.push_back(sub);
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "MeshData.h"
+
+// Interleaved vertex as uploaded to the GPU: position, normal, texcoord
+struct MeshVertex {
+    float px, py, pz;
+    float nx, ny, nz;
+    float u, v;
+};
+
+// One material's slice of the index buffer
+struct SubMesh {
+    std::string material;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+};
+
+// A mesh with every distinct (v, vt, vn) corner stored once and triangles
+// referring to it by index. Sub-meshes follow materialFaces order.
+struct IndexedMesh {
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<SubMesh> subMeshes;
+
+    // 16-bit indices are enough when every vertex fits in a GLushort
+    bool fitsIn16Bit() const { return vertices.size() <= 0x10000; }
+};
+
+// Deduplicates face corners into an IndexedMesh. Faces with an out-of-range
+// vertex index are dropped; a missing normal or texcoord becomes (0, 1, 0)
+// or (0, 0). GL-free, so tools and benchmarks can use it.
+void buildIndexedMesh(const std::vector<Vec3>& positions, const std::vector<Vec3>& normals,
+                      const std::vector<Vec2>& texcoords,
+                      const std::map<std::string, std::vector<Face>>& materialFaces,
+                      IndexedMesh& out);
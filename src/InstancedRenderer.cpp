@@ -0,0 +1,330 @@
+#include "InstancedRenderer.h"
+#include "GlState.h"
+#include "ObjectModel.h"
+#include "Log.h"
+#include <cmath>
+#include <cstddef>
+
+namespace {
+
+// Attribute slots for the instance data. 6 and 7 are not aliased to any
+// fixed-function array on the drivers that alias (e.g. 2 is gl_Normal on NVIDIA).
+const GLuint INSTANCE_POSITION_SCALE = 6;
+const GLuint INSTANCE_ROTATION = 7;
+// Queued items carry the batch and the material range, in 8 bits; this
+// value stands for every range at once
+const uint32_t ALL_RANGES = 0xFF;
+
+// Fixed-function equivalent: LIGHT0 (directional), GL_COLOR_MATERIAL on
+// ambient and diffuse, texture modulated by the lit colour
+const char* VERTEX_SHADER = R"(
+#version 120
+attribute vec4 instancePositionScale;
+attribute float instanceYaw;
+varying vec4 litColor;
+varying vec2 texCoord;
+
+void main() {
+    float s = sin(instanceYaw);
+    float c = cos(instanceYaw);
+    vec3 p = gl_Vertex.xyz * instancePositionScale.w;
+    vec3 world = vec3(c * p.x + s * p.z, p.y, -s * p.x + c * p.z) + instancePositionScale.xyz;
+    vec3 n = vec3(c * gl_Normal.x + s * gl_Normal.z, gl_Normal.y, -s * gl_Normal.x + c * gl_Normal.z);
+
+    vec3 eyeNormal = normalize(gl_NormalMatrix * n);
+    vec3 lightDir = normalize(gl_LightSource[0].position.xyz);
+    float diffuse = max(dot(eyeNormal, lightDir), 0.0);
+    vec4 ambient = gl_LightModel.ambient + gl_LightSource[0].ambient;
+    litColor = gl_Color * ambient + gl_Color * gl_LightSource[0].diffuse * diffuse;
+    litColor.a = gl_Color.a;
+
+    texCoord = gl_MultiTexCoord0.xy;
+    gl_Position = gl_ModelViewProjectionMatrix * vec4(world, 1.0);
+}
+)";
+
+const char* FRAGMENT_SHADER = R"(
+#version 120
+uniform sampler2D diffuseMap;
+uniform bool useTexture;
+varying vec4 litColor;
+varying vec2 texCoord;
+
+void main() {
+    vec4 color = litColor;
+    if (useTexture) color *= texture2D(diffuseMap, texCoord);
+    gl_FragColor = color;
+}
+)";
+
+// Box batch vertices: position then normal
+const int BOX_VERTEX_FLOATS = 6;
+const int BOX_VERTICES = 36;
+
+// Two triangles per face, counter-clockwise seen from outside, of a box
+// `size` across with its base centred on the origin
+void buildBox(const Vec3& size, std::vector<float>& out) {
+    // Per face: the normal, then two axes along it with u x v = normal
+    const Vec3 faces[6][3] = {
+        { Vec3(1, 0, 0), Vec3(0, 1, 0), Vec3(0, 0, 1) },  { Vec3(-1, 0, 0), Vec3(0, 0, 1), Vec3(0, 1, 0) },
+        { Vec3(0, 1, 0), Vec3(0, 0, 1), Vec3(1, 0, 0) },  { Vec3(0, -1, 0), Vec3(1, 0, 0), Vec3(0, 0, 1) },
+        { Vec3(0, 0, 1), Vec3(1, 0, 0), Vec3(0, 1, 0) },  { Vec3(0, 0, -1), Vec3(0, 1, 0), Vec3(1, 0, 0) },
+    };
+    const float corners[6][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, -1 }, { 1, 1 }, { -1, 1 } };
+    out.clear();
+    for (const auto& face : faces) {
+        for (const auto& corner : corners) {
+            const Vec3 p = Vec3(0.0f, 0.5f, 0.0f) + (face[0] + face[1] * corner[0] + face[2] * corner[1]) * 0.5f;
+            const float vertex[BOX_VERTEX_FLOATS] = { p.x * size.x, p.y * size.y, p.z * size.z,
+                                                      face[0].x, face[0].y, face[0].z };
+            out.insert(out.end(), vertex, vertex + BOX_VERTEX_FLOATS);
+        }
+    }
+}
+
+GLuint compileShader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        LOG_ERROR("Instancing shader failed to compile: " << log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+} // namespace
+
+InstancedRenderer::InstancedRenderer() {
+    // Instanced arrays are core in 3.3; earlier drivers need both extensions
+    bool supported = GLEW_VERSION_3_3 || (GLEW_ARB_instanced_arrays && GLEW_ARB_draw_instanced);
+    if (!supported || ObjModel::usingDisplayLists() || !compileProgram()) {
+        LOG_INFO("Instanced rendering unavailable, drawing props one by one");
+    }
+}
+
+InstancedRenderer::~InstancedRenderer() {
+    clearBatches();
+    if (program) GlState::get().deleteProgram(program);
+}
+
+void InstancedRenderer::clearBatches() {
+    for (auto& batch : batches) {
+        if (batch.instanceBuffer) glDeleteBuffers(1, &batch.instanceBuffer);
+        if (batch.boxVao) GlState::get().deleteVertexArrays(1, &batch.boxVao);
+        if (batch.boxVbo) glDeleteBuffers(1, &batch.boxVbo);
+    }
+    batches.clear();
+}
+
+bool InstancedRenderer::compileProgram() {
+    GLuint vs = compileShader(GL_VERTEX_SHADER, VERTEX_SHADER);
+    GLuint fs = compileShader(GL_FRAGMENT_SHADER, FRAGMENT_SHADER);
+    if (!vs || !fs) {
+        if (vs) glDeleteShader(vs);
+        if (fs) glDeleteShader(fs);
+        return false;
+    }
+
+    program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glBindAttribLocation(program, INSTANCE_POSITION_SCALE, "instancePositionScale");
+    glBindAttribLocation(program, INSTANCE_ROTATION, "instanceYaw");
+    glLinkProgram(program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+        LOG_ERROR("Instancing shader failed to link: " << log);
+        glDeleteProgram(program);
+        program = 0;
+        return false;
+    }
+
+    GlState::get().useProgram(program);
+    glUniform1i(glGetUniformLocation(program, "diffuseMap"), 0);
+    useTextureLocation = glGetUniformLocation(program, "useTexture");
+    return true;
+}
+
+int InstancedRenderer::addBatch(const ObjModel* model, int lod) {
+    Batch batch;
+    batch.model = model;
+    batch.lod = lod;
+    batch.instanceBuffer = 0;
+    if (program) glGenBuffers(1, &batch.instanceBuffer);
+    batches.push_back(batch);
+    return static_cast<int>(batches.size()) - 1;
+}
+
+int InstancedRenderer::addBoxBatch(const Vec3& size, const Vec3& color) {
+    Batch batch;
+    batch.model = nullptr;
+    batch.lod = 0;
+    batch.instanceBuffer = 0;
+    buildBox(size, batch.boxVertices);
+    batch.boxColor = color;
+    if (program) {
+        glGenBuffers(1, &batch.instanceBuffer);
+        glGenBuffers(1, &batch.boxVbo);
+        glBindBuffer(GL_ARRAY_BUFFER, batch.boxVbo);
+        glBufferData(GL_ARRAY_BUFFER, batch.boxVertices.size() * sizeof(float), batch.boxVertices.data(),
+                     GL_STATIC_DRAW);
+
+        // Fixed-function arrays; in a compatibility context they are VAO state
+        const GLsizei stride = BOX_VERTEX_FLOATS * sizeof(float);
+        glGenVertexArrays(1, &batch.boxVao);
+        GlState::get().bindVertexArray(batch.boxVao);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(3, GL_FLOAT, stride, nullptr);
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glNormalPointer(GL_FLOAT, stride, reinterpret_cast<const void*>(3 * sizeof(float)));
+        GlState::get().bindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    batches.push_back(batch);
+    return static_cast<int>(batches.size()) - 1;
+}
+
+void InstancedRenderer::setInstances(int batchIndex, const std::vector<InstanceData>& instances, bool streaming) {
+    Batch& batch = batches[batchIndex];
+    // Kept as Transforms, which the fallback composes its matrices from
+    batch.instances.resize(instances.size());
+    for (size_t i = 0; i < instances.size(); i++) {
+        const InstanceData& instance = instances[i];
+        batch.instances[i] = { instance.x, instance.y, instance.z, instance.scale, instance.yaw };
+    }
+    if (!batch.instanceBuffer) return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, batch.instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), instances.data(),
+                 streaming ? GL_STREAM_DRAW : GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+size_t InstancedRenderer::getInstanceCount() const {
+    size_t count = 0;
+    for (const auto& batch : batches) count += batch.instances.size();
+    return count;
+}
+
+// ===============================
+// Rendering
+// ===============================
+// One item per material range of each model batch, so ranges that share
+// a texture are drawn together whichever batch they are in; one per box
+// batch; and the batches without a VAO on the fixed-function pass
+void InstancedRenderer::enqueue(RenderQueue& queue) const {
+    for (size_t i = 0; i < batches.size(); i++) {
+        const Batch& batch = batches[i];
+        if (batch.instances.empty()) continue;
+        const uint32_t index = static_cast<uint32_t>(i);
+        if (!program || (batch.model && !batch.model->getVertexArray())) {
+            const GLuint mesh = batch.model ? batch.model->getVertexArray() : batch.boxVao;
+            queue.push(queue.makeKey(RenderPass::FixedFunction, 0, 0, mesh, 0.0f), submitFallback, this, index);
+        } else if (!batch.model) {
+            queue.push(queue.makeKey(RenderPass::Opaque, program, 0, batch.boxVao, 0.0f), submitBoxes, this, index);
+        } else if (static_cast<uint32_t>(batch.model->getRangeCount(batch.lod)) >= ALL_RANGES) {
+            // More materials than the item data holds: one item for the lot
+            const uint64_t key = queue.makeKey(RenderPass::Opaque, program, 0, batch.model->getVertexArray(), 0.0f);
+            queue.push(key, submitRange, this, index << 8 | ALL_RANGES);
+        } else {
+            for (int range = 0; range < batch.model->getRangeCount(batch.lod); range++) {
+                const GLuint texture = batch.model->getRangeTexture(batch.lod, range);
+                const uint64_t key =
+                    queue.makeKey(RenderPass::Opaque, program, texture, batch.model->getVertexArray(), 0.0f);
+                queue.push(key, submitRange, this, index << 8 | static_cast<uint32_t>(range));
+            }
+        }
+    }
+}
+
+void InstancedRenderer::submitRange(const void* owner, uint32_t data) {
+    const InstancedRenderer& self = *static_cast<const InstancedRenderer*>(owner);
+    const Batch& batch = self.batches[data >> 8];
+    const uint32_t range = data & 0xFF;
+    GlState::get().useProgram(self.program);
+    batch.model->renderInstanced(batch.instanceBuffer, static_cast<GLsizei>(batch.instances.size()),
+                                 INSTANCE_POSITION_SCALE, INSTANCE_ROTATION, self.useTextureLocation, batch.lod,
+                                 range == ALL_RANGES ? -1 : static_cast<int>(range));
+}
+
+void InstancedRenderer::submitBoxes(const void* owner, uint32_t data) {
+    const InstancedRenderer& self = *static_cast<const InstancedRenderer*>(owner);
+    GlState::get().useProgram(self.program);
+    self.renderBoxes(self.batches[data]);
+}
+
+void InstancedRenderer::submitFallback(const void* owner, uint32_t data) {
+    const InstancedRenderer& self = *static_cast<const InstancedRenderer*>(owner);
+    self.renderFallback(self.batches[data]);
+}
+
+void InstancedRenderer::renderBoxes(const Batch& batch) const {
+    const GLsizei count = static_cast<GLsizei>(batch.instances.size());
+    GlState::get().bindVertexArray(batch.boxVao);
+    const GLsizei stride = sizeof(InstanceData);
+    glBindBuffer(GL_ARRAY_BUFFER, batch.instanceBuffer);
+    glEnableVertexAttribArray(INSTANCE_POSITION_SCALE);
+    glVertexAttribPointer(INSTANCE_POSITION_SCALE, 4, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<const void*>(offsetof(InstanceData, x)));
+    glVertexAttribDivisor(INSTANCE_POSITION_SCALE, 1);
+    glEnableVertexAttribArray(INSTANCE_ROTATION);
+    glVertexAttribPointer(INSTANCE_ROTATION, 1, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<const void*>(offsetof(InstanceData, yaw)));
+    glVertexAttribDivisor(INSTANCE_ROTATION, 1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glUniform1i(useTextureLocation, 0);
+    glColor3f(batch.boxColor.x, batch.boxColor.y, batch.boxColor.z);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, BOX_VERTICES, count);
+    glColor3f(1.0f, 1.0f, 1.0f);
+    ObjModel::addDrawStats(1, BOX_VERTICES / 3 * static_cast<size_t>(count));
+
+    glDisableVertexAttribArray(INSTANCE_POSITION_SCALE);
+    glDisableVertexAttribArray(INSTANCE_ROTATION);
+}
+
+void InstancedRenderer::renderFallback(const Batch& batch) const {
+    if (!batch.model) {
+        GlState& state = GlState::get();
+        state.useProgram(0);
+        state.disable(GL_TEXTURE_2D);
+        glColor3f(batch.boxColor.x, batch.boxColor.y, batch.boxColor.z);
+    }
+    // Every instance's modelview on the CPU in two batched passes, each then
+    // loaded as is
+    const size_t count = batch.instances.size();
+    Mat4 view;
+    glGetFloatv(GL_MODELVIEW_MATRIX, view.m);
+    fallbackMatrices.resize(count);
+    composeTransforms(batch.instances.data(), count, fallbackMatrices.data());
+    multiplyMatrices(view, fallbackMatrices.data(), count, fallbackMatrices.data());
+    for (size_t i = 0; i < count; i++) {
+        glLoadMatrixf(fallbackMatrices[i].m);
+        if (batch.model) {
+            batch.model->render(batch.lod);
+        } else {
+            glBegin(GL_TRIANGLES);
+            for (size_t v = 0; v < batch.boxVertices.size(); v += BOX_VERTEX_FLOATS) {
+                glNormal3fv(&batch.boxVertices[v + 3]);
+                glVertex3fv(&batch.boxVertices[v]);
+            }
+            glEnd();
+            ObjModel::addDrawStats(1, BOX_VERTICES / 3);
+        }
+    }
+    glLoadMatrixf(view.m);
+    if (!batch.model) glColor3f(1.0f, 1.0f, 1.0f);
+}
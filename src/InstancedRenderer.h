@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <GL/glew.h>
+#include "Mat4.h"
+#include "RenderQueue.h"
+#include "Vec3.h"
+
+class ObjModel;
+
+// Per-instance transform as stored in the instance buffer: world position,
+// uniform scale and a rotation about the Y axis in radians
+struct InstanceData {
+    float x, y, z;
+    float scale;
+    float yaw;
+};
+
+// Draws many copies of the same ObjModel with one glDrawElementsInstanced
+// per material. The transforms live in a GPU buffer and are applied by a
+// small compatibility-profile shader that reproduces the fixed-function
+// lighting used by the rest of the scene.
+//
+// Models on the display-list path, or drivers without instancing, fall back
+// to one push/translate/draw per instance. Nothing is drawn directly: each
+// batch and material goes into the frame's RenderQueue.
+class InstancedRenderer {
+public:
+    InstancedRenderer();
+    ~InstancedRenderer();
+
+    // Returns a batch handle; instances are uploaded with setInstances.
+    // Pass streaming = true when the set is replaced every frame (e.g. the
+    // visible subset after culling).
+    int addBatch(const ObjModel* model, int lod = 0);
+    // A batch of boxes instead of a model, for placeholders: `size` wide
+    // (x), high (y, standing on y = 0) and long (z) before the instance
+    // scale, lit in `color`
+    int addBoxBatch(const Vec3& size, const Vec3& color);
+    void setInstances(int batch, const std::vector<InstanceData>& instances, bool streaming = false);
+    size_t getInstanceCount() const;
+    // Drops every batch, e.g. when a streamed model arrives with new LODs
+    void clearBatches();
+
+    // Queues this frame's draws; they read the instances when submitted
+    void enqueue(RenderQueue& queue) const;
+
+    bool isInstanced() const { return program != 0; }
+
+private:
+    struct Batch {
+        const ObjModel* model; // null for a box batch
+        int lod;
+        GLuint instanceBuffer;
+        std::vector<Transform> instances; // kept for the fallback path
+
+        // Box batches: triangles as position and normal, and their arrays
+        std::vector<float> boxVertices;
+        Vec3 boxColor;
+        GLuint boxVao = 0, boxVbo = 0;
+    };
+
+    static void submitRange(const void* owner, uint32_t data);
+    static void submitBoxes(const void* owner, uint32_t data);
+    static void submitFallback(const void* owner, uint32_t data);
+
+    bool compileProgram();
+    void renderBoxes(const Batch& batch) const;
+    void renderFallback(const Batch& batch) const;
+
+    std::vector<Batch> batches;
+    mutable std::vector<Mat4> fallbackMatrices; // renderFallback()'s modelviews
+    GLuint program = 0;
+    GLint useTextureLocation = -1;
+};
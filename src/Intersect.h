@@ -0,0 +1,178 @@
+#pragma once
+#include "Vec3.h"
+
+// Geometry tests shared by the loaders, spatial indices and gameplay code.
+// Header-only and GL-free so tools and benchmarks can use them directly.
+
+// Möller–Trumbore against a triangle given as its first corner and two edges
+// (edge1 = v1 - v0, edge2 = v2 - v0). The SoA kernels in TriangleSoA.cpp
+// mirror these exact operations so their results stay bit-identical.
+inline bool intersectRayTriangleEdges(const Vec3& rayOrigin, const Vec3& rayDir,
+                                      const Vec3& v0, const Vec3& edge1, const Vec3& edge2,
+                                      float& outT) {
+    // A small value to prevent division by zero or floating-point errors
+    const float EPSILON = 0.0000001f;
+
+    // Calculate the cross product of the ray direction and edge2
+    Vec3 h = { rayDir.y * edge2.z - rayDir.z * edge2.y,
+               rayDir.z * edge2.x - rayDir.x * edge2.z,
+               rayDir.x * edge2.y - rayDir.y * edge2.x };
+
+    // Calculate the determinant
+    float a = edge1.x * h.x + edge1.y * h.y + edge1.z * h.z;
+
+    // Check if the ray is parallel to the triangle
+    if (a > -EPSILON && a < EPSILON) {
+        return false;
+    }
+
+    float f = 1.0f / a;
+    Vec3 s = { rayOrigin.x - v0.x, rayOrigin.y - v0.y, rayOrigin.z - v0.z };
+
+    // Calculate the barycentric coordinate u
+    float u = f * (s.x * h.x + s.y * h.y + s.z * h.z);
+
+    // Check if the intersection point is outside the triangle
+    if (u < 0.0f || u > 1.0f) {
+        return false;
+    }
+
+    // Calculate the cross product of s and edge1
+    Vec3 q = { s.y * edge1.z - s.z * edge1.y,
+               s.z * edge1.x - s.x * edge1.z,
+               s.x * edge1.y - s.y * edge1.x };
+
+    // Calculate the barycentric coordinate v
+    float v = f * (rayDir.x * q.x + rayDir.y * q.y + rayDir.z * q.z);
+
+    // Check if the intersection point is outside the triangle
+    if (v < 0.0f || u + v > 1.0f) {
+        return false;
+    }
+
+    // Calculate the distance `t`
+    float t = f * (edge2.x * q.x + edge2.y * q.y + edge2.z * q.z);
+
+    // Check if the intersection is in front of the ray's origin
+    if (t > EPSILON) {
+        outT = t;
+        return true;
+    }
+
+    return false;
+}
+
+// Ray-triangle intersection (Möller–Trumbore)
+inline bool intersectRayTriangle(const Vec3& rayOrigin, const Vec3& rayDir,
+                                 const Vec3& v0, const Vec3& v1, const Vec3& v2,
+                                 float& outT) {
+    // Calculate vectors for triangle edges
+    Vec3 edge1 = { v1.x - v0.x, v1.y - v0.y, v1.z - v0.z };
+    Vec3 edge2 = { v2.x - v0.x, v2.y - v0.y, v2.z - v0.z };
+    return intersectRayTriangleEdges(rayOrigin, rayDir, v0, edge1, edge2, outT);
+}
+
+// Closest point to `p` on triangle a-b-c (Ericson, Real-Time Collision
+// Detection 5.1.5), by which Voronoi region of the triangle p falls in
+inline Vec3 closestPointOnTriangle(const Vec3& p, const Vec3& a, const Vec3& b, const Vec3& c) {
+    const Vec3 ab = b - a, ac = c - a, ap = p - a;
+    const float d1 = ab.dot(ap), d2 = ac.dot(ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+    const Vec3 bp = p - b;
+    const float d3 = ab.dot(bp), d4 = ac.dot(bp);
+    if (d3 >= 0.0f && d4 <= d3) return b;
+
+    const float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+
+    const Vec3 cp = p - c;
+    const float d5 = ab.dot(cp), d6 = ac.dot(cp);
+    if (d6 >= 0.0f && d5 <= d6) return c;
+
+    const float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+
+    const float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    const float denom = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// Closest points between segments p1-q1 and p2-q2 (Ericson 5.1.9);
+// returns the squared distance between them
+inline float closestPointsSegmentSegment(const Vec3& p1, const Vec3& q1, const Vec3& p2, const Vec3& q2,
+                                         Vec3& outOn1, Vec3& outOn2) {
+    const float EPSILON = 1e-12f;
+    const Vec3 d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+    const float a = d1.dot(d1), e = d2.dot(d2), f = d2.dot(r);
+    float s, t;
+    if (a <= EPSILON && e <= EPSILON) {
+        s = t = 0.0f;
+    } else if (a <= EPSILON) {
+        s = 0.0f;
+        t = std::fmin(std::fmax(f / e, 0.0f), 1.0f);
+    } else {
+        const float c = d1.dot(r);
+        if (e <= EPSILON) {
+            t = 0.0f;
+            s = std::fmin(std::fmax(-c / a, 0.0f), 1.0f);
+        } else {
+            const float b = d1.dot(d2);
+            const float denom = a * e - b * b;
+            s = denom != 0.0f ? std::fmin(std::fmax((b * f - c * e) / denom, 0.0f), 1.0f) : 0.0f;
+            t = (b * s + f) / e;
+            if (t < 0.0f) {
+                t = 0.0f;
+                s = std::fmin(std::fmax(-c / a, 0.0f), 1.0f);
+            } else if (t > 1.0f) {
+                t = 1.0f;
+                s = std::fmin(std::fmax((b - c) / a, 0.0f), 1.0f);
+            }
+        }
+    }
+    outOn1 = p1 + d1 * s;
+    outOn2 = p2 + d2 * t;
+    const Vec3 between = outOn1 - outOn2;
+    return between.dot(between);
+}
+
+// Closest points between segment p-q and triangle a-b-c; returns the
+// squared distance, 0 where the segment passes through the triangle. The
+// nearest pair is either where the segment crosses the triangle, an end
+// of the segment against the triangle, or the segment against an edge.
+inline float closestPointsSegmentTriangle(const Vec3& p, const Vec3& q, const Vec3& a, const Vec3& b, const Vec3& c,
+                                          Vec3& outOnSegment, Vec3& outOnTriangle) {
+    const Vec3 pq = q - p;
+    float t;
+    if (intersectRayTriangle(p, pq, a, b, c, t) && t <= 1.0f) {
+        outOnSegment = outOnTriangle = p + pq * t;
+        return 0.0f;
+    }
+
+    outOnSegment = p;
+    outOnTriangle = closestPointOnTriangle(p, a, b, c);
+    Vec3 between = outOnTriangle - p;
+    float best = between.dot(between);
+
+    const Vec3 onQ = closestPointOnTriangle(q, a, b, c);
+    between = onQ - q;
+    if (between.dot(between) < best) {
+        best = between.dot(between);
+        outOnSegment = q;
+        outOnTriangle = onQ;
+    }
+
+    const Vec3* edges[3][2] = { { &a, &b }, { &b, &c }, { &c, &a } };
+    for (const auto& edge : edges) {
+        Vec3 onSegment, onEdge;
+        const float d = closestPointsSegmentSegment(p, q, *edge[0], *edge[1], onSegment, onEdge);
+        if (d < best) {
+            best = d;
+            outOnSegment = onSegment;
+            outOnTriangle = onEdge;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,180 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "Log.h"
+#include <cstdlib>
+
+namespace {
+
+// Which system's worker the current thread is, if any, and its queue
+thread_local const JobSystem* currentSystem = nullptr;
+thread_local unsigned currentQueue = 0;
+
+unsigned defaultThreadCount() {
+    if (const char* env = std::getenv("FALLAGA_JOB_THREADS")) {
+        const int count = std::atoi(env);
+        if (count > 0) return static_cast<unsigned>(count);
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// run(std::function) jobs: the closure is heap-allocated and freed once it has run
+void runTask(void* data, size_t, size_t) {
+    std::function<void()>* task = static_cast<std::function<void()>*>(data);
+    (*task)();
+    delete task;
+}
+
+Job taskJob(std::function<void()> task, JobCounter* counter) {
+    Job job;
+    job.function = runTask;
+    job.data = new std::function<void()>(std::move(task));
+    job.counter = counter;
+    return job;
+}
+
+} // namespace
+
+JobSystem& JobSystem::get() {
+    static JobSystem system(defaultThreadCount());
+    return system;
+}
+
+JobSystem::JobSystem(unsigned threadCount) {
+    start(threadCount ? threadCount : defaultThreadCount());
+    LOG_INFO("Job system on " << getThreadCount() << " threads");
+}
+
+JobSystem::~JobSystem() {
+    stop();
+}
+
+void JobSystem::resize(unsigned threadCount) {
+    stop();
+    start(std::max(1u, threadCount));
+}
+
+void JobSystem::start(unsigned threadCount) {
+    stopping = false;
+    queues.clear();
+    for (unsigned i = 0; i < threadCount; i++) queues.emplace_back(new Queue());
+    for (unsigned i = 1; i < threadCount; i++) workers.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+void JobSystem::stop() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) worker.join();
+    workers.clear();
+}
+
+void JobSystem::run(const Job& job) {
+    if (job.counter) job.counter->pending.fetch_add(1, std::memory_order_relaxed);
+    push(job);
+}
+
+void JobSystem::run(std::function<void()> task, JobCounter* counter) {
+    run(taskJob(std::move(task), counter));
+}
+
+void JobSystem::then(JobCounter& dependency, std::function<void()> task, JobCounter* counter) {
+    const Job job = taskJob(std::move(task), counter);
+    if (counter) counter->pending.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(dependency.mutex);
+        if (!dependency.done()) {
+            dependency.continuations.push_back(job);
+            return;
+        }
+    }
+    push(job);
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    const unsigned own = queueOfCaller();
+    while (!counter.done()) {
+        Job job;
+        if (take(own, job)) execute(job);
+        else std::this_thread::yield();
+    }
+    // The job that brought the count to zero may still be inside its
+    // critical section; the caller is free to destroy the counter after this
+    std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+unsigned JobSystem::queueOfCaller() const {
+    return currentSystem == this ? currentQueue : 0;
+}
+
+void JobSystem::push(const Job& job) {
+    Queue& queue = *queues[queueOfCaller()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(job);
+    }
+    // Pairs with the sleeper's increment before it checks `queued`: one of
+    // the two sees the other, so a job is never left with everyone asleep
+    queued.fetch_add(1);
+    if (sleepers.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wake.notify_one();
+    }
+}
+
+bool JobSystem::take(unsigned own, Job& out) {
+    if (queued.load(std::memory_order_relaxed) == 0) return false;
+    {
+        Queue& queue = *queues[own];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty()) {
+            out = queue.jobs.back();
+            queue.jobs.pop_back();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    const unsigned count = static_cast<unsigned>(queues.size());
+    for (unsigned i = 1; i < count; i++) {
+        Queue& victim = *queues[(own + i) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.jobs.empty()) continue;
+        out = victim.jobs.front();
+        victim.jobs.pop_front();
+        queued.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::execute(const Job& job) {
+    job.function(job.data, job.begin, job.end);
+    JobCounter* counter = job.counter;
+    if (!counter) return;
+
+    std::vector<Job> ready;
+    {
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) ready.swap(counter->continuations);
+    }
+    for (const Job& next : ready) push(next);
+}
+
+void JobSystem::workerLoop(unsigned queue) {
+    PROFILE_THREAD("Job worker");
+    currentSystem = this;
+    currentQueue = queue;
+    for (;;) {
+        Job job;
+        if (take(queue, job)) {
+            execute(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepers.fetch_add(1);
+        wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+        sleepers.fetch_sub(1);
+        if (stopping) return;
+    }
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class JobCounter;
+
+// A unit of work: function(data, begin, end). Small and copied by value,
+// so scheduling one allocates nothing; `data` must outlive the job.
+struct Job {
+    void (*function)(void* data, size_t begin, size_t end) = nullptr;
+    void* data = nullptr;
+    size_t begin = 0, end = 0;
+    JobCounter* counter = nullptr; // decremented once the job has run
+};
+
+// Jobs still to finish. run() adds one per job, which subtracts one when
+// it is done; continuations added with JobSystem::then() are scheduled
+// when the count reaches zero. Only destroy a counter once wait() on it has
+// returned.
+class JobCounter {
+public:
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+    std::atomic<int> pending{0};
+    std::mutex mutex; // guards continuations and the step to zero
+    std::vector<Job> continuations;
+};
+
+// Work-stealing job scheduler: one worker per core besides the threads
+// that submit work. Every worker has its own queue; it runs the newest job
+// of its own queue first (still in cache) and, when that is empty, steals
+// the oldest job of another queue. Threads that aren't workers (the GL
+// thread, the simulation, streamer workers) share one more queue.
+//
+// wait() runs queued jobs until its counter drops to zero instead of
+// blocking, so a job may itself split work and wait for it, and the
+// calling thread always takes part. With one thread every job runs on the
+// caller and parallelFor() is a plain loop.
+//
+//     JobSystem::get().parallelFor(points.size(), 1024, [&](size_t begin, size_t end) {
+//         for (size_t i = begin; i < end; i++) heights[i] = ...;
+//     });
+class JobSystem {
+public:
+    // Chunks parallelFor() aims for per thread, so a thread that falls
+    // behind can have work taken off it
+    static const size_t CHUNKS_PER_THREAD = 4;
+
+    // The process-wide scheduler: FALLAGA_JOB_THREADS threads (default one
+    // per core), the caller included
+    static JobSystem& get();
+
+    // threadCount = 0 uses one thread per core, the caller included
+    explicit JobSystem(unsigned threadCount = 0);
+    ~JobSystem();
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Threads that run jobs: the workers plus the waiting caller
+    unsigned getThreadCount() const { return static_cast<unsigned>(workers.size()) + 1; }
+    // Restarts the workers (benchmarks). Nothing may be running or queued.
+    void resize(unsigned threadCount);
+
+    // Queues `job`, adding one to its counter if it has one
+    void run(const Job& job);
+    // Convenience form that allocates the closure
+    void run(std::function<void()> task, JobCounter* counter = nullptr);
+    // Queues `task` once `dependency` drops to zero (at once if it already
+    // has). `counter` counts it from now, not only once it is queued.
+    void then(JobCounter& dependency, std::function<void()> task, JobCounter* counter = nullptr);
+    // Runs queued jobs, from any queue, until `counter` is zero
+    void wait(JobCounter& counter);
+
+    // body(begin, end) over [0, count) in chunks of at least minChunk
+    // items, on every thread, and returns once all of them are done. The
+    // first chunk runs on the caller.
+    template <class F>
+    void parallelFor(size_t count, size_t minChunk, F&& body);
+
+private:
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    void start(unsigned threadCount);
+    void stop();
+    void workerLoop(unsigned queue);
+    void push(const Job& job);
+    // Newest job of `own`, else the oldest of the first non-empty other queue
+    bool take(unsigned own, Job& out);
+    void execute(const Job& job);
+    // Queue of the calling thread: its own for a worker, else the shared one
+    unsigned queueOfCaller() const;
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<Queue>> queues; // [0] shared, [1..] one per worker
+    std::atomic<size_t> queued{0};              // jobs in all queues
+    std::atomic<int> sleepers{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+// ===============================
+// Template Definitions
+// ===============================
+template <class F>
+void JobSystem::parallelFor(size_t count, size_t minChunk, F&& body) {
+    if (count == 0) return;
+    minChunk = std::max<size_t>(minChunk, 1);
+    const size_t chunks = std::min((count + minChunk - 1) / minChunk, getThreadCount() * CHUNKS_PER_THREAD);
+    if (chunks <= 1) {
+        body(size_t(0), count);
+        return;
+    }
+    const size_t chunkSize = (count + chunks - 1) / chunks;
+
+    typedef typename std::remove_reference<F>::type Body;
+    JobCounter counter;
+    Job job;
+    job.function = [](void* data, size_t begin, size_t end) { (*static_cast<Body*>(data))(begin, end); };
+    job.data = const_cast<void*>(static_cast<const void*>(&body));
+    job.counter = &counter;
+    for (size_t begin = chunkSize; begin < count; begin += chunkSize) {
+        job.begin = begin;
+        job.end = std::min(begin + chunkSize, count);
+        run(job);
+    }
+    body(size_t(0), chunkSize);
+    wait(counter);
+}
@@ -0,0 +1,218 @@
+#include "Log.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const size_t RING_SLOTS = 4096; // power of two
+const size_t MESSAGE_BYTES = 240;
+// How long the writer sleeps when the ring is empty
+const std::chrono::milliseconds WRITER_IDLE(2);
+
+int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int levelFromEnvironment() {
+    const char* value = std::getenv("FALLAGA_LOG_LEVEL");
+    if (!value) return static_cast<int>(LogLevel::Info);
+    const char* names[] = { "trace", "debug", "info", "warn", "error", "off" };
+    for (int i = 0; i < 6; i++) {
+        if (std::strcmp(value, names[i]) == 0) return i;
+    }
+    std::fprintf(stderr, "Unknown FALLAGA_LOG_LEVEL '%s', using info\n", value);
+    return static_cast<int>(LogLevel::Info);
+}
+
+// One message. `sequence` follows the bounded queue of D. Vyukov: equal to
+// the slot's position when free to claim, position + 1 once published.
+struct Slot {
+    std::atomic<uint64_t> sequence;
+    LogLevel level;
+    int suppressed;
+    double time;
+    size_t length;
+    char text[MESSAGE_BYTES];
+};
+
+// Lets an ostream format into a slot's fixed buffer; output past the end
+// is dropped
+class SlotBuffer : public std::streambuf {
+public:
+    void reset(char* begin, size_t size) { setp(begin, begin + size); }
+    size_t length() const { return static_cast<size_t>(pptr() - pbase()); }
+
+protected:
+    int_type overflow(int_type) override { return traits_type::eof(); }
+};
+
+struct ThreadStream {
+    SlotBuffer buffer;
+    std::ostream stream{&buffer};
+    // Where messages go when the ring is full: bad from the start, so
+    // nothing gets formatted
+    std::ostream discard{nullptr};
+};
+
+ThreadStream& threadStream() {
+    thread_local ThreadStream local;
+    return local;
+}
+
+// ===============================
+// Ring and Writer Thread
+// ===============================
+class Logger {
+public:
+    Logger() : slots(RING_SLOTS), start(std::chrono::steady_clock::now()) {
+        for (size_t i = 0; i < RING_SLOTS; i++) slots[i].sequence.store(i, std::memory_order_relaxed);
+        writer = std::thread(&Logger::run, this);
+    }
+
+    // At exit: whatever is still queued gets written
+    ~Logger() {
+        stopping.store(true, std::memory_order_release);
+        writer.join();
+    }
+
+    Slot* claim(uint64_t& position) {
+        uint64_t pos = enqueuePosition.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots[pos & (RING_SLOTS - 1)];
+            uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            int64_t diff = static_cast<int64_t>(sequence) - static_cast<int64_t>(pos);
+            if (diff == 0) {
+                if (enqueuePosition.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    position = pos;
+                    slot.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                    return &slot;
+                }
+            } else if (diff < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            } else {
+                pos = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void publish(Slot* slot, uint64_t position) {
+        slot->sequence.store(position + 1, std::memory_order_release);
+    }
+
+    void flush() {
+        const uint64_t target = enqueuePosition.load(std::memory_order_acquire);
+        while (written.load(std::memory_order_acquire) < target) std::this_thread::sleep_for(WRITER_IDLE);
+    }
+
+private:
+    void run() {
+        uint64_t position = 0;
+        std::string line;
+        for (;;) {
+            bool wroteAny = false;
+            for (;;) {
+                Slot& slot = slots[position & (RING_SLOTS - 1)];
+                if (slot.sequence.load(std::memory_order_acquire) != position + 1) break;
+                write(slot, line);
+                slot.sequence.store(position + RING_SLOTS, std::memory_order_release);
+                position++;
+                written.store(position, std::memory_order_release);
+                wroteAny = true;
+            }
+
+            if (int lost = dropped.exchange(0, std::memory_order_relaxed)) {
+                std::fprintf(stderr, "warning: %d log messages dropped, queue full\n", lost);
+                wroteAny = true;
+            }
+            if (wroteAny) {
+                std::fflush(stdout);
+                std::fflush(stderr);
+                continue;
+            }
+            // Only exit once a pass has found nothing left
+            if (stopping.load(std::memory_order_acquire) &&
+                enqueuePosition.load(std::memory_order_acquire) == position) {
+                return;
+            }
+            std::this_thread::sleep_for(WRITER_IDLE);
+        }
+    }
+
+    static void write(const Slot& slot, std::string& line) {
+        static const char* prefixes[] = { "trace: ", "debug: ", "", "warning: ", "error: ", "" };
+        char header[32];
+        std::snprintf(header, sizeof(header), "[%9.3f] ", slot.time);
+        line.assign(header);
+        line += prefixes[static_cast<int>(slot.level)];
+        line.append(slot.text, slot.length);
+        if (slot.suppressed > 0) line += " (+" + std::to_string(slot.suppressed) + " more suppressed)";
+        line += '\n';
+        std::fputs(line.c_str(), slot.level >= LogLevel::Warn ? stderr : stdout);
+    }
+
+    std::vector<Slot> slots;
+    alignas(64) std::atomic<uint64_t> enqueuePosition{0};
+    alignas(64) std::atomic<uint64_t> written{0};
+    std::atomic<int> dropped{0};
+    std::atomic<bool> stopping{false};
+    std::chrono::steady_clock::time_point start;
+    std::thread writer;
+};
+
+Logger& logger() {
+    static Logger instance;
+    return instance;
+}
+
+} // namespace
+
+std::atomic<int> Log::runtimeLevel{levelFromEnvironment()};
+
+void Log::flush() {
+    logger().flush();
+}
+
+bool LogSite::allow() {
+    const int64_t now = nowMs();
+    int64_t window = windowStart.load(std::memory_order_relaxed);
+    if (now - window >= 1000 && windowStart.compare_exchange_strong(window, now, std::memory_order_relaxed))
+        count.store(0, std::memory_order_relaxed);
+    if (count.fetch_add(1, std::memory_order_relaxed) < LOG_SITE_RATE) return true;
+    suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+LogMessage::LogMessage(LogLevel level, LogSite& site) : position(0) {
+    Slot* claimed = logger().claim(position);
+    slot = claimed;
+    if (!claimed) return;
+    claimed->level = level;
+    claimed->suppressed = site.takeSuppressed();
+    ThreadStream& local = threadStream();
+    local.buffer.reset(claimed->text, MESSAGE_BYTES);
+    // Undo whatever manipulators the thread's last message used
+    local.stream.clear();
+    local.stream.flags(std::ios_base::skipws | std::ios_base::dec);
+    local.stream.precision(6);
+    local.stream.fill(' ');
+}
+
+LogMessage::~LogMessage() {
+    if (!slot) return;
+    Slot* claimed = static_cast<Slot*>(slot);
+    claimed->length = threadStream().buffer.length();
+    logger().publish(claimed, position);
+}
+
+std::ostream& LogMessage::stream() {
+    ThreadStream& local = threadStream();
+    return slot ? local.stream : local.discard;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+// Asynchronous logging. A message is formatted straight into a slot of a
+// lock-free ring buffer and a background thread writes the slots out
+// (info and below to stdout, warnings and errors to stderr), so logging
+// never waits on console I/O:
+//
+//   LOG_INFO("Loaded " << name << " in " << ms << " ms");
+//
+// - Messages below the runtime level (FALLAGA_LOG_LEVEL=trace|debug|info|
+//   warn|error|off, default info) cost a load and a compare; the message
+//   expression is not evaluated.
+// - Levels below FALLAGA_LOG_MIN_LEVEL (0 = trace ... 5 = off) are
+//   compiled out.
+// - Each call site gets at most LOG_SITE_RATE messages a second. The
+//   rest are counted and reported with the next one that gets through.
+// - With the ring full, messages are dropped (and counted), not waited on.
+// - Messages longer than a slot are cut off.
+
+#ifndef FALLAGA_LOG_MIN_LEVEL
+#define FALLAGA_LOG_MIN_LEVEL 0
+#endif
+
+enum class LogLevel { Trace, Debug, Info, Warn, Error, Off };
+
+// Rate limiter state of one LOG_* call site
+class LogSite {
+public:
+    static const int LOG_SITE_RATE = 20;
+    bool allow();
+    // Messages turned away since the last one let through
+    int takeSuppressed() { return suppressed.exchange(0, std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> windowStart{0}; // milliseconds
+    std::atomic<int> count{0};
+    std::atomic<int> suppressed{0};
+};
+
+class Log {
+public:
+    static bool enabled(LogLevel level) {
+        return static_cast<int>(level) >= runtimeLevel.load(std::memory_order_relaxed);
+    }
+    // Blocks until everything logged so far has been written, e.g. before
+    // printing program output that must come after it
+    static void flush();
+
+private:
+    static std::atomic<int> runtimeLevel;
+};
+
+// A message being formatted into its ring slot; published on destruction
+class LogMessage {
+public:
+    LogMessage(LogLevel level, LogSite& site);
+    ~LogMessage();
+    LogMessage(const LogMessage&) = delete;
+    LogMessage& operator=(const LogMessage&) = delete;
+
+    std::ostream& stream();
+
+private:
+    void* slot;        // null when the ring was full
+    uint64_t position;
+};
+
+#define LOG_AT(level, message)                                                           \
+    do {                                                                                 \
+        if (static_cast<int>(level) >= FALLAGA_LOG_MIN_LEVEL && Log::enabled(level)) {   \
+            static LogSite logSite;                                                      \
+            if (logSite.allow()) {                                                       \
+                LogMessage logMessage(level, logSite);                                   \
+                logMessage.stream() << message;                                          \
+            }                                                                            \
+        }                                                                                \
+    } while (0)
+
+#define LOG_TRACE(message) LOG_AT(LogLevel::Trace, message)
+#define LOG_DEBUG(message) LOG_AT(LogLevel::Debug, message)
+#define LOG_INFO(message) LOG_AT(LogLevel::Info, message)
+#define LOG_WARN(message) LOG_AT(LogLevel::Warn, message)
+#define LOG_ERROR(message) LOG_AT(LogLevel::Error, message)
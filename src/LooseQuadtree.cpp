@@ -0,0 +1,146 @@
+#include "LooseQuadtree.h"
+#include <algorithm>
+
+namespace {
+
+const int MAX_DEPTH = 10;
+
+} // namespace
+
+void LooseQuadtree::clear() {
+    nodes.clear();
+    bounds.clear();
+    objectNode.clear();
+    objectStart.clear();
+    nodeObjects.clear();
+}
+
+int LooseQuadtree::childFor(int node, float x, float z) {
+    const int quadrant = (x >= nodes[node].centerX ? 1 : 0) + (z >= nodes[node].centerZ ? 2 : 0);
+    int child = nodes[node].children[quadrant];
+    if (child >= 0) return child;
+
+    Node n;
+    n.halfSize = nodes[node].halfSize * 0.5f;
+    n.centerX = nodes[node].centerX + ((quadrant & 1) ? n.halfSize : -n.halfSize);
+    n.centerZ = nodes[node].centerZ + ((quadrant & 2) ? n.halfSize : -n.halfSize);
+    n.boxMin = Vec3(1e30f, 1e30f, 1e30f);
+    n.boxMax = Vec3(-1e30f, -1e30f, -1e30f);
+    n.children[0] = n.children[1] = n.children[2] = n.children[3] = -1;
+    n.parent = node;
+    n.subtreeCount = 0;
+
+    child = static_cast<int>(nodes.size());
+    nodes.push_back(n); // may reallocate, so nodes[node] is re-read below
+    nodes[node].children[quadrant] = child;
+    return child;
+}
+
+void LooseQuadtree::build(const std::vector<ObjectBounds>& objects) {
+    clear();
+    if (objects.empty()) return;
+    bounds = objects;
+
+    // Root cell: a square around every object centre
+    float minX = 1e30f, minZ = 1e30f, maxX = -1e30f, maxZ = -1e30f;
+    for (const auto& b : bounds) {
+        float cx = (b.min.x + b.max.x) * 0.5f, cz = (b.min.z + b.max.z) * 0.5f;
+        minX = std::min(minX, cx); maxX = std::max(maxX, cx);
+        minZ = std::min(minZ, cz); maxZ = std::max(maxZ, cz);
+    }
+    Node root;
+    root.centerX = (minX + maxX) * 0.5f;
+    root.centerZ = (minZ + maxZ) * 0.5f;
+    root.halfSize = std::max(std::max(maxX - minX, maxZ - minZ) * 0.5f, 1e-3f) * 1.001f;
+    root.boxMin = Vec3(1e30f, 1e30f, 1e30f);
+    root.boxMax = Vec3(-1e30f, -1e30f, -1e30f);
+    root.children[0] = root.children[1] = root.children[2] = root.children[3] = -1;
+    root.parent = -1;
+    root.subtreeCount = 0;
+    nodes.push_back(root);
+
+    // Descend while the object still fits the child's cell size
+    objectNode.resize(bounds.size());
+    std::vector<int> path;
+    for (size_t i = 0; i < bounds.size(); i++) {
+        const ObjectBounds& b = bounds[i];
+        const float extent = std::max(b.max.x - b.min.x, b.max.z - b.min.z);
+        const float cx = (b.min.x + b.max.x) * 0.5f, cz = (b.min.z + b.max.z) * 0.5f;
+
+        int node = 0;
+        path.assign(1, 0);
+        for (int depth = 0; depth < MAX_DEPTH && extent <= nodes[node].halfSize; depth++) {
+            node = childFor(node, cx, cz);
+            path.push_back(node);
+        }
+        objectNode[i] = static_cast<uint32_t>(node);
+
+        for (int n : path) {
+            Node& parent = nodes[n];
+            parent.boxMin = Vec3(std::min(parent.boxMin.x, b.min.x), std::min(parent.boxMin.y, b.min.y), std::min(parent.boxMin.z, b.min.z));
+            parent.boxMax = Vec3(std::max(parent.boxMax.x, b.max.x), std::max(parent.boxMax.y, b.max.y), std::max(parent.boxMax.z, b.max.z));
+            parent.subtreeCount++;
+        }
+    }
+
+    // Group object indices by node (counting sort)
+    objectStart.assign(nodes.size() + 1, 0);
+    for (uint32_t n : objectNode) objectStart[n + 1]++;
+    for (size_t i = 1; i < objectStart.size(); i++) objectStart[i] += objectStart[i - 1];
+    nodeObjects.resize(bounds.size());
+    std::vector<uint32_t> cursor(objectStart.begin(), objectStart.end() - 1);
+    for (size_t i = 0; i < bounds.size(); i++) nodeObjects[cursor[objectNode[i]]++] = static_cast<uint32_t>(i);
+}
+
+void LooseQuadtree::move(uint32_t object, const ObjectBounds& box) {
+    bounds[object] = box;
+    for (int n = static_cast<int>(objectNode[object]); n >= 0; n = nodes[n].parent) {
+        Node& node = nodes[n];
+        node.boxMin = Vec3(std::min(node.boxMin.x, box.min.x), std::min(node.boxMin.y, box.min.y), std::min(node.boxMin.z, box.min.z));
+        node.boxMax = Vec3(std::max(node.boxMax.x, box.max.x), std::max(node.boxMax.y, box.max.y), std::max(node.boxMax.z, box.max.z));
+    }
+}
+
+// ===============================
+// Visibility
+// ===============================
+void LooseQuadtree::query(const Frustum& frustum, std::vector<uint32_t>& visible, CullStats& stats) const {
+    if (nodes.empty()) return;
+    queryNode(0, frustum, visible, stats);
+}
+
+void LooseQuadtree::queryNode(int node, const Frustum& frustum, std::vector<uint32_t>& visible,
+                              CullStats& stats) const {
+    const Node& n = nodes[node];
+    if (n.subtreeCount == 0) return;
+    stats.nodesVisited++;
+
+    Frustum::Result result = frustum.classifyBox(n.boxMin, n.boxMax);
+    if (result == Frustum::OUTSIDE) {
+        stats.culled += n.subtreeCount;
+        return;
+    }
+    if (result == Frustum::INSIDE) {
+        appendSubtree(node, visible, stats);
+        return;
+    }
+
+    for (uint32_t i = objectStart[node]; i < objectStart[node + 1]; i++) {
+        const uint32_t object = nodeObjects[i];
+        if (frustum.intersectsBox(bounds[object].min, bounds[object].max)) {
+            visible.push_back(object);
+            stats.drawn++;
+        } else {
+            stats.culled++;
+        }
+    }
+    for (int child : n.children)
+        if (child >= 0) queryNode(child, frustum, visible, stats);
+}
+
+void LooseQuadtree::appendSubtree(int node, std::vector<uint32_t>& visible, CullStats& stats) const {
+    visible.insert(visible.end(), nodeObjects.begin() + objectStart[node], nodeObjects.begin() + objectStart[node + 1]);
+    stats.drawn += objectStart[node + 1] - objectStart[node];
+    for (int child : nodes[node].children)
+        if (child >= 0) appendSubtree(child, visible, stats);
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Frustum.h"
+#include "Vec3.h"
+
+// Loose quadtree over XZ for static scene objects. An object is stored in
+// the deepest node whose cell contains its centre and whose size is at
+// least the object's XZ extent, so it never lands in more than one node.
+// Each node also keeps the 3D bounds of everything below it, which is what
+// the frustum is tested against.
+class LooseQuadtree {
+public:
+    // Objects are identified by their index in `objects`
+    void build(const std::vector<ObjectBounds>& objects);
+    void clear();
+    // Gives an object a new box without a rebuild. It stays in its node,
+    // whose box and its ancestors' grow to cover the new one: always
+    // correct, and as tight as a rebuild for a box that only moved
+    // vertically (a prop dropped to a new height).
+    void move(uint32_t object, const ObjectBounds& box);
+
+    // Appends the indices of objects that intersect the frustum. Subtrees
+    // outside it are skipped whole and subtrees fully inside are taken
+    // without testing their objects.
+    void query(const Frustum& frustum, std::vector<uint32_t>& visible, CullStats& stats) const;
+
+    size_t nodeCount() const { return nodes.size(); }
+    size_t objectCount() const { return bounds.size(); }
+
+private:
+    struct Node {
+        float centerX, centerZ, halfSize; // cell used for placement
+        Vec3 boxMin, boxMax;              // bounds of the whole subtree
+        int children[4];                  // -1 when absent; index = (x >= cx) + 2 * (z >= cz)
+        int parent;                       // -1 for the root
+        uint32_t subtreeCount;
+    };
+
+    int childFor(int node, float x, float z);
+    void queryNode(int node, const Frustum& frustum, std::vector<uint32_t>& visible, CullStats& stats) const;
+    void appendSubtree(int node, std::vector<uint32_t>& visible, CullStats& stats) const;
+
+    std::vector<Node> nodes;
+    std::vector<ObjectBounds> bounds;
+    std::vector<uint32_t> objectNode; // node each object is stored in
+    // Objects grouped by node: node n owns nodeObjects[objectStart[n] .. objectStart[n + 1])
+    std::vector<uint32_t> objectStart;
+    std::vector<uint32_t> nodeObjects;
+};
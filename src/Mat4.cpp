@@ -0,0 +1,245 @@
+#include "Mat4.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const float DEGREES_TO_RADIANS = 3.14159265f / 180.0f;
+
+Mat4 fromColumns(const Vec4& c0, const Vec4& c1, const Vec4& c2, const Vec4& c3) {
+    Mat4 r;
+    const Vec4* columns[4] = { &c0, &c1, &c2, &c3 };
+    for (int c = 0; c < 4; c++) {
+        r.m[c * 4 + 0] = columns[c]->x;
+        r.m[c * 4 + 1] = columns[c]->y;
+        r.m[c * 4 + 2] = columns[c]->z;
+        r.m[c * 4 + 3] = columns[c]->w;
+    }
+    return r;
+}
+
+#ifdef FALLAGA_SSE
+// a * b with a's columns already in registers
+inline void multiplySse(const __m128 a[4], const float* b, float* out) {
+    for (int c = 0; c < 4; c++) {
+        __m128 sum = _mm_mul_ps(a[0], _mm_set1_ps(b[c * 4 + 0]));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a[1], _mm_set1_ps(b[c * 4 + 1])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a[2], _mm_set1_ps(b[c * 4 + 2])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a[3], _mm_set1_ps(b[c * 4 + 3])));
+        _mm_store_ps(out + c * 4, sum);
+    }
+}
+#endif
+
+// Same order of operations as multiplySse, so both give the same result
+inline void multiplyScalar(const float* a, const float* b, float* out) {
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++) {
+            float sum = a[r] * b[c * 4];
+            sum += a[4 + r] * b[c * 4 + 1];
+            sum += a[8 + r] * b[c * 4 + 2];
+            sum += a[12 + r] * b[c * 4 + 3];
+            out[c * 4 + r] = sum;
+        }
+}
+
+} // namespace
+
+// ===============================
+// Construction
+// ===============================
+Mat4 Mat4::identity() {
+    Mat4 r = {};
+    r.m[0] = r.m[5] = r.m[10] = r.m[15] = 1.0f;
+    return r;
+}
+
+Mat4 Mat4::translation(const Vec3& t) {
+    Mat4 r = identity();
+    r.m[12] = t.x;
+    r.m[13] = t.y;
+    r.m[14] = t.z;
+    return r;
+}
+
+Mat4 Mat4::scale(float s) {
+    Mat4 r = identity();
+    r.m[0] = r.m[5] = r.m[10] = s;
+    return r;
+}
+
+Mat4 Mat4::rotationX(float radians) {
+    const float c = std::cos(radians), s = std::sin(radians);
+    Mat4 r = identity();
+    r.m[5] = c;
+    r.m[6] = s;
+    r.m[9] = -s;
+    r.m[10] = c;
+    return r;
+}
+
+Mat4 Mat4::rotationY(float radians) {
+    const float c = std::cos(radians), s = std::sin(radians);
+    Mat4 r = identity();
+    r.m[0] = c;
+    r.m[2] = -s;
+    r.m[8] = s;
+    r.m[10] = c;
+    return r;
+}
+
+Mat4 Mat4::fromTransform(const Transform& t) {
+    const float c = std::cos(t.yaw) * t.scale, s = std::sin(t.yaw) * t.scale;
+    return fromColumns(Vec4(c, 0.0f, -s, 0.0f), Vec4(0.0f, t.scale, 0.0f, 0.0f), Vec4(s, 0.0f, c, 0.0f),
+                       Vec4(t.x, t.y, t.z, 1.0f));
+}
+
+Mat4 Mat4::lookAt(const Vec3& eye, const Vec3& target, const Vec3& up) {
+    Vec3 f = target - eye;
+    f.normalize();
+    Vec3 s = f.cross(up);
+    s.normalize();
+    const Vec3 u = s.cross(f);
+    return fromColumns(Vec4(s.x, u.x, -f.x, 0.0f), Vec4(s.y, u.y, -f.y, 0.0f), Vec4(s.z, u.z, -f.z, 0.0f),
+                       Vec4(-s.dot(eye), -u.dot(eye), f.dot(eye), 1.0f));
+}
+
+Mat4 Mat4::perspective(float fovYDegrees, float aspect, float zNear, float zFar) {
+    const float cot = 1.0f / std::tan(0.5f * fovYDegrees * DEGREES_TO_RADIANS);
+    return fromColumns(Vec4(cot / aspect, 0.0f, 0.0f, 0.0f), Vec4(0.0f, cot, 0.0f, 0.0f),
+                       Vec4(0.0f, 0.0f, (zFar + zNear) / (zNear - zFar), -1.0f),
+                       Vec4(0.0f, 0.0f, 2.0f * zFar * zNear / (zNear - zFar), 0.0f));
+}
+
+Mat4 Mat4::orthographic(float left, float right, float bottom, float top, float zNear, float zFar) {
+    return fromColumns(Vec4(2.0f / (right - left), 0.0f, 0.0f, 0.0f), Vec4(0.0f, 2.0f / (top - bottom), 0.0f, 0.0f),
+                       Vec4(0.0f, 0.0f, -2.0f / (zFar - zNear), 0.0f),
+                       Vec4(-(right + left) / (right - left), -(top + bottom) / (top - bottom),
+                            -(zFar + zNear) / (zFar - zNear), 1.0f));
+}
+
+// ===============================
+// Operations
+// ===============================
+Mat4 Mat4::operator*(const Mat4& other) const {
+    Mat4 r;
+#ifdef FALLAGA_SSE
+    const __m128 a[4] = { _mm_load_ps(m), _mm_load_ps(m + 4), _mm_load_ps(m + 8), _mm_load_ps(m + 12) };
+    multiplySse(a, other.m, r.m);
+#else
+    multiplyScalar(m, other.m, r.m);
+#endif
+    return r;
+}
+
+Vec3 Mat4::transformPoint(const Vec3& p) const {
+    return Vec3(m[0] * p.x + m[4] * p.y + m[8] * p.z + m[12],
+                m[1] * p.x + m[5] * p.y + m[9] * p.z + m[13],
+                m[2] * p.x + m[6] * p.y + m[10] * p.z + m[14]);
+}
+
+Mat4 Mat4::inverse() const {
+    // Cofactors from the 2x2 minors of the top and bottom row pairs
+    const float s0 = at(0, 0) * at(1, 1) - at(1, 0) * at(0, 1);
+    const float s1 = at(0, 0) * at(1, 2) - at(1, 0) * at(0, 2);
+    const float s2 = at(0, 0) * at(1, 3) - at(1, 0) * at(0, 3);
+    const float s3 = at(0, 1) * at(1, 2) - at(1, 1) * at(0, 2);
+    const float s4 = at(0, 1) * at(1, 3) - at(1, 1) * at(0, 3);
+    const float s5 = at(0, 2) * at(1, 3) - at(1, 2) * at(0, 3);
+    const float c5 = at(2, 2) * at(3, 3) - at(3, 2) * at(2, 3);
+    const float c4 = at(2, 1) * at(3, 3) - at(3, 1) * at(2, 3);
+    const float c3 = at(2, 1) * at(3, 2) - at(3, 1) * at(2, 2);
+    const float c2 = at(2, 0) * at(3, 3) - at(3, 0) * at(2, 3);
+    const float c1 = at(2, 0) * at(3, 2) - at(3, 0) * at(2, 2);
+    const float c0 = at(2, 0) * at(3, 1) - at(3, 0) * at(2, 1);
+    const float det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    if (std::fabs(det) < 1e-20f) return identity();
+    const float k = 1.0f / det;
+
+    Mat4 r;
+    r.at(0, 0) = (at(1, 1) * c5 - at(1, 2) * c4 + at(1, 3) * c3) * k;
+    r.at(0, 1) = (-at(0, 1) * c5 + at(0, 2) * c4 - at(0, 3) * c3) * k;
+    r.at(0, 2) = (at(3, 1) * s5 - at(3, 2) * s4 + at(3, 3) * s3) * k;
+    r.at(0, 3) = (-at(2, 1) * s5 + at(2, 2) * s4 - at(2, 3) * s3) * k;
+    r.at(1, 0) = (-at(1, 0) * c5 + at(1, 2) * c2 - at(1, 3) * c1) * k;
+    r.at(1, 1) = (at(0, 0) * c5 - at(0, 2) * c2 + at(0, 3) * c1) * k;
+    r.at(1, 2) = (-at(3, 0) * s5 + at(3, 2) * s2 - at(3, 3) * s1) * k;
+    r.at(1, 3) = (at(2, 0) * s5 - at(2, 2) * s2 + at(2, 3) * s1) * k;
+    r.at(2, 0) = (at(1, 0) * c4 - at(1, 1) * c2 + at(1, 3) * c0) * k;
+    r.at(2, 1) = (-at(0, 0) * c4 + at(0, 1) * c2 - at(0, 3) * c0) * k;
+    r.at(2, 2) = (at(3, 0) * s4 - at(3, 1) * s2 + at(3, 3) * s0) * k;
+    r.at(2, 3) = (-at(2, 0) * s4 + at(2, 1) * s2 - at(2, 3) * s0) * k;
+    r.at(3, 0) = (-at(1, 0) * c3 + at(1, 1) * c1 - at(1, 2) * c0) * k;
+    r.at(3, 1) = (at(0, 0) * c3 - at(0, 1) * c1 + at(0, 2) * c0) * k;
+    r.at(3, 2) = (-at(3, 0) * s3 + at(3, 1) * s1 - at(3, 2) * s0) * k;
+    r.at(3, 3) = (at(2, 0) * s3 - at(2, 1) * s1 + at(2, 2) * s0) * k;
+    return r;
+}
+
+// ===============================
+// Batched kernels
+// ===============================
+void composeTransforms(const Transform* transforms, size_t count, Mat4* out) {
+    for (size_t i = 0; i < count; i++) out[i] = Mat4::fromTransform(transforms[i]);
+}
+
+void multiplyMatrices(const Mat4& a, const Mat4* b, size_t count, Mat4* out) {
+#ifdef FALLAGA_SSE
+    const __m128 columns[4] = { _mm_load_ps(a.m), _mm_load_ps(a.m + 4), _mm_load_ps(a.m + 8),
+                                _mm_load_ps(a.m + 12) };
+    for (size_t i = 0; i < count; i++) multiplySse(columns, b[i].m, out[i].m);
+#else
+    multiplyMatricesScalar(a, b, count, out);
+#endif
+}
+
+void multiplyMatricesScalar(const Mat4& a, const Mat4* b, size_t count, Mat4* out) {
+    for (size_t i = 0; i < count; i++) multiplyScalar(a.m, b[i].m, out[i].m);
+}
+
+// Center and half extent of `local`, then per matrix (Arvo): the center
+// transformed, and each world half extent the sum of the local ones
+// weighted by the absolute matrix entries
+void transformBounds(const ObjectBounds& local, const Mat4* matrices, size_t count, ObjectBounds* out) {
+#ifdef FALLAGA_SSE
+    const Vec3 center = (local.min + local.max) * 0.5f;
+    const Vec3 extent = (local.max - local.min) * 0.5f;
+    const __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+    const __m128 ex = _mm_set1_ps(extent.x), ey = _mm_set1_ps(extent.y), ez = _mm_set1_ps(extent.z);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    alignas(16) float lo[4], hi[4];
+    for (size_t i = 0; i < count; i++) {
+        const float* m = matrices[i].m;
+        const __m128 c0 = _mm_load_ps(m), c1 = _mm_load_ps(m + 4), c2 = _mm_load_ps(m + 8);
+        __m128 c = _mm_add_ps(_mm_load_ps(m + 12), _mm_mul_ps(c0, cx));
+        c = _mm_add_ps(c, _mm_mul_ps(c1, cy));
+        c = _mm_add_ps(c, _mm_mul_ps(c2, cz));
+        __m128 e = _mm_mul_ps(_mm_and_ps(c0, absMask), ex);
+        e = _mm_add_ps(e, _mm_mul_ps(_mm_and_ps(c1, absMask), ey));
+        e = _mm_add_ps(e, _mm_mul_ps(_mm_and_ps(c2, absMask), ez));
+        _mm_store_ps(lo, _mm_sub_ps(c, e));
+        _mm_store_ps(hi, _mm_add_ps(c, e));
+        out[i].min = Vec3(lo[0], lo[1], lo[2]);
+        out[i].max = Vec3(hi[0], hi[1], hi[2]);
+    }
+#else
+    transformBoundsScalar(local, matrices, count, out);
+#endif
+}
+
+void transformBoundsScalar(const ObjectBounds& local, const Mat4* matrices, size_t count, ObjectBounds* out) {
+    const Vec3 center = (local.min + local.max) * 0.5f;
+    const Vec3 extent = (local.max - local.min) * 0.5f;
+    for (size_t i = 0; i < count; i++) {
+        const Mat4& m = matrices[i];
+        const Vec3 c(m.m[12] + m.m[0] * center.x + m.m[4] * center.y + m.m[8] * center.z,
+                     m.m[13] + m.m[1] * center.x + m.m[5] * center.y + m.m[9] * center.z,
+                     m.m[14] + m.m[2] * center.x + m.m[6] * center.y + m.m[10] * center.z);
+        const Vec3 e(std::fabs(m.m[0]) * extent.x + std::fabs(m.m[4]) * extent.y + std::fabs(m.m[8]) * extent.z,
+                     std::fabs(m.m[1]) * extent.x + std::fabs(m.m[5]) * extent.y + std::fabs(m.m[9]) * extent.z,
+                     std::fabs(m.m[2]) * extent.x + std::fabs(m.m[6]) * extent.y + std::fabs(m.m[10]) * extent.z);
+        out[i].min = c - e;
+        out[i].max = c + e;
+    }
+}
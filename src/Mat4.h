@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include "Components.h"
+#include "Vec3.h"
+
+// One column of a matrix, or a homogeneous point. Vec3 stays three floats,
+// as meshes, bounds and the tile files store it that way.
+struct Vec4 {
+    float x, y, z, w;
+
+    Vec4() : x(0), y(0), z(0), w(0) {}
+    Vec4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+    Vec4(const Vec3& v, float w) : x(v.x), y(v.y), z(v.z), w(w) {}
+
+    Vec4 operator+(const Vec4& o) const { return Vec4(x + o.x, y + o.y, z + o.z, w + o.w); }
+    Vec4 operator-(const Vec4& o) const { return Vec4(x - o.x, y - o.y, z - o.z, w - o.w); }
+    Vec4 operator*(float s) const { return Vec4(x * s, y * s, z * s, w * s); }
+    float dot(const Vec4& o) const { return x * o.x + y * o.y + z * o.z + w * o.w; }
+    Vec3 xyz() const { return Vec3(x, y, z); }
+};
+
+// 4x4 matrix, column-major (m[col * 4 + row]): the layout glLoadMatrixf
+// and GLSL take, so it goes to GL as is. Products and the batched
+// kernels below use SSE where available.
+struct alignas(16) Mat4 {
+    float m[16];
+
+    static Mat4 identity();
+    static Mat4 translation(const Vec3& t);
+    static Mat4 scale(float s);
+    // Right-handed rotations by `radians`, as glRotatef about that axis
+    static Mat4 rotationX(float radians);
+    static Mat4 rotationY(float radians);
+    // Placement of a Transform: scale, then yaw about Y, then translate,
+    // the same the instancing shader applies
+    static Mat4 fromTransform(const Transform& t);
+
+    // The matrices gluLookAt, gluPerspective and glOrtho build
+    static Mat4 lookAt(const Vec3& eye, const Vec3& target, const Vec3& up);
+    static Mat4 perspective(float fovYDegrees, float aspect, float zNear, float zFar);
+    static Mat4 orthographic(float left, float right, float bottom, float top, float zNear, float zFar);
+
+    // This transform after `other`
+    Mat4 operator*(const Mat4& other) const;
+    Vec3 transformPoint(const Vec3& p) const; // w = 1, no divide
+    // General inverse; identity for a singular matrix
+    Mat4 inverse() const;
+
+    float& at(int row, int col) { return m[col * 4 + row]; }
+    float at(int row, int col) const { return m[col * 4 + row]; }
+};
+
+// Batched kernels for thousands of instances per call.
+// fromTransform() for each of `count` transforms
+void composeTransforms(const Transform* transforms, size_t count, Mat4* out);
+// out[i] = a * b[i], e.g. the view times each model matrix
+void multiplyMatrices(const Mat4& a, const Mat4* b, size_t count, Mat4* out);
+// World box of the box `local` under each of `matrices`: the box around
+// its eight transformed corners, computed from the matrix columns
+void transformBounds(const ObjectBounds& local, const Mat4* matrices, size_t count, ObjectBounds* out);
+
+// The same without SSE, for comparison
+void multiplyMatricesScalar(const Mat4& a, const Mat4* b, size_t count, Mat4* out);
+void transformBoundsScalar(const ObjectBounds& local, const Mat4* matrices, size_t count, ObjectBounds* out);
@@ -0,0 +1,385 @@
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include "MeshLoader.h"
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+// ===============================
+// File Layout
+// ===============================
+// header | sources | materials | groups | vertices | normals | texcoords | faces | strings
+// Every section starts on a 16-byte boundary. Strings are referenced by
+// (offset, length) into the trailing string blob.
+namespace {
+
+struct CacheHeader {
+    char magic[4];            // "FMSH"
+    uint32_t version;
+    uint32_t sourceCount;
+    uint32_t materialCount;
+    uint32_t groupCount;
+    uint32_t reserved;
+    uint64_t vertexCount;
+    uint64_t normalCount;
+    uint64_t texcoordCount;
+    uint64_t faceCount;
+    uint64_t stringBytes;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+struct CacheSource {
+    uint64_t size;
+    int64_t mtime;
+    uint64_t hash;
+    uint32_t pathOffset, pathLength;
+};
+
+struct CacheMaterial {
+    uint32_t nameOffset, nameLength;
+    uint32_t textureOffset, textureLength;
+};
+
+struct CacheGroup {
+    uint32_t nameOffset, nameLength;
+    uint64_t faceCount;
+};
+
+struct CacheLayout {
+    size_t sources, materials, groups, vertices, normals, texcoords, faces, strings, total;
+};
+
+inline size_t align16(size_t n) {
+    return (n + 15) & ~size_t(15);
+}
+
+// False if the counts add up to more than a size_t holds, as a corrupt
+// header's can; the offsets would wrap and pass the file length check
+bool computeLayout(const CacheHeader& h, CacheLayout& l) {
+    size_t end = sizeof(CacheHeader);
+    // The next array, `count` elements of `size` bytes, 16-byte aligned
+    auto place = [&end](uint64_t count, size_t size, size_t& offset) {
+        offset = align16(end);
+        if (offset < end || count > (SIZE_MAX - offset) / size) return false;
+        end = offset + static_cast<size_t>(count) * size;
+        return true;
+    };
+    if (!place(h.sourceCount, sizeof(CacheSource), l.sources) ||
+        !place(h.materialCount, sizeof(CacheMaterial), l.materials) ||
+        !place(h.groupCount, sizeof(CacheGroup), l.groups) ||
+        !place(h.vertexCount, sizeof(Vec3), l.vertices) ||
+        !place(h.normalCount, sizeof(Vec3), l.normals) ||
+        !place(h.texcoordCount, sizeof(Vec2), l.texcoords) ||
+        !place(h.faceCount, sizeof(Face), l.faces) ||
+        !place(h.stringBytes, 1, l.strings))
+        return false;
+    l.total = end;
+    return true;
+}
+
+// FNV-1a, 64 bit
+uint64_t hashBytes(const char* data, size_t size) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+struct SourceStamp {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+};
+
+bool stampFile(const std::string& path, SourceStamp& out) {
+    std::error_code ec;
+    out.size = std::filesystem::file_size(path, ec);
+    if (ec) return false;
+    auto time = std::filesystem::last_write_time(path, ec);
+    if (ec) return false;
+    out.mtime = static_cast<int64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+bool hashFile(const std::string& path, uint64_t& out) {
+    MappedFile file(path);
+    if (!file.isOpen()) return false;
+    out = hashBytes(file.data(), file.size());
+    return true;
+}
+
+std::string directoryOf(const std::string& filename) {
+    size_t lastSlash = filename.find_last_of("/\\");
+    return (lastSlash == std::string::npos) ? "" : filename.substr(0, lastSlash + 1);
+}
+
+// Appends a string to the blob and returns its (offset, length)
+void addString(std::string& blob, const std::string& s, uint32_t& offset, uint32_t& length) {
+    offset = static_cast<uint32_t>(blob.size());
+    length = static_cast<uint32_t>(s.size());
+    blob += s;
+}
+
+std::string readString(const char* strings, uint64_t stringBytes, uint32_t offset, uint32_t length) {
+    if (uint64_t(offset) + length > stringBytes) return std::string();
+    return std::string(strings + offset, length);
+}
+
+// The faces the OBJ loader can produce: it leaves -1 for a missing or
+// unresolvable index and keeps an index past the end as the file wrote it,
+// and every reader of the faces skips both. Anything below -1 can only be
+// a corrupt cache.
+bool validFaces(const std::vector<Face>& faces) {
+    for (const Face& f : faces) {
+        for (int c = 0; c < 3; c++)
+            if (f.v[c] < -1 || f.vt[c] < -1 || f.vn[c] < -1) return false;
+    }
+    return true;
+}
+
+// A source that was touched but hashed the same: its new mtime, and where
+// in the cache file it goes
+struct StaleStamp {
+    size_t offset;
+    int64_t mtime;
+};
+
+// Records the new mtimes so the next load trusts them without hashing again.
+// Failing only costs that next load a hash.
+void refreshStamps(const std::string& cachePath, const std::vector<StaleStamp>& stale) {
+    std::fstream file(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file.is_open()) return;
+    for (const StaleStamp& s : stale) {
+        file.seekp(static_cast<std::streamoff>(s.offset));
+        file.write(reinterpret_cast<const char*>(&s.mtime), sizeof(s.mtime));
+    }
+    if (!file) LOG_WARN("Failed to refresh source times in " << cachePath);
+}
+
+} // namespace
+
+// ===============================
+// Writing
+// ===============================
+std::string meshCachePath(const std::string& objFilename) {
+    return objFilename + ".fmesh";
+}
+
+bool writeMeshCache(const std::string& objFilename, const MeshData& mesh) {
+    const std::string dir = directoryOf(objFilename);
+
+    CacheHeader header = {};
+    std::memcpy(header.magic, "FMSH", 4);
+    header.version = MESH_CACHE_VERSION;
+
+    std::string strings;
+    std::vector<CacheSource> sources;
+    for (const auto& rel : mesh.sourceFiles) {
+        CacheSource src = {};
+        SourceStamp stamp;
+        if (!stampFile(dir + rel, stamp) || !hashFile(dir + rel, src.hash)) {
+            // A missing MTL is recorded too, so creating it later invalidates the cache
+            src.size = ~uint64_t(0);
+        } else {
+            src.size = stamp.size;
+            src.mtime = stamp.mtime;
+        }
+        addString(strings, rel, src.pathOffset, src.pathLength);
+        sources.push_back(src);
+    }
+
+    std::vector<CacheMaterial> materials;
+    for (const auto& m : mesh.materials) {
+        CacheMaterial cm = {};
+        addString(strings, m.name, cm.nameOffset, cm.nameLength);
+        addString(strings, m.texturePath, cm.textureOffset, cm.textureLength);
+        materials.push_back(cm);
+    }
+
+    std::vector<CacheGroup> groups;
+    for (const auto& [name, faces] : mesh.materialFaces) {
+        CacheGroup g = {};
+        addString(strings, name, g.nameOffset, g.nameLength);
+        g.faceCount = faces.size();
+        header.faceCount += faces.size();
+        groups.push_back(g);
+    }
+
+    header.sourceCount = static_cast<uint32_t>(sources.size());
+    header.materialCount = static_cast<uint32_t>(materials.size());
+    header.groupCount = static_cast<uint32_t>(groups.size());
+    header.vertexCount = mesh.vertices.size();
+    header.normalCount = mesh.normals.size();
+    header.texcoordCount = mesh.texcoords.size();
+    header.stringBytes = strings.size();
+    header.boundsMin[0] = mesh.boundsMin.x; header.boundsMin[1] = mesh.boundsMin.y; header.boundsMin[2] = mesh.boundsMin.z;
+    header.boundsMax[0] = mesh.boundsMax.x; header.boundsMax[1] = mesh.boundsMax.y; header.boundsMax[2] = mesh.boundsMax.z;
+
+    CacheLayout layout;
+    if (!computeLayout(header, layout)) return false;
+
+    // Write to a temporary file and rename it over the old cache so a
+    // crash mid-write never leaves a truncated cache behind
+    const std::string finalPath = meshCachePath(objFilename);
+    const std::string tempPath = finalPath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return false;
+
+        size_t written = 0;
+        auto put = [&](size_t offset, const void* data, size_t size) {
+            static const char zeros[16] = {};
+            while (written < offset) {
+                size_t pad = std::min<size_t>(offset - written, sizeof(zeros));
+                file.write(zeros, pad);
+                written += pad;
+            }
+            if (size) file.write(static_cast<const char*>(data), size);
+            written += size;
+        };
+
+        put(0, &header, sizeof(header));
+        put(layout.sources, sources.data(), sources.size() * sizeof(CacheSource));
+        put(layout.materials, materials.data(), materials.size() * sizeof(CacheMaterial));
+        put(layout.groups, groups.data(), groups.size() * sizeof(CacheGroup));
+        put(layout.vertices, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vec3));
+        put(layout.normals, mesh.normals.data(), mesh.normals.size() * sizeof(Vec3));
+        put(layout.texcoords, mesh.texcoords.data(), mesh.texcoords.size() * sizeof(Vec2));
+        size_t faceOffset = layout.faces;
+        for (const auto& [name, faces] : mesh.materialFaces) {
+            put(faceOffset, faces.data(), faces.size() * sizeof(Face));
+            faceOffset += faces.size() * sizeof(Face);
+        }
+        put(layout.strings, strings.data(), strings.size());
+
+        if (!file) {
+            file.close();
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, finalPath, ec);
+    if (ec) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// ===============================
+// Reading
+// ===============================
+bool readMeshCache(const std::string& objFilename, MeshData& out) {
+    const std::string cachePath = meshCachePath(objFilename);
+    MappedFile file(cachePath);
+    if (!file.isOpen() || file.size() < sizeof(CacheHeader)) return false;
+
+    const char* base = file.data();
+    CacheHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, "FMSH", 4) != 0 || header.version != MESH_CACHE_VERSION) return false;
+
+    CacheLayout layout;
+    if (!computeLayout(header, layout) || layout.total > file.size()) return false;
+
+    const char* strings = base + layout.strings;
+    const std::string dir = directoryOf(objFilename);
+
+    // Invalidate on any source change: size and mtime first, and only if the
+    // mtime moved without a size change, fall back to hashing the contents
+    MeshData mesh;
+    std::vector<StaleStamp> stale;
+    for (uint32_t i = 0; i < header.sourceCount; i++) {
+        CacheSource src;
+        const size_t srcOffset = layout.sources + i * sizeof(CacheSource);
+        std::memcpy(&src, base + srcOffset, sizeof(src));
+        std::string rel = readString(strings, header.stringBytes, src.pathOffset, src.pathLength);
+
+        SourceStamp stamp;
+        bool exists = stampFile(dir + rel, stamp);
+        if (!exists) {
+            if (src.size != ~uint64_t(0)) return false;
+        } else {
+            if (stamp.size != src.size) return false;
+            if (stamp.mtime != src.mtime) {
+                uint64_t hash = 0;
+                if (!hashFile(dir + rel, hash) || hash != src.hash) return false;
+                stale.push_back({ srcOffset + offsetof(CacheSource, mtime), stamp.mtime });
+            }
+        }
+        mesh.sourceFiles.push_back(rel);
+    }
+
+    for (uint32_t i = 0; i < header.materialCount; i++) {
+        CacheMaterial cm;
+        std::memcpy(&cm, base + layout.materials + i * sizeof(CacheMaterial), sizeof(cm));
+        MaterialDesc m;
+        m.name = readString(strings, header.stringBytes, cm.nameOffset, cm.nameLength);
+        m.texturePath = readString(strings, header.stringBytes, cm.textureOffset, cm.textureLength);
+        mesh.materials.push_back(m);
+    }
+
+    mesh.vertices.resize(header.vertexCount);
+    mesh.normals.resize(header.normalCount);
+    mesh.texcoords.resize(header.texcoordCount);
+    if (header.vertexCount) std::memcpy(mesh.vertices.data(), base + layout.vertices, header.vertexCount * sizeof(Vec3));
+    if (header.normalCount) std::memcpy(mesh.normals.data(), base + layout.normals, header.normalCount * sizeof(Vec3));
+    if (header.texcoordCount) std::memcpy(mesh.texcoords.data(), base + layout.texcoords, header.texcoordCount * sizeof(Vec2));
+
+    uint64_t faceCursor = 0;
+    for (uint32_t i = 0; i < header.groupCount; i++) {
+        CacheGroup g;
+        std::memcpy(&g, base + layout.groups + i * sizeof(CacheGroup), sizeof(g));
+        if (faceCursor + g.faceCount > header.faceCount) return false;
+        auto& faces = mesh.materialFaces[readString(strings, header.stringBytes, g.nameOffset, g.nameLength)];
+        faces.resize(g.faceCount);
+        if (g.faceCount) std::memcpy(faces.data(), base + layout.faces + faceCursor * sizeof(Face), g.faceCount * sizeof(Face));
+        faceCursor += g.faceCount;
+        if (!validFaces(faces)) {
+            LOG_WARN("Mesh cache " << cachePath << " has invalid face indices, rebuilding");
+            return false;
+        }
+    }
+
+    mesh.boundsMin = Vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    mesh.boundsMax = Vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+    out = std::move(mesh);
+
+    if (!stale.empty()) {
+        file.close();
+        refreshStamps(cachePath, stale);
+    }
+    return true;
+}
+
+// ===============================
+// Cached Loading
+// ===============================
+bool loadMesh(const std::string& objFilename, MeshData& out) {
+    const bool useCache = !std::getenv("FALLAGA_NO_MESH_CACHE");
+
+    auto start = std::chrono::steady_clock::now();
+    if (useCache && readMeshCache(objFilename, out)) {
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        LOG_INFO("Loaded baked mesh " << meshCachePath(objFilename) << " in " << ms << " ms");
+        return true;
+    }
+
+    if (!loadMeshFromObj(objFilename, out)) return false;
+
+    if (useCache && !writeMeshCache(objFilename, out))
+        LOG_WARN("Failed to write mesh cache: " << meshCachePath(objFilename));
+    return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "MeshData.h"
+
+// Binary baked-mesh cache.
+// A "<model>.obj.fmesh" file sits next to its source OBJ and holds the fully
+// processed MeshData plus the size, mtime and content hash of every source
+// file it was built from. Loading it is a memory map and a few memcpys.
+
+const uint32_t MESH_CACHE_VERSION = 1;
+
+std::string meshCachePath(const std::string& objFilename);
+
+// Writes the cache file for a mesh that was loaded from `objFilename`
+bool writeMeshCache(const std::string& objFilename, const MeshData& mesh);
+
+// Fills `out` from the cache file if it exists, has the current version,
+// none of its recorded source files changed and every face index is in
+// range. A source that was touched but hashes the same gets its new mtime
+// written back, so later loads don't hash it again.
+bool readMeshCache(const std::string& objFilename, MeshData& out);
+
+// Cache first, source second; a fresh source load is written back so the next
+// run can skip parsing. Set FALLAGA_NO_MESH_CACHE=1 to always load from source.
+bool loadMesh(const std::string& objFilename, MeshData& out);
@@ -0,0 +1,38 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include "Vec3.h"
+
+// Plain mesh structs shared by the loaders and the renderer.
+// Nothing in here touches OpenGL, so offline tools can use it too.
+
+struct Vec2 {
+    float u, v;
+    Vec2(float u = 0.0f, float v = 0.0f) : u(u), v(v) {}
+};
+
+struct Face {
+    int v[3];   // Vertex indices
+    int vt[3];  // Texture coordinate indices
+    int vn[3];  // Normal indices
+};
+
+// A material as described by the MTL file, before any texture is uploaded
+struct MaterialDesc {
+    std::string name;
+    std::string texturePath; // map_Kd, relative to the OBJ directory
+};
+
+// A fully processed mesh: parsed, materials resolved and normals generated.
+// This is what the binary mesh cache stores and what ObjModel uploads.
+struct MeshData {
+    std::vector<Vec3> vertices;
+    std::vector<Vec3> normals;
+    std::vector<Vec2> texcoords;
+    std::vector<MaterialDesc> materials;
+    std::map<std::string, std::vector<Face>> materialFaces;
+    Vec3 boundsMin;
+    Vec3 boundsMax;
+    std::vector<std::string> sourceFiles; // OBJ then MTLs, relative to the OBJ directory
+};
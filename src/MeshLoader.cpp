@@ -0,0 +1,165 @@
+#include "MeshLoader.h"
+#include "ObjParser.h"
+#include "JobSystem.h"
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+// ===============================
+// MTL Parser
+// ===============================
+bool parseMtlFile(const std::string& filename, std::vector<MaterialDesc>& out) {
+    std::ifstream file(filename);
+    if (!file.is_open()) return false;
+
+    std::string line;
+    MaterialDesc currentMaterial;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        std::string prefix;
+        iss >> prefix;
+
+        if (prefix == "newmtl") {
+            if (!currentMaterial.name.empty()) out.push_back(currentMaterial);
+            iss >> currentMaterial.name;
+            currentMaterial.texturePath.clear();
+        } else if (prefix == "map_Kd") {
+            iss >> currentMaterial.texturePath;
+        }
+    }
+    if (!currentMaterial.name.empty()) out.push_back(currentMaterial);
+    return true;
+}
+
+// ===============================
+// Normal Computation
+// ===============================
+namespace {
+
+// Faces and vertices per parallelFor chunk: enough work to be worth a job
+const size_t NORMAL_FACES_PER_JOB = 4096;
+const size_t NORMAL_VERTICES_PER_JOB = 16384;
+
+bool validFace(const Face& face, int count) {
+    return face.v[0] >= 0 && face.v[1] >= 0 && face.v[2] >= 0 &&
+           face.v[0] < count && face.v[1] < count && face.v[2] < count;
+}
+
+} // namespace
+
+void accumulateFaceNormals(const std::vector<Vec3>& vertices, std::vector<Face>& faces,
+                           std::vector<Vec3>& vertexNormals) {
+    const int count = static_cast<int>(vertices.size());
+    for (auto& face : faces) {
+        if (!validFace(face, count)) continue;
+
+        const Vec3& v0 = vertices[face.v[0]];
+        const Vec3& v1 = vertices[face.v[1]];
+        const Vec3& v2 = vertices[face.v[2]];
+
+        Vec3 edge1 = v1 - v0;
+        Vec3 edge2 = v2 - v0;
+        Vec3 normal = edge1.cross(edge2);
+        normal.normalize();
+
+        for (int i = 0; i < 3; i++) {
+            vertexNormals[face.v[i]] = vertexNormals[face.v[i]] + normal;
+            face.vn[i] = face.v[i]; // assign normal index = vertex index
+        }
+    }
+}
+
+void finalizeVertexNormals(std::vector<Vec3>& vertexNormals) {
+    for (auto& n : vertexNormals) n.normalize();
+}
+
+void computeVertexNormals(const std::vector<Vec3>& vertices, const std::vector<std::vector<Face>*>& faceLists,
+                          std::vector<Vec3>& vertexNormals) {
+    JobSystem& jobs = JobSystem::get();
+    const int count = static_cast<int>(vertices.size());
+    vertexNormals.assign(vertices.size(), Vec3(0, 0, 0));
+    std::vector<Vec3> faceNormals;
+    for (std::vector<Face>* list : faceLists) {
+        std::vector<Face>& faces = *list;
+        faceNormals.resize(faces.size());
+        jobs.parallelFor(faces.size(), NORMAL_FACES_PER_JOB, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                Face& face = faces[i];
+                if (!validFace(face, count)) continue;
+                Vec3 normal = (vertices[face.v[1]] - vertices[face.v[0]]).cross(vertices[face.v[2]] - vertices[face.v[0]]);
+                normal.normalize();
+                faceNormals[i] = normal;
+                for (int c = 0; c < 3; c++) face.vn[c] = face.v[c];
+            }
+        });
+        // Neighbouring faces share vertices, so the scatter stays on one thread
+        for (size_t i = 0; i < faces.size(); i++) {
+            const Face& face = faces[i];
+            if (!validFace(face, count)) continue;
+            for (int c = 0; c < 3; c++) vertexNormals[face.v[c]] = vertexNormals[face.v[c]] + faceNormals[i];
+        }
+    }
+    jobs.parallelFor(vertexNormals.size(), NORMAL_VERTICES_PER_JOB, [&vertexNormals](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) vertexNormals[i].normalize();
+    });
+}
+
+// ===============================
+// OBJ + MTL Loading
+// ===============================
+bool loadMeshFromObj(const std::string& filename, MeshData& out) {
+    size_t lastSlash = filename.find_last_of("/\\");
+    std::string basepath = (lastSlash == std::string::npos) ? "" : filename.substr(0, lastSlash + 1);
+
+    ObjData data;
+    auto parseStart = std::chrono::steady_clock::now();
+    if (!parseObjFile(filename, data)) return false;
+    double parseMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - parseStart).count();
+
+    // Timing comparison against the original parser
+    if (std::getenv("FALLAGA_OBJ_COMPARE")) {
+        ObjData legacy;
+        auto legacyStart = std::chrono::steady_clock::now();
+        parseObjFileLegacy(filename, legacy);
+        double legacyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - legacyStart).count();
+        LOG_INFO("OBJ parse " << filename << ": fast " << parseMs << " ms, legacy " << legacyMs
+                 << " ms, results " << (objDataEqual(data, legacy) ? "match" : "DIFFER"));
+    }
+
+    out = MeshData();
+    out.sourceFiles.push_back(filename.substr(basepath.size()));
+    for (const auto& mtlFile : data.mtlLibs) {
+        out.sourceFiles.push_back(mtlFile);
+        if (!parseMtlFile(basepath + mtlFile, out.materials))
+            LOG_WARN("Failed to load MTL: " << basepath + mtlFile);
+    }
+
+    out.vertices = std::move(data.vertices);
+    out.normals = std::move(data.normals);
+    out.texcoords = std::move(data.texcoords);
+    out.materialFaces = std::move(data.materialFaces);
+
+    // Compute smooth normals across every material if the file has none
+    if (out.normals.empty() && !out.materialFaces.empty()) {
+        LOG_INFO("No normals in OBJ, computing smooth normals...");
+        std::vector<std::vector<Face>*> faceLists;
+        for (auto& [mtlName, faces] : out.materialFaces) faceLists.push_back(&faces);
+        computeVertexNormals(out.vertices, faceLists, out.normals);
+    }
+
+    if (!out.vertices.empty()) {
+        out.boundsMin = out.boundsMax = out.vertices[0];
+        for (const auto& v : out.vertices) {
+            out.boundsMin.x = std::min(out.boundsMin.x, v.x);
+            out.boundsMin.y = std::min(out.boundsMin.y, v.y);
+            out.boundsMin.z = std::min(out.boundsMin.z, v.z);
+            out.boundsMax.x = std::max(out.boundsMax.x, v.x);
+            out.boundsMax.y = std::max(out.boundsMax.y, v.y);
+            out.boundsMax.z = std::max(out.boundsMax.z, v.z);
+        }
+    }
+    return true;
+}
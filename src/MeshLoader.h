@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "MeshData.h"
+
+// Parses an MTL file into material descriptions (no textures are loaded)
+bool parseMtlFile(const std::string& filename, std::vector<MaterialDesc>& out);
+
+// Smooth per-vertex normals for a face list; sets each face's vn to its v.
+// `vertexNormals` must hold one accumulator per vertex and is normalized by
+// finalizeVertexNormals once every face list has been accumulated.
+void accumulateFaceNormals(const std::vector<Vec3>& vertices, std::vector<Face>& faces,
+                           std::vector<Vec3>& vertexNormals);
+void finalizeVertexNormals(std::vector<Vec3>& vertexNormals);
+
+// The same normals for several face lists at once, split over the job
+// system: face normals and the final normalize run in parallel, the sums
+// stay in face order so the result matches the serial pair bit for bit.
+// Replaces `vertexNormals`.
+void computeVertexNormals(const std::vector<Vec3>& vertices, const std::vector<std::vector<Face>*>& faceLists,
+                          std::vector<Vec3>& vertexNormals);
+
+// Loads an OBJ and its MTL libraries from source text and builds the
+// processed mesh: normals are generated when the file has none and the
+// bounds are computed. Does not consult the binary cache.
+bool loadMeshFromObj(const std::string& filename, MeshData& out);
@@ -0,0 +1,340 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+// Border edges get an extra plane perpendicular to their triangle so open
+// outlines keep their shape; weighted well above the surface planes
+const double BORDER_WEIGHT = 10.0;
+
+// A collapse may not turn a triangle more than ~75 degrees
+const float MIN_NORMAL_DOT = 0.25f;
+
+enum VertexKind : uint8_t { KIND_INTERIOR, KIND_BORDER, KIND_LOCKED };
+
+// Symmetric 4x4 error quadric plus the total weight folded into it
+struct Quadric {
+    double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+    double weight = 0;
+
+    void addPlane(double a, double b, double c, double d, double w) {
+        a2 += w * a * a; ab += w * a * b; ac += w * a * c; ad += w * a * d;
+        b2 += w * b * b; bc += w * b * c; bd += w * b * d;
+        c2 += w * c * c; cd += w * c * d;
+        d2 += w * d * d;
+        weight += w;
+    }
+
+    void add(const Quadric& q) {
+        a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+        b2 += q.b2; bc += q.bc; bd += q.bd;
+        c2 += q.c2; cd += q.cd;
+        d2 += q.d2;
+        weight += q.weight;
+    }
+
+    // Weighted sum of squared plane distances at (x, y, z)
+    double eval(double x, double y, double z) const {
+        return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+             + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+             + c2 * z * z + 2 * cd * z + d2;
+    }
+};
+
+inline Vec3 positionOf(const MeshVertex& v) {
+    return Vec3(v.px, v.py, v.pz);
+}
+
+inline uint64_t edgeKey(uint32_t a, uint32_t b) {
+    if (a > b) std::swap(a, b);
+    return (static_cast<uint64_t>(a) << 32) | b;
+}
+
+struct PositionKey {
+    uint32_t x, y, z;
+    bool operator==(const PositionKey& o) const { return x == o.x && y == o.y && z == o.z; }
+};
+
+struct PositionKeyHash {
+    size_t operator()(const PositionKey& k) const {
+        uint64_t h = k.x * 0x9E3779B97F4A7C15ull;
+        h ^= k.y * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+        h ^= k.z * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+        return static_cast<size_t>(h ^ (h >> 29));
+    }
+};
+
+struct Collapse {
+    uint32_t from, to;
+    double cost;
+};
+
+} // namespace
+
+MeshLod simplifyMesh(const IndexedMesh& mesh, const MeshLod& source, size_t targetTriangles) {
+    const std::vector<MeshVertex>& vertices = mesh.vertices;
+    const size_t vertexCount = vertices.size();
+
+    // Flatten to one triangle list with a material per triangle
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> triangleMaterial;
+    indices.reserve(source.indices.size());
+    triangleMaterial.reserve(source.indices.size() / 3);
+    for (size_t m = 0; m < source.subMeshes.size(); m++) {
+        const SubMesh& sub = source.subMeshes[m];
+        indices.insert(indices.end(), source.indices.begin() + sub.firstIndex,
+                       source.indices.begin() + sub.firstIndex + sub.indexCount);
+        triangleMaterial.insert(triangleMaterial.end(), sub.indexCount / 3, static_cast<uint32_t>(m));
+    }
+
+    // Vertices that share a position with another vertex sit on a UV or
+    // normal seam; moving one side would open a crack, so they stay put
+    std::vector<uint8_t> onSeam(vertexCount, 0);
+    {
+        std::unordered_map<PositionKey, uint32_t, PositionKeyHash> firstAt;
+        firstAt.reserve(vertexCount);
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            PositionKey key;
+            std::memcpy(&key.x, &vertices[v].px, 4);
+            std::memcpy(&key.y, &vertices[v].py, 4);
+            std::memcpy(&key.z, &vertices[v].pz, 4);
+            auto inserted = firstAt.emplace(key, v);
+            if (!inserted.second) onSeam[v] = onSeam[inserted.first->second] = 1;
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t t = 0; t < indices.size(); t += 3) {
+        Vec3 p0 = positionOf(vertices[indices[t]]);
+        Vec3 n = (positionOf(vertices[indices[t + 1]]) - p0).cross(positionOf(vertices[indices[t + 2]]) - p0);
+        double length = n.length();
+        if (length <= 0.0) continue;
+        double a = n.x / length, b = n.y / length, c = n.z / length;
+        double d = -(a * p0.x + b * p0.y + c * p0.z);
+        for (int k = 0; k < 3; k++) quadrics[indices[t + k]].addPlane(a, b, c, d, length * 0.5);
+    }
+
+    std::vector<uint32_t> adjacencyStart(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<uint8_t> kind(vertexCount);
+    std::vector<int> vertexMaterial(vertexCount);
+    std::vector<uint32_t> collapseTo(vertexCount);
+    std::vector<uint8_t> touched(vertexCount);
+    std::vector<uint32_t> stamp(vertexCount, 0);
+    uint32_t stampValue = 0;
+    std::unordered_map<uint64_t, uint32_t> edgeUse;
+    std::vector<Collapse> candidates;
+    double maxError = 0.0;
+    bool firstPass = true;
+
+    while (indices.size() / 3 > targetTriangles) {
+        const size_t triangleCount = indices.size() / 3;
+
+        // Triangles around each vertex
+        std::fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+        for (uint32_t v : indices) adjacencyStart[v + 1]++;
+        for (size_t i = 1; i <= vertexCount; i++) adjacencyStart[i] += adjacencyStart[i - 1];
+        adjacency.resize(indices.size());
+        {
+            std::vector<uint32_t> cursor(adjacencyStart.begin(), adjacencyStart.end() - 1);
+            for (size_t i = 0; i < indices.size(); i++) adjacency[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        // Classify vertices: edges used once are borders, edges used more
+        // than twice are non-manifold, and mixed materials lock a vertex
+        edgeUse.clear();
+        edgeUse.reserve(indices.size() * 2);
+        for (size_t t = 0; t < indices.size(); t += 3)
+            for (int k = 0; k < 3; k++) edgeUse[edgeKey(indices[t + k], indices[t + (k + 1) % 3])]++;
+
+        std::vector<uint8_t> borderEdges(vertexCount, 0);
+        std::fill(kind.begin(), kind.end(), static_cast<uint8_t>(KIND_INTERIOR));
+        std::fill(vertexMaterial.begin(), vertexMaterial.end(), -1);
+        for (size_t t = 0; t < indices.size(); t += 3) {
+            for (int k = 0; k < 3; k++) {
+                uint32_t a = indices[t + k], b = indices[t + (k + 1) % 3];
+                uint32_t use = edgeUse[edgeKey(a, b)];
+                if (use == 1) {
+                    if (borderEdges[a] < 255) borderEdges[a]++;
+                    if (borderEdges[b] < 255) borderEdges[b]++;
+                    if (firstPass) {
+                        // Plane through the edge, perpendicular to the triangle
+                        Vec3 pa = positionOf(vertices[a]), pb = positionOf(vertices[b]);
+                        Vec3 pc = positionOf(vertices[indices[t + (k + 2) % 3]]);
+                        Vec3 edge = pb - pa;
+                        Vec3 n = edge.cross(pc - pa).cross(edge);
+                        double length = n.length();
+                        if (length > 0.0) {
+                            double na = n.x / length, nb = n.y / length, nc = n.z / length;
+                            double d = -(na * pa.x + nb * pa.y + nc * pa.z);
+                            double w = edge.dot(edge) * BORDER_WEIGHT;
+                            quadrics[a].addPlane(na, nb, nc, d, w);
+                            quadrics[b].addPlane(na, nb, nc, d, w);
+                        }
+                    }
+                } else if (use > 2) {
+                    kind[a] = kind[b] = KIND_LOCKED;
+                }
+
+                const int material = static_cast<int>(triangleMaterial[t / 3]);
+                if (vertexMaterial[a] < 0) vertexMaterial[a] = material;
+                else if (vertexMaterial[a] != material) kind[a] = KIND_LOCKED;
+            }
+        }
+        firstPass = false;
+        for (size_t v = 0; v < vertexCount; v++) {
+            if (kind[v] == KIND_LOCKED) continue;
+            if (onSeam[v]) kind[v] = KIND_LOCKED;
+            else if (borderEdges[v] == 2) kind[v] = KIND_BORDER;
+            else if (borderEdges[v] != 0) kind[v] = KIND_LOCKED; // border corner or bow-tie
+        }
+
+        // Cheapest collapse for every vertex that may move
+        candidates.clear();
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            if (kind[v] == KIND_LOCKED || adjacencyStart[v] == adjacencyStart[v + 1]) continue;
+            Collapse best = { v, v, 1e300 };
+            for (uint32_t i = adjacencyStart[v]; i < adjacencyStart[v + 1]; i++) {
+                const uint32_t* tri = &indices[adjacency[i] * 3];
+                for (int k = 0; k < 3; k++) {
+                    uint32_t u = tri[k];
+                    if (u == v) continue;
+                    if (kind[v] == KIND_BORDER && edgeUse[edgeKey(v, u)] != 1) continue;
+                    Quadric q = quadrics[v];
+                    q.add(quadrics[u]);
+                    double cost = q.eval(vertices[u].px, vertices[u].py, vertices[u].pz) / std::max(q.weight, 1e-20);
+                    if (cost < best.cost) best = { v, u, cost };
+                }
+            }
+            if (best.to != v) candidates.push_back(best);
+        }
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+        // Apply the cheapest ones that don't overlap; anything next to a
+        // collapse waits for the next pass, when adjacency is rebuilt
+        const size_t wanted = triangleCount - targetTriangles;
+        size_t removed = 0;
+        size_t collapses = 0;
+        std::fill(touched.begin(), touched.end(), 0);
+        for (uint32_t v = 0; v < vertexCount; v++) collapseTo[v] = v;
+
+        for (const Collapse& c : candidates) {
+            if (removed >= wanted) break;
+            if (touched[c.from] || touched[c.to]) continue;
+
+            // Link condition: the two vertices may only share the neighbours
+            // of the triangles being removed, or the surface pinches
+            stampValue++;
+            size_t sharedTriangles = 0;
+            for (uint32_t i = adjacencyStart[c.from]; i < adjacencyStart[c.from + 1]; i++) {
+                const uint32_t* tri = &indices[adjacency[i] * 3];
+                if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) sharedTriangles++;
+                for (int k = 0; k < 3; k++) stamp[tri[k]] = stampValue;
+            }
+            size_t sharedNeighbours = 0;
+            stampValue++;
+            for (uint32_t i = adjacencyStart[c.to]; i < adjacencyStart[c.to + 1]; i++) {
+                const uint32_t* tri = &indices[adjacency[i] * 3];
+                for (int k = 0; k < 3; k++) {
+                    uint32_t u = tri[k];
+                    if (u == c.from || u == c.to) continue;
+                    if (stamp[u] == stampValue - 1) {
+                        sharedNeighbours++;
+                        stamp[u] = stampValue; // count each neighbour once
+                    }
+                }
+            }
+            if (sharedNeighbours != sharedTriangles) continue;
+
+            // Reject collapses that flip or crush a remaining triangle
+            const Vec3 target = positionOf(vertices[c.to]);
+            bool flips = false;
+            for (uint32_t i = adjacencyStart[c.from]; i < adjacencyStart[c.from + 1] && !flips; i++) {
+                const uint32_t* tri = &indices[adjacency[i] * 3];
+                if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) continue;
+                Vec3 p[3], q[3];
+                for (int k = 0; k < 3; k++) {
+                    p[k] = positionOf(vertices[tri[k]]);
+                    q[k] = tri[k] == c.from ? target : p[k];
+                }
+                Vec3 before = (p[1] - p[0]).cross(p[2] - p[0]);
+                Vec3 after = (q[1] - q[0]).cross(q[2] - q[0]);
+                float scale = before.length() * after.length();
+                if (scale <= 0.0f || before.dot(after) < MIN_NORMAL_DOT * scale) flips = true;
+            }
+            if (flips) continue;
+
+            collapseTo[c.from] = c.to;
+            quadrics[c.to].add(quadrics[c.from]);
+            removed += sharedTriangles;
+            collapses++;
+            maxError = std::max(maxError, c.cost);
+            touched[c.to] = 1;
+            for (uint32_t i = adjacencyStart[c.from]; i < adjacencyStart[c.from + 1]; i++) {
+                const uint32_t* tri = &indices[adjacency[i] * 3];
+                for (int k = 0; k < 3; k++) touched[tri[k]] = 1;
+            }
+        }
+        if (collapses == 0) break;
+
+        // Rewrite the triangles and drop the ones that collapsed to an edge
+        size_t out = 0;
+        for (size_t t = 0; t < indices.size(); t += 3) {
+            uint32_t a = collapseTo[indices[t]], b = collapseTo[indices[t + 1]], c = collapseTo[indices[t + 2]];
+            if (a == b || b == c || a == c) continue;
+            indices[out] = a;
+            indices[out + 1] = b;
+            indices[out + 2] = c;
+            triangleMaterial[out / 3] = triangleMaterial[t / 3];
+            out += 3;
+        }
+        indices.resize(out);
+        triangleMaterial.resize(out / 3);
+    }
+
+    // Regroup by material, keeping the source order
+    MeshLod lod;
+    lod.error = static_cast<float>(std::sqrt(maxError));
+    std::vector<uint32_t> materialStart(source.subMeshes.size() + 1, 0);
+    for (uint32_t m : triangleMaterial) materialStart[m + 1] += 3;
+    for (size_t m = 1; m < materialStart.size(); m++) materialStart[m] += materialStart[m - 1];
+    lod.indices.resize(indices.size());
+    {
+        std::vector<uint32_t> cursor(materialStart.begin(), materialStart.end() - 1);
+        for (size_t t = 0; t < triangleMaterial.size(); t++) {
+            uint32_t& at = cursor[triangleMaterial[t]];
+            for (int k = 0; k < 3; k++) lod.indices[at++] = indices[t * 3 + k];
+        }
+    }
+    for (size_t m = 0; m < source.subMeshes.size(); m++) {
+        SubMesh sub;
+        sub.material = source.subMeshes[m].material;
+        sub.firstIndex = materialStart[m];
+        sub.indexCount = materialStart[m + 1] - materialStart[m];
+        if (sub.indexCount > 0) lod.subMeshes.push_back(sub);
+    }
+    lod.error = std::max(lod.error, source.error);
+    return lod;
+}
+
+void buildLodChain(const IndexedMesh& mesh, int levels, float ratio, std::vector<MeshLod>& out) {
+    out.clear();
+    MeshLod full;
+    full.indices = mesh.indices;
+    full.subMeshes = mesh.subMeshes;
+    out.push_back(std::move(full));
+
+    for (int level = 1; level < levels; level++) {
+        const size_t previous = out.back().indices.size() / 3;
+        const size_t target = static_cast<size_t>(previous * ratio);
+        if (target == 0) break;
+        MeshLod lod = simplifyMesh(mesh, out.back(), target);
+        // Not worth a level if the locked vertices stopped it from shrinking
+        if (lod.indices.size() / 3 > previous * 0.9) break;
+        out.push_back(std::move(lod));
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "IndexedMesh.h"
+
+// One level of detail over the vertex buffer of an IndexedMesh. Triangles
+// are grouped by material exactly like IndexedMesh::subMeshes; sub-meshes
+// that simplify away entirely are dropped.
+struct MeshLod {
+    std::vector<uint32_t> indices;
+    std::vector<SubMesh> subMeshes;
+    float error = 0.0f; // largest quadric error accepted, in world units
+};
+
+// Quadric-error simplification (Garland & Heckbert) with half-edge
+// collapses: a vertex is only ever merged into one of its neighbours, so
+// every LOD reuses the original vertex buffer unchanged.
+//
+// Vertices on UV/normal seams (one position, several vertices) and on
+// material boundaries never move, which keeps seams and material edges
+// intact. Open borders may only collapse along themselves, and collapses
+// that would flip a triangle are rejected. The result can keep more
+// triangles than asked for when the locked vertices leave nothing to collapse.
+MeshLod simplifyMesh(const IndexedMesh& mesh, const MeshLod& source, size_t targetTriangles);
+
+// out[0] is the full mesh, each further level keeps about `ratio` of the
+// previous one. Stops early when a level no longer gets smaller.
+void buildLodChain(const IndexedMesh& mesh, int levels, float ratio, std::vector<MeshLod>& out);
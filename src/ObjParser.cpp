@@ -0,0 +1,349 @@
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+// ===============================
+// Fast Parser Helpers
+// ===============================
+namespace {
+
+// Chunks smaller than this are not worth a thread of their own
+const size_t MIN_CHUNK_BYTES = 256 * 1024;
+
+// A run of faces that share one usemtl. The first run of every chunk
+// inherits whatever material was active at the end of the previous chunk.
+struct MaterialRun {
+    bool inherit;
+    std::string name;
+    size_t firstFace;
+};
+
+// Everything one thread pulled out of its slice of the file.
+// Indices are already 0-based; corners written with negative (relative)
+// indices are stored relative to the chunk start and listed in `relative`
+// so the merge can add the chunk's base offset.
+struct ChunkResult {
+    std::vector<Vec3> vertices;
+    std::vector<Vec3> normals;
+    std::vector<Vec2> texcoords;
+    std::vector<Face> faces;
+    std::vector<MaterialRun> runs;
+    std::vector<std::string> mtlLibs;
+    std::vector<uint32_t> relative; // face * 9 + component * 3 + corner
+};
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* skipSpace(const char* p, const char* end) {
+    while (p < end && isSpace(*p)) ++p;
+    return p;
+}
+
+inline const char* skipToken(const char* p, const char* end) {
+    while (p < end && !isSpace(*p)) ++p;
+    return p;
+}
+
+// Reads the next float; returns null (and leaves `out` alone) when there is none,
+// which matches how `iss >> f` leaves the remaining components at zero
+inline const char* parseFloat(const char* p, const char* end, float& out) {
+    p = skipSpace(p, end);
+    if (p < end && *p == '+') ++p;
+    std::from_chars_result r = std::from_chars(p, end, out);
+    if (r.ec != std::errc()) return nullptr;
+    return r.ptr;
+}
+
+// One face corner: "v", "v/vt", "v//vn" or "v/vt/vn"
+struct Corner {
+    int idx[3];
+    bool rel[3];
+};
+
+// Parses a corner starting at p and returns the position after it.
+// `counts` are the chunk-local v/vt/vn counts used to resolve negative indices.
+const char* parseCorner(const char* p, const char* end, const size_t counts[3], Corner& c) {
+    for (int k = 0; k < 3; k++) {
+        c.idx[k] = -1;
+        c.rel[k] = false;
+    }
+
+    for (int k = 0; k < 3 && p < end && !isSpace(*p); k++) {
+        if (*p != '/') {
+            int value = 0;
+            std::from_chars_result r = std::from_chars(p, end, value);
+            if (r.ec == std::errc()) {
+                if (value > 0) {
+                    c.idx[k] = value - 1;
+                } else if (value < 0) {
+                    c.idx[k] = static_cast<int>(counts[k]) + value;
+                    c.rel[k] = true;
+                }
+                p = r.ptr;
+            }
+        }
+        // Skip anything unparsable up to the next separator
+        while (p < end && *p != '/' && !isSpace(*p)) ++p;
+        if (p < end && *p == '/') ++p;
+    }
+    return skipToken(p, end);
+}
+
+void parseChunk(const char* begin, const char* end, ChunkResult& out) {
+    out.runs.push_back({ true, std::string(), 0 });
+
+    std::vector<Corner> corners;
+    corners.reserve(8);
+
+    const char* p = begin;
+    while (p < end) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!lineEnd) lineEnd = end;
+
+        const char* q = skipSpace(p, lineEnd);
+        const char* keyEnd = skipToken(q, lineEnd);
+        size_t keyLen = keyEnd - q;
+
+        if (keyLen == 1 && q[0] == 'v') {
+            Vec3 v;
+            const char* r = parseFloat(keyEnd, lineEnd, v.x);
+            if (r) r = parseFloat(r, lineEnd, v.y);
+            if (r) r = parseFloat(r, lineEnd, v.z);
+            out.vertices.push_back(v);
+        } else if (keyLen == 2 && q[0] == 'v' && q[1] == 'n') {
+            Vec3 n;
+            const char* r = parseFloat(keyEnd, lineEnd, n.x);
+            if (r) r = parseFloat(r, lineEnd, n.y);
+            if (r) r = parseFloat(r, lineEnd, n.z);
+            out.normals.push_back(n);
+        } else if (keyLen == 2 && q[0] == 'v' && q[1] == 't') {
+            Vec2 t;
+            const char* r = parseFloat(keyEnd, lineEnd, t.u);
+            if (r) parseFloat(r, lineEnd, t.v);
+            out.texcoords.push_back(t);
+        } else if (keyLen == 1 && q[0] == 'f') {
+            const size_t counts[3] = { out.vertices.size(), out.texcoords.size(), out.normals.size() };
+            corners.clear();
+            const char* r = skipSpace(keyEnd, lineEnd);
+            while (r < lineEnd) {
+                Corner c;
+                r = skipSpace(parseCorner(r, lineEnd, counts, c), lineEnd);
+                corners.push_back(c);
+            }
+
+            // Fan-triangulate quads and n-gons; the first triangle is the
+            // one the legacy parser produced by reading three corners
+            for (size_t i = 1; i + 1 < corners.size(); i++) {
+                const Corner* tri[3] = { &corners[0], &corners[i], &corners[i + 1] };
+                Face f;
+                uint32_t faceIndex = static_cast<uint32_t>(out.faces.size());
+                for (int k = 0; k < 3; k++) {
+                    f.v[k]  = tri[k]->idx[0];
+                    f.vt[k] = tri[k]->idx[1];
+                    f.vn[k] = tri[k]->idx[2];
+                    for (int comp = 0; comp < 3; comp++)
+                        if (tri[k]->rel[comp]) out.relative.push_back(faceIndex * 9 + comp * 3 + k);
+                }
+                out.faces.push_back(f);
+            }
+        } else if (keyLen == 6 && std::memcmp(q, "usemtl", 6) == 0) {
+            const char* nameBegin = skipSpace(keyEnd, lineEnd);
+            const char* nameEnd = skipToken(nameBegin, lineEnd);
+            if (nameEnd > nameBegin) {
+                // Drop the previous run if no face used it
+                if (out.runs.back().firstFace == out.faces.size()) out.runs.pop_back();
+                out.runs.push_back({ false, std::string(nameBegin, nameEnd), out.faces.size() });
+            }
+        } else if (keyLen == 6 && std::memcmp(q, "mtllib", 6) == 0) {
+            const char* nameBegin = skipSpace(keyEnd, lineEnd);
+            const char* nameEnd = skipToken(nameBegin, lineEnd);
+            if (nameEnd > nameBegin) out.mtlLibs.emplace_back(nameBegin, nameEnd);
+        }
+
+        p = lineEnd + 1;
+    }
+}
+
+inline int* faceComponent(Face& f, int comp) {
+    return comp == 0 ? f.v : (comp == 1 ? f.vt : f.vn);
+}
+
+} // namespace
+
+// ===============================
+// Fast Parser
+// ===============================
+bool parseObjFile(const std::string& filename, ObjData& out, unsigned threadCount) {
+    MappedFile file(filename);
+    if (!file.isOpen()) return false;
+
+    out = ObjData();
+    const char* data = file.data();
+    const size_t size = file.size();
+    if (size == 0) return true;
+
+    if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+    size_t chunkCount = std::min<size_t>(threadCount, std::max<size_t>(1, size / MIN_CHUNK_BYTES));
+
+    // Split on line boundaries so no line straddles two chunks
+    std::vector<size_t> bounds(chunkCount + 1, size);
+    bounds[0] = 0;
+    for (size_t i = 1; i < chunkCount; i++) {
+        size_t pos = std::max(bounds[i - 1], size * i / chunkCount);
+        const void* nl = (pos < size) ? std::memchr(data + pos, '\n', size - pos) : nullptr;
+        bounds[i] = nl ? static_cast<size_t>(static_cast<const char*>(nl) - data) + 1 : size;
+    }
+
+    std::vector<ChunkResult> chunks(chunkCount);
+    std::vector<std::thread> workers;
+    workers.reserve(chunkCount - 1);
+    for (size_t i = 1; i < chunkCount; i++)
+        workers.emplace_back(parseChunk, data + bounds[i], data + bounds[i + 1], std::ref(chunks[i]));
+    parseChunk(data + bounds[0], data + bounds[1], chunks[0]);
+    for (auto& w : workers) w.join();
+
+    // Merge in file order, rebasing relative indices and carrying the
+    // active material across chunk boundaries
+    size_t totalV = 0, totalVt = 0, totalVn = 0;
+    for (const auto& c : chunks) {
+        totalV += c.vertices.size();
+        totalVt += c.texcoords.size();
+        totalVn += c.normals.size();
+    }
+    out.vertices.reserve(totalV);
+    out.texcoords.reserve(totalVt);
+    out.normals.reserve(totalVn);
+
+    std::string currentMtl;
+    for (auto& c : chunks) {
+        const int base[3] = { static_cast<int>(out.vertices.size()),
+                              static_cast<int>(out.texcoords.size()),
+                              static_cast<int>(out.normals.size()) };
+        for (uint32_t code : c.relative) {
+            Face& f = c.faces[code / 9];
+            int* arr = faceComponent(f, (code % 9) / 3);
+            int& idx = arr[code % 3];
+            idx += base[(code % 9) / 3];
+            if (idx < 0) idx = -1;
+        }
+
+        out.vertices.insert(out.vertices.end(), c.vertices.begin(), c.vertices.end());
+        out.texcoords.insert(out.texcoords.end(), c.texcoords.begin(), c.texcoords.end());
+        out.normals.insert(out.normals.end(), c.normals.begin(), c.normals.end());
+        out.mtlLibs.insert(out.mtlLibs.end(), c.mtlLibs.begin(), c.mtlLibs.end());
+
+        for (size_t r = 0; r < c.runs.size(); r++) {
+            if (!c.runs[r].inherit) currentMtl = c.runs[r].name;
+            size_t first = c.runs[r].firstFace;
+            size_t last = (r + 1 < c.runs.size()) ? c.runs[r + 1].firstFace : c.faces.size();
+            if (first == last) continue;
+            auto& dst = out.materialFaces[currentMtl];
+            dst.insert(dst.end(), c.faces.begin() + first, c.faces.begin() + last);
+        }
+
+        // Free each chunk as soon as it is merged to keep peak memory down
+        c = ChunkResult();
+    }
+    return true;
+}
+
+// ===============================
+// Legacy Parser
+// ===============================
+
+// Parse a vertex string "v/vt/vn"
+static void parseVertexString(const std::string& vertStr, int& v_idx, int& vt_idx, int& vn_idx) {
+    std::stringstream vss(vertStr);
+    std::string token;
+    v_idx = vt_idx = vn_idx = -1;
+
+    if (std::getline(vss, token, '/'))
+        if (!token.empty()) v_idx = std::stoi(token) - 1;
+
+    if (std::getline(vss, token, '/'))
+        if (!token.empty()) vt_idx = std::stoi(token) - 1;
+
+    if (std::getline(vss, token, '/'))
+        if (!token.empty()) vn_idx = std::stoi(token) - 1;
+}
+
+bool parseObjFileLegacy(const std::string& filename, ObjData& out) {
+    std::ifstream file(filename);
+    if (!file.is_open()) return false;
+
+    out = ObjData();
+    std::string line, mtlFile, currentMtlName;
+
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        std::string prefix;
+        iss >> prefix;
+
+        if (prefix == "v") {
+            Vec3 v; iss >> v.x >> v.y >> v.z; out.vertices.push_back(v);
+        } else if (prefix == "vn") {
+            Vec3 n; iss >> n.x >> n.y >> n.z; out.normals.push_back(n);
+        } else if (prefix == "vt") {
+            Vec2 t; iss >> t.u >> t.v; out.texcoords.push_back(t);
+        } else if (prefix == "mtllib") {
+            iss >> mtlFile; out.mtlLibs.push_back(mtlFile);
+        } else if (prefix == "usemtl") {
+            iss >> currentMtlName;
+        } else if (prefix == "f") {
+            Face f;
+            for (int i = 0; i < 3; i++) {
+                std::string vertStr; iss >> vertStr;
+                int v_idx, vt_idx, vn_idx;
+                parseVertexString(vertStr, v_idx, vt_idx, vn_idx);
+                f.v[i]  = v_idx;
+                f.vt[i] = vt_idx;
+                f.vn[i] = vn_idx;
+            }
+            out.materialFaces[currentMtlName].push_back(f);
+        }
+    }
+    return true;
+}
+
+// ===============================
+// Comparison
+// ===============================
+bool objDataEqual(const ObjData& a, const ObjData& b) {
+    auto sameVec3 = [](const std::vector<Vec3>& x, const std::vector<Vec3>& y) {
+        return x.size() == y.size() &&
+               std::equal(x.begin(), x.end(), y.begin(), [](const Vec3& p, const Vec3& q) {
+                   return p.x == q.x && p.y == q.y && p.z == q.z;
+               });
+    };
+    auto sameVec2 = [](const std::vector<Vec2>& x, const std::vector<Vec2>& y) {
+        return x.size() == y.size() &&
+               std::equal(x.begin(), x.end(), y.begin(), [](const Vec2& p, const Vec2& q) {
+                   return p.u == q.u && p.v == q.v;
+               });
+    };
+    auto sameFaces = [](const std::vector<Face>& x, const std::vector<Face>& y) {
+        return x.size() == y.size() &&
+               std::equal(x.begin(), x.end(), y.begin(), [](const Face& p, const Face& q) {
+                   return std::memcmp(&p, &q, sizeof(Face)) == 0;
+               });
+    };
+
+    if (!sameVec3(a.vertices, b.vertices) || !sameVec3(a.normals, b.normals) ||
+        !sameVec2(a.texcoords, b.texcoords) || a.mtlLibs != b.mtlLibs ||
+        a.materialFaces.size() != b.materialFaces.size())
+        return false;
+
+    for (auto ia = a.materialFaces.begin(), ib = b.materialFaces.begin();
+         ia != a.materialFaces.end(); ++ia, ++ib) {
+        if (ia->first != ib->first || !sameFaces(ia->second, ib->second)) return false;
+    }
+    return true;
+}
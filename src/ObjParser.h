@@ -0,0 +1,27 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include "MeshData.h"
+
+// Raw contents of an OBJ file, before normals are generated or buffers built
+struct ObjData {
+    std::vector<Vec3> vertices;
+    std::vector<Vec3> normals;
+    std::vector<Vec2> texcoords;
+    std::vector<std::string> mtlLibs; // mtllib entries in file order
+    std::map<std::string, std::vector<Face>> materialFaces;
+};
+
+// Memory-maps the file and parses line-aligned chunks on several threads.
+// Faces with more than three corners are fan-triangulated, negative (relative)
+// indices are resolved and "v//vn" corners are accepted.
+// threadCount = 0 picks one thread per hardware core.
+bool parseObjFile(const std::string& filename, ObjData& out, unsigned threadCount = 0);
+
+// The original getline/istringstream parser, kept as the reference the fast
+// path is compared against (set FALLAGA_OBJ_COMPARE=1 to time both on load)
+bool parseObjFileLegacy(const std::string& filename, ObjData& out);
+
+// True when both parses produced identical arrays and face lists
+bool objDataEqual(const ObjData& a, const ObjData& b);
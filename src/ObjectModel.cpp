@@ -1,14 +1,26 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "ObjectModel.h"
-#include <fstream>
-#include <sstream>
-#include <iostream>
 #include <vector>
 #include <limits> // For numeric_limits
 #include <cmath>  // For std::abs
 #include <map>    // For std::map
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
 #include "Vec3.h"
+#include "MeshCache.h"
+#include "MeshLoader.h"
+#include "Intersect.h"
+#include "InstancedRenderer.h"
+#include "AssetStreamer.h"
+#include "GlState.h"
+#include "ResourceManager.h"
+#include "Profiler.h"
+#include "Log.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
@@ -23,287 +35,462 @@ bool ObjModel::rayTriangleIntersect(
      const Vec3& v0, 
      const Vec3& v1, 
      const Vec3& v2,
-    float& outT) const {
-    // A small value to prevent division by zero or floating-point errors
-    const float EPSILON = 0.0000001f;
-
-    // Calculate vectors for triangle edges
-    Vec3 edge1 = { v1.x - v0.x, v1.y - v0.y, v1.z - v0.z };
-    Vec3 edge2 = { v2.x - v0.x, v2.y - v0.y, v2.z - v0.z };
-
-    // Calculate the cross product of the ray direction and edge2
-    Vec3 h = { rayDir.y * edge2.z - rayDir.z * edge2.y,
-               rayDir.z * edge2.x - rayDir.x * edge2.z,
-               rayDir.x * edge2.y - rayDir.y * edge2.x };
-
-    // Calculate the determinant
-    float a = edge1.x * h.x + edge1.y * h.y + edge1.z * h.z;
-
-    // Check if the ray is parallel to the triangle
-    if (a > -EPSILON && a < EPSILON) {
-        return false;
-    }
+    float& outT) {
+    return intersectRayTriangle(rayOrigin, rayDir, v0, v1, v2, outT);
+}
 
-    float f = 1.0f / a;
-    Vec3 s = { rayOrigin.x - v0.x, rayOrigin.y - v0.y, rayOrigin.z - v0.z };
+void ObjModel::getMinMaxY(float& minY, float& maxY) const {
+    // Bounds come with the mesh (computed at load time or stored in the cache)
+    minY = boundsMin.y;
+    maxY = boundsMax.y;
+}
 
-    // Calculate the barycentric coordinate u
-    float u = f * (s.x * h.x + s.y * h.y + s.z * h.z);
+// ===============================
+// Normal Computation (Fix)
+// ===============================
+void ObjModel::computeVertexNormals(std::vector<Face>& faces) {
+    ::computeVertexNormals(temp_vertices, { &faces }, temp_normals);
+}
 
-    // Check if the intersection point is outside the triangle
-    if (u < 0.0f || u > 1.0f) {
-        return false;
+// ===============================
+// OBJ Loader
+// ===============================
+namespace {
+
+// Box-filters `pixels` down to 1x1, level 0 first. Odd sizes reuse the
+// last row/column, which is what glGenerateMipmap does on most drivers.
+void buildMipChain(const unsigned char* pixels, int width, int height, int channels, std::vector<MipLevel>& out) {
+    MipLevel base;
+    base.width = width;
+    base.height = height;
+    base.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * channels);
+    out.push_back(std::move(base));
+
+    while (out.back().width > 1 || out.back().height > 1) {
+        const MipLevel& src = out.back();
+        MipLevel dst;
+        dst.width = std::max(1, src.width / 2);
+        dst.height = std::max(1, src.height / 2);
+        dst.pixels.resize(static_cast<size_t>(dst.width) * dst.height * channels);
+        for (int y = 0; y < dst.height; y++) {
+            const int y0 = std::min(y * 2, src.height - 1), y1 = std::min(y * 2 + 1, src.height - 1);
+            for (int x = 0; x < dst.width; x++) {
+                const int x0 = std::min(x * 2, src.width - 1), x1 = std::min(x * 2 + 1, src.width - 1);
+                for (int c = 0; c < channels; c++) {
+                    int sum = src.pixels[(static_cast<size_t>(y0) * src.width + x0) * channels + c]
+                            + src.pixels[(static_cast<size_t>(y0) * src.width + x1) * channels + c]
+                            + src.pixels[(static_cast<size_t>(y1) * src.width + x0) * channels + c]
+                            + src.pixels[(static_cast<size_t>(y1) * src.width + x1) * channels + c];
+                    dst.pixels[(static_cast<size_t>(y) * dst.width + x) * channels + c] = static_cast<unsigned char>((sum + 2) / 4);
+                }
+            }
+        }
+        out.push_back(std::move(dst));
     }
+}
 
-    // Calculate the cross product of s and edge1
-    Vec3 q = { s.y * edge1.z - s.z * edge1.y,
-               s.z * edge1.x - s.x * edge1.z,
-               s.x * edge1.y - s.y * edge1.x };
-
-    // Calculate the barycentric coordinate v
-    float v = f * (rayDir.x * q.x + rayDir.y * q.y + rayDir.z * q.z);
-
-    // Check if the intersection point is outside the triangle
-    if (v < 0.0f || u + v > 1.0f) {
-        return false;
+} // namespace
+
+// Everything a load produces before it needs GL. Filled by loadCpu (on a
+// streamer worker when there is one), then consumed by uploadStep on the GL
+// thread, which moves it into the model once the last piece is on the GPU.
+struct ObjModel::LoadData {
+    std::string filename;
+    std::string basepath;
+    int lodLevels = 1;
+    bool useVbo = false; // decided on the GL thread, where GLEW can be asked
+    bool ok = false;
+
+    MeshData mesh;
+    std::vector<Face> faces;
+    HeightGrid heightGrid;
+    Bvh bvh;
+
+    // Shared materials, acquired by the worker; handed to the model at the end
+    std::vector<MaterialResource*> materials;
+
+    // Textures this load is the first user of. The worker decodes the file
+    // and builds the whole mip chain, so the GL thread only copies rows (no
+    // glGenerateMipmap)
+    struct Image {
+        TextureResource* resource = nullptr;
+        std::string path;
+        int channels = 0;
+        std::vector<MipLevel> levels; // empty when there is no texture
+        size_t level = 0;             // upload progress
+        int rowsUploaded = 0;
+        GLuint texture = 0;
+    };
+    std::vector<Image> images;
+    size_t nextImage = 0;
+
+    // Indexed VBO path: vertex and index data ready to copy, plus where
+    // each LOD's indices start
+    IndexedMesh indexedMesh;
+    std::vector<MeshLod> lodChain;
+    std::vector<unsigned char> indexData;
+    std::vector<size_t> lodOffset;
+    GLenum indexType = GL_UNSIGNED_INT;
+    size_t indexSize = sizeof(GLuint);
+    GLuint vbo = 0, ibo = 0;
+    size_t vertexBytesUploaded = 0, indexBytesUploaded = 0;
+
+    ~LoadData() {
+        // A load dropped part way (streamer shut down) cleans up here. The
+        // streamer only drops jobs on the GL thread.
+        for (auto& image : images)
+            if (image.texture) GlState::get().deleteTextures(1, &image.texture);
+        for (MaterialResource* material : materials) ResourceManager::get().release(material);
+        if (vbo) glDeleteBuffers(1, &vbo);
+        if (ibo) glDeleteBuffers(1, &ibo);
     }
+};
 
-    // Calculate the distance `t`
-    float t = f * (edge2.x * q.x + edge2.y * q.y + edge2.z * q.z);
+ObjModel::ObjModel(const std::string& filename, int lodLevels, AssetStreamer* streamer)
+    : displayList(0), lodLevels(lodLevels) {
+    LOG_INFO("Trying to load OBJ: " << filename);
 
-    // Check if the intersection is in front of the ray's origin
-    if (t > EPSILON) {
-        outT = t;
-        return true;
-    }
-
-    return false;
-}
+    size_t lastSlash = filename.find_last_of("/\\");
+    basepath = (lastSlash == std::string::npos) ? "" : filename.substr(0, lastSlash + 1);
 
-void ObjModel::getMinMaxY(float& minY, float& maxY) const {
-    // If the vector of vertices is empty, there is no data to check
-    if (temp_vertices.empty()) {
-        minY = 0.0f;
-        maxY = 0.0f;
+    auto data = std::make_shared<LoadData>();
+    data->filename = filename;
+    data->basepath = basepath;
+    data->lodLevels = lodLevels;
+    // VAOs need GL 3.0 or ARB_vertex_array_object; older drivers keep display lists
+    data->useVbo = !usingDisplayLists() && (GLEW_VERSION_3_0 || GLEW_ARB_vertex_array_object);
+
+    if (!streamer) {
+        loadCpu(*data);
+        size_t bytes = 0;
+        while (!uploadStep(*data, bytes, nullptr)) {}
         return;
     }
 
-    // Initialize minY and maxY with the first vertex's y-coordinate
-    minY = temp_vertices[0].y;
-    maxY = temp_vertices[0].y;
-
-    // Iterate through the remaining vertices to find the true min and max
-    for (size_t i = 1; i < temp_vertices.size(); ++i) {
-        minY = std::min(minY, temp_vertices[i].y);
-        maxY = std::max(maxY, temp_vertices[i].y);
-    }
+    // Drawn as the fallback cube until the real mesh is resident
+    createFallbackCube();
+    streamer->submit([data] { loadCpu(*data); },
+                     [this, data, streamer](size_t& bytes) { return uploadStep(*data, bytes, streamer); });
 }
 
-// Parse a vertex string "v/vt/vn"
-void ObjModel::parseVertexString(const std::string& vertStr, int& v_idx, int& vt_idx, int& vn_idx) {
-    std::stringstream vss(vertStr);
-    std::string token;
-    v_idx = vt_idx = vn_idx = -1;
-
-    if (std::getline(vss, token, '/'))
-        if (!token.empty()) v_idx = std::stoi(token) - 1;
-
-    if (std::getline(vss, token, '/'))
-        if (!token.empty()) vt_idx = std::stoi(token) - 1;
-
-    if (std::getline(vss, token, '/'))
-        if (!token.empty()) vn_idx = std::stoi(token) - 1;
+ObjModel::~ObjModel()
+{
+    if (displayList) {
+        glDeleteLists(displayList, 1);
+        displayList = 0;
+    }
+    for (const auto& range : listRanges) glDeleteLists(range.list, 1);
+    if (vao) GlState::get().deleteVertexArrays(1, &vao);
+    if (vbo) glDeleteBuffers(1, &vbo);
+    if (ibo) glDeleteBuffers(1, &ibo);
+    vao = vbo = ibo = 0;
+    // Textures go once no other model uses them
+    for (MaterialResource* material : materials) ResourceManager::get().release(material);
 }
 
-// ===============================
-// Texture Loading
-// ===============================
-void ObjModel::loadTexture(const std::string& textureFilename, GLuint& textureID) {
-    if (textureFilename.empty()) {
-        textureID = 0;
+// Parsing, image decoding, spatial indices, vertex dedup and LODs: nothing here touches GL
+void ObjModel::loadCpu(LoadData& data) {
+    PROFILE_SCOPE("ObjModel::loadCpu");
+    // Baked .fmesh next to the OBJ if it is up to date, otherwise parse the
+    // OBJ/MTL text (normals already generated either way)
+    MeshData& mesh = data.mesh;
+    if (!loadMesh(data.filename, mesh)) {
+        LOG_ERROR("Failed to load OBJ: " << data.filename);
         return;
     }
 
-    std::string fullPath = basepath + textureFilename;
-
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // Textures already loaded (or loading) for another model are shared,
+    // only the first user decodes and uploads
+    for (const auto& desc : mesh.materials) {
+        const std::string texturePath = desc.texturePath.empty() ? "" : data.basepath + desc.texturePath;
+        bool mustLoad = false;
+        MaterialResource* material = ResourceManager::get().acquireMaterial(desc.name, texturePath, mustLoad);
+        data.materials.push_back(material);
+        if (!mustLoad) continue;
+
+        LoadData::Image image;
+        image.resource = material->texture;
+        image.path = texturePath;
+        int width, height;
+        unsigned char* pixels = stbi_load(image.path.c_str(), &width, &height, &image.channels, 0);
+        if (pixels) {
+            buildMipChain(pixels, width, height, image.channels, image.levels);
+            stbi_image_free(pixels);
+            data.images.push_back(std::move(image));
+        } else {
+            LOG_WARN("Failed to load texture: " << image.path);
+        }
+    }
 
-    int width, height, nrChannels;
-    unsigned char* data = stbi_load(fullPath.c_str(), &width, &height, &nrChannels, 0);
+    LOG_INFO("Successfully loaded model with " << mesh.vertices.size()
+             << " vertices and " << mesh.materialFaces.size() << " materials.");
+
+    // Flat face list for spatial queries, indexed once by the height grid
+    for (const auto& group : mesh.materialFaces)
+        data.faces.insert(data.faces.end(), group.second.begin(), group.second.end());
+    data.heightGrid.build(mesh.vertices, data.faces);
+    data.bvh.build(mesh.vertices, data.faces);
+
+    if (data.useVbo) {
+        buildIndexedMesh(mesh.vertices, mesh.normals, mesh.texcoords, mesh.materialFaces, data.indexedMesh);
+
+        // Every level shares the vertex buffer, only the indices differ
+        auto lodStart = std::chrono::steady_clock::now();
+        buildLodChain(data.indexedMesh, data.lodLevels, 0.5f, data.lodChain);
+        if (data.lodChain.size() > 1) {
+            double lodMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - lodStart).count();
+            std::string counts;
+            for (size_t i = 0; i < data.lodChain.size(); i++)
+                counts += (i ? " / " : "") + std::to_string(data.lodChain[i].indices.size() / 3);
+            LOG_INFO("Built " << data.lodChain.size() << " LODs (" << counts << " triangles) in " << lodMs << " ms");
+        }
 
-    if (data) {
-        GLenum format = (nrChannels == 1) ? GL_RED : (nrChannels == 3 ? GL_RGB : GL_RGBA);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        std::cout << "Texture loaded successfully: " << fullPath << std::endl;
-    } else {
-        std::cerr << "Failed to load texture: " << fullPath << std::endl;
-        textureID = 0;
+        // All levels go into one index buffer, back to back
+        std::vector<uint32_t> allIndices;
+        for (const auto& lod : data.lodChain) {
+            data.lodOffset.push_back(allIndices.size());
+            allIndices.insert(allIndices.end(), lod.indices.begin(), lod.indices.end());
+        }
+        if (data.indexedMesh.fitsIn16Bit()) {
+            std::vector<GLushort> shortIndices(allIndices.begin(), allIndices.end());
+            data.indexType = GL_UNSIGNED_SHORT;
+            data.indexSize = sizeof(GLushort);
+            data.indexData.resize(shortIndices.size() * data.indexSize);
+            std::memcpy(data.indexData.data(), shortIndices.data(), data.indexData.size());
+        } else {
+            data.indexType = GL_UNSIGNED_INT;
+            data.indexSize = sizeof(GLuint);
+            data.indexData.resize(allIndices.size() * data.indexSize);
+            std::memcpy(data.indexData.data(), allIndices.data(), data.indexData.size());
+        }
     }
-    stbi_image_free(data);
+    data.ok = true;
 }
 
-// ===============================
-// MTL Loader
-// ===============================
-void ObjModel::loadMtl(const std::string& mtlFilename) {
-    std::string fullPath = basepath + mtlFilename;
-    std::ifstream file(fullPath);
-    if (!file.is_open()) {
-        std::cerr << "Failed to load MTL: " << fullPath << std::endl;
-        return;
+// One bounded piece of GL work: a slice of a texture, a chunk of the vertex
+// or index buffer, or the final hand-over. Returns true when the model is done.
+bool ObjModel::uploadStep(LoadData& data, size_t& bytes, AssetStreamer* streamer) {
+    if (!data.ok) {
+        if (!displayList) createFallbackCube();
+        loaded.store(true, std::memory_order_release);
+        return true;
     }
 
-    std::string line;
-    Material currentMaterial;
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string prefix;
-        iss >> prefix;
-
-        if (prefix == "newmtl") {
-            if (!currentMaterial.name.empty()) materials.push_back(currentMaterial);
-            iss >> currentMaterial.name;
-            currentMaterial.textureID = 0;
-        } else if (prefix == "map_Kd") {
-            std::string texturePath;
-            iss >> texturePath;
-            loadTexture(texturePath, currentMaterial.textureID);
+    // Textures first, a slice of rows at a time
+    while (data.nextImage < data.images.size()) {
+        LoadData::Image& image = data.images[data.nextImage];
+        if (image.level == image.levels.size()) {
+            data.nextImage++;
+            continue;
         }
+        uploadTextureSlice(data, bytes, streamer);
+        return false;
     }
-    if (!currentMaterial.name.empty()) materials.push_back(currentMaterial);
-}
-
-// ===============================
-// Normal Computation (Fix)
-// ===============================
-void ObjModel::computeVertexNormals(std::vector<Face>& faces) {
-    std::vector<Vec3> vertexNormals(temp_vertices.size(), Vec3(0,0,0));
-
-    for (auto& face : faces) {
-        const Vec3& v0 = temp_vertices[face.v[0]];
-        const Vec3& v1 = temp_vertices[face.v[1]];
-        const Vec3& v2 = temp_vertices[face.v[2]];
 
-        Vec3 edge1 = v1 - v0;
-        Vec3 edge2 = v2 - v0;
-        Vec3 normal = edge1.cross(edge2);
-        normal.normalize();
-
-        for (int i = 0; i < 3; i++) {
-            vertexNormals[face.v[i]] = vertexNormals[face.v[i]] + normal;
-            face.vn[i] = face.v[i]; // assign normal index = vertex index
+    if (data.useVbo && !data.indexData.empty()) {
+        // Index buffer binds would otherwise land in the last VAO drawn
+        GlState::get().bindVertexArray(0);
+        const size_t vertexBytes = data.indexedMesh.vertices.size() * sizeof(MeshVertex);
+        if (!data.vbo) {
+            // Storage first, contents in chunks below
+            glGenBuffers(1, &data.vbo);
+            glBindBuffer(GL_ARRAY_BUFFER, data.vbo);
+            glBufferData(GL_ARRAY_BUFFER, vertexBytes, nullptr, GL_STATIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glGenBuffers(1, &data.ibo);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.ibo);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.indexData.size(), nullptr, GL_STATIC_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        }
+        if (data.vertexBytesUploaded < vertexBytes) {
+            size_t chunk = std::min(AssetStreamer::CHUNK_BYTES, vertexBytes - data.vertexBytesUploaded);
+            glBindBuffer(GL_ARRAY_BUFFER, data.vbo);
+            glBufferSubData(GL_ARRAY_BUFFER, data.vertexBytesUploaded, chunk,
+                            reinterpret_cast<const unsigned char*>(data.indexedMesh.vertices.data()) + data.vertexBytesUploaded);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            data.vertexBytesUploaded += chunk;
+            bytes += chunk;
+            return false;
+        }
+        if (data.indexBytesUploaded < data.indexData.size()) {
+            size_t chunk = std::min(AssetStreamer::CHUNK_BYTES, data.indexData.size() - data.indexBytesUploaded);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.ibo);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, data.indexBytesUploaded, chunk,
+                            data.indexData.data() + data.indexBytesUploaded);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+            data.indexBytesUploaded += chunk;
+            bytes += chunk;
+            return false;
         }
     }
 
-    temp_normals.resize(temp_vertices.size());
-    for (size_t i = 0; i < vertexNormals.size(); i++){
-          Vec3 n=vertexNormals[i];
-    n.normalize();
-        temp_normals[i] = n;
-    }
-  
+    finishLoad(data);
+    return true;
 }
 
-// ===============================
-// OBJ Loader
-// ===============================
-ObjModel::ObjModel(const std::string& filename) : displayList(0) {
-    std::cout << "Trying to load OBJ: " << filename << std::endl;
-
-    size_t lastSlash = filename.find_last_of("/\\");
-    basepath = (lastSlash == std::string::npos) ? "" : filename.substr(0, lastSlash + 1);
-
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Failed to load OBJ: " << filename << std::endl;
-        createFallbackCube();
-        return;
+void ObjModel::uploadTextureSlice(LoadData& data, size_t& bytes, AssetStreamer* streamer) {
+    LoadData::Image& image = data.images[data.nextImage];
+    const GLenum format = (image.channels == 1) ? GL_RED : (image.channels == 3 ? GL_RGB : GL_RGBA);
+    if (!image.texture) {
+        // Storage for every level up front, contents a slice at a time
+        glGenTextures(1, &image.texture);
+        GlState::get().bindTexture(0, image.texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        for (size_t i = 0; i < image.levels.size(); i++)
+            glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i), format, image.levels[i].width, image.levels[i].height,
+                         0, format, GL_UNSIGNED_BYTE, nullptr);
+    } else {
+        GlState::get().bindTexture(0, image.texture);
     }
 
-    std::string line, mtlFile, currentMtlName;
-    std::map<std::string, std::vector<Face>> materialFaces;
-
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string prefix;
-        iss >> prefix;
-
-        if (prefix == "v") {
-            Vec3 v; iss >> v.x >> v.y >> v.z; temp_vertices.push_back(v);
-        } else if (prefix == "vn") {
-            Vec3 n; iss >> n.x >> n.y >> n.z; temp_normals.push_back(n);
-        } else if (prefix == "vt") {
-            Vec2 t; iss >> t.u >> t.v; temp_texcoords.push_back(t);
-        } else if (prefix == "mtllib") {
-            iss >> mtlFile; loadMtl(mtlFile);
-        } else if (prefix == "usemtl") {
-            iss >> currentMtlName;
-        } else if (prefix == "f") {
-            Face f;
-            for (int i = 0; i < 3; i++) {
-                std::string vertStr; iss >> vertStr;
-                int v_idx, vt_idx, vn_idx;
-                parseVertexString(vertStr, v_idx, vt_idx, vn_idx);
-                f.v[i]  = v_idx;
-                f.vt[i] = vt_idx;
-                f.vn[i] = vn_idx;
-            }
-            materialFaces[currentMtlName].push_back(f);
-        }
+    // Rows are tightly packed, whatever the width
+    MipLevel& level = image.levels[image.level];
+    const size_t rowBytes = static_cast<size_t>(level.width) * image.channels;
+    const unsigned char* src = level.pixels.data() + image.rowsUploaded * rowBytes;
+    const GLint levelIndex = static_cast<GLint>(image.level);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    int rows = level.height - image.rowsUploaded;
+    if (streamer) {
+        rows = std::min(rows, std::max(1, static_cast<int>(AssetStreamer::CHUNK_BYTES / rowBytes)));
+        streamer->uploadTextureRows(levelIndex, image.rowsUploaded, rows, level.width, format, image.channels, src);
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, levelIndex, 0, image.rowsUploaded, level.width, rows, format, GL_UNSIGNED_BYTE, src);
     }
-
-    std::cout << "Successfully loaded model with " << temp_vertices.size()
-              << " vertices and " << materialFaces.size() << " materials." << std::endl;
-
-    // ✅ Fix: compute normals if missing
-    for (auto& [mtlName, faces] : materialFaces) {
-        if (temp_normals.empty()) {
-            std::cout << "No normals in OBJ, computing smooth normals...\n";
-            computeVertexNormals(faces);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    image.rowsUploaded += rows;
+    bytes += rows * rowBytes;
+
+    if (image.rowsUploaded == level.height) {
+        std::vector<unsigned char>().swap(level.pixels);
+        image.rowsUploaded = 0;
+        if (++image.level == image.levels.size()) {
+            // Complete: every material using this file can bind it now
+            size_t textureBytes = 0;
+            for (const auto& mip : image.levels) textureBytes += static_cast<size_t>(mip.width) * mip.height * image.channels;
+            ResourceManager::get().textureUploaded(image.resource, image.texture, textureBytes);
+            image.texture = 0;
+            LOG_INFO("Texture loaded successfully: " << image.path);
         }
     }
-
-    setupBuffers(materialFaces);
 }
 
-ObjModel::~ObjModel()
-{
+// Last step, all at once so the rest of the game sees either the
+// placeholder or the finished model, never something in between
+void ObjModel::finishLoad(LoadData& data) {
+    materials = std::move(data.materials);
+    data.materials.clear();
+
+    temp_vertices = std::move(data.mesh.vertices);
+    temp_normals = std::move(data.mesh.normals);
+    temp_texcoords = std::move(data.mesh.texcoords);
+    temp_faces = std::move(data.faces);
+    heightGrid = std::move(data.heightGrid);
+    bvh = std::move(data.bvh);
+    boundsMin = data.mesh.boundsMin;
+    boundsMax = data.mesh.boundsMax;
+
+    // Placeholder cube, if this was a streamed load
     if (displayList) {
         glDeleteLists(displayList, 1);
         displayList = 0;
     }
+
+    if (!data.useVbo) {
+        setupDisplayList(data.mesh.materialFaces);
+    } else if (data.vbo) {
+        setupVertexArray(data);
+    }
+    loaded.store(true, std::memory_order_release);
 }
 
 // ===============================
 // Rendering
 // ===============================
-void ObjModel::setupBuffers(const std::map<std::string, std::vector<Face>>& materialFaces) {
-    displayList = glGenLists(1);
-    glNewList(displayList, GL_COMPILE);
+size_t ObjModel::gpuMeshBytes = 0;
+ObjModel::DrawStats ObjModel::drawStats;
+
+bool ObjModel::usingDisplayLists() {
+    static const bool enabled = [] {
+        const char* env = std::getenv("FALLAGA_DISPLAY_LISTS");
+        return env && std::strcmp(env, "0") != 0;
+    }();
+    return enabled;
+}
+
+const MaterialResource* ObjModel::findMaterial(const std::string& materialName) const {
+    // Interned ids, so this is one hash for the name and integer compares
+    const uint32_t id = ResourceManager::get().intern(materialName);
+    const MaterialResource* found = nullptr;
+    for (const MaterialResource* material : materials)
+        if (material->id == id) found = material;
+    return found;
+}
 
-    glShadeModel(GL_SMOOTH); // ✅ enable smooth shading
+// Takes over the filled buffers from `data` and records them in a VAO
+void ObjModel::setupVertexArray(LoadData& data) {
+    vbo = data.vbo;
+    ibo = data.ibo;
+    indexType = data.indexType;
+    data.vbo = data.ibo = 0;
+
+    glGenVertexArrays(1, &vao);
+    GlState::get().bindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+    // Fixed-function arrays; in a compatibility context they are VAO state
+    const GLsizei stride = sizeof(MeshVertex);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, stride, reinterpret_cast<const void*>(offsetof(MeshVertex, px)));
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glNormalPointer(GL_FLOAT, stride, reinterpret_cast<const void*>(offsetof(MeshVertex, nx)));
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glTexCoordPointer(2, GL_FLOAT, stride, reinterpret_cast<const void*>(offsetof(MeshVertex, u)));
+
+    // The element buffer binding is recorded in the VAO as well
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+
+    GlState::get().bindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    for (size_t i = 0; i < data.lodChain.size(); i++) {
+        LodLevel level;
+        level.triangleCount = data.lodChain[i].indices.size() / 3;
+        for (const auto& sub : data.lodChain[i].subMeshes) {
+            DrawRange range;
+            range.material = findMaterial(sub.material);
+            range.indexCount = static_cast<GLsizei>(sub.indexCount);
+            range.byteOffset = (data.lodOffset[i] + sub.firstIndex) * data.indexSize;
+            level.ranges.push_back(range);
+        }
+        lods.push_back(level);
+    }
+
+    const size_t bytes = data.vertexBytesUploaded + data.indexBytesUploaded;
+    gpuMeshBytes += bytes;
+    LOG_INFO("Uploaded " << data.indexedMesh.vertices.size() << " unique vertices, "
+             << data.indexData.size() / data.indexSize
+             << (indexType == GL_UNSIGNED_SHORT ? " 16-bit" : " 32-bit") << " indices in "
+             << lods[0].ranges.size() << " ranges x " << lods.size() << " LODs (" << bytes / 1024 << " KB)");
+}
 
+// One list per material. Textures are bound at draw time rather than
+// recorded in the list, since a shared texture may still be streaming in.
+void ObjModel::setupDisplayList(const std::map<std::string, std::vector<Face>>& materialFaces) {
     for (const auto& pair : materialFaces) {
         const auto& faces = pair.second;
 
-        GLuint currentTextureID = 0;
-        for (const auto& mtl : materials)
-            if (mtl.name == pair.first) currentTextureID = mtl.textureID;
-
-        if (currentTextureID) {
-            glEnable(GL_TEXTURE_2D);
-            glBindTexture(GL_TEXTURE_2D, currentTextureID);
-        } else {
-            glDisable(GL_TEXTURE_2D);
-        }
+        ListRange range;
+        range.material = findMaterial(pair.first);
+        range.list = glGenLists(1);
+        listRanges.push_back(range);
+        gpuMeshBytes += faces.size() * 3 * sizeof(MeshVertex);
+        displayListTriangles += faces.size();
 
+        glNewList(range.list, GL_COMPILE);
         glBegin(GL_TRIANGLES);
         for (const auto& face : faces) {
             for (int i = 0; i < 3; i++) {
@@ -322,16 +509,15 @@ void ObjModel::setupBuffers(const std::map<std::string, std::vector<Face>>& mate
             }
         }
         glEnd();
+        glEndList();
     }
-
-    glDisable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    glEndList();
 }
 
 void ObjModel::createFallbackCube()
 {
+    boundsMin = Vec3(-1.0f, -1.0f, -1.0f);
+    boundsMax = Vec3(1.0f, 1.0f, 1.0f);
+
     displayList = glGenLists(1);
     glNewList(displayList, GL_COMPILE);
 
@@ -373,36 +559,213 @@ void ObjModel::createFallbackCube()
     glVertex3f( 1.0f, -1.0f,  1.0f);
     glVertex3f(-1.0f, -1.0f,  1.0f);
     glEnd();
+    // Streamed models draw this until they load, so the face colours must
+    // not leak into whatever is drawn next (GL_COLOR_MATERIAL copies them
+    // into the material too). White is what the rest of the scene assumes.
+    glColor3f(1.0f, 1.0f, 1.0f);
 
     glEndList();
 }
 
-void ObjModel::render() const {
-    if (displayList) glCallList(displayList);
+namespace {
+
+void bindMaterialTexture(const MaterialResource* material) {
+    GlState& state = GlState::get();
+    GLuint texture = material ? material->textureName() : 0;
+    if (texture) {
+        state.enable(GL_TEXTURE_2D);
+        state.bindTexture(0, texture);
+    } else {
+        state.disable(GL_TEXTURE_2D);
+    }
+}
+
+} // namespace
+
+// Fixed-function draws; whatever is bound afterwards stays bound (see
+// GlState), so each one sets all the state it depends on
+void ObjModel::render(int lod) const {
+    GlState& state = GlState::get();
+    state.useProgram(0);
+    if (vao) {
+        lod = std::min(std::max(lod, 0), getLodCount() - 1);
+        state.shadeModel(GL_SMOOTH);
+        state.bindVertexArray(vao);
+        for (const auto& range : lods[lod].ranges) {
+            bindMaterialTexture(range.material);
+            glDrawElements(GL_TRIANGLES, range.indexCount, indexType,
+                           reinterpret_cast<const void*>(range.byteOffset));
+            drawStats.drawCalls++;
+            drawStats.triangles += range.indexCount / 3;
+        }
+        return;
+    }
+    if (!listRanges.empty()) {
+        state.shadeModel(GL_SMOOTH);
+        for (const auto& range : listRanges) {
+            bindMaterialTexture(range.material);
+            glCallList(range.list);
+        }
+        drawStats.drawCalls += listRanges.size();
+        drawStats.triangles += displayListTriangles;
+        return;
+    }
+    if (displayList) {
+        state.disable(GL_TEXTURE_2D);
+        glCallList(displayList);
+        drawStats.drawCalls++;
+    }
+}
+
+int ObjModel::getRangeCount(int lod) const {
+    if (!vao) return 0;
+    return static_cast<int>(lods[std::min(std::max(lod, 0), getLodCount() - 1)].ranges.size());
+}
+
+GLuint ObjModel::getRangeTexture(int lod, int range) const {
+    const DrawRange& r = lods[std::min(std::max(lod, 0), getLodCount() - 1)].ranges[range];
+    return r.material ? r.material->textureName() : 0;
+}
+
+bool ObjModel::renderInstanced(GLuint instanceBuffer, GLsizei instanceCount, GLuint positionScaleAttrib,
+                               GLuint rotationAttrib, GLint useTextureLocation, int lod, int range) const {
+    if (!vao) return false;
+    lod = std::min(std::max(lod, 0), getLodCount() - 1);
+
+    GlState& state = GlState::get();
+    state.bindVertexArray(vao);
+
+    // The instance attributes become part of this VAO's state as well, but
+    // are disabled again below so plain render() never sees them
+    const GLsizei stride = sizeof(InstanceData);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glEnableVertexAttribArray(positionScaleAttrib);
+    glVertexAttribPointer(positionScaleAttrib, 4, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<const void*>(offsetof(InstanceData, x)));
+    glVertexAttribDivisor(positionScaleAttrib, 1);
+    glEnableVertexAttribArray(rotationAttrib);
+    glVertexAttribPointer(rotationAttrib, 1, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<const void*>(offsetof(InstanceData, yaw)));
+    glVertexAttribDivisor(rotationAttrib, 1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    const std::vector<DrawRange>& ranges = lods[lod].ranges;
+    const size_t first = range < 0 ? 0 : static_cast<size_t>(range);
+    const size_t last = range < 0 ? ranges.size() : first + 1;
+    for (size_t i = first; i < last; i++) {
+        GLuint texture = ranges[i].material ? ranges[i].material->textureName() : 0;
+        glUniform1i(useTextureLocation, texture ? 1 : 0);
+        // Untextured ranges bind 0 as well: with useTexture off the shader
+        // never samples, but a texture left bound still costs software
+        // rasterizers (llvmpipe) the sampling setup, about 15% of a frame
+        state.bindTexture(0, texture);
+        glDrawElementsInstanced(GL_TRIANGLES, ranges[i].indexCount, indexType,
+                                reinterpret_cast<const void*>(ranges[i].byteOffset), instanceCount);
+        drawStats.drawCalls++;
+        drawStats.triangles += ranges[i].indexCount / 3 * static_cast<size_t>(instanceCount);
+    }
+
+    glDisableVertexAttribArray(positionScaleAttrib);
+    glDisableVertexAttribArray(rotationAttrib);
+    return true;
+}
+
+// ===============================
+// Level of Detail
+// ===============================
+namespace {
+
+// Projected size (bounding radius over the half-height of the view) below
+// which level i + 1 takes over from level i
+const float LOD_SCREEN_SIZE[] = { 0.4f, 0.2f, 0.1f, 0.05f, 0.025f };
+const int LOD_THRESHOLDS = sizeof(LOD_SCREEN_SIZE) / sizeof(LOD_SCREEN_SIZE[0]);
+// Fraction past a boundary before the level changes
+const float LOD_HYSTERESIS = 0.15f;
+
+} // namespace
+
+bool ObjModel::lodDisabled() {
+    static const bool disabled = [] {
+        const char* env = std::getenv("FALLAGA_NO_LOD");
+        return env && std::strcmp(env, "0") != 0;
+    }();
+    return disabled;
+}
+
+size_t ObjModel::getLodTriangles(int lod) const {
+    if (lods.empty()) return displayListTriangles;
+    lod = std::min(std::max(lod, 0), getLodCount() - 1);
+    return lods[lod].triangleCount;
+}
+
+int ObjModel::selectLod(float screenSize, int current) const {
+    const int count = std::min(getLodCount(), LOD_THRESHOLDS + 1);
+    if (count <= 1 || lodDisabled()) return 0;
+
+    if (current < 0 || current >= count) {
+        int level = 0;
+        while (level + 1 < count && screenSize < LOD_SCREEN_SIZE[level]) level++;
+        return level;
+    }
+    int level = current;
+    while (level + 1 < count && screenSize < LOD_SCREEN_SIZE[level] * (1.0f - LOD_HYSTERESIS)) level++;
+    while (level > 0 && screenSize > LOD_SCREEN_SIZE[level - 1] * (1.0f + LOD_HYSTERESIS)) level--;
+    return level;
+}
+
+void ObjModel::getBoundingSphere(Vec3& center, float& radius) const {
+    center = (boundsMin + boundsMax) * 0.5f;
+    radius = (boundsMax - boundsMin).length() * 0.5f;
 }
 
 // ===============================
 // Height Query
 // ===============================
+// Rays start just above the highest vertex, so any mesh height works
+float ObjModel::heightRayStart() const {
+    return boundsMax.y + 1.0f;
+}
+
 float ObjModel::getHeightAt(float x, float z) const {
-    float maxHeight = -std::numeric_limits<float>::max();
-    Vec3 rayOrigin = { x, 1000.0f, z };
-    Vec3 rayDir = { 0.0f, -1.0f, 0.0f };
+    PROFILE_SCOPE("ObjModel::getHeightAt");
+    if (!isLoaded()) return 0.0f;
+    if (heightGrid.empty()) return getHeightAtBruteForce(x, z);
+
+    float height = 0.0f;
+    heightGrid.heightAt(x, z, heightRayStart(), height);
+    LOG_TRACE("Height at (" << x << ", " << z << ") = " << height);
+    return height;
+}
 
-    for (const auto& face : temp_faces) {
-        if (face.v[0] == -1 || face.v[1] == -1 || face.v[2] == -1) continue;
+void ObjModel::getHeightsAt(const std::vector<Vec3>& points, std::vector<float>& out) const {
+    PROFILE_SCOPE("ObjModel::getHeightsAt");
+    if (!isLoaded()) {
+        out.assign(points.size(), 0.0f);
+        return;
+    }
+    if (heightGrid.empty()) {
+        out.resize(points.size());
+        for (size_t i = 0; i < points.size(); i++) out[i] = getHeightAtBruteForce(points[i].x, points[i].z);
+        return;
+    }
+    heightGrid.heightsAt(points, heightRayStart(), 0.0f, out);
+}
 
-        const Vec3& v0 = temp_vertices[face.v[0]];
-        const Vec3& v1 = temp_vertices[face.v[1]];
-        const Vec3& v2 = temp_vertices[face.v[2]];
+// Reference path: scans every triangle instead of one grid cell.
+// Kept to validate the grid against.
+float ObjModel::getHeightAtBruteForce(float x, float z) const {
+    Vec3 rayOrigin = { x, heightRayStart(), z };
+    Vec3 rayDir = { 0.0f, -1.0f, 0.0f };
 
-        float t = 0.0f;
-        if (rayTriangleIntersect(rayOrigin, rayDir, v0, v1, v2, t)) {
-            std::cout << "Intersection at t = " << t << std::endl;
-            float intersectionY = rayOrigin.y + t * rayDir.y;
-            if (intersectionY > maxHeight) maxHeight = intersectionY;
-        }
+    // The highest hit is the nearest one along the downward ray
+    const TriangleSoA& triangles = bvh.getTriangles();
+    float t = 0.0f;
+    size_t index = 0;
+    float height = 0.0f;
+    if (soaClosestHit(triangles, 0, triangles.size(), rayOrigin, rayDir,
+                      std::numeric_limits<float>::max(), t, index)) {
+        height = rayOrigin.y + t * rayDir.y;
     }
-      std::cout << "Height at (" << x << ", " << z << ") = " << maxHeight << std::endl;
-    return (maxHeight == -std::numeric_limits<float>::max()) ? 0.0f : maxHeight;
+    LOG_TRACE("Height at (" << x << ", " << z << ") = " << height);
+    return height;
 }
@@ -1,64 +1,160 @@
 #pragma once
+#include <atomic>
 #include <string>
 #include <vector>
 #include <map>
 #include <GL/glew.h>
 #include "Vec3.h"
+#include "MeshData.h"
+#include "HeightGrid.h"
+#include "Bvh.h"
+#include "IndexedMesh.h"
+#include "MeshSimplifier.h"
+#include "ResourceManager.h"
 
-// Simplified structs for reading OBJ files
-struct Vec2 {
-    float u, v;
-    Vec2(float u = 0.0f, float v = 0.0f) : u(u), v(v) {}
-};
+class AssetStreamer;
 
-struct Face {
-    int v[3];   // Vertex indices
-    int vt[3];  // Texture coordinate indices
-    int vn[3];  // Normal indices
+// One level of a texture's mip chain, tightly packed rows
+struct MipLevel {
+    int width, height;
+    std::vector<unsigned char> pixels;
 };
 
-// New Material structure to hold properties from the MTL file
-struct Material {
-    std::string name;
-    GLuint textureID = 0; // OpenGL texture ID
-};
 
 class ObjModel {
 public:
-    ObjModel(const std::string& filename);
+    // lodLevels is how many detail levels to build at load (1 = full mesh only).
+    // With a streamer the file is loaded in the background and the model
+    // draws as the fallback cube until isLoaded(); without one this blocks.
+    ObjModel(const std::string& filename, int lodLevels = 4, AssetStreamer* streamer = nullptr);
     ~ObjModel();
 
-    void render() const;
+    // True once the mesh (or, after a failed load, the fallback cube) is final
+    bool isLoaded() const { return loaded.load(std::memory_order_acquire); }
+
+    void render(int lod = 0) const;
+    // Draws `instanceCount` copies with per-instance attributes read from
+    // instanceBuffer (InstanceData layout) while the caller's shader is bound;
+    // every material range of the level, or just `range`. Returns false when
+    // the model has no VAO to draw instanced from.
+    bool renderInstanced(GLuint instanceBuffer, GLsizei instanceCount, GLuint positionScaleAttrib,
+                         GLuint rotationAttrib, GLint useTextureLocation, int lod = 0, int range = -1) const;
+    // Material ranges of a level on the VAO path (0 without a VAO), and the
+    // texture each one draws with, for sorting draws by state
+    int getRangeCount(int lod) const;
+    GLuint getRangeTexture(int lod, int range) const;
+    GLuint getVertexArray() const { return vao; }
+
+    // Level of detail. Level 0 is the full mesh; each further level has about
+    // half the triangles of the one before.
+    int getLodCount() const { return lods.empty() ? 1 : static_cast<int>(lods.size()); }
+    size_t getLodTriangles(int lod) const;
+    // Picks a level from the model's projected size (Camera::screenSize of its
+    // bounding sphere). `current` is last frame's level, or -1; a level only
+    // changes once the size is clearly past the boundary, so it can't flicker.
+    int selectLod(float screenSize, int current) const;
+    // FALLAGA_NO_LOD=1 always draws level 0, for comparisons
+    static bool lodDisabled();
+    void getBoundingSphere(Vec3& center, float& radius) const;
     void getMinMaxY(float& minY, float& maxY) const;
-    bool rayTriangleIntersect(const Vec3& rayOrigin, const Vec3& rayDir,
+    void getBounds(Vec3& outMin, Vec3& outMax) const { outMin = boundsMin; outMax = boundsMax; }
+    static bool rayTriangleIntersect(const Vec3& rayOrigin, const Vec3& rayDir,
                           const Vec3& v0, const Vec3& v1, const Vec3& v2,
-                          float& outT) const;
+                          float& outT);
     // Method to get the height of the terrain at a given (x, z) coordinate
     float getHeightAt(float x, float z) const;
+    // Batched height query; points are read as (x, z), misses return 0
+    void getHeightsAt(const std::vector<Vec3>& points, std::vector<float>& out) const;
+    float getHeightAtBruteForce(float x, float z) const;
+    // General ray casts in model space, answered by the SAH BVH
+    bool raycast(const Ray& ray, RayHit& out) const { return isLoaded() && bvh.closestHit(ray, out); }
+    bool occluded(const Ray& ray) const { return isLoaded() && bvh.anyHit(ray); }
+    const Bvh& getBvh() const { return bvh; }
+
+    // FALLAGA_DISPLAY_LISTS=1 renders through the old display lists instead of VBOs
+    static bool usingDisplayLists();
+    // Bytes of mesh data handed to the GPU by every model so far
+    // (for display lists this is an estimate: 32 bytes per submitted corner)
+    static size_t getGpuMeshBytes() { return gpuMeshBytes; }
+    // Draw calls and triangles submitted by every model since the last
+    // reset (GL thread only)
+    struct DrawStats {
+        size_t drawCalls = 0;
+        size_t triangles = 0;
+    };
+    static const DrawStats& getDrawStats() { return drawStats; }
+    static void resetDrawStats() { drawStats = DrawStats(); }
+    // For geometry drawn outside ObjModel (the CDLOD ground)
+    static void addDrawStats(size_t drawCalls, size_t triangles) {
+        drawStats.drawCalls += drawCalls;
+        drawStats.triangles += triangles;
+    }
+    // Texture of the first material, 0 if it has none or it is still loading
+    GLuint getTextureName() const { return materials.empty() ? 0 : materials[0]->textureName(); }
    void computeVertexNormals(std::vector<Face>& faces);
     std::vector<Vec3> temp_vertices;
     std::vector<Vec3> temp_normals;
     std::vector<Vec2> temp_texcoords;
     
-    // Store faces temporarily, but now they are grouped by material in the constructor
-    std::vector<Face> temp_faces;  // New function to compute normals if missing
+    // Every face of every material, used by the spatial queries
+    std::vector<Face> temp_faces;
 private:
-    // This function now needs to accept the map of faces to materials
-    void setupBuffers(const std::map<std::string, std::vector<Face>>& materialFaces);
+    // Loading is split so the CPU half can run on a worker thread
+    struct LoadData;
+    static void loadCpu(LoadData& data);
+    bool uploadStep(LoadData& data, size_t& bytes, AssetStreamer* streamer);
+    static void uploadTextureSlice(LoadData& data, size_t& bytes, AssetStreamer* streamer);
+    void finishLoad(LoadData& data);
+    void setupDisplayList(const std::map<std::string, std::vector<Face>>& materialFaces);
+    void setupVertexArray(LoadData& data);
+    const MaterialResource* findMaterial(const std::string& materialName) const;
     void createFallbackCube();
 
     // Data read from the OBJ file
    
     
-    // Data structures for materials and textures
-    std::vector<Material> materials;
+    // Shared through the ResourceManager, released in the destructor
+    std::vector<MaterialResource*> materials;
     std::string basepath; // Store the directory of the OBJ file
+    Vec3 boundsMin;
+    Vec3 boundsMax;
+
+    // XZ triangle grid behind getHeightAt
+    HeightGrid heightGrid;
+    Bvh bvh;
+    float heightRayStart() const;
 
-    // Functions for loading materials and textures
-    void loadTexture(const std::string& textureFilename, GLuint& textureID);
-    void loadMtl(const std::string& mtlFilename);
-    void parseVertexString(const std::string& vertStr, int& v_idx, int& vt_idx, int& vn_idx); // New helper function
    /// void computeVertexNormals(const std::vector<Face>& faces); // New function to compute normals if missing
-    // Legacy OpenGL Display List
+    // Legacy OpenGL Display List (also the fallback cube)
     GLuint displayList;
+    // Display-list path: one list per material
+    struct ListRange {
+        const MaterialResource* material;
+        GLuint list;
+    };
+    std::vector<ListRange> listRanges;
+
+    // Indexed VBO path: one glDrawElements per material through the VAO
+    struct DrawRange {
+        const MaterialResource* material;
+        GLsizei indexCount;
+        size_t byteOffset;
+    };
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint ibo = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    struct LodLevel {
+        std::vector<DrawRange> ranges;
+        size_t triangleCount;
+    };
+    std::vector<LodLevel> lods;
+    int lodLevels;
+    // Set last, with release, once the mesh is in place: queries from the
+    // simulation thread treat the model as empty until then
+    std::atomic<bool> loaded{false};
+    size_t displayListTriangles = 0;
+
+    static size_t gpuMeshBytes;
+    static DrawStats drawStats;
 };
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#ifdef FALLAGA_HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#include "OffscreenContext.h"
+#include "Log.h"
+
+OffscreenContext::~OffscreenContext() {
+    if (framebuffer) {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(2, renderbuffers);
+    }
+#ifdef FALLAGA_HAVE_EGL
+    if (context) {
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(display, context);
+    }
+    if (display) eglTerminate(display);
+#endif
+    if (window) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
+}
+
+bool OffscreenContext::create(int width, int height) {
+    if (createEgl()) {
+        api = "egl";
+    } else if (createHiddenWindow(width, height)) {
+        api = "glfw";
+    } else {
+        LOG_ERROR("Could not create an offscreen OpenGL context");
+        return false;
+    }
+
+    glewExperimental = GL_TRUE;
+    GLenum status = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // Without an X display GLEW still loads every GL entry point before
+    // failing to set up GLX, which EGL doesn't need
+    if (status == GLEW_ERROR_NO_GLX_DISPLAY) status = GLEW_OK;
+#endif
+    if (status != GLEW_OK) {
+        LOG_ERROR("Failed to initialize GLEW: " << glewGetErrorString(status));
+        return false;
+    }
+    if (!GLEW_VERSION_3_0 && !GLEW_ARB_framebuffer_object) {
+        LOG_ERROR("Offscreen rendering needs framebuffer objects");
+        return false;
+    }
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        LOG_ERROR("Offscreen framebuffer is incomplete");
+        return false;
+    }
+    glViewport(0, 0, width, height);
+    return true;
+}
+
+bool OffscreenContext::createEgl() {
+#ifdef FALLAGA_HAVE_EGL
+    EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+    auto getPlatformDisplay =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay) eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (eglDisplay == EGL_NO_DISPLAY) eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, nullptr, nullptr)) return false;
+    display = eglDisplay;
+    if (!eglBindAPI(EGL_OPENGL_API)) return false;
+
+    const EGLint attributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    EGLConfig config = nullptr;
+    EGLint configCount = 0;
+    eglChooseConfig(eglDisplay, attributes, &config, 1, &configCount);
+    // Compatibility profile: the renderer still uses fixed-function GL
+    EGLContext eglContext = eglCreateContext(eglDisplay, configCount ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, nullptr);
+    if (eglContext == EGL_NO_CONTEXT) return false;
+    context = eglContext;
+    return eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext);
+#else
+    return false;
+#endif
+}
+
+bool OffscreenContext::createHiddenWindow(int width, int height) {
+    if (!glfwInit()) return false;
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    window = glfwCreateWindow(width, height, "RDR2 Prototype (bench)", nullptr, nullptr);
+    if (!window) {
+        glfwTerminate();
+        return false;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+    return true;
+}
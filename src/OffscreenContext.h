@@ -0,0 +1,34 @@
+#pragma once
+#include <GL/glew.h>
+
+struct GLFWwindow;
+
+// A GL context with no window to show, rendering into its own framebuffer.
+// Surfaceless EGL where available (Mesa llvmpipe on CPU-only machines),
+// otherwise a hidden GLFW window. Used by --bench and fallaga_bench.
+class OffscreenContext {
+public:
+    OffscreenContext() = default;
+    ~OffscreenContext();
+    OffscreenContext(const OffscreenContext&) = delete;
+    OffscreenContext& operator=(const OffscreenContext&) = delete;
+
+    // Makes the context current, initializes GLEW and binds a width x height
+    // framebuffer. False (with a message) if any of that fails.
+    bool create(int width, int height);
+
+    // "egl" or "glfw"
+    const char* getApi() const { return api; }
+
+private:
+    bool createEgl();
+    bool createHiddenWindow(int width, int height);
+
+    // EGLDisplay and EGLContext, kept opaque so users don't need EGL headers
+    void* display = nullptr;
+    void* context = nullptr;
+    GLFWwindow* window = nullptr;
+    GLuint framebuffer = 0;
+    GLuint renderbuffers[2] = { 0, 0 };
+    const char* api = "";
+};
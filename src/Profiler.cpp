@@ -0,0 +1,328 @@
+#include <GL/glew.h>
+#include <GL/glut.h>
+#include "Profiler.h"
+#include "GlState.h"
+#include "Mat4.h"
+#include "Log.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Events kept per thread; older ones are overwritten
+const uint64_t RING_SIZE = 1 << 16;
+// Frames of samples behind each phase's percentiles
+const size_t HISTORY = 240;
+// A GPU query gets this many frames to finish before its slot is reused;
+// results that aren't ready by then are dropped rather than waited for
+const int GPU_FRAMES = 4;
+const size_t GPU_QUERIES_PER_FRAME = 32;
+
+struct Event {
+    const char* name;
+    uint64_t start, end;
+};
+
+// Written only by its own thread. `written` is published with release, so
+// a reader that loads it with acquire sees every event below it (as long
+// as the writer hasn't wrapped around since).
+struct ThreadBuffer {
+    std::string name;
+    std::vector<Event> events = std::vector<Event>(RING_SIZE);
+    std::atomic<uint64_t> written{0};
+    uint64_t folded = 0; // next event endFrame looks at (GL thread only)
+
+    void push(const char* eventName, uint64_t start, uint64_t end) {
+        uint64_t n = written.load(std::memory_order_relaxed);
+        events[n & (RING_SIZE - 1)] = {eventName, start, end};
+        written.store(n + 1, std::memory_order_release);
+    }
+};
+
+// Buffers are never freed: threads that have exited still show in traces
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> threads;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+ThreadBuffer& newBuffer(const std::string& name) {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.threads.emplace_back(new ThreadBuffer());
+    reg.threads.back()->name = name.empty() ? "Thread " + std::to_string(reg.threads.size()) : name;
+    return *reg.threads.back();
+}
+
+ThreadBuffer& localBuffer() {
+    thread_local ThreadBuffer* buffer = &newBuffer(std::string());
+    return *buffer;
+}
+
+// ===============================
+// Phase Statistics (GL thread)
+// ===============================
+struct Phase {
+    std::string label;
+    std::vector<float> samples; // per-frame milliseconds, ring of HISTORY
+    size_t next = 0;
+    float frameMs = 0.0f;
+    bool seen = false;
+};
+
+std::vector<Phase> phases;
+std::unordered_map<const char*, size_t> cpuPhases, gpuPhases;
+
+Phase& phaseFor(std::unordered_map<const char*, size_t>& index, const char* name, const char* suffix) {
+    auto found = index.find(name);
+    if (found != index.end()) return phases[found->second];
+    index.emplace(name, phases.size());
+    phases.emplace_back();
+    phases.back().label = std::string(name) + suffix;
+    return phases.back();
+}
+
+void addSample(Phase& phase, uint64_t start, uint64_t end) {
+    phase.frameMs += static_cast<float>(end - start) * 1e-6f;
+    phase.seen = true;
+}
+
+float percentile(std::vector<float> values, float p) {
+    if (values.empty()) return 0.0f;
+    auto nth = values.begin() + static_cast<size_t>(p * (values.size() - 1) + 0.5f);
+    std::nth_element(values.begin(), nth, values.end());
+    return *nth;
+}
+
+// ===============================
+// GPU Queries (GL thread)
+// ===============================
+struct GpuQuery {
+    GLuint query;
+    const char* name;
+    uint64_t cpuStart;
+};
+
+struct GpuFrame {
+    std::vector<GpuQuery> queries;
+    size_t used = 0;
+};
+
+GpuFrame gpuFrames[GPU_FRAMES];
+int gpuFrame = 0;
+bool gpuActive = false;
+ThreadBuffer* gpuTrack = nullptr;
+
+bool gpuTimersSupported() {
+    // Timer queries are core in 3.3
+    static const bool supported = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+    return supported;
+}
+
+void collectGpuResults(GpuFrame& frame) {
+    for (size_t i = 0; i < frame.used; i++) {
+        GpuQuery& q = frame.queries[i];
+        GLint available = 0;
+        glGetQueryObjectiv(q.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(q.query, GL_QUERY_RESULT, &elapsed);
+        addSample(phaseFor(gpuPhases, q.name, " (GPU)"), 0, elapsed);
+        // GL_TIME_ELAPSED has no start time: the trace places the GPU work
+        // where the CPU submitted it
+        if (!gpuTrack) gpuTrack = &newBuffer("GPU");
+        gpuTrack->push(q.name, q.cpuStart, q.cpuStart + elapsed);
+    }
+    frame.used = 0;
+}
+
+} // namespace
+
+uint64_t Profiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::setThreadName(const char* name) {
+    ThreadBuffer& buffer = localBuffer();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    buffer.name = name;
+}
+
+void Profiler::record(const char* name, uint64_t start, uint64_t end) {
+    localBuffer().push(name, start, end);
+}
+
+bool Profiler::beginGpu(const char* name) {
+    if (gpuActive || !gpuTimersSupported()) return false;
+    GpuFrame& frame = gpuFrames[gpuFrame];
+    if (frame.used == frame.queries.size()) {
+        if (frame.queries.size() >= GPU_QUERIES_PER_FRAME) return false;
+        GpuQuery query = {};
+        glGenQueries(1, &query.query);
+        frame.queries.push_back(query);
+    }
+    GpuQuery& q = frame.queries[frame.used++];
+    q.name = name;
+    q.cpuStart = now();
+    glBeginQuery(GL_TIME_ELAPSED, q.query);
+    gpuActive = true;
+    return true;
+}
+
+void Profiler::endGpu() {
+    glEndQuery(GL_TIME_ELAPSED);
+    gpuActive = false;
+}
+
+void Profiler::endFrame() {
+    // CPU events from every thread since the last frame
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (auto& thread : reg.threads) {
+            if (thread.get() == gpuTrack) continue;
+            uint64_t written = thread->written.load(std::memory_order_acquire);
+            uint64_t first = std::max(thread->folded, written > RING_SIZE ? written - RING_SIZE : 0);
+            for (uint64_t i = first; i < written; i++) {
+                const Event& event = thread->events[i & (RING_SIZE - 1)];
+                addSample(phaseFor(cpuPhases, event.name, ""), event.start, event.end);
+            }
+            thread->folded = written;
+        }
+    }
+
+    // The oldest frame's queries have had GPU_FRAMES - 1 frames to finish
+    gpuFrame = (gpuFrame + 1) % GPU_FRAMES;
+    collectGpuResults(gpuFrames[gpuFrame]);
+
+    // Phases that didn't run this frame (e.g. asset loads once everything
+    // is resident) keep their old samples rather than filling up with zeros
+    for (Phase& phase : phases) {
+        if (!phase.seen) continue;
+        if (phase.samples.size() < HISTORY) {
+            phase.samples.push_back(phase.frameMs);
+        } else {
+            phase.samples[phase.next] = phase.frameMs;
+            phase.next = (phase.next + 1) % HISTORY;
+        }
+        phase.frameMs = 0.0f;
+        phase.seen = false;
+    }
+}
+
+// ===============================
+// Overlay
+// ===============================
+void Profiler::drawOverlay() {
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    // Fixed-function text: no program, and texturing off on unit 0, which
+    // GlState keeps track of (the rest comes back with the pop below)
+    GlState& state = GlState::get();
+    state.useProgram(0);
+    state.disable(GL_TEXTURE_2D);
+
+    // Color material off too, or glColor would change the scene's material
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_COLOR_MATERIAL);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    // Pixel coordinates
+    const Mat4 pixels = Mat4::orthographic(0.0f, static_cast<float>(viewport[2]), 0.0f,
+                                           static_cast<float>(viewport[3]), -1.0f, 1.0f);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadMatrixf(pixels.m);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glColor3f(1.0f, 1.0f, 0.3f);
+    int y = viewport[3] - 16;
+    auto line = [&y](const char* text) {
+        glRasterPos2i(8, y);
+        for (const char* c = text; *c; c++) glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *c);
+        y -= 14;
+    };
+    char text[128];
+    std::snprintf(text, sizeof(text), "%-28s %7s %7s", "phase (ms)", "p50", "p99");
+    line(text);
+    for (const Phase& phase : phases) {
+        std::snprintf(text, sizeof(text), "%-28.28s %7.2f %7.2f", phase.label.c_str(),
+                      percentile(phase.samples, 0.5f), percentile(phase.samples, 0.99f));
+        line(text);
+    }
+
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopAttrib();
+}
+
+// ===============================
+// Chrome Trace Export
+// ===============================
+bool Profiler::exportChromeTrace(const std::string& path) {
+    std::ofstream out(path);
+    if (!out) {
+        LOG_ERROR("Could not write trace " << path);
+        return false;
+    }
+
+    auto quoted = [](const char* s) {
+        std::string q = "\"";
+        for (; *s; s++) {
+            if (*s == '"' || *s == '\\') q += '\\';
+            q += *s;
+        }
+        return q + '"';
+    };
+
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    // Timestamps in microseconds from the earliest event
+    uint64_t origin = UINT64_MAX;
+    for (auto& thread : reg.threads) {
+        uint64_t written = thread->written.load(std::memory_order_acquire);
+        for (uint64_t i = written > RING_SIZE ? written - RING_SIZE : 0; i < written; i++)
+            origin = std::min(origin, thread->events[i & (RING_SIZE - 1)].start);
+    }
+
+    out << "{\"traceEvents\":[\n";
+    size_t count = 0;
+    for (size_t tid = 0; tid < reg.threads.size(); tid++) {
+        ThreadBuffer& thread = *reg.threads[tid];
+        out << (tid ? ",\n" : "") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+            << ",\"args\":{\"name\":" << quoted(thread.name.c_str()) << "}}";
+        uint64_t written = thread.written.load(std::memory_order_acquire);
+        for (uint64_t i = written > RING_SIZE ? written - RING_SIZE : 0; i < written; i++) {
+            const Event& event = thread.events[i & (RING_SIZE - 1)];
+            char times[96];
+            std::snprintf(times, sizeof(times), "\"ts\":%.3f,\"dur\":%.3f", (event.start - origin) * 1e-3,
+                          (event.end - event.start) * 1e-3);
+            out << ",\n{\"name\":" << quoted(event.name) << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid << ","
+                << times << "}";
+            count++;
+        }
+    }
+    out << "\n]}\n";
+
+    LOG_INFO("Wrote " << count << " trace events to " << path);
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Frame profiler: nested CPU scopes recorded into per-thread ring buffers,
+// GPU time from GL_TIME_ELAPSED queries read back a few frames later,
+// rolling p50/p99 per phase, and Chrome/Perfetto trace export.
+//
+// Build with -DFALLAGA_PROFILE=ON to enable it. Otherwise the macros expand
+// to nothing and none of this is called.
+//
+// Scope names must be string literals (or otherwise outlive the profiler):
+// events store the pointer and phases are keyed by it.
+class Profiler {
+public:
+    // Any thread. Names the calling thread in traces.
+    static void setThreadName(const char* name);
+
+    // Any thread. Times [start, end) of one scope on the calling thread.
+    static uint64_t now();
+    static void record(const char* name, uint64_t start, uint64_t end);
+
+    // GL thread. At most one GPU scope is timed at a time (GL_TIME_ELAPSED
+    // queries don't nest); inner ones are ignored.
+    static bool beginGpu(const char* name);
+    static void endGpu();
+
+    // GL thread, once per frame: folds the frame's events into the phase
+    // statistics and collects GPU results that are ready, without waiting.
+    static void endFrame();
+
+    // GL thread. Text overlay with the rolling p50/p99 of every phase.
+    static void drawOverlay();
+
+    // Writes everything still in the ring buffers as Chrome trace JSON
+    // (chrome://tracing, ui.perfetto.dev). Returns false if the file
+    // can't be written.
+    static bool exportChromeTrace(const std::string& path);
+};
+
+#ifdef FALLAGA_PROFILE
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name) : name(name), start(Profiler::now()) {}
+    ~ProfileScope() { Profiler::record(name, start, Profiler::now()); }
+
+private:
+    const char* name;
+    uint64_t start;
+};
+
+class GpuProfileScope {
+public:
+    explicit GpuProfileScope(const char* name) : active(Profiler::beginGpu(name)) {}
+    ~GpuProfileScope() {
+        if (active) Profiler::endGpu();
+    }
+
+private:
+    bool active;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+// CPU time of the enclosing block
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+// CPU and GPU time of the enclosing block (GL thread only)
+#define PROFILE_GPU_SCOPE(name)                                                 \
+    ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name);                  \
+    GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+#define PROFILE_THREAD(name) Profiler::setThreadName(name)
+#define PROFILE_FRAME() Profiler::endFrame()
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_GPU_SCOPE(name)
+#define PROFILE_THREAD(name)
+#define PROFILE_FRAME()
+
+#endif
@@ -0,0 +1,54 @@
+#pragma once
+#include <cmath>
+#include "Vec3.h"
+
+// Unit quaternion for joint rotations (x, y, z vector part, w scalar)
+struct Quat {
+    float x, y, z, w;
+
+    Quat() : x(0), y(0), z(0), w(1) {}
+    Quat(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+
+    // `angle` radians about the unit vector `axis`
+    static Quat fromAxisAngle(const Vec3& axis, float angle) {
+        const float s = std::sin(0.5f * angle);
+        return Quat(axis.x * s, axis.y * s, axis.z * s, std::cos(0.5f * angle));
+    }
+
+    // This rotation after `other`
+    Quat operator*(const Quat& other) const {
+        return Quat(w * other.x + x * other.w + y * other.z - z * other.y,
+                    w * other.y - x * other.z + y * other.w + z * other.x,
+                    w * other.z + x * other.y - y * other.x + z * other.w,
+                    w * other.w - x * other.x - y * other.y - z * other.z);
+    }
+
+    Vec3 rotate(const Vec3& v) const {
+        // v + 2w (u x v) + 2 u x (u x v), with u the vector part
+        const Vec3 u(x, y, z);
+        const Vec3 t = u.cross(v) * 2.0f;
+        return v + t * w + u.cross(t);
+    }
+
+    float dot(const Quat& other) const { return x * other.x + y * other.y + z * other.z + w * other.w; }
+
+    void normalize() {
+        const float len = std::sqrt(dot(*this));
+        if (len > 0) {
+            x /= len;
+            y /= len;
+            z /= len;
+            w /= len;
+        }
+    }
+};
+
+// Normalized lerp along the shorter arc: close enough to slerp for the
+// small steps between keys, and much cheaper
+inline Quat nlerp(const Quat& a, const Quat& b, float t) {
+    const float s = a.dot(b) < 0.0f ? -t : t;
+    Quat q(a.x + (b.x * s - a.x * t), a.y + (b.y * s - a.y * t), a.z + (b.z * s - a.z * t),
+           a.w + (b.w * s - a.w * t));
+    q.normalize();
+    return q;
+}
@@ -0,0 +1,82 @@
+#include "RenderQueue.h"
+#include "Profiler.h"
+#include <algorithm>
+
+namespace {
+
+const int PROGRAM_BITS = 8, TEXTURE_BITS = 12, MESH_BITS = 16, DEPTH_BITS = 24;
+// Depths past this all sort as the farthest
+const float MAX_DEPTH = 1000.0f;
+
+} // namespace
+
+uint32_t RenderQueue::slot(std::vector<GLuint>& names, GLuint name, uint32_t limit) {
+    // Name 0 (no program, no texture) is always slot 0
+    if (name == 0) return 0;
+    const auto found = std::find(names.begin(), names.end(), name);
+    size_t index = found - names.begin();
+    if (found == names.end()) names.push_back(name);
+    return static_cast<uint32_t>(std::min<size_t>(index + 1, limit));
+}
+
+uint64_t RenderQueue::makeKey(RenderPass pass, GLuint program, GLuint texture, uint32_t mesh, float depth) {
+    const uint64_t programSlot = slot(programs, program, (1u << PROGRAM_BITS) - 1);
+    const uint64_t textureSlot = slot(textures, texture, (1u << TEXTURE_BITS) - 1);
+    const uint64_t meshSlot = slot(meshes, mesh, (1u << MESH_BITS) - 1);
+    const float clamped = std::min(std::max(depth / MAX_DEPTH, 0.0f), 1.0f);
+    const uint64_t depthBits = static_cast<uint64_t>(clamped * ((1u << DEPTH_BITS) - 1));
+
+    uint64_t key = static_cast<uint64_t>(pass);
+    key = (key << PROGRAM_BITS) | programSlot;
+    key = (key << TEXTURE_BITS) | textureSlot;
+    key = (key << MESH_BITS) | meshSlot;
+    key = (key << DEPTH_BITS) | depthBits;
+    return key;
+}
+
+void RenderQueue::push(uint64_t key, void (*submit)(const void*, uint32_t), const void* owner, uint32_t data) {
+    items.push_back({ key, submit, owner, data });
+}
+
+void RenderQueue::sort() {
+    PROFILE_SCOPE("RenderQueue::sort");
+    radixSort(items, scratch);
+}
+
+void RenderQueue::submit() {
+    for (const DrawItem& item : items) item.submit(item.owner, item.data);
+    items.clear();
+}
+
+// ===============================
+// Radix sort
+// ===============================
+void RenderQueue::radixSort(std::vector<DrawItem>& items, std::vector<DrawItem>& scratch) {
+    const size_t n = items.size();
+    if (n < 2) return;
+    scratch.resize(n);
+
+    // One histogram per byte, all from a single pass over the keys
+    size_t counts[8][256] = {};
+    for (const DrawItem& item : items) {
+        for (int byte = 0; byte < 8; byte++) counts[byte][(item.key >> (8 * byte)) & 0xFF]++;
+    }
+
+    DrawItem* from = items.data();
+    DrawItem* to = scratch.data();
+    for (int byte = 0; byte < 8; byte++) {
+        size_t* count = counts[byte];
+        // Every key has the same byte here: this pass wouldn't move anything
+        if (count[(from[0].key >> (8 * byte)) & 0xFF] == n) continue;
+
+        size_t offset = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            const size_t c = count[digit];
+            count[digit] = offset;
+            offset += c;
+        }
+        for (size_t i = 0; i < n; i++) to[count[(from[i].key >> (8 * byte)) & 0xFF]++] = from[i];
+        std::swap(from, to);
+    }
+    if (from != items.data()) std::copy(from, from + n, items.data());
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <GL/glew.h>
+
+// Order in which groups of draws are submitted, highest bits of the key
+enum class RenderPass : uint8_t {
+    Opaque = 0,        // GLSL programs
+    FixedFunction = 1, // display lists, immediate mode and other fallbacks
+};
+
+// One draw: its sort key and how to issue it. `submit` gets back the
+// owner and data it was queued with; it binds through GlState, so the
+// state the previous item left behind costs nothing to ask for again.
+struct DrawItem {
+    uint64_t key;
+    void (*submit)(const void* owner, uint32_t data);
+    const void* owner;
+    uint32_t data;
+};
+
+// A frame's draws, collected from every renderer, sorted by a 64-bit key
+// and submitted in that order, so draws sharing a program, a texture or a
+// mesh run back to back wherever they were queued. From the top bit down
+// the key holds:
+//
+//   pass     4 bits
+//   program  8 bits   (a slot per program name, in order of first use)
+//   texture 12 bits   (the same for textures; 0 is none)
+//   mesh    16 bits   (likewise, for vertex arrays or other mesh ids)
+//   depth   24 bits   (distance from the camera, near first)
+//
+// The sort is an LSD radix sort over bytes that skips the bytes every key
+// shares, which for a frame's queue is most of them.
+class RenderQueue {
+public:
+    uint64_t makeKey(RenderPass pass, GLuint program, GLuint texture, uint32_t mesh, float depth);
+    void push(uint64_t key, void (*submit)(const void*, uint32_t), const void* owner, uint32_t data = 0);
+
+    void sort();
+    // Issues every item in order, then empties the queue
+    void submit();
+    void clear() { items.clear(); }
+
+    size_t size() const { return items.size(); }
+    const std::vector<DrawItem>& getItems() const { return items; }
+
+    // Stable, ascending by key; `scratch` is resized as needed
+    static void radixSort(std::vector<DrawItem>& items, std::vector<DrawItem>& scratch);
+
+private:
+    // Slot of `name` in `names`, added on first use and saturating at the
+    // field's width (the key only loses grouping past that)
+    static uint32_t slot(std::vector<GLuint>& names, GLuint name, uint32_t limit);
+
+    std::vector<DrawItem> items, scratch;
+    std::vector<GLuint> programs, textures, meshes;
+};
@@ -0,0 +1,97 @@
+#include "ResourceManager.h"
+#include "GlState.h"
+#include <filesystem>
+
+ResourceManager& ResourceManager::get() {
+    static ResourceManager manager;
+    return manager;
+}
+
+std::string ResourceManager::canonicalPath(const std::string& path) {
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+    if (error) canonical = std::filesystem::absolute(path, error).lexically_normal();
+    return error ? path : canonical.string();
+}
+
+uint32_t ResourceManager::intern(const std::string& s) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto inserted = internIds.emplace(s, static_cast<uint32_t>(internIds.size()));
+    return inserted.first->second;
+}
+
+MaterialResource* ResourceManager::acquireMaterial(const std::string& name, const std::string& texturePath,
+                                                   bool& mustLoadTexture) {
+    mustLoadTexture = false;
+    // Outside the lock: it may touch the file system
+    const std::string texture = texturePath.empty() ? std::string() : canonicalPath(texturePath);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    const std::string key = name + '\n' + texture;
+    auto found = materials.find(key);
+    if (found != materials.end()) {
+        stats.materialHits++;
+        found->second->refCount++;
+        return found->second.get();
+    }
+    stats.materialMisses++;
+
+    std::unique_ptr<MaterialResource> material(new MaterialResource());
+    material->key = key;
+    material->id = internIds.emplace(name, static_cast<uint32_t>(internIds.size())).first->second;
+    material->refCount = 1;
+
+    if (!texture.empty()) {
+        auto& slot = textures[texture];
+        if (slot) {
+            stats.textureHits++;
+        } else {
+            stats.textureMisses++;
+            slot.reset(new TextureResource());
+            slot->path = texture;
+            mustLoadTexture = true;
+        }
+        slot->refCount++;
+        material->texture = slot.get();
+    }
+
+    MaterialResource* result = material.get();
+    materials.emplace(key, std::move(material));
+    stats.liveMaterials = materials.size();
+    return result;
+}
+
+void ResourceManager::release(MaterialResource* material) {
+    if (!material) return;
+    GLuint unusedTexture = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--material->refCount > 0) return;
+
+        TextureResource* texture = material->texture;
+        if (texture && --texture->refCount == 0) {
+            unusedTexture = texture->name;
+            if (texture->name) {
+                stats.residentTextures--;
+                stats.residentBytes -= texture->bytes;
+            }
+            textures.erase(texture->path);
+        }
+        materials.erase(material->key);
+        stats.liveMaterials = materials.size();
+    }
+    if (unusedTexture) GlState::get().deleteTextures(1, &unusedTexture);
+}
+
+void ResourceManager::textureUploaded(TextureResource* texture, GLuint name, size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    texture->name = name;
+    texture->bytes = bytes;
+    stats.residentTextures++;
+    stats.residentBytes += bytes;
+}
+
+ResourceManager::Stats ResourceManager::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <GL/glew.h>
+
+// A texture file, shared by every material that uses it
+struct TextureResource {
+    std::string path;  // canonical path, the cache key
+    GLuint name = 0;   // 0 until uploaded, and for files that failed to load
+    size_t bytes = 0;  // GPU bytes, mips included
+    int refCount = 0;  // materials using it
+};
+
+// An MTL material. Two materials with the same name and texture are the
+// same material, whichever file or model they came from.
+struct MaterialResource {
+    std::string key;
+    uint32_t id = 0;                     // interned material name
+    TextureResource* texture = nullptr;  // null when the material has none
+    int refCount = 0;
+
+    GLuint textureName() const { return texture ? texture->name : 0; }
+};
+
+// Process-wide cache of textures and materials. Handles are plain pointers
+// that stay valid until released; GL objects are freed with the last one.
+//
+// acquire/intern may be called from any thread (streaming workers resolve
+// materials while they decode). textureUploaded and release must be called
+// on the GL thread.
+class ResourceManager {
+public:
+    static ResourceManager& get();
+
+    // Equal strings get equal ids, so lookups compare integers
+    uint32_t intern(const std::string& s);
+
+    // Adds a reference. `mustLoadTexture` is set for the first user of a
+    // texture file, who decodes it and hands it over with textureUploaded();
+    // everyone else sees the texture once that has happened.
+    MaterialResource* acquireMaterial(const std::string& name, const std::string& texturePath, bool& mustLoadTexture);
+    void release(MaterialResource* material);
+
+    void textureUploaded(TextureResource* texture, GLuint name, size_t bytes);
+
+    struct Stats {
+        size_t textureHits = 0, textureMisses = 0;
+        size_t materialHits = 0, materialMisses = 0;
+        size_t residentTextures = 0;
+        size_t residentBytes = 0;
+        size_t liveMaterials = 0;
+    };
+    Stats getStats() const;
+
+    // Absolute and normalized, with symlinks resolved where the file exists
+    static std::string canonicalPath(const std::string& path);
+
+private:
+    ResourceManager() = default;
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::unique_ptr<TextureResource>> textures;
+    std::unordered_map<std::string, std::unique_ptr<MaterialResource>> materials;
+    std::unordered_map<std::string, uint32_t> internIds;
+    Stats stats;
+};
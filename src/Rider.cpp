@@ -0,0 +1,217 @@
+#include "Rider.h"
+#include "Horse.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "Log.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const char* RIDER_RIG = "assets/rider/rider.rig";
+// The rig is life-size; riders are drawn to the placeholder horses' scale
+const float RIDER_SCALE = 0.4f;
+// Top of a seated rider's head above the horse's back
+const float RIDER_HEIGHT = 1.0f * RIDER_SCALE;
+const Vec3 CLOTHES(0.25f, 0.22f, 0.2f);
+// Horse speeds, m/s, at which the gallop blend starts and is complete
+const float TROT_SPEED = 1.0f;
+const float GALLOP_SPEED = 5.0f;
+const float CLIP_FRAME_RATE = 30.0f;
+const size_t RIDERS_PER_JOB = 32;
+
+// Hips height above the saddle in the rig: the bottom of the hips box
+const float SEAT = 0.08f;
+// The thighs reach forward and out around the horse, the shins hang down
+const float THIGH_FORWARD = 0.7f;
+const float THIGH_SPREAD = 1.2f;
+
+// One stride of a gait, as the shape of a few sine waves over it
+struct Gait {
+    float duration;       // seconds per stride
+    float bounce;         // hips rise, metres
+    int bouncesPerStride; // 2 at the trot (rising to each diagonal), 1 at the gallop
+    float lean;           // forward pitch of the hips, radians
+    float leanSwing;
+    float reach;          // arms forward to the reins, radians
+    float reachSwing;
+    float legSwing;       // shins, radians
+};
+
+const Gait TROT = { 0.7f, 0.04f, 2, 0.08f, 0.04f, 0.5f, 0.05f, 0.1f };
+const Gait GALLOP = { 0.45f, 0.07f, 1, 0.3f, 0.1f, 0.7f, 0.2f, 0.25f };
+
+Quat aboutX(float angle) {
+    return Quat::fromAxisAngle(Vec3(1.0f, 0.0f, 0.0f), angle);
+}
+
+Quat aboutZ(float angle) {
+    return Quat::fromAxisAngle(Vec3(0.0f, 0.0f, 1.0f), angle);
+}
+
+// One stride of `gait` sampled at CLIP_FRAME_RATE (near enough that the
+// stride is a whole number of frames); the last frame repeats the first
+// so the clip loops. Joints the rig doesn't have are skipped.
+RawClip makeGait(const char* name, const Skeleton& skeleton, const Gait& gait) {
+    RawClip raw;
+    raw.name = name;
+    raw.jointCount = skeleton.jointCount();
+    const int strideFrames = std::max(2, static_cast<int>(std::lround(gait.duration * CLIP_FRAME_RATE)));
+    raw.frameRate = strideFrames / gait.duration;
+
+    const float TWO_PI = 6.2831853f;
+    for (int frame = 0; frame <= strideFrames; frame++) {
+        const float s = TWO_PI * frame / strideFrames;
+        std::vector<JointPose> pose = skeleton.bindPose;
+        auto set = [&](const char* joint, const Quat& rotation) {
+            const int j = skeleton.find(joint);
+            if (j >= 0) pose[j].rotation = rotation;
+        };
+
+        const int hips = skeleton.find("hips");
+        if (hips >= 0) {
+            const float rise = gait.bounce * (0.5f - 0.5f * std::cos(gait.bouncesPerStride * s));
+            pose[hips].translation = Vec3(0.0f, SEAT + rise, 0.02f * std::sin(s));
+            pose[hips].rotation = aboutX(gait.lean + gait.leanSwing * std::sin(s));
+        }
+        // The back gives a little and the head stays on the horizon
+        set("spine", aboutX(-0.4f * gait.leanSwing * std::sin(s)));
+        set("head", aboutX(-0.7f * gait.lean));
+        const Quat reach = aboutX(-(gait.reach + gait.reachSwing * std::sin(s)));
+        set("upperarm_l", reach);
+        set("upperarm_r", reach);
+        set("forearm_l", aboutX(-0.9f));
+        set("forearm_r", aboutX(-0.9f));
+        // Each shin undoes its thigh's turn, then swings with the stride
+        const Quat swing = aboutX(gait.legSwing * std::sin(s));
+        set("thigh_l", aboutZ(THIGH_SPREAD) * aboutX(-THIGH_FORWARD));
+        set("thigh_r", aboutZ(-THIGH_SPREAD) * aboutX(-THIGH_FORWARD));
+        set("shin_l", aboutX(THIGH_FORWARD) * aboutZ(-THIGH_SPREAD) * swing);
+        set("shin_r", aboutX(THIGH_FORWARD) * aboutZ(THIGH_SPREAD) * swing);
+
+        raw.frames.insert(raw.frames.end(), pose.begin(), pose.end());
+    }
+    return raw;
+}
+
+// Rig space to world: on the horse's back, facing its way, at rider scale
+Mat34 placementOf(const Transform& t) {
+    JointPose pose;
+    pose.rotation = Quat::fromAxisAngle(Vec3(0.0f, 1.0f, 0.0f), t.yaw);
+    pose.translation = Vec3(t.x, t.y + HORSE_HEIGHT * t.scale, t.z);
+    Mat34 placement = Mat34::fromPose(pose);
+    const float scale = RIDER_SCALE * t.scale;
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) placement.m[r][c] *= scale;
+    }
+    return placement;
+}
+
+float groundSpeed(const Velocity& v) {
+    return std::sqrt(v.value.x * v.value.x + v.value.z * v.value.z);
+}
+
+} // namespace
+
+void mountRiders(World& world, size_t count) {
+    std::vector<Entity> horses;
+    world.eachChunk<HorseTag>([&](size_t n, const Entity* entities, HorseTag*) {
+        horses.insert(horses.end(), entities, entities + n);
+    });
+    size_t mounted = 0;
+    for (size_t i = 0; i < horses.size() && mounted < count; i++) {
+        if (world.has<Rider>(horses[i])) continue;
+        // Golden ratio apart, so neighbours are out of step
+        const float phase = 0.618034f * i;
+        world.add(horses[i], Rider{ phase - std::floor(phase) });
+        mounted++;
+    }
+}
+
+// ===============================
+// RiderAnimation
+// ===============================
+bool RiderAnimation::load(const std::string& rigPath) {
+    if (!loadSkinnedModel(rigPath, skeleton, mesh)) {
+        skeleton = Skeleton();
+        return false;
+    }
+    rawTrot = makeGait("trot", skeleton, TROT);
+    rawGallop = makeGait("gallop", skeleton, GALLOP);
+    trot = AnimationClip(rawTrot);
+    gallop = AnimationClip(rawGallop);
+    LOG_INFO("Rider gaits: " << trot.getMemoryBytes() + gallop.getMemoryBytes() << " bytes compressed, "
+             << (rawTrot.frames.size() + rawGallop.frames.size()) * sizeof(JointPose) << " raw");
+    return true;
+}
+
+float RiderAnimation::gallopAt(float speed) {
+    return std::min(std::max((speed - TROT_SPEED) / (GALLOP_SPEED - TROT_SPEED), 0.0f), 1.0f);
+}
+
+float RiderAnimation::strideAdvance(float blend, float dt) const {
+    return dt / (trot.getDuration() + (gallop.getDuration() - trot.getDuration()) * blend);
+}
+
+void RiderAnimation::computePalette(const RiderPose& rider, Mat34* palette) const {
+    const size_t joints = skeleton.jointCount();
+    thread_local std::vector<JointPose> pose, galloping;
+    pose.resize(joints);
+    galloping.resize(joints);
+    // A gait at zero weight isn't sampled at all
+    if (rider.gallop < 1.0f) trot.sample(rider.phase * trot.getDuration(), pose.data());
+    if (rider.gallop > 0.0f) {
+        gallop.sample(rider.phase * gallop.getDuration(), galloping.data());
+        if (rider.gallop < 1.0f) blendPoses(pose.data(), galloping.data(), rider.gallop, joints, pose.data());
+        else pose.swap(galloping);
+    }
+    ::computePalette(skeleton, pose.data(), placementOf(rider.placement), palette);
+}
+
+void RiderAnimation::computePalettes(const std::vector<RiderPose>& riders, std::vector<Mat34>& palettes) const {
+    PROFILE_SCOPE("RiderAnimation::computePalettes");
+    const size_t stride = mesh.paletteSize;
+    palettes.resize(riders.size() * stride);
+    JobSystem::get().parallelFor(riders.size(), RIDERS_PER_JOB, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) computePalette(riders[i], &palettes[i * stride]);
+    });
+}
+
+// ===============================
+// Riders
+// ===============================
+Riders::Riders() {
+    if (animation.load(RIDER_RIG)) renderer = new SkinnedRenderer(animation.getMesh(), CLOTHES);
+}
+
+Riders::~Riders() {
+    delete renderer;
+}
+
+void Riders::update(World& world, float dt) {
+    if (!animation.isLoaded()) return;
+    world.each<Velocity, Bounds, Rider>([this, dt](Velocity& v, Bounds& b, Rider& rider) {
+        rider.phase += animation.strideAdvance(RiderAnimation::gallopAt(groundSpeed(v)), dt);
+        rider.phase -= std::floor(rider.phase);
+        b.max.y += RIDER_HEIGHT;
+    });
+}
+
+void Riders::enqueue(World& world, RenderQueue& queue) {
+    PROFILE_SCOPE("Riders::enqueue");
+    if (!renderer) return;
+    visible.clear();
+    world.each<Transform, Velocity, Visibility, Rider>(
+        [this](Transform& t, Velocity& v, Visibility& visibility, Rider& rider) {
+            if (visibility.visible) visible.push_back({ t, rider.phase, RiderAnimation::gallopAt(groundSpeed(v)) });
+        });
+    animation.computePalettes(visible, palettes);
+    if (visible.empty()) return;
+    const RenderPass pass = renderer->isGpuSkinning() ? RenderPass::Opaque : RenderPass::FixedFunction;
+    queue.push(queue.makeKey(pass, renderer->getProgram(), 0, renderer->getVertexArray(), 0.0f), submit, this);
+}
+
+void Riders::submit(const void* owner, uint32_t) {
+    const Riders& self = *static_cast<const Riders*>(owner);
+    self.renderer->render(self.palettes, self.visible.size());
+}
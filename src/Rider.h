@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "AnimationClip.h"
+#include "Components.h"
+#include "RenderQueue.h"
+#include "Skeleton.h"
+#include "SkinnedRenderer.h"
+#include "World.h"
+
+// Puts a rider (a Rider component, see Components.h) on up to `count`
+// horses that have none, each starting at its own point in the stride
+void mountRiders(World& world, size_t count);
+
+// Where one rider is and how it moves
+struct RiderPose {
+    Transform placement; // its horse's
+    float phase;         // through the stride, 0 to 1
+    float gallop;        // blend from the trot (0) to the gallop (1)
+};
+
+// The rider rig and its two gaits, shared by every rider. The gaits are
+// generated from the rig's joints and compressed like any other clip;
+// both are one stride long, so blending them at the same phase keeps the
+// feet in step.
+class RiderAnimation {
+public:
+    // False (with a message) if the rig can't be read
+    bool load(const std::string& rigPath);
+    bool isLoaded() const { return skeleton.jointCount() > 0; }
+
+    const Skeleton& getSkeleton() const { return skeleton; }
+    const SkinnedMesh& getMesh() const { return mesh; }
+    const AnimationClip& getTrot() const { return trot; }
+    const AnimationClip& getGallop() const { return gallop; }
+    // Uncompressed, to measure the clips against
+    const RawClip& getRawTrot() const { return rawTrot; }
+    const RawClip& getRawGallop() const { return rawGallop; }
+
+    // Gallop blend for a horse moving at `speed`
+    static float gallopAt(float speed);
+    // Stride fraction covered in `dt` seconds at gallop blend `gallop`
+    float strideAdvance(float gallop, float dt) const;
+
+    // World-space palettes for `riders`, mesh.paletteSize matrices each,
+    // sampled, blended and composed in parallel on the job system
+    void computePalettes(const std::vector<RiderPose>& riders, std::vector<Mat34>& palettes) const;
+    // The same for one rider, on the calling thread
+    void computePalette(const RiderPose& rider, Mat34* palette) const;
+
+private:
+    Skeleton skeleton;
+    SkinnedMesh mesh;
+    RawClip rawTrot, rawGallop;
+    AnimationClip trot, gallop;
+};
+
+// Animates and draws the riders of every horse with a Rider component
+class Riders {
+public:
+    // Loads assets/rider/rider.rig; without it nothing is drawn
+    Riders();
+    ~Riders();
+    Riders(const Riders&) = delete;
+    Riders& operator=(const Riders&) = delete;
+
+    // Moves each rider along its stride at its horse's pace, and raises its
+    // horse's bounds to take the rider in; call after updateHorses()
+    void update(World& world, float dt);
+    // Poses the riders of the horses cullEntities() found visible and
+    // queues their draw, one for all of them on the GPU skinning path
+    void enqueue(World& world, RenderQueue& queue);
+
+    const RiderAnimation& getAnimation() const { return animation; }
+
+private:
+    static void submit(const void* owner, uint32_t data);
+
+    RiderAnimation animation;
+    SkinnedRenderer* renderer = nullptr;
+    std::vector<RiderPose> visible;
+    std::vector<Mat34> palettes;
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+// What the hand-written vector kernels may use on this target. Every file
+// with such a kernel includes this instead of testing the compiler's macros
+// itself, and keeps a scalar path for when these are not defined.
+//
+//   FALLAGA_SSE          SSE2 is part of the baseline (always so on x86-64):
+//                        the intrinsics can be used anywhere
+//   FALLAGA_X86          any x86; wider sets must be checked for at run time
+//                        and their kernels marked with FALLAGA_TARGET_AVX2
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define FALLAGA_SSE 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FALLAGA_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX2 instructions inside functions that ask for them;
+// MSVC accepts the intrinsics anywhere
+#if defined(FALLAGA_X86) && (defined(__GNUC__) || defined(__clang__))
+#define FALLAGA_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define FALLAGA_TARGET_AVX2
+#endif
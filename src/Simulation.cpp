@@ -0,0 +1,134 @@
+#include "Simulation.h"
+#include "Character.h"
+#include "Terrain.h"
+#include "ObjectModel.h"
+#include "Profiler.h"
+#include "Log.h"
+#include <chrono>
+
+namespace {
+
+Vec3 lerp(const Vec3& a, const Vec3& b, float t) {
+    return a + (b - a) * t;
+}
+
+// Behind by more than this, the simulation skips ahead instead of running
+// a burst of catch-up ticks (e.g. after a debugger break)
+const double MAX_CATCH_UP = 0.25;
+
+} // namespace
+
+Simulation::Simulation(Character* player, Terrain* terrain, double tickRate)
+    : player(player), terrain(terrain), camera(player), tickRate(tickRate) {
+    // The starting state is published before the thread runs, so the first
+    // frame already has something to draw
+    camera.update();
+    state.playerPosition = player->getPosition();
+    state.cameraPosition = camera.getPosition();
+    state.cameraTarget = camera.getTarget();
+    WorldSnapshot& first = snapshots.back();
+    first.previous = first.current = state;
+    first.time = now();
+    snapshots.publish();
+}
+
+Simulation::~Simulation() {
+    stop();
+}
+
+double Simulation::now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Simulation::start() {
+    if (running.exchange(true)) return;
+    thread = std::thread(&Simulation::run, this);
+    LOG_INFO("Simulation running at " << tickRate << " Hz on its own thread");
+}
+
+void Simulation::stop() {
+    if (!running.exchange(false)) return;
+    thread.join();
+}
+
+bool Simulation::pushInput(const InputEvent& event) {
+    return input.push(event);
+}
+
+// ===============================
+// Simulation Thread
+// ===============================
+void Simulation::run() {
+    PROFILE_THREAD("Simulation");
+    const double dt = 1.0 / tickRate;
+    double tickTime = now();
+    while (running.load(std::memory_order_relaxed)) {
+        auto start = std::chrono::steady_clock::now();
+
+        InputEvent event;
+        while (input.pop(event)) apply(event);
+
+        WorldState previous = state;
+        step(static_cast<float>(dt));
+        tick++;
+
+        // Stamped with the scheduled time rather than the wall clock, so
+        // interpolation stays smooth when a tick runs late
+        WorldSnapshot& snapshot = snapshots.back();
+        snapshot.previous = previous;
+        snapshot.current = state;
+        snapshot.time = tickTime;
+        snapshot.tick = tick;
+        snapshot.stepMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        snapshots.publish();
+
+        tickTime += dt;
+        const double current = now();
+        if (current - tickTime > MAX_CATCH_UP) tickTime = current;
+        if (tickTime > current) std::this_thread::sleep_for(std::chrono::duration<double>(tickTime - current));
+    }
+}
+
+void Simulation::apply(const InputEvent& event) {
+    switch (event.type) {
+        case InputEvent::KEY_DOWN: player->keyDown(event.key); break;
+        case InputEvent::KEY_UP: player->keyUp(event.key); break;
+        case InputEvent::MOUSE_MOVE: camera.handleMouse(event.x, event.y); break;
+    }
+}
+
+void Simulation::step(float dt) {
+    PROFILE_SCOPE("Simulation::step");
+    ObjModel* ground = terrain->getModel();
+    player->update(&camera, dt, terrain);
+    terrain->updatePaging(player->getPosition(), player->getVelocity());
+    camera.update();
+
+    // Camera-to-player occlusion: if the ground is between them, pull the camera in
+    Vec3 focus = player->getPosition() + Vec3(0.0f, 0.5f, 0.0f);
+    Vec3 toEye = camera.getPosition() - focus;
+    float eyeDistance = toEye.length();
+    if (eyeDistance > 0.0f) {
+        RayHit hit;
+        Ray ray(focus, toEye * (1.0f / eyeDistance), eyeDistance);
+        if (ground->raycast(ray, hit)) camera.clampDistance(hit.t - 0.2f);
+    }
+
+    state.playerPosition = player->getPosition();
+    state.cameraPosition = camera.getPosition();
+    state.cameraTarget = camera.getTarget();
+}
+
+// ===============================
+// Interpolation
+// ===============================
+WorldState Simulation::interpolate(const WorldSnapshot& snapshot, double time) const {
+    float alpha = static_cast<float>((time - snapshot.time) * tickRate);
+    alpha = alpha < 0.0f ? 0.0f : (alpha > 1.0f ? 1.0f : alpha);
+
+    WorldState blended;
+    blended.playerPosition = lerp(snapshot.previous.playerPosition, snapshot.current.playerPosition, alpha);
+    blended.cameraPosition = lerp(snapshot.previous.cameraPosition, snapshot.current.cameraPosition, alpha);
+    blended.cameraTarget = lerp(snapshot.previous.cameraTarget, snapshot.current.cameraTarget, alpha);
+    return blended;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include "Camera.h"
+#include "SpscQueue.h"
+#include "TripleBuffer.h"
+#include "Vec3.h"
+
+class Character;
+class Terrain;
+
+// What the renderer needs from one simulation tick
+struct WorldState {
+    Vec3 playerPosition;
+    Vec3 cameraPosition;
+    Vec3 cameraTarget;
+};
+
+// Published once per tick. Holds the last two states so the renderer can
+// interpolate between them from a single consistent read.
+struct WorldSnapshot {
+    WorldState previous;
+    WorldState current;
+    double time = 0.0;  // Simulation::now() at which `current` was scheduled
+    uint64_t tick = 0;
+    float stepMs = 0.0f; // cost of the tick that produced it
+};
+
+struct InputEvent {
+    enum Type { KEY_DOWN, KEY_UP, MOUSE_MOVE };
+    Type type;
+    unsigned char key; // Character key code for KEY_DOWN / KEY_UP
+    double x, y;       // cursor position for MOUSE_MOVE
+};
+
+// Runs player movement and the follow camera on their own thread at a
+// fixed rate, so simulation cost no longer stretches frames and movement
+// no longer depends on the frame rate.
+//
+// The simulation thread owns the character's position and keys and the
+// simulation camera. The render thread only sees snapshots.
+class Simulation {
+public:
+    Simulation(Character* player, Terrain* terrain, double tickRate = 60.0);
+    ~Simulation();
+
+    void start();
+    void stop();
+
+    // Input thread. Never blocks; returns false if the queue is full.
+    bool pushInput(const InputEvent& event);
+
+    // Render thread. Newest snapshot, and the state to draw at `time`
+    // (one tick behind the simulation, blended between the last two ticks).
+    const WorldSnapshot& latest() { return snapshots.read(); }
+    WorldState interpolate(const WorldSnapshot& snapshot, double time) const;
+
+    double getTickRate() const { return tickRate; }
+    // Seconds on the clock used for snapshot times
+    static double now();
+
+private:
+    void run();
+    void step(float dt);
+    void apply(const InputEvent& event);
+
+    Character* player;
+    Terrain* terrain;
+    Camera camera; // simulation-side: yaw/pitch from the mouse, occlusion clamp
+    double tickRate;
+
+    WorldState state;
+    uint64_t tick = 0;
+    SpscQueue<InputEvent, 256> input;
+    TripleBuffer<WorldSnapshot> snapshots;
+    std::atomic<bool> running{false};
+    std::thread thread;
+};
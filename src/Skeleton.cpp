@@ -0,0 +1,283 @@
+#include "Skeleton.h"
+#include "Log.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+// ===============================
+// Mat34
+// ===============================
+Mat34 Mat34::identity() {
+    Mat34 r = {};
+    r.m[0][0] = r.m[1][1] = r.m[2][2] = 1.0f;
+    return r;
+}
+
+Mat34 Mat34::fromPose(const JointPose& pose) {
+    const Quat& q = pose.rotation;
+    const float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    const float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    const float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    Mat34 r;
+    r.m[0][0] = 1.0f - 2.0f * (yy + zz);
+    r.m[0][1] = 2.0f * (xy - wz);
+    r.m[0][2] = 2.0f * (xz + wy);
+    r.m[0][3] = pose.translation.x;
+    r.m[1][0] = 2.0f * (xy + wz);
+    r.m[1][1] = 1.0f - 2.0f * (xx + zz);
+    r.m[1][2] = 2.0f * (yz - wx);
+    r.m[1][3] = pose.translation.y;
+    r.m[2][0] = 2.0f * (xz - wy);
+    r.m[2][1] = 2.0f * (yz + wx);
+    r.m[2][2] = 1.0f - 2.0f * (xx + yy);
+    r.m[2][3] = pose.translation.z;
+    return r;
+}
+
+Mat34 Mat34::operator*(const Mat34& other) const {
+    Mat34 r;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 4; j++) {
+            r.m[i][j] = m[i][0] * other.m[0][j] + m[i][1] * other.m[1][j] + m[i][2] * other.m[2][j];
+        }
+        r.m[i][3] += m[i][3];
+    }
+    return r;
+}
+
+Vec3 Mat34::transformPoint(const Vec3& p) const {
+    return Vec3(m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+                m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+                m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]);
+}
+
+Mat34 Mat34::rigidInverse() const {
+    Mat34 r;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) r.m[i][j] = m[j][i];
+        r.m[i][3] = -(m[0][i] * m[0][3] + m[1][i] * m[1][3] + m[2][i] * m[2][3]);
+    }
+    return r;
+}
+
+// ===============================
+// Skeleton
+// ===============================
+int Skeleton::find(const std::string& name) const {
+    for (size_t i = 0; i < names.size(); i++) {
+        if (names[i] == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+void computeModelPose(const Skeleton& skeleton, const JointPose* local, Mat34* model) {
+    for (size_t j = 0; j < skeleton.jointCount(); j++) {
+        const Mat34 joint = Mat34::fromPose(local[j]);
+        const int parent = skeleton.parents[j];
+        model[j] = parent < 0 ? joint : model[parent] * joint;
+    }
+}
+
+void computePalette(const Skeleton& skeleton, const JointPose* local, const Mat34& placement, Mat34* palette) {
+    computeModelPose(skeleton, local, palette);
+    for (size_t j = 0; j < skeleton.jointCount(); j++) {
+        palette[j] = placement * (palette[j] * skeleton.inverseBind[j]);
+    }
+}
+
+// ===============================
+// Loading
+// ===============================
+bool loadSkinnedModel(const std::string& path, Skeleton& skeleton, SkinnedMesh& mesh) {
+    std::ifstream in(path);
+    if (!in) {
+        LOG_ERROR("Could not open rig " << path);
+        return false;
+    }
+    skeleton = Skeleton();
+    mesh = SkinnedMesh();
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string command;
+        if (!(words >> command)) continue;
+
+        bool ok = true;
+        if (command == "joint") {
+            std::string name, parent;
+            JointPose pose;
+            ok = static_cast<bool>(words >> name >> parent >> pose.translation.x >> pose.translation.y
+                                   >> pose.translation.z);
+            Quat q;
+            if (ok && words >> q.x >> q.y >> q.z >> q.w) {
+                q.normalize();
+                pose.rotation = q;
+            }
+            const int parentIndex = parent == "-" ? -1 : skeleton.find(parent);
+            ok = ok && (parent == "-" || parentIndex >= 0) && skeleton.find(name) < 0
+                 && skeleton.jointCount() < MAX_SKIN_JOINTS;
+            if (ok) {
+                skeleton.names.push_back(name);
+                skeleton.parents.push_back(parentIndex);
+                skeleton.bindPose.push_back(pose);
+            }
+        } else if (command == "v") {
+            SkinVertex v = {};
+            ok = static_cast<bool>(words >> v.position[0] >> v.position[1] >> v.position[2] >> v.normal[0]
+                                   >> v.normal[1] >> v.normal[2]);
+            // Heaviest first, so skinning can stop at the first zero
+            std::vector<std::pair<float, int>> influences;
+            int joint;
+            float weight;
+            while (ok && words >> joint >> weight) {
+                ok = joint >= 1 && joint <= static_cast<int>(skeleton.jointCount()) && weight >= 0.0f;
+                influences.push_back(std::make_pair(weight, joint - 1));
+            }
+            ok = ok && !influences.empty() && influences.size() <= MAX_SKIN_WEIGHTS;
+            float total = 0.0f;
+            for (const auto& influence : influences) total += influence.first;
+            ok = ok && total > 0.0f;
+            if (ok) {
+                std::sort(influences.rbegin(), influences.rend());
+                int remaining = 255;
+                for (size_t i = 0; i < influences.size(); i++) {
+                    // The heaviest takes whatever rounding leaves over
+                    const int w = static_cast<int>(std::lround(255.0f * influences[i].first / total));
+                    v.joints[i] = static_cast<uint8_t>(influences[i].second);
+                    v.weights[i] = static_cast<uint8_t>(std::min(w, remaining));
+                    remaining -= v.weights[i];
+                }
+                v.weights[0] = static_cast<uint8_t>(v.weights[0] + remaining);
+                mesh.vertices.push_back(v);
+            }
+        } else if (command == "f") {
+            uint32_t a, b, c;
+            ok = static_cast<bool>(words >> a >> b >> c) && a >= 1 && b >= 1 && c >= 1;
+            if (ok) {
+                mesh.indices.push_back(a - 1);
+                mesh.indices.push_back(b - 1);
+                mesh.indices.push_back(c - 1);
+            }
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            LOG_ERROR(path << ":" << lineNumber << ": bad line: " << line);
+            return false;
+        }
+    }
+
+    for (uint32_t index : mesh.indices) {
+        if (index >= mesh.vertices.size()) {
+            LOG_ERROR(path << ": face refers to vertex " << index + 1 << " of " << mesh.vertices.size());
+            return false;
+        }
+    }
+    if (skeleton.jointCount() == 0 || mesh.indices.empty()) {
+        LOG_ERROR(path << ": needs at least one joint and one face");
+        return false;
+    }
+
+    mesh.paletteSize = skeleton.jointCount();
+    std::vector<Mat34> model(skeleton.jointCount());
+    computeModelPose(skeleton, skeleton.bindPose.data(), model.data());
+    skeleton.inverseBind.resize(skeleton.jointCount());
+    for (size_t j = 0; j < skeleton.jointCount(); j++) skeleton.inverseBind[j] = model[j].rigidInverse();
+
+    LOG_INFO("Loaded rig " << path << ": " << skeleton.jointCount() << " joints, " << mesh.vertices.size()
+             << " vertices, " << mesh.indices.size() / 3 << " triangles");
+    return true;
+}
+
+// ===============================
+// CPU Skinning
+// ===============================
+void skinVerticesScalar(const SkinnedMesh& mesh, const Mat34* palette, float* positions, float* normals) {
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        const SkinVertex& v = mesh.vertices[i];
+        Mat34 blended = {};
+        for (int k = 0; k < MAX_SKIN_WEIGHTS && v.weights[k]; k++) {
+            const float w = v.weights[k] * (1.0f / 255.0f);
+            const Mat34& joint = palette[v.joints[k]];
+            for (int r = 0; r < 3; r++) {
+                for (int c = 0; c < 4; c++) blended.m[r][c] += w * joint.m[r][c];
+            }
+        }
+        const Vec3 p = blended.transformPoint(Vec3(v.position[0], v.position[1], v.position[2]));
+        Vec3 n(blended.m[0][0] * v.normal[0] + blended.m[0][1] * v.normal[1] + blended.m[0][2] * v.normal[2],
+               blended.m[1][0] * v.normal[0] + blended.m[1][1] * v.normal[1] + blended.m[1][2] * v.normal[2],
+               blended.m[2][0] * v.normal[0] + blended.m[2][1] * v.normal[1] + blended.m[2][2] * v.normal[2]);
+        n.normalize();
+        positions[3 * i] = p.x;
+        positions[3 * i + 1] = p.y;
+        positions[3 * i + 2] = p.z;
+        normals[3 * i] = n.x;
+        normals[3 * i + 1] = n.y;
+        normals[3 * i + 2] = n.z;
+    }
+}
+
+#ifdef FALLAGA_SSE
+void skinVertices(const SkinnedMesh& mesh, const Mat34* palette, float* positions, float* normals) {
+    // The palette as columns (x, y, z axes and translation), so a blended
+    // transform is four weighted sums and applying it four multiply-adds
+    struct Columns {
+        __m128 axis[4];
+    };
+    thread_local std::vector<Columns> columns;
+    columns.resize(mesh.paletteSize);
+    for (size_t j = 0; j < mesh.paletteSize; j++) {
+        __m128 r0 = _mm_load_ps(palette[j].m[0]);
+        __m128 r1 = _mm_load_ps(palette[j].m[1]);
+        __m128 r2 = _mm_load_ps(palette[j].m[2]);
+        __m128 r3 = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        columns[j].axis[0] = r0;
+        columns[j].axis[1] = r1;
+        columns[j].axis[2] = r2;
+        columns[j].axis[3] = r3;
+    }
+
+    alignas(16) float p[4], n[4];
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        const SkinVertex& v = mesh.vertices[i];
+        __m128 cx = _mm_setzero_ps(), cy = _mm_setzero_ps(), cz = _mm_setzero_ps(), ct = _mm_setzero_ps();
+        for (int k = 0; k < MAX_SKIN_WEIGHTS && v.weights[k]; k++) {
+            const __m128 w = _mm_set1_ps(v.weights[k] * (1.0f / 255.0f));
+            const __m128* joint = columns[v.joints[k]].axis;
+            cx = _mm_add_ps(cx, _mm_mul_ps(w, joint[0]));
+            cy = _mm_add_ps(cy, _mm_mul_ps(w, joint[1]));
+            cz = _mm_add_ps(cz, _mm_mul_ps(w, joint[2]));
+            ct = _mm_add_ps(ct, _mm_mul_ps(w, joint[3]));
+        }
+        const __m128 axes = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(v.normal[0])),
+                                                  _mm_mul_ps(cy, _mm_set1_ps(v.normal[1]))),
+                                       _mm_mul_ps(cz, _mm_set1_ps(v.normal[2])));
+        const __m128 moved = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(v.position[0])),
+                                                   _mm_mul_ps(cy, _mm_set1_ps(v.position[1]))),
+                                        _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(v.position[2])), ct));
+        // Lane 3 of `axes` is 0, so the squared length is the sum of all four
+        __m128 squared = _mm_mul_ps(axes, axes);
+        squared = _mm_add_ps(squared, _mm_shuffle_ps(squared, squared, _MM_SHUFFLE(2, 3, 0, 1)));
+        squared = _mm_add_ps(squared, _mm_shuffle_ps(squared, squared, _MM_SHUFFLE(1, 0, 3, 2)));
+        _mm_store_ps(p, moved);
+        _mm_store_ps(n, _mm_div_ps(axes, _mm_sqrt_ps(_mm_max_ps(squared, _mm_set1_ps(1e-20f)))));
+        positions[3 * i] = p[0];
+        positions[3 * i + 1] = p[1];
+        positions[3 * i + 2] = p[2];
+        normals[3 * i] = n[0];
+        normals[3 * i + 1] = n[1];
+        normals[3 * i + 2] = n[2];
+    }
+}
+#else
+void skinVertices(const SkinnedMesh& mesh, const Mat34* palette, float* positions, float* normals) {
+    skinVerticesScalar(mesh, palette, positions, normals);
+}
+#endif
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Quat.h"
+#include "Vec3.h"
+
+// Local transform of one joint relative to its parent
+struct JointPose {
+    Quat rotation;
+    Vec3 translation;
+};
+
+// Affine transform as three rows of four (rotation and translation), the
+// layout the skinning shader reads as three vec4s per joint
+struct alignas(16) Mat34 {
+    float m[3][4];
+
+    static Mat34 identity();
+    static Mat34 fromPose(const JointPose& pose);
+    // This transform after `other`
+    Mat34 operator*(const Mat34& other) const;
+    Vec3 transformPoint(const Vec3& p) const;
+    // Inverse of a rotation plus translation (no scale)
+    Mat34 rigidInverse() const;
+};
+
+// Joint hierarchy; parents always come before their children, so poses
+// can be composed in one pass from the root
+struct Skeleton {
+    std::vector<std::string> names;
+    std::vector<int> parents; // -1 for the root
+    std::vector<JointPose> bindPose;
+    std::vector<Mat34> inverseBind; // model space to joint space, in bind pose
+
+    size_t jointCount() const { return names.size(); }
+    // Index of the joint called `name`, or -1
+    int find(const std::string& name) const;
+};
+
+// At most this many joints move one vertex
+const int MAX_SKIN_WEIGHTS = 4;
+// Joint indices are bytes
+const size_t MAX_SKIN_JOINTS = 256;
+
+// Bind-pose vertex and the joints that move it; weights are in 1/255ths
+// and sum to 255, unused slots have weight 0
+struct SkinVertex {
+    float position[3];
+    float normal[3];
+    uint8_t joints[MAX_SKIN_WEIGHTS];
+    uint8_t weights[MAX_SKIN_WEIGHTS];
+};
+
+struct SkinnedMesh {
+    std::vector<SkinVertex> vertices;
+    std::vector<uint32_t> indices; // triangles, counter-clockwise
+    size_t paletteSize = 0;        // matrices per palette: the skeleton's joints
+};
+
+// Reads a rig in the text format below ('#' starts a comment). Joints come
+// parents first; joints and vertices are numbered from 1 in file order,
+// as in OBJ.
+//
+//   joint <name> <parent name or -> <tx ty tz> [<qx qy qz qw>]   bind pose, local
+//   v <x y z> <nx ny nz> <joint weight> [<joint weight> ...]     up to 4 pairs
+//   f <a> <b> <c>
+//
+// Weights are normalized on load. False (with a message) on any error.
+bool loadSkinnedModel(const std::string& path, Skeleton& skeleton, SkinnedMesh& mesh);
+
+// Model-space joint transforms of the local pose `local`
+void computeModelPose(const Skeleton& skeleton, const JointPose* local, Mat34* model);
+// Skinning matrices: `placement` * model pose * inverse bind, per joint
+void computePalette(const Skeleton& skeleton, const JointPose* local, const Mat34& placement, Mat34* palette);
+
+// CPU skinning with SSE where available: positions and normals of `mesh`
+// moved by `palette`, three floats per vertex each. For headless runs and
+// drivers without vertex texture fetch; the GPU path does the same.
+void skinVertices(const SkinnedMesh& mesh, const Mat34* palette, float* positions, float* normals);
+// Plain C++ version of skinVertices, for comparison
+void skinVerticesScalar(const SkinnedMesh& mesh, const Mat34* palette, float* positions, float* normals);
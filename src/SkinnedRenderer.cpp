@@ -0,0 +1,261 @@
+#include "SkinnedRenderer.h"
+#include "GlState.h"
+#include "ObjectModel.h"
+#include "Profiler.h"
+#include "Log.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Generic attribute slots; 1, 6 and 7 are not aliased to any fixed-function
+// array on the drivers that alias (see InstancedRenderer.cpp)
+const GLuint SKIN_JOINTS = 1;
+const GLuint SKIN_WEIGHTS = 6;
+const GLuint PALETTE_ROW = 7;
+const int TEXELS_PER_JOINT = 3;
+
+// Same lighting as the instancing shader; the palette is read with
+// texture2DLod at texel centres, so it must not be filtered
+const char* VERTEX_SHADER = R"(
+#version 120
+uniform sampler2D palettes;
+uniform vec2 paletteScale; // 1 / texture size
+attribute vec4 skinJoints;
+attribute vec4 skinWeights;
+attribute float paletteRow;
+varying vec4 litColor;
+
+vec4 fetch(float joint, float r) {
+    vec2 at = vec2((joint * 3.0 + r + 0.5) * paletteScale.x, (paletteRow + 0.5) * paletteScale.y);
+    return texture2DLod(palettes, at, 0.0);
+}
+
+void main() {
+    vec4 r0 = vec4(0.0), r1 = vec4(0.0), r2 = vec4(0.0);
+    for (int k = 0; k < 4; k++) {
+        float w = skinWeights[k];
+        if (w > 0.0) {
+            r0 += w * fetch(skinJoints[k], 0.0);
+            r1 += w * fetch(skinJoints[k], 1.0);
+            r2 += w * fetch(skinJoints[k], 2.0);
+        }
+    }
+    vec4 p = vec4(gl_Vertex.xyz, 1.0);
+    vec3 world = vec3(dot(r0, p), dot(r1, p), dot(r2, p));
+    vec3 n = vec3(dot(r0.xyz, gl_Normal), dot(r1.xyz, gl_Normal), dot(r2.xyz, gl_Normal));
+
+    vec3 eyeNormal = normalize(gl_NormalMatrix * n);
+    vec3 lightDir = normalize(gl_LightSource[0].position.xyz);
+    float diffuse = max(dot(eyeNormal, lightDir), 0.0);
+    vec4 ambient = gl_LightModel.ambient + gl_LightSource[0].ambient;
+    litColor = gl_Color * ambient + gl_Color * gl_LightSource[0].diffuse * diffuse;
+    litColor.a = gl_Color.a;
+
+    gl_Position = gl_ModelViewProjectionMatrix * vec4(world, 1.0);
+}
+)";
+
+const char* FRAGMENT_SHADER = R"(
+#version 120
+varying vec4 litColor;
+
+void main() {
+    gl_FragColor = litColor;
+}
+)";
+
+GLuint compileShader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        LOG_ERROR("Skinning shader failed to compile: " << log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+} // namespace
+
+SkinnedRenderer::SkinnedRenderer(const SkinnedMesh& mesh, const Vec3& color) : mesh(mesh), color(color) {
+    GLint vertexTextureUnits = 0;
+    glGetIntegerv(GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS, &vertexTextureUnits);
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    const char* cpu = std::getenv("FALLAGA_CPU_SKINNING");
+    const bool supported = (GLEW_VERSION_3_3 || (GLEW_ARB_instanced_arrays && GLEW_ARB_draw_instanced))
+                           && (GLEW_VERSION_3_0 || GLEW_ARB_texture_float) && vertexTextureUnits > 0
+                           && static_cast<GLint>(mesh.paletteSize * TEXELS_PER_JOINT) <= maxTextureSize;
+    if (cpu && std::strcmp(cpu, "1") == 0) {
+        LOG_INFO("Skinning on the CPU (FALLAGA_CPU_SKINNING)");
+    } else if (!supported || !compileProgram()) {
+        LOG_INFO("GPU skinning unavailable, skinning on the CPU");
+    }
+    if (program) createBuffers();
+}
+
+SkinnedRenderer::~SkinnedRenderer() {
+    GlState& state = GlState::get();
+    if (program) state.deleteProgram(program);
+    if (vao) state.deleteVertexArrays(1, &vao);
+    if (vertexBuffer) glDeleteBuffers(1, &vertexBuffer);
+    if (indexBuffer) glDeleteBuffers(1, &indexBuffer);
+    if (rowBuffer) glDeleteBuffers(1, &rowBuffer);
+    if (paletteTexture) state.deleteTextures(1, &paletteTexture);
+}
+
+bool SkinnedRenderer::compileProgram() {
+    GLuint vs = compileShader(GL_VERTEX_SHADER, VERTEX_SHADER);
+    GLuint fs = compileShader(GL_FRAGMENT_SHADER, FRAGMENT_SHADER);
+    if (!vs || !fs) {
+        if (vs) glDeleteShader(vs);
+        if (fs) glDeleteShader(fs);
+        return false;
+    }
+
+    program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glBindAttribLocation(program, SKIN_JOINTS, "skinJoints");
+    glBindAttribLocation(program, SKIN_WEIGHTS, "skinWeights");
+    glBindAttribLocation(program, PALETTE_ROW, "paletteRow");
+    glLinkProgram(program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+        LOG_ERROR("Skinning shader failed to link: " << log);
+        glDeleteProgram(program);
+        program = 0;
+        return false;
+    }
+
+    GlState::get().useProgram(program);
+    glUniform1i(glGetUniformLocation(program, "palettes"), 0);
+    paletteScaleLocation = glGetUniformLocation(program, "paletteScale");
+    return true;
+}
+
+void SkinnedRenderer::createBuffers() {
+    glGenBuffers(1, &vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(SkinVertex), mesh.vertices.data(), GL_STATIC_DRAW);
+    glGenBuffers(1, &rowBuffer);
+
+    // Fixed-function and generic arrays; in a compatibility context both
+    // are VAO state, as is the index buffer
+    const GLsizei stride = sizeof(SkinVertex);
+    GlState& state = GlState::get();
+    glGenVertexArrays(1, &vao);
+    state.bindVertexArray(vao);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, stride, reinterpret_cast<const void*>(offsetof(SkinVertex, position)));
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glNormalPointer(GL_FLOAT, stride, reinterpret_cast<const void*>(offsetof(SkinVertex, normal)));
+    glEnableVertexAttribArray(SKIN_JOINTS);
+    glVertexAttribPointer(SKIN_JOINTS, MAX_SKIN_WEIGHTS, GL_UNSIGNED_BYTE, GL_FALSE, stride,
+                          reinterpret_cast<const void*>(offsetof(SkinVertex, joints)));
+    glEnableVertexAttribArray(SKIN_WEIGHTS);
+    glVertexAttribPointer(SKIN_WEIGHTS, MAX_SKIN_WEIGHTS, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                          reinterpret_cast<const void*>(offsetof(SkinVertex, weights)));
+    glBindBuffer(GL_ARRAY_BUFFER, rowBuffer);
+    glEnableVertexAttribArray(PALETTE_ROW);
+    glVertexAttribPointer(PALETTE_ROW, 1, GL_FLOAT, GL_FALSE, sizeof(float), nullptr);
+    glVertexAttribDivisor(PALETTE_ROW, 1);
+    glGenBuffers(1, &indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(uint32_t), mesh.indices.data(),
+                 GL_STATIC_DRAW);
+    state.bindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    glGenTextures(1, &paletteTexture);
+    state.bindTexture(0, paletteTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+// ===============================
+// Rendering
+// ===============================
+void SkinnedRenderer::render(const std::vector<Mat34>& palettes, size_t count) {
+    PROFILE_GPU_SCOPE("SkinnedRenderer::render");
+    count = std::min(count, mesh.paletteSize ? palettes.size() / mesh.paletteSize : 0);
+    if (count == 0) return;
+    glColor3f(color.x, color.y, color.z);
+    if (program) renderGpu(palettes, count);
+    else renderCpu(palettes, count);
+    glColor3f(1.0f, 1.0f, 1.0f);
+}
+
+void SkinnedRenderer::renderGpu(const std::vector<Mat34>& palettes, size_t count) {
+    const size_t width = mesh.paletteSize * TEXELS_PER_JOINT;
+    const size_t rowsPerDraw = std::min(count, static_cast<size_t>(maxTextureSize));
+    if (rowCapacity < rowsPerDraw) {
+        std::vector<float> rows(rowsPerDraw);
+        for (size_t i = 0; i < rowsPerDraw; i++) rows[i] = static_cast<float>(i);
+        glBindBuffer(GL_ARRAY_BUFFER, rowBuffer);
+        glBufferData(GL_ARRAY_BUFFER, rows.size() * sizeof(float), rows.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        rowCapacity = rowsPerDraw;
+    }
+
+    GlState& state = GlState::get();
+    state.useProgram(program);
+    state.bindTexture(0, paletteTexture);
+    if (textureRows < rowsPerDraw) {
+        // Grows only; rows past the copies drawn are never read
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, static_cast<GLsizei>(width), static_cast<GLsizei>(rowsPerDraw),
+                     0, GL_RGBA, GL_FLOAT, nullptr);
+        textureRows = rowsPerDraw;
+    }
+    glUniform2f(paletteScaleLocation, 1.0f / width, 1.0f / textureRows);
+    state.bindVertexArray(vao);
+
+    // More copies than the texture has rows take several draws
+    const GLsizei indexCount = static_cast<GLsizei>(mesh.indices.size());
+    for (size_t first = 0; first < count; first += rowsPerDraw) {
+        const size_t n = std::min(rowsPerDraw, count - first);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, static_cast<GLsizei>(width), static_cast<GLsizei>(n), GL_RGBA,
+                        GL_FLOAT, &palettes[first * mesh.paletteSize]);
+        glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(n));
+        ObjModel::addDrawStats(1, mesh.indices.size() / 3 * n);
+    }
+}
+
+void SkinnedRenderer::renderCpu(const std::vector<Mat34>& palettes, size_t count) {
+    positions.resize(3 * mesh.vertices.size());
+    normals.resize(3 * mesh.vertices.size());
+    // Client arrays and the fixed-function pipeline: nothing of the
+    // previous draw may stay bound
+    GlState& state = GlState::get();
+    state.useProgram(0);
+    state.bindVertexArray(0);
+    state.disable(GL_TEXTURE_2D);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, positions.data());
+    glNormalPointer(GL_FLOAT, 0, normals.data());
+    for (size_t i = 0; i < count; i++) {
+        skinVertices(mesh, &palettes[i * mesh.paletteSize], positions.data(), normals.data());
+        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(mesh.indices.size()), GL_UNSIGNED_INT, mesh.indices.data());
+        ObjModel::addDrawStats(1, mesh.indices.size() / 3);
+    }
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <GL/glew.h>
+#include "Skeleton.h"
+#include "Vec3.h"
+
+// Draws many copies of one skinned mesh, each posed by its own matrix
+// palette (mesh.paletteSize matrices, already in world space).
+//
+// On the GPU path the palettes go to a float texture, three texels per
+// joint and one row per copy, and a single glDrawElementsInstanced draws
+// every copy; the vertex shader blends the palette matrices it reads for
+// each vertex. Drivers without float textures or vertex texture fetch,
+// or FALLAGA_CPU_SKINNING=1, skin on the CPU with skinVertices() and draw
+// copy by copy.
+class SkinnedRenderer {
+public:
+    // `mesh` must outlive the renderer; it is drawn lit in `color`
+    SkinnedRenderer(const SkinnedMesh& mesh, const Vec3& color);
+    ~SkinnedRenderer();
+    SkinnedRenderer(const SkinnedRenderer&) = delete;
+    SkinnedRenderer& operator=(const SkinnedRenderer&) = delete;
+
+    // Copy i is posed by palettes[i * paletteSize ...]
+    void render(const std::vector<Mat34>& palettes, size_t count);
+
+    bool isGpuSkinning() const { return program != 0; }
+    // For render queue keys: 0 on the CPU path
+    GLuint getProgram() const { return program; }
+    GLuint getVertexArray() const { return vao; }
+
+private:
+    bool compileProgram();
+    void createBuffers();
+    void renderGpu(const std::vector<Mat34>& palettes, size_t count);
+    void renderCpu(const std::vector<Mat34>& palettes, size_t count);
+
+    const SkinnedMesh& mesh;
+    Vec3 color;
+
+    GLuint program = 0;
+    GLint paletteScaleLocation = -1;
+    GLuint vao = 0, vertexBuffer = 0, indexBuffer = 0;
+    GLuint rowBuffer = 0;     // 0, 1, 2, ... per copy: its palette row
+    size_t rowCapacity = 0;
+    GLuint paletteTexture = 0;
+    GLint maxTextureSize = 0;
+    size_t textureRows = 0;   // rows allocated in paletteTexture
+
+    // CPU path scratch
+    std::vector<float> positions, normals;
+};
@@ -2,43 +2,299 @@
 #include <GLFW/glfw3.h>
 #include <GL/glut.h>
 #include "Terrain.h"
+#include "AssetStreamer.h"
+#include "JobSystem.h"
+#include "Mat4.h"
+#include "TilePager.h"
 #include "ObjectModel.h"
+#include "Profiler.h"
+#include "Log.h"
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
-#include <iostream>
+#include <memory>
 
-Terrain::Terrain() : treeModel(nullptr), rockModel(nullptr), terrainModel(nullptr) {
-    srand(static_cast<unsigned>(time(nullptr)));
+namespace {
+
+// Props per job when placing them
+const size_t PROPS_PER_JOB = 2048;
+// Placements composed at a time, on the stack, for the bounds kernel
+const size_t BOUNDS_BATCH = 64;
+
+} // namespace
+
+Terrain::Terrain(World& world, int treeCount, int rockCount, AssetStreamer* streamer, unsigned seed)
+    : world(world), treeModel(nullptr), rockModel(nullptr), terrainModel(nullptr), ground(nullptr), streamer(streamer),
+      props(nullptr) {
+    srand(seed ? seed : static_cast<unsigned>(time(nullptr)));
     
-    // Create models by loading from files
-    terrainModel = new ObjModel("assets/terrain/untitled.obj");
-    treeModel = new ObjModel("assets/Tree_02/Tree.obj");
-    rockModel = new ObjModel("assets/Rock1/Rock1.obj");
+    // Create models by loading from files (in the background with a streamer)
+    // The ground is always drawn whole, so it gets no detail levels
+    terrainModel = new ObjModel("assets/terrain/untitled.obj", 1, streamer);
+    treeModel = new ObjModel("assets/Tree_02/Tree.obj", 4, streamer);
+    rockModel = new ObjModel("assets/Rock1/Rock1.obj", 4, streamer);
+
+    // Scatter over [-50, 50) in 1cm steps so large counts don't stack up
+    auto randomCoord = [] { return (rand() % 10000) / 100.0f - 50.0f; };
 
     // Generate random trees
-    trees.reserve(20);
-    for (int i = 0; i < 20; i++) {
-        Tree t;
-        t.x = static_cast<float>((rand() % 100) - 50);
-        t.z = static_cast<float>((rand() % 100) - 50);
-        t.y = getHeight(t.x, t.z);
-        trees.push_back(t);
+    for (int i = 0; i < treeCount; i++) {
+        Transform t = { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f };
+        t.x = randomCoord();
+        t.z = randomCoord();
+        world.create(t, Bounds(), RenderMesh{ treeModel, -1 }, TreeTag());
     }
 
     // Generate random rocks
-    rocks.reserve(10);
-    for (int i = 0; i < 10; i++) {
-        Rock r;
-        r.x = static_cast<float>((rand() % 100) - 50);
-        r.z = static_cast<float>((rand() % 100) - 50);
-        r.y = getHeight(r.x, r.z);
-        r.size = static_cast<float>((rand() % 5 + 2) / 10.0f);
-        rocks.push_back(r);
+    for (int i = 0; i < rockCount; i++) {
+        Transform r = { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f };
+        r.x = randomCoord();
+        r.z = randomCoord();
+        r.scale = static_cast<float>((rand() % 5 + 2) / 10.0f);
+        world.create(r, Bounds(), RenderMesh{ rockModel, -1 }, RockTag());
+    }
+
+    const std::string tiles = tileFilePath();
+    if (!tiles.empty()) {
+        pager = new TilePager();
+        if (pager->open(tiles)) {
+            LOG_INFO("Paging terrain heights from " << tiles << " within "
+                     << (pager->getStats().budgetBytes >> 20) << " MB");
+        } else {
+            LOG_WARN("Could not read terrain tiles: " << tiles);
+            delete pager;
+            pager = nullptr;
+        }
+    }
+
+    props = new InstancedRenderer();
+    if (!groundMeshForced()) {
+        ground = new CdlodTerrain();
+        if (!ground->isSupported()) {
+            delete ground;
+            ground = nullptr;
+        }
+    }
+    placeProps();
+
+    LOG_INFO("Placed " << world.count<TreeTag>() << " trees and " << world.count<RockTag>() << " rocks");
+}
+
+int Terrain::loadedModels() const {
+    return (terrainModel->isLoaded() ? 1 : 0) | (treeModel->isLoaded() ? 2 : 0) | (rockModel->isLoaded() ? 4 : 0);
+}
+
+void Terrain::update() {
+    // Heights, bounds and LOD counts change when a streamed model arrives;
+    // props placed on a fallback height move once their tile pages in
+    if (loadedModels() != placedWith) placeProps();
+    else if (pager && !fallbackObjects.empty() && pager->getGeneration() != placedGeneration) replaceFallbackProps();
+    if (ground && !resampleStarted && terrainModel->isLoaded()) startResample();
+}
+
+std::string Terrain::tileFilePath() {
+    if (const char* env = std::getenv("FALLAGA_TERRAIN_TILES")) return env;
+    // Baked with `bake --tiles`; optional
+    const char* baked = "assets/terrain/untitled.ftiles";
+    FILE* file = std::fopen(baked, "rb");
+    if (!file) return std::string();
+    std::fclose(file);
+    return baked;
+}
+
+bool Terrain::groundMeshForced() {
+    const char* env = std::getenv("FALLAGA_TERRAIN_MESH");
+    return env && std::strcmp(env, "0") != 0;
+}
+
+// Sampling the mesh is a few hundred thousand height queries for a large
+// ground, so with a streamer it runs on a worker and only the texture
+// upload happens on the GL thread. Until then the mesh is drawn.
+void Terrain::startResample() {
+    resampleStarted = true;
+    Vec3 groundMin, groundMax;
+    terrainModel->getBounds(groundMin, groundMax);
+    auto field = std::make_shared<HeightField>();
+    auto ok = std::make_shared<bool>(false);
+    const ObjModel* model = terrainModel;
+    auto load = [model, field, ok] { *ok = resampleHeightField(*model, *field); };
+    auto upload = [this, field, ok, groundMin, groundMax](size_t& bytes) {
+        if (*ok) {
+            bytes += field->heights.size() * sizeof(float);
+            ground->setHeightField(std::move(*field), groundMin, groundMax);
+        }
+        return true;
+    };
+    if (streamer) {
+        streamer->submit(load, upload);
+    } else {
+        size_t bytes = 0;
+        load();
+        upload(bytes);
+    }
+}
+
+void Terrain::placeProps() {
+    placedWith = loadedModels();
+
+    // Every prop, trees then rocks. sceneEntities keeps this order for the
+    // quadtree, the colliders and later re-placements, whichever archetype
+    // a prop moves to.
+    sceneEntities.clear();
+    sceneEntities.reserve(world.count<TreeTag>() + world.count<RockTag>());
+    world.eachChunk<TreeTag>([this](size_t count, const Entity* entities, TreeTag*) {
+        sceneEntities.insert(sceneEntities.end(), entities, entities + count);
+    });
+    world.eachChunk<RockTag>([this](size_t count, const Entity* entities, RockTag*) {
+        sceneEntities.insert(sceneEntities.end(), entities, entities + count);
+    });
+
+    // Drop everything onto the ground with one batched height query; until
+    // the ground is loaded the props wait at y = 0
+    std::vector<Vec3> points;
+    points.reserve(sceneEntities.size());
+    for (Entity e : sceneEntities) {
+        const Transform& t = *world.get<Transform>(e);
+        points.push_back(Vec3(t.x, 0.0f, t.z));
+    }
+    std::vector<float> heights;
+    std::vector<TilePager::Sample> samples;
+    if (pager) placedGeneration = pager->getGeneration();
+    sampleHeights(points, heights, samples);
+    fallbackObjects.clear();
+    for (uint32_t object = 0; object < sceneEntities.size(); object++) {
+        settleProp(object, heights[object], samples[object]);
+        if (samples[object] == TilePager::FALLBACK) fallbackObjects.push_back(object);
+    }
+
+    // World bounds for culling, and a fresh start for LOD selection
+    JobSystem& jobs = JobSystem::get();
+    auto placeBounds = [&jobs](const ObjModel* model) {
+        ObjectBounds local;
+        model->getBounds(local.min, local.max);
+        return [&jobs, local](size_t count, const Entity*, Transform* transforms, Bounds* bounds, auto*) {
+            jobs.parallelFor(count, PROPS_PER_JOB, [=](size_t begin, size_t end) {
+                Mat4 placements[BOUNDS_BATCH];
+                for (size_t first = begin; first < end; first += BOUNDS_BATCH) {
+                    const size_t n = std::min(BOUNDS_BATCH, end - first);
+                    composeTransforms(transforms + first, n, placements);
+                    transformBounds(local, placements, n, bounds + first);
+                }
+            });
+        };
+    };
+    world.eachChunk<Transform, Bounds, TreeTag>(placeBounds(treeModel));
+    world.eachChunk<Transform, Bounds, RockTag>(placeBounds(rockModel));
+    world.each<RenderMesh>([](RenderMesh& mesh) { mesh.lod = -1; });
+
+    // The visible instances are uploaded each frame and drawn with one call
+    // per material and level of detail
+    props->clearBatches();
+    treeBatches.clear();
+    rockBatches.clear();
+    for (int lod = 0; lod < treeModel->getLodCount(); lod++) treeBatches.push_back(props->addBatch(treeModel, lod));
+    for (int lod = 0; lod < rockModel->getLodCount(); lod++) rockBatches.push_back(props->addBatch(rockModel, lod));
+    visibleByBatch.assign(treeBatches.size() + rockBatches.size(), std::vector<InstanceData>());
+
+    // Scene quadtree over the props, then the ground
+    std::vector<ObjectBounds> objects;
+    objects.reserve(sceneEntities.size() + 1);
+    for (Entity e : sceneEntities) objects.push_back(*world.get<Bounds>(e));
+    ObjectBounds ground;
+    terrainModel->getBounds(ground.min, ground.max);
+    objects.push_back(ground);
+    sceneTree.build(objects);
+
+    // The same props as colliders, against their models' full triangles
+    if (treeCollider < 0 && treeModel->isLoaded())
+        treeCollider = collision.addMesh("tree", CollisionMesh::fromTriangles(treeModel->getBvh().getTriangles()));
+    if (rockCollider < 0 && rockModel->isLoaded())
+        rockCollider = collision.addMesh("rock", CollisionMesh::fromTriangles(rockModel->getBvh().getTriangles()));
+    std::vector<CollisionInstance> colliders;
+    colliders.reserve(sceneEntities.size());
+    for (Entity e : sceneEntities) colliders.push_back(colliderFor(e));
+    collision.setStatics(colliders);
+}
+
+// Props placed on a tile that wasn't resident yet only had its mean
+// height. Once tiles page in, just those props are sampled again, and the
+// ones now on a resident tile move to their exact height: their bounds,
+// quadtree boxes and colliders are updated in place, without a rebuild.
+void Terrain::replaceFallbackProps() {
+    PROFILE_SCOPE("Terrain::replaceFallbackProps");
+    placedGeneration = pager->getGeneration();
+
+    std::vector<Vec3> points;
+    points.reserve(fallbackObjects.size());
+    for (uint32_t object : fallbackObjects) {
+        const Transform& t = *world.get<Transform>(sceneEntities[object]);
+        points.push_back(Vec3(t.x, 0.0f, t.z));
     }
+    std::vector<float> heights;
+    std::vector<TilePager::Sample> samples;
+    sampleHeights(points, heights, samples);
+
+    std::vector<uint32_t> settled, waiting;
+    std::vector<CollisionInstance> colliders;
+    for (size_t i = 0; i < fallbackObjects.size(); i++) {
+        const uint32_t object = fallbackObjects[i];
+        if (samples[i] == TilePager::FALLBACK) {
+            waiting.push_back(object);
+            continue;
+        }
+        settleProp(object, heights[i], samples[i]);
+
+        const Entity e = sceneEntities[object];
+        const Transform& t = *world.get<Transform>(e);
+        const Mat4 placement = Mat4::fromTransform(t);
+        ObjectBounds local;
+        (world.has<TreeTag>(e) ? treeModel : rockModel)->getBounds(local.min, local.max);
+        Bounds& bounds = *world.get<Bounds>(e);
+        transformBounds(local, &placement, 1, &bounds);
+        sceneTree.move(object, bounds);
+        settled.push_back(object);
+        colliders.push_back(colliderFor(e));
+    }
+    collision.updateStatics(settled.data(), colliders.data(), settled.size());
+    fallbackObjects.swap(waiting);
+    if (!settled.empty())
+        LOG_DEBUG("Re-placed " << settled.size() << " props on new tiles, " << fallbackObjects.size() << " still waiting");
+}
+
+// Puts a prop at `height`. Trees don't grow on rock: those lose their
+// RenderMesh, and get it back if a later placement puts them on grass.
+void Terrain::settleProp(uint32_t object, float height, TilePager::Sample sample) {
+    const Entity e = sceneEntities[object];
+    Transform& t = *world.get<Transform>(e);
+    t.y = height;
+    if (!world.has<TreeTag>(e)) return;
+
+    TileMaterial material = TileMaterial::GRASS;
+    if (sample != TilePager::OUTSIDE) pager->materialAt(t.x, t.z, material);
+    const bool drawn = world.has<RenderMesh>(e);
+    if (material == TileMaterial::ROCK && drawn) world.remove<RenderMesh>(e);
+    if (material != TileMaterial::ROCK && !drawn) world.add(e, RenderMesh{ treeModel, -1 });
+}
+
+// A drawn prop collides once its model is in; a hidden one holds its
+// place without colliding
+CollisionInstance Terrain::colliderFor(Entity prop) const {
+    const RenderMesh* mesh = world.get<RenderMesh>(prop);
+    int collider = -1;
+    if (mesh) collider = mesh->model == treeModel ? treeCollider : rockCollider;
+    return { collider, *world.get<Transform>(prop) };
 }
 
 Terrain::~Terrain() {
+    // The props' RenderMesh points at the models deleted below
+    world.destroyAll<TreeTag>();
+    world.destroyAll<RockTag>();
+    delete pager;
+    delete ground;
+    delete props;
     delete treeModel;
     delete rockModel;
     delete terrainModel;
@@ -48,74 +304,114 @@ Terrain::~Terrain() {
 // void Terrain::createDisplayLists() {}
 
 float Terrain::getHeight(float x, float z) const {
+    float height = 0.0f;
+    TilePager::Sample sample = pager ? pager->heightAt(x, z, height) : TilePager::OUTSIDE;
+    if (sample == TilePager::EXACT) return height;
+
     ObjModel* model = terrainModel; // Use the member variable directly
     if (!model) {
-        std::cerr << "Error: Terrain model not available for height check." << std::endl;
-        return 0.0f;
+        LOG_ERROR("Terrain model not available for height check.");
+        return height;
     }
+    // Past the tiles, or on one that isn't resident yet, the mesh is exact
+    // once it has loaded; before that a fallback height beats none
+    if (sample == TilePager::FALLBACK && !model->isLoaded()) return height;
 
-    // Get the maximum Y-coordinate of the terrain model to ensure the ray starts above it.
-    float minY, maxY;
-    model->getMinMaxY(minY, maxY);
-    
-    // Set the ray origin to be slightly above the highest point of the model.
-    // This is a much more robust solution than a fixed value like 1000.0f.
-    const float rayStartHeight = maxY + 1.0f; 
-    Vec3 rayOrigin = { x, rayStartHeight, z };
-    Vec3 rayDir = { 0.0f, -1.0f, 0.0f };
-
-    float maxHeight = -std::numeric_limits<float>::max();
-    float t = 0.0f;
-
-    for (const auto& face : model->temp_faces) {
-        // It's crucial to check that the indices are valid before accessing the vector.
-        int v0_idx = face.v[0] - 1;
-        int v1_idx = face.v[1] - 1;
-        int v2_idx = face.v[2] - 1;
-
-        if (v0_idx < 0 || v1_idx < 0 || v2_idx < 0 || 
-            v0_idx >= model->temp_vertices.size() || v1_idx >= model->temp_vertices.size() || v2_idx >= model->temp_vertices.size()) {
+    // The model answers from its XZ triangle grid, casting from just above its highest point
+    return model->getHeightAt(x, z);
+}
+
+void Terrain::getHeights(const std::vector<Vec3>& points, std::vector<float>& out) const {
+    std::vector<TilePager::Sample> samples;
+    sampleHeights(points, out, samples);
+}
+
+// getHeight() for many points at once: the mesh's batched query, then
+// resident tiles on top. The index's fallback heights are only better
+// than nothing, so they don't override a loaded mesh.
+void Terrain::sampleHeights(const std::vector<Vec3>& points, std::vector<float>& out,
+                            std::vector<TilePager::Sample>& samples) const {
+    out.assign(points.size(), 0.0f);
+    if (terrainModel->isLoaded()) terrainModel->getHeightsAt(points, out);
+    samples.assign(points.size(), TilePager::OUTSIDE);
+    if (!pager) return;
+    std::vector<float> paged;
+    pager->heightsAt(points, paged, samples);
+    for (size_t i = 0; i < points.size(); i++) {
+        if (samples[i] == TilePager::EXACT || (samples[i] == TilePager::FALLBACK && !terrainModel->isLoaded()))
+            out[i] = paged[i];
+    }
+}
+
+void Terrain::updatePaging(const Vec3& position, const Vec3& velocity) {
+    if (pager) pager->update(position, velocity);
+}
+
+void Terrain::enqueue(const Camera& camera, RenderQueue& queue) const {
+    PROFILE_SCOPE("Terrain::enqueue");
+    visibleObjects.clear();
+    cullStats = CullStats();
+    sceneTree.query(camera.getFrustum(), visibleObjects, cullStats);
+
+    bool groundVisible = false;
+    trianglesSubmitted = trianglesWithoutLod = 0;
+    for (auto& list : visibleByBatch) list.clear();
+    for (uint32_t object : visibleObjects) {
+        if (object == sceneEntities.size()) {
+            groundVisible = true;
             continue;
         }
 
-        const Vec3& v0 = model->temp_vertices[v0_idx];
-        const Vec3& v1 = model->temp_vertices[v1_idx];
-        const Vec3& v2 = model->temp_vertices[v2_idx];
-
-        if (model->rayTriangleIntersect(rayOrigin, rayDir, v0, v1, v2, t)) {
-            float intersectionY = rayOrigin.y + t * rayDir.y;
-            if (intersectionY > maxHeight) {
-                maxHeight = intersectionY;
-            }
+        // Trees on rock stay in the quadtree but aren't drawn
+        const Entity entity = sceneEntities[object];
+        RenderMesh* drawn = world.get<RenderMesh>(entity);
+        if (!drawn) {
+            cullStats.drawn--;
+            cullStats.culled++;
+            continue;
         }
+
+        // Pick the level from the prop's projected bounding sphere
+        const Transform& instance = *world.get<Transform>(entity);
+        RenderMesh& mesh = *drawn;
+        const ObjModel* model = mesh.model;
+        Vec3 center;
+        float radius;
+        model->getBoundingSphere(center, radius);
+        center = Vec3(instance.x, instance.y, instance.z) + center * instance.scale;
+        int lod = model->selectLod(camera.screenSize(center, radius * instance.scale), mesh.lod);
+        mesh.lod = static_cast<int8_t>(lod);
+
+        int batch = model == treeModel ? treeBatches[lod] : rockBatches[lod];
+        visibleByBatch[batch].push_back({ instance.x, instance.y, instance.z, instance.scale, instance.yaw });
+        trianglesSubmitted += model->getLodTriangles(lod);
+        trianglesWithoutLod += model->getLodTriangles(0);
     }
 
-    // Debug output to help you see the result
-    std::cout << "Height at (" << x << ", " << z << ") = " << maxHeight << std::endl;
-    
-    return (maxHeight == -std::numeric_limits<float>::max()) ? 0.0f : maxHeight;
+    groundCamera = &camera;
+    if (groundVisible && usingCdlod()) {
+        const uint64_t key = queue.makeKey(RenderPass::Opaque, ground->getProgram(), terrainModel->getTextureName(),
+                                           0, 0.0f);
+        queue.push(key, submitGround, this);
+        trianglesWithoutLod += terrainModel->getLodTriangles(0);
+    } else if (groundVisible) {
+        queue.push(queue.makeKey(RenderPass::FixedFunction, 0, 0, 0, 0.0f), submitGround, this);
+        trianglesSubmitted += terrainModel->getLodTriangles(0);
+        trianglesWithoutLod += terrainModel->getLodTriangles(0);
+    }
+
+    for (size_t batch = 0; batch < visibleByBatch.size(); batch++)
+        props->setInstances(static_cast<int>(batch), visibleByBatch[batch], true);
+    props->enqueue(queue);
 }
 
-void Terrain::render() const {
-    glPushMatrix();
-  //  glTranslatef(0.0f, -1.5f, 0.0f);
-   // glScalef(50.0f, 50.0f, 50.0f);
-    terrainModel->render();
-    glPopMatrix();
-    
-    for (const auto& t : trees) {
-        glPushMatrix();
-        glTranslatef(t.x, t.y, t.z);
-        glScalef(1.0f, 1.0f, 1.0f);
-        treeModel->render();
-        glPopMatrix();
-    }
-    
-    for (const auto& r : rocks) {
-        glPushMatrix();
-        glTranslatef(r.x, r.y, r.z);
-        glScalef(r.size, r.size, r.size);
-        rockModel->render();
-        glPopMatrix();
+void Terrain::submitGround(const void* owner, uint32_t) {
+    const Terrain& self = *static_cast<const Terrain*>(owner);
+    PROFILE_GPU_SCOPE("Terrain::submitGround");
+    if (self.usingCdlod()) {
+        self.ground->render(*self.groundCamera, self.terrainModel->getTextureName());
+        self.trianglesSubmitted += self.ground->getTrianglesDrawn();
+        return;
     }
-}
\ No newline at end of file
+    self.terrainModel->render();
+}
@@ -1,33 +1,112 @@
 #pragma once
+#include <cstdint>
+#include <string>
 #include <vector>
 #include "ObjectModel.h"
-struct Tree {
-    float x, y, z;
-};
+#include "InstancedRenderer.h"
+#include "RenderQueue.h"
+#include "LooseQuadtree.h"
+#include "Camera.h"
+#include "CdlodTerrain.h"
+#include "Collision.h"
+#include "Components.h"
+#include "TilePager.h"
+#include "World.h"
 
-struct Rock {
-    float x, y, z, size;
-};
+class AssetStreamer;
 
 class ObjModel;
 
 class Terrain {
 public:
-    Terrain();
+    // Trees and rocks are created in `world` as entities (Transform, Bounds,
+    // RenderMesh and a TreeTag or RockTag). Prop counts can go well past the
+    // defaults; they are drawn instanced. With a streamer the models load in
+    // the background (see update()). A non-zero seed gives the same layout
+    // every run (benchmarks).
+    Terrain(World& world, int treeCount = 20, int rockCount = 10, AssetStreamer* streamer = nullptr, unsigned seed = 0);
     ~Terrain();
-    void render() const;
+    // Re-places every prop whenever a streamed model has finished loading,
+    // and only those waiting on a fallback height when tiles page in
+    void update();
+    // Queues only what intersects the camera frustum, each prop at the
+    // level of detail its screen size calls for; see getCullStats(). The
+    // camera must outlive the queue's submit().
+    void enqueue(const Camera& camera, RenderQueue& queue) const;
+    const CullStats& getCullStats() const { return cullStats; }
+    // Triangles sent last frame (the ground's once submitted), and what the same props cost at full detail
+    size_t getTrianglesSubmitted() const { return trianglesSubmitted; }
+    size_t getTrianglesWithoutLod() const { return trianglesWithoutLod; }
     ObjModel* getModel() {return terrainModel; };
+    // True when the ground is drawn through CDLOD rather than as the whole
+    // mesh (FALLAGA_TERRAIN_MESH=1 forces the mesh, for comparisons)
+    bool usingCdlod() const { return ground && ground->isReady(); }
+    // From the paged tiles where there are any (see TilePager), otherwise
+    // from the ground mesh
     float getHeight(float x, float z) const;
-    
+    // The same for many points (read as x, z) at once
+    void getHeights(const std::vector<Vec3>& points, std::vector<float>& out) const;
+    // Simulation thread, each tick: moves the paged working set with the player
+    void updatePaging(const Vec3& position, const Vec3& velocity);
+    // Every placed prop as a static collider, rebuilt with the placement;
+    // moving bodies (horses) are added by whoever moves them
+    CollisionWorld& getCollision() { return collision; }
+    const CollisionWorld& getCollision() const { return collision; }
+
 private:
-    std::vector<Tree> trees;
-    std::vector<Rock> rocks;
+    World& world;
+
+    void placeProps();
+    void replaceFallbackProps();
+    void settleProp(uint32_t object, float height, TilePager::Sample sample);
+    CollisionInstance colliderFor(Entity prop) const;
+    int loadedModels() const; // bit per model: ground, tree, rock
+    int placedWith = -1;      // loadedModels() at the last placeProps()
 
+    static void submitGround(const void* owner, uint32_t data);
     void drawTree(float x, float y, float z) const;
     void drawRock(float x, float y, float z, float size) const;
     ObjModel* treeModel;
     ObjModel* rockModel;
     ObjModel* terrainModel;
+
+    // The ground mesh resampled into a height field once it has loaded
+    static bool groundMeshForced();
+    void startResample();
+    CdlodTerrain* ground;
+    AssetStreamer* streamer;
+    bool resampleStarted = false;
+
+    // Out-of-core heights and materials (FALLAGA_TERRAIN_TILES, or the
+    // ground's .ftiles next to its OBJ); null without a tile file. The
+    // ground mesh stays loaded next to it: the tiles page heights and
+    // materials, they don't replace the mesh.
+    static std::string tileFilePath();
+    void sampleHeights(const std::vector<Vec3>& points, std::vector<float>& out,
+                       std::vector<TilePager::Sample>& samples) const;
+    TilePager* pager = nullptr;
+    unsigned placedGeneration = 0;         // pager generation at the last placement
+    std::vector<uint32_t> fallbackObjects; // props placed on a non-resident tile, by object
+
+    InstancedRenderer* props;
+    // One instanced batch per level of detail of each model
+    std::vector<int> treeBatches;
+    std::vector<int> rockBatches;
+
+    // Every prop, then the terrain mesh, by world bounds; enqueue() only
+    // queues what the frustum query returns and has a RenderMesh. The props
+    // don't move, so a hierarchy beats testing each box every frame.
+    LooseQuadtree sceneTree;
+    CollisionWorld collision;
+    int treeCollider = -1; // meshes in `collision`, once their model is in
+    int rockCollider = -1;
+    std::vector<Entity> sceneEntities; // same order as sceneTree and the colliders, without the ground
+    mutable std::vector<uint32_t> visibleObjects;
+    mutable std::vector<std::vector<InstanceData>> visibleByBatch;
+    mutable CullStats cullStats;
+    mutable const Camera* groundCamera = nullptr; // the last enqueue()'s
+    mutable size_t trianglesSubmitted = 0;
+    mutable size_t trianglesWithoutLod = 0;
     
     unsigned int treeDisplayList;
     unsigned int rockDisplayList;
@@ -0,0 +1,198 @@
+#include "TileFile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+// ===============================
+// File Layout
+// ===============================
+// header | index | tile 0 | tile 1 | ...
+// Tiles are row-major (z then x) and each starts on a PAGE_BYTES boundary:
+// (tileCells + 1)^2 float heights, then as many material bytes.
+namespace {
+
+const size_t PAGE_BYTES = 4096;
+// Steeper than this (rise over run, about 35 degrees) is rock
+const float ROCK_SLOPE = 0.7f;
+
+struct TileFileHeader {
+    char magic[4];  // "FTIL"
+    uint32_t version;
+    uint32_t tileCells;
+    uint32_t tilesX, tilesZ;
+    uint32_t cellsX, cellsZ;
+    float originX, originZ;
+    float spacing;
+};
+
+struct TileIndexEntry {
+    uint64_t offset;
+    float minHeight, maxHeight, meanHeight;
+    uint32_t mainMaterial;
+};
+
+inline size_t alignPage(size_t n) {
+    return (n + PAGE_BYTES - 1) & ~(PAGE_BYTES - 1);
+}
+
+size_t tileDataBytes(uint32_t tileCells) {
+    const size_t samples = size_t(tileCells + 1) * (tileCells + 1);
+    return samples * (sizeof(float) + sizeof(uint8_t));
+}
+
+TileMaterial classify(const HeightField& field, int x, int z) {
+    const int last = field.cells;
+    const int x0 = std::max(x - 1, 0), x1 = std::min(x + 1, last);
+    const int z0 = std::max(z - 1, 0), z1 = std::min(z + 1, last);
+    const float dx = (field.at(x1, z) - field.at(x0, z)) / ((x1 - x0) * field.spacing);
+    const float dz = (field.at(x, z1) - field.at(x, z0)) / ((z1 - z0) * field.spacing);
+    return std::sqrt(dx * dx + dz * dz) > ROCK_SLOPE ? TileMaterial::ROCK : TileMaterial::GRASS;
+}
+
+} // namespace
+
+// ===============================
+// Writing
+// ===============================
+bool writeTileFile(const std::string& path, const HeightField& field, uint32_t tileCells) {
+    if (field.cells <= 0 || tileCells == 0) return false;
+
+    TileFileHeader header = {};
+    std::memcpy(header.magic, "FTIL", 4);
+    header.version = TILE_FILE_VERSION;
+    header.tileCells = tileCells;
+    header.tilesX = header.tilesZ = (field.cells + tileCells - 1) / tileCells;
+    header.cellsX = header.cellsZ = field.cells;
+    header.originX = field.originX;
+    header.originZ = field.originZ;
+    header.spacing = field.spacing;
+
+    const size_t tileCount = size_t(header.tilesX) * header.tilesZ;
+    const size_t dataBytes = tileDataBytes(tileCells);
+    const size_t firstTile = alignPage(sizeof(TileFileHeader) + tileCount * sizeof(TileIndexEntry));
+    const int side = static_cast<int>(tileCells) + 1;
+
+    const std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return false;
+
+        // The index is filled in as the tiles are cut, then written in front
+        std::vector<TileIndexEntry> index(tileCount);
+        std::vector<float> heights(size_t(side) * side);
+        std::vector<uint8_t> materials(heights.size());
+        std::vector<char> page(alignPage(dataBytes), 0);
+        file.seekp(static_cast<std::streamoff>(firstTile));
+        for (uint32_t tz = 0; tz < header.tilesZ; tz++) {
+            for (uint32_t tx = 0; tx < header.tilesX; tx++) {
+                TileIndexEntry& entry = index[size_t(tz) * header.tilesX + tx];
+                entry.offset = firstTile + (size_t(tz) * header.tilesX + tx) * page.size();
+                entry.minHeight = INFINITY;
+                entry.maxHeight = -INFINITY;
+                double sum = 0.0;
+                size_t rockCount = 0;
+                for (int z = 0; z < side; z++) {
+                    for (int x = 0; x < side; x++) {
+                        // Past the far edges of the field the edge repeats
+                        const int fx = std::min(static_cast<int>(tx * tileCells) + x, field.cells);
+                        const int fz = std::min(static_cast<int>(tz * tileCells) + z, field.cells);
+                        const float h = field.at(fx, fz);
+                        const TileMaterial material = classify(field, fx, fz);
+                        heights[size_t(z) * side + x] = h;
+                        materials[size_t(z) * side + x] = static_cast<uint8_t>(material);
+                        entry.minHeight = std::min(entry.minHeight, h);
+                        entry.maxHeight = std::max(entry.maxHeight, h);
+                        sum += h;
+                        if (material == TileMaterial::ROCK) rockCount++;
+                    }
+                }
+                entry.meanHeight = static_cast<float>(sum / heights.size());
+                entry.mainMaterial = static_cast<uint32_t>(rockCount * 2 > heights.size() ? TileMaterial::ROCK
+                                                                                          : TileMaterial::GRASS);
+
+                std::memcpy(page.data(), heights.data(), heights.size() * sizeof(float));
+                std::memcpy(page.data() + heights.size() * sizeof(float), materials.data(), materials.size());
+                file.write(page.data(), static_cast<std::streamsize>(page.size()));
+            }
+        }
+
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(index.data()),
+                   static_cast<std::streamsize>(index.size() * sizeof(TileIndexEntry)));
+        if (!file) {
+            file.close();
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// ===============================
+// Reading
+// ===============================
+bool TileFile::open(const std::string& path) {
+    tilesX = tilesZ = 0;
+    index.clear();
+    offsets.clear();
+    if (!file.open(path) || file.size() < sizeof(TileFileHeader)) return false;
+
+    TileFileHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, "FTIL", 4) != 0 || header.version != TILE_FILE_VERSION) return false;
+    if (header.tileCells == 0 || header.tilesX == 0 || header.tilesZ == 0 || !(header.spacing > 0.0f)) return false;
+
+    const size_t tileCount = size_t(header.tilesX) * header.tilesZ;
+    if (sizeof(TileFileHeader) + tileCount * sizeof(TileIndexEntry) > file.size()) return false;
+
+    // Validate every offset up front so tile reads need no checks
+    const size_t dataBytes = tileDataBytes(header.tileCells);
+    index.resize(tileCount);
+    offsets.resize(tileCount);
+    for (size_t i = 0; i < tileCount; i++) {
+        TileIndexEntry entry;
+        std::memcpy(&entry, file.data() + sizeof(TileFileHeader) + i * sizeof(TileIndexEntry), sizeof(entry));
+        if (entry.offset % PAGE_BYTES != 0 || entry.offset + dataBytes > file.size()) {
+            index.clear();
+            offsets.clear();
+            return false;
+        }
+        offsets[i] = entry.offset;
+        index[i] = { entry.minHeight, entry.maxHeight, entry.meanHeight, static_cast<TileMaterial>(entry.mainMaterial) };
+    }
+
+    tileCells = static_cast<int>(header.tileCells);
+    tilesX = static_cast<int>(header.tilesX);
+    tilesZ = static_cast<int>(header.tilesZ);
+    cellsX = static_cast<int>(header.cellsX);
+    cellsZ = static_cast<int>(header.cellsZ);
+    originX = header.originX;
+    originZ = header.originZ;
+    spacing = header.spacing;
+    return true;
+}
+
+size_t TileFile::tileBytes() const {
+    return tileDataBytes(static_cast<uint32_t>(tileCells));
+}
+
+const float* TileFile::heights(int tx, int tz) const {
+    return reinterpret_cast<const float*>(file.data() + offsets[static_cast<size_t>(tz) * tilesX + tx]);
+}
+
+const uint8_t* TileFile::materials(int tx, int tz) const {
+    const size_t samples = size_t(tileResolution()) * tileResolution();
+    return reinterpret_cast<const uint8_t*>(heights(tx, tz) + samples);
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "HeightField.h"
+#include "MappedFile.h"
+
+// Tiled terrain on disk (".ftiles"), for grounds too large to keep in memory.
+// The height field is cut into square tiles of tileCells x tileCells cells;
+// each tile stores its own (tileCells + 1)^2 heights, edge samples repeated
+// from its neighbours so it can be sampled alone, followed by one material
+// byte per sample. Every tile starts on a page boundary so paging one in
+// touches only its own pages. A small index in front gives each tile's
+// offset and height range, and is all that stays resident.
+
+const uint32_t TILE_FILE_VERSION = 1;
+const uint32_t TILE_CELLS_DEFAULT = 64;
+
+// Surface at a height sample, classified by slope at bake time
+enum class TileMaterial : uint8_t {
+    GRASS = 0,
+    ROCK = 1,
+};
+
+// Per-tile index entry
+struct TileInfo {
+    float minHeight, maxHeight, meanHeight;
+    TileMaterial mainMaterial; // the most common material in the tile
+};
+
+// Cuts `field` into tiles and writes them to `path` (through a temporary
+// file, so a failed bake never leaves a truncated file behind)
+bool writeTileFile(const std::string& path, const HeightField& field, uint32_t tileCells = TILE_CELLS_DEFAULT);
+
+// Read side: the file is memory mapped, the index is copied out and tile
+// data is only touched through heights() and materials()
+class TileFile {
+public:
+    // False if the file is missing, has another version or is truncated
+    bool open(const std::string& path);
+    bool isOpen() const { return file.isOpen() && tilesX > 0; }
+
+    int getTileCells() const { return tileCells; }
+    int getTilesX() const { return tilesX; }
+    int getTilesZ() const { return tilesZ; }
+    // Cells of the source field; the tiles past its far edges are padded
+    int getCellsX() const { return cellsX; }
+    int getCellsZ() const { return cellsZ; }
+    float getOriginX() const { return originX; }
+    float getOriginZ() const { return originZ; }
+    float getSpacing() const { return spacing; }
+    // Samples per tile side
+    int tileResolution() const { return tileCells + 1; }
+    // Heights and materials of one tile, as copied into memory
+    size_t tileBytes() const;
+
+    const TileInfo& info(int tx, int tz) const { return index[static_cast<size_t>(tz) * tilesX + tx]; }
+    // Point into the mapping; reading them may fault pages in from disk
+    const float* heights(int tx, int tz) const;
+    const uint8_t* materials(int tx, int tz) const;
+
+private:
+    MappedFile file;
+    int tileCells = 0, tilesX = 0, tilesZ = 0, cellsX = 0, cellsZ = 0;
+    float originX = 0.0f, originZ = 0.0f, spacing = 1.0f;
+    std::vector<TileInfo> index;
+    std::vector<uint64_t> offsets;
+};
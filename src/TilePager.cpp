@@ -0,0 +1,281 @@
+#include "TilePager.h"
+#include "Profiler.h"
+#include "Log.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+const size_t DEFAULT_BUDGET_MB = 64;
+// Tiles this many rings around the player's tile are always wanted
+const int WORKING_RADIUS = 1;
+// How far ahead along the velocity to prefetch, and at least how many
+// tile lengths (the character walks slower than a tile per few seconds)
+const float PREFETCH_SECONDS = 2.0f;
+const float PREFETCH_MIN_TILES = 1.5f;
+
+} // namespace
+
+TilePager::TilePager(size_t budget) : budgetBytes(budget) {
+    if (budgetBytes == 0) {
+        budgetBytes = DEFAULT_BUDGET_MB << 20;
+        if (const char* mb = std::getenv("FALLAGA_TILE_BUDGET_MB"))
+            budgetBytes = static_cast<size_t>(std::max(0.0, std::atof(mb)) * (1 << 20));
+    }
+    stats.budgetBytes = budgetBytes;
+}
+
+TilePager::~TilePager() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (loader.joinable()) loader.join();
+}
+
+bool TilePager::open(const std::string& path) {
+    if (!file.open(path)) return false;
+    wantedMask.assign(static_cast<size_t>(file.getTilesX()) * file.getTilesZ(), 0);
+    if (budgetBytes < file.tileBytes()) {
+        LOG_WARN("Tile budget of " << budgetBytes << " bytes is below one tile; paging one at a time");
+        budgetBytes = stats.budgetBytes = file.tileBytes();
+    }
+    loader = std::thread(&TilePager::loaderLoop, this);
+    return true;
+}
+
+void TilePager::getBounds(Vec3& min, Vec3& max) const {
+    min = Vec3(file.getOriginX(), 0.0f, file.getOriginZ());
+    max = Vec3(file.getOriginX() + file.getCellsX() * file.getSpacing(), 0.0f,
+               file.getOriginZ() + file.getCellsZ() * file.getSpacing());
+}
+
+// ===============================
+// Working Set
+// ===============================
+void TilePager::update(const Vec3& position, const Vec3& velocity) {
+    if (!isOpen()) return;
+    const float tileSize = file.getTileCells() * file.getSpacing();
+    auto tileOf = [&](float x, float z, int& tx, int& tz) {
+        tx = std::min(std::max(static_cast<int>(std::floor((x - file.getOriginX()) / tileSize)), 0), file.getTilesX() - 1);
+        tz = std::min(std::max(static_cast<int>(std::floor((z - file.getOriginZ()) / tileSize)), 0), file.getTilesZ() - 1);
+    };
+
+    Vec3 ahead = position;
+    const float speed = std::sqrt(velocity.x * velocity.x + velocity.z * velocity.z);
+    if (speed > 0.0f) {
+        const float distance = std::max(speed * PREFETCH_SECONDS, tileSize * PREFETCH_MIN_TILES);
+        ahead.x += velocity.x / speed * distance;
+        ahead.z += velocity.z / speed * distance;
+    }
+    int cx, cz, ax, az;
+    tileOf(position.x, position.z, cx, cz);
+    tileOf(ahead.x, ahead.z, ax, az);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    useClock++;
+    if (key(cx, cz) == wantedCenter && key(ax, az) == wantedAhead) return;
+    wantedCenter = key(cx, cz);
+    wantedAhead = key(ax, az);
+
+    for (int k : wanted) wantedMask[k] = 0;
+    wanted.clear();
+    nextWanted = 0;
+    full = false;
+
+    // Around the player first, then the tiles on the way to the point
+    // ahead, then around that point
+    requestAround(cx, cz, WORKING_RADIUS);
+    const float dx = ahead.x - position.x, dz = ahead.z - position.z;
+    const int steps = static_cast<int>(std::ceil(std::sqrt(dx * dx + dz * dz) / (tileSize * 0.5f)));
+    for (int i = 1; i <= steps; i++) {
+        int tx, tz;
+        tileOf(position.x + dx * i / steps, position.z + dz * i / steps, tx, tz);
+        requestAround(tx, tz, 0);
+    }
+    requestAround(ax, az, WORKING_RADIUS);
+
+    // Whatever is already resident counts as just used
+    for (int k : wanted) {
+        auto it = resident.find(k);
+        if (it != resident.end()) it->second->lastUsed = useClock;
+    }
+    wake.notify_one();
+}
+
+// Adds the tiles within `radius` rings of (tx, tz), nearest ring first
+void TilePager::requestAround(int tx, int tz, int radius) {
+    for (int ring = 0; ring <= radius; ring++) {
+        for (int z = tz - ring; z <= tz + ring; z++) {
+            for (int x = tx - ring; x <= tx + ring; x++) {
+                if (std::max(std::abs(x - tx), std::abs(z - tz)) != ring) continue;
+                if (x < 0 || z < 0 || x >= file.getTilesX() || z >= file.getTilesZ()) continue;
+                const int k = key(x, z);
+                if (wantedMask[k]) continue;
+                wantedMask[k] = 1;
+                wanted.push_back(k);
+            }
+        }
+    }
+}
+
+// Drops the least recently used tile outside the working set
+bool TilePager::evictOne() {
+    auto victim = resident.end();
+    for (auto it = resident.begin(); it != resident.end(); ++it) {
+        if (wantedMask[it->first]) continue;
+        if (victim == resident.end() || it->second->lastUsed < victim->second->lastUsed) victim = it;
+    }
+    if (victim == resident.end()) return false;
+    stats.residentBytes -= file.tileBytes();
+    stats.residentTiles--;
+    stats.evictions++;
+    resident.erase(victim);
+    return true;
+}
+
+// ===============================
+// Loading
+// ===============================
+void TilePager::loaderLoop() {
+    PROFILE_THREAD("Tile loader");
+    const int side = file.tileResolution();
+    const size_t samples = static_cast<size_t>(side) * side;
+    for (;;) {
+        int k;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;) {
+                if (stopping) return;
+                while (nextWanted < wanted.size() && resident.count(wanted[nextWanted])) nextWanted++;
+                if (nextWanted < wanted.size() && !full) {
+                    while (stats.residentBytes + file.tileBytes() > budgetBytes && evictOne()) {}
+                    if (stats.residentBytes + file.tileBytes() <= budgetBytes) break;
+                    // Everything resident is wanted; wait for the player to move on
+                    full = true;
+                }
+                wake.wait(lock);
+            }
+            k = wanted[nextWanted];
+            loading = true;
+        }
+
+        // Outside the lock: this is where the pages come in from disk
+        PROFILE_SCOPE("TilePager::load");
+        const int tx = k % file.getTilesX(), tz = k / file.getTilesX();
+        auto tile = std::make_unique<Tile>();
+        tile->heights.assign(file.heights(tx, tz), file.heights(tx, tz) + samples);
+        tile->materials.assign(file.materials(tx, tz), file.materials(tx, tz) + samples);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        tile->lastUsed = useClock;
+        resident[k] = std::move(tile);
+        stats.residentBytes += file.tileBytes();
+        stats.residentTiles++;
+        stats.loads++;
+        generation++;
+        loading = false;
+    }
+}
+
+unsigned TilePager::getGeneration() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return generation;
+}
+
+bool TilePager::idle() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (loading) return false;
+    if (full) return true;
+    for (int k : wanted)
+        if (!resident.count(k)) return false;
+    return true;
+}
+
+TilePager::Stats TilePager::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+// ===============================
+// Queries
+// ===============================
+bool TilePager::locate(float x, float z, int& tx, int& tz, float& lx, float& lz) const {
+    if (!isOpen()) return false;
+    const float gx = (x - file.getOriginX()) / file.getSpacing();
+    const float gz = (z - file.getOriginZ()) / file.getSpacing();
+    if (!(gx >= 0.0f && gz >= 0.0f && gx <= file.getCellsX() && gz <= file.getCellsZ())) return false;
+    const int cells = file.getTileCells();
+    tx = std::min(static_cast<int>(gx) / cells, file.getTilesX() - 1);
+    tz = std::min(static_cast<int>(gz) / cells, file.getTilesZ() - 1);
+    lx = std::min(gx - tx * cells, static_cast<float>(cells));
+    lz = std::min(gz - tz * cells, static_cast<float>(cells));
+    return true;
+}
+
+float TilePager::sampleHeight(const Tile& tile, float lx, float lz) const {
+    const int cells = file.getTileCells(), side = file.tileResolution();
+    const int ix = std::min(static_cast<int>(lx), cells - 1);
+    const int iz = std::min(static_cast<int>(lz), cells - 1);
+    const float fx = lx - ix, fz = lz - iz;
+    const float* row0 = tile.heights.data() + static_cast<size_t>(iz) * side + ix;
+    const float* row1 = row0 + side;
+    const float h0 = row0[0] + (row0[1] - row0[0]) * fx;
+    const float h1 = row1[0] + (row1[1] - row1[0]) * fx;
+    return h0 + (h1 - h0) * fz;
+}
+
+TilePager::Sample TilePager::heightAt(float x, float z, float& out) const {
+    int tx, tz;
+    float lx, lz;
+    if (!locate(x, z, tx, tz, lx, lz)) return OUTSIDE;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = resident.find(key(tx, tz));
+    if (it == resident.end()) {
+        out = file.info(tx, tz).meanHeight;
+        return FALLBACK;
+    }
+    it->second->lastUsed = useClock;
+    out = sampleHeight(*it->second, lx, lz);
+    return EXACT;
+}
+
+TilePager::Sample TilePager::materialAt(float x, float z, TileMaterial& out) const {
+    int tx, tz;
+    float lx, lz;
+    if (!locate(x, z, tx, tz, lx, lz)) return OUTSIDE;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = resident.find(key(tx, tz));
+    if (it == resident.end()) {
+        out = file.info(tx, tz).mainMaterial;
+        return FALLBACK;
+    }
+    it->second->lastUsed = useClock;
+    const int side = file.tileResolution();
+    const int ix = static_cast<int>(lx + 0.5f), iz = static_cast<int>(lz + 0.5f);
+    out = static_cast<TileMaterial>(it->second->materials[static_cast<size_t>(iz) * side + ix]);
+    return EXACT;
+}
+
+void TilePager::heightsAt(const std::vector<Vec3>& points, std::vector<float>& out, std::vector<Sample>& samples) const {
+    out.resize(points.size());
+    samples.assign(points.size(), OUTSIDE);
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < points.size(); i++) {
+        int tx, tz;
+        float lx, lz;
+        if (!locate(points[i].x, points[i].z, tx, tz, lx, lz)) continue;
+        auto it = resident.find(key(tx, tz));
+        if (it == resident.end()) {
+            out[i] = file.info(tx, tz).meanHeight;
+            samples[i] = FALLBACK;
+        } else {
+            it->second->lastUsed = useClock;
+            out[i] = sampleHeight(*it->second, lx, lz);
+            samples[i] = EXACT;
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "TileFile.h"
+#include "Vec3.h"
+
+// Keeps the tiles of a TileFile around the player in memory, within a byte
+// budget (FALLAGA_TILE_BUDGET_MB, 64 by default). update() names the
+// working set: the tiles around the player, then the tiles along its
+// direction of travel. A loader thread copies missing ones out of the
+// mapping, nearest first, evicting the least recently used tiles outside
+// the working set to make room.
+//
+// Queries never wait for disk. A tile that is not resident answers from
+// the index instead (its mean height and main material), and says so.
+// Every method may be called from any thread.
+class TilePager {
+public:
+    enum Sample {
+        EXACT,    // interpolated from the resident tile
+        FALLBACK, // tile not resident, answered from its index entry
+        OUTSIDE,  // not over the tiled area; nothing is written
+    };
+
+    struct Stats {
+        size_t residentTiles = 0;
+        size_t residentBytes = 0;
+        size_t budgetBytes = 0;
+        size_t loads = 0;
+        size_t evictions = 0;
+    };
+
+    // budgetBytes = 0 reads FALLAGA_TILE_BUDGET_MB
+    explicit TilePager(size_t budgetBytes = 0);
+    ~TilePager();
+    TilePager(const TilePager&) = delete;
+    TilePager& operator=(const TilePager&) = delete;
+
+    // Maps the file and starts the loader; false if it can't be read
+    bool open(const std::string& path);
+    bool isOpen() const { return file.isOpen(); }
+
+    // Once per simulation tick with the player's position and velocity
+    void update(const Vec3& position, const Vec3& velocity);
+
+    Sample heightAt(float x, float z, float& out) const;
+    Sample materialAt(float x, float z, TileMaterial& out) const;
+    // Batched heights; points are read as (x, z). Points OUTSIDE keep
+    // whatever `out` held, so callers can prefill it.
+    void heightsAt(const std::vector<Vec3>& points, std::vector<float>& out, std::vector<Sample>& samples) const;
+
+    // XZ area covered by the tiles' source field
+    void getBounds(Vec3& min, Vec3& max) const;
+    // Bumped every time a tile is paged in
+    unsigned getGeneration() const;
+    // True when the whole working set is resident or no more fits
+    bool idle() const;
+    Stats getStats() const;
+
+private:
+    struct Tile {
+        std::vector<float> heights;
+        std::vector<uint8_t> materials;
+        uint64_t lastUsed = 0;
+    };
+
+    int key(int tx, int tz) const { return tz * file.getTilesX() + tx; }
+    // Tile and the sample coordinates inside it; false outside the field
+    bool locate(float x, float z, int& tx, int& tz, float& lx, float& lz) const;
+    float sampleHeight(const Tile& tile, float lx, float lz) const;
+    void requestAround(int tx, int tz, int radius);
+    bool evictOne();
+    void loaderLoop();
+
+    TileFile file;
+    size_t budgetBytes;
+
+    std::thread loader;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    // Guarded by mutex
+    std::unordered_map<int, std::unique_ptr<Tile>> resident;
+    std::vector<int> wanted;         // working set, in loading order
+    std::vector<uint8_t> wantedMask; // per tile: currently in `wanted`
+    int wantedCenter = -1, wantedAhead = -1;
+    size_t nextWanted = 0;           // wanted[0, nextWanted) are resident or loading
+    uint64_t useClock = 0;
+    unsigned generation = 0;
+    bool loading = false;
+    bool full = false;               // the budget is spent on working set tiles
+    Stats stats;
+};
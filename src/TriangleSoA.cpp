@@ -0,0 +1,386 @@
+#include "TriangleSoA.h"
+#include "Intersect.h"
+#include "Simd.h"
+#include <cstdlib>
+#include <cstring>
+
+// NOTE: this file is built with floating-point contraction disabled (see
+// CMakeLists.txt) so no mul+add pair is fused and the vector kernels match
+// the scalar routine bit for bit.
+
+// ===============================
+// Kernel Selection
+// ===============================
+namespace {
+
+inline int lowestBit(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+SimdLevel cpuSimdLevel() {
+#ifdef FALLAGA_X86
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::Avx2;
+    return SimdLevel::Sse;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5)) return SimdLevel::Avx2;
+    }
+    return SimdLevel::Sse;
+#else
+    return SimdLevel::Sse;
+#endif
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+SimdLevel initialSimdLevel() {
+    SimdLevel level = cpuSimdLevel();
+    if (const char* env = std::getenv("FALLAGA_SIMD")) {
+        SimdLevel requested = level;
+        if (std::strcmp(env, "scalar") == 0) requested = SimdLevel::Scalar;
+        else if (std::strcmp(env, "sse") == 0) requested = SimdLevel::Sse;
+        else if (std::strcmp(env, "avx2") == 0) requested = SimdLevel::Avx2;
+        if (requested < level) level = requested;
+    }
+    return level;
+}
+
+SimdLevel& currentLevel() {
+    static SimdLevel level = initialSimdLevel();
+    return level;
+}
+
+const float EPSILON = 0.0000001f;
+
+} // namespace
+
+SimdLevel detectSimdLevel() {
+    return cpuSimdLevel();
+}
+
+SimdLevel activeSimdLevel() {
+    return currentLevel();
+}
+
+void setSimdLevel(SimdLevel level) {
+    SimdLevel cpu = cpuSimdLevel();
+    currentLevel() = (level < cpu) ? level : cpu;
+}
+
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Scalar: return "scalar";
+        case SimdLevel::Sse: return "sse";
+        case SimdLevel::Avx2: return "avx2";
+    }
+    return "unknown";
+}
+
+// ===============================
+// Storage
+// ===============================
+void TriangleSoA::resize(size_t n) {
+    count = n;
+    for (auto* arr : { &v0x, &v0y, &v0z, &e1x, &e1y, &e1z, &e2x, &e2y, &e2z }) {
+        arr->assign(n + PADDING, 0.0f);
+    }
+}
+
+void TriangleSoA::set(size_t i, const Vec3& a, const Vec3& b, const Vec3& c) {
+    v0x[i] = a.x; v0y[i] = a.y; v0z[i] = a.z;
+    e1x[i] = b.x - a.x; e1y[i] = b.y - a.y; e1z[i] = b.z - a.z;
+    e2x[i] = c.x - a.x; e2y[i] = c.y - a.y; e2z[i] = c.z - a.z;
+}
+
+// ===============================
+// Scalar Kernel
+// ===============================
+namespace {
+
+inline uint32_t blockScalar(const TriangleSoA& s, size_t i, size_t lanes,
+                            const Vec3& origin, const Vec3& dir, float* tOut) {
+    uint32_t mask = 0;
+    for (size_t k = 0; k < lanes; k++) {
+        size_t j = i + k;
+        Vec3 v0(s.v0x[j], s.v0y[j], s.v0z[j]);
+        Vec3 e1(s.e1x[j], s.e1y[j], s.e1z[j]);
+        Vec3 e2(s.e2x[j], s.e2y[j], s.e2z[j]);
+        if (intersectRayTriangleEdges(origin, dir, v0, e1, e2, tOut[k])) mask |= 1u << k;
+    }
+    return mask;
+}
+
+} // namespace
+
+// ===============================
+// SSE Kernel (4 triangles)
+// ===============================
+#ifdef FALLAGA_X86
+namespace {
+
+struct RaySse {
+    __m128 ox, oy, oz, dx, dy, dz;
+    RaySse(const Vec3& o, const Vec3& d)
+        : ox(_mm_set1_ps(o.x)), oy(_mm_set1_ps(o.y)), oz(_mm_set1_ps(o.z)),
+          dx(_mm_set1_ps(d.x)), dy(_mm_set1_ps(d.y)), dz(_mm_set1_ps(d.z)) {}
+};
+
+// Same operations, in the same order, as intersectRayTriangleEdges.
+// Comparisons are phrased as "reject if" so NaN lanes behave like the scalar code.
+inline uint32_t blockSse(const TriangleSoA& s, size_t i, const RaySse& r, float* tOut) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 eps = _mm_set1_ps(EPSILON);
+    const __m128 negEps = _mm_set1_ps(-EPSILON);
+
+    __m128 e1x = _mm_loadu_ps(&s.e1x[i]), e1y = _mm_loadu_ps(&s.e1y[i]), e1z = _mm_loadu_ps(&s.e1z[i]);
+    __m128 e2x = _mm_loadu_ps(&s.e2x[i]), e2y = _mm_loadu_ps(&s.e2y[i]), e2z = _mm_loadu_ps(&s.e2z[i]);
+
+    __m128 hx = _mm_sub_ps(_mm_mul_ps(r.dy, e2z), _mm_mul_ps(r.dz, e2y));
+    __m128 hy = _mm_sub_ps(_mm_mul_ps(r.dz, e2x), _mm_mul_ps(r.dx, e2z));
+    __m128 hz = _mm_sub_ps(_mm_mul_ps(r.dx, e2y), _mm_mul_ps(r.dy, e2x));
+
+    __m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, hx), _mm_mul_ps(e1y, hy)), _mm_mul_ps(e1z, hz));
+    __m128 reject = _mm_and_ps(_mm_cmpgt_ps(a, negEps), _mm_cmplt_ps(a, eps));
+
+    __m128 f = _mm_div_ps(one, a);
+    __m128 sx = _mm_sub_ps(r.ox, _mm_loadu_ps(&s.v0x[i]));
+    __m128 sy = _mm_sub_ps(r.oy, _mm_loadu_ps(&s.v0y[i]));
+    __m128 sz = _mm_sub_ps(r.oz, _mm_loadu_ps(&s.v0z[i]));
+
+    __m128 u = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, hx), _mm_mul_ps(sy, hy)), _mm_mul_ps(sz, hz)));
+    reject = _mm_or_ps(reject, _mm_or_ps(_mm_cmplt_ps(u, zero), _mm_cmpgt_ps(u, one)));
+
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+
+    __m128 v = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(r.dx, qx), _mm_mul_ps(r.dy, qy)), _mm_mul_ps(r.dz, qz)));
+    reject = _mm_or_ps(reject, _mm_or_ps(_mm_cmplt_ps(v, zero), _mm_cmpgt_ps(_mm_add_ps(u, v), one)));
+
+    __m128 t = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)));
+    __m128 hit = _mm_andnot_ps(reject, _mm_cmpgt_ps(t, eps));
+
+    _mm_storeu_ps(tOut, t);
+    return static_cast<uint32_t>(_mm_movemask_ps(hit));
+}
+
+bool closestSse(const TriangleSoA& s, size_t begin, size_t end, const Vec3& origin, const Vec3& dir,
+                float maxT, float& outT, size_t& outIndex) {
+    const RaySse r(origin, dir);
+    float best = maxT;
+    bool found = false;
+    float t[4];
+    for (size_t i = begin; i < end; i += 4) {
+        uint32_t mask = blockSse(s, i, r, t);
+        if (end - i < 4) mask &= (1u << (end - i)) - 1;
+        while (mask) {
+            int lane = lowestBit(mask);
+            mask &= mask - 1;
+            if (found ? t[lane] < best : t[lane] <= best) {
+                best = t[lane];
+                outIndex = i + lane;
+                found = true;
+            }
+        }
+    }
+    if (found) outT = best;
+    return found;
+}
+
+bool anySse(const TriangleSoA& s, size_t begin, size_t end, const Vec3& origin, const Vec3& dir, float maxT) {
+    const RaySse r(origin, dir);
+    const __m128 limit = _mm_set1_ps(maxT);
+    float t[4];
+    for (size_t i = begin; i < end; i += 4) {
+        uint32_t mask = blockSse(s, i, r, t);
+        if (end - i < 4) mask &= (1u << (end - i)) - 1;
+        mask &= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(t), limit)));
+        if (mask) return true;
+    }
+    return false;
+}
+
+// ===============================
+// AVX2 Kernel (8 triangles)
+// ===============================
+struct RayAvx {
+    __m256 ox, oy, oz, dx, dy, dz;
+};
+
+FALLAGA_TARGET_AVX2 inline RayAvx makeRayAvx(const Vec3& o, const Vec3& d) {
+    RayAvx r;
+    r.ox = _mm256_set1_ps(o.x); r.oy = _mm256_set1_ps(o.y); r.oz = _mm256_set1_ps(o.z);
+    r.dx = _mm256_set1_ps(d.x); r.dy = _mm256_set1_ps(d.y); r.dz = _mm256_set1_ps(d.z);
+    return r;
+}
+
+FALLAGA_TARGET_AVX2 inline uint32_t blockAvx2(const TriangleSoA& s, size_t i, const RayAvx& r, float* tOut) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 eps = _mm256_set1_ps(EPSILON);
+    const __m256 negEps = _mm256_set1_ps(-EPSILON);
+
+    __m256 e1x = _mm256_loadu_ps(&s.e1x[i]), e1y = _mm256_loadu_ps(&s.e1y[i]), e1z = _mm256_loadu_ps(&s.e1z[i]);
+    __m256 e2x = _mm256_loadu_ps(&s.e2x[i]), e2y = _mm256_loadu_ps(&s.e2y[i]), e2z = _mm256_loadu_ps(&s.e2z[i]);
+
+    __m256 hx = _mm256_sub_ps(_mm256_mul_ps(r.dy, e2z), _mm256_mul_ps(r.dz, e2y));
+    __m256 hy = _mm256_sub_ps(_mm256_mul_ps(r.dz, e2x), _mm256_mul_ps(r.dx, e2z));
+    __m256 hz = _mm256_sub_ps(_mm256_mul_ps(r.dx, e2y), _mm256_mul_ps(r.dy, e2x));
+
+    __m256 a = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, hx), _mm256_mul_ps(e1y, hy)), _mm256_mul_ps(e1z, hz));
+    __m256 reject = _mm256_and_ps(_mm256_cmp_ps(a, negEps, _CMP_GT_OQ), _mm256_cmp_ps(a, eps, _CMP_LT_OQ));
+
+    __m256 f = _mm256_div_ps(one, a);
+    __m256 sx = _mm256_sub_ps(r.ox, _mm256_loadu_ps(&s.v0x[i]));
+    __m256 sy = _mm256_sub_ps(r.oy, _mm256_loadu_ps(&s.v0y[i]));
+    __m256 sz = _mm256_sub_ps(r.oz, _mm256_loadu_ps(&s.v0z[i]));
+
+    __m256 u = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, hx), _mm256_mul_ps(sy, hy)), _mm256_mul_ps(sz, hz)));
+    reject = _mm256_or_ps(reject, _mm256_or_ps(_mm256_cmp_ps(u, zero, _CMP_LT_OQ), _mm256_cmp_ps(u, one, _CMP_GT_OQ)));
+
+    __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+    __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+    __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+
+    __m256 v = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r.dx, qx), _mm256_mul_ps(r.dy, qy)), _mm256_mul_ps(r.dz, qz)));
+    reject = _mm256_or_ps(reject, _mm256_or_ps(_mm256_cmp_ps(v, zero, _CMP_LT_OQ),
+                                               _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_GT_OQ)));
+
+    __m256 t = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)));
+    __m256 hit = _mm256_andnot_ps(reject, _mm256_cmp_ps(t, eps, _CMP_GT_OQ));
+
+    _mm256_storeu_ps(tOut, t);
+    return static_cast<uint32_t>(_mm256_movemask_ps(hit));
+}
+
+FALLAGA_TARGET_AVX2 bool closestAvx2(const TriangleSoA& s, size_t begin, size_t end, const Vec3& origin,
+                                     const Vec3& dir, float maxT, float& outT, size_t& outIndex) {
+    const RayAvx r = makeRayAvx(origin, dir);
+    float best = maxT;
+    bool found = false;
+    float t[8];
+    for (size_t i = begin; i < end; i += 8) {
+        uint32_t mask = blockAvx2(s, i, r, t);
+        if (end - i < 8) mask &= (1u << (end - i)) - 1;
+        while (mask) {
+            int lane = lowestBit(mask);
+            mask &= mask - 1;
+            if (found ? t[lane] < best : t[lane] <= best) {
+                best = t[lane];
+                outIndex = i + lane;
+                found = true;
+            }
+        }
+    }
+    if (found) outT = best;
+    return found;
+}
+
+FALLAGA_TARGET_AVX2 bool anyAvx2(const TriangleSoA& s, size_t begin, size_t end, const Vec3& origin,
+                                 const Vec3& dir, float maxT) {
+    const RayAvx r = makeRayAvx(origin, dir);
+    const __m256 limit = _mm256_set1_ps(maxT);
+    float t[8];
+    for (size_t i = begin; i < end; i += 8) {
+        uint32_t mask = blockAvx2(s, i, r, t);
+        if (end - i < 8) mask &= (1u << (end - i)) - 1;
+        mask &= static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(t), limit, _CMP_LE_OQ)));
+        if (mask) return true;
+    }
+    return false;
+}
+
+FALLAGA_TARGET_AVX2 uint32_t maskAvx2(const TriangleSoA& s, size_t begin, const Vec3& origin,
+                                      const Vec3& dir, float* tOut) {
+    return blockAvx2(s, begin, makeRayAvx(origin, dir), tOut);
+}
+
+} // namespace
+#endif // FALLAGA_X86
+
+// ===============================
+// Dispatch
+// ===============================
+bool soaClosestHit(const TriangleSoA& tris, size_t begin, size_t end,
+                   const Vec3& origin, const Vec3& dir, float maxT,
+                   float& outT, size_t& outIndex) {
+#ifdef FALLAGA_X86
+    switch (currentLevel()) {
+        case SimdLevel::Avx2: return closestAvx2(tris, begin, end, origin, dir, maxT, outT, outIndex);
+        case SimdLevel::Sse: return closestSse(tris, begin, end, origin, dir, maxT, outT, outIndex);
+        default: break;
+    }
+#endif
+    float best = maxT;
+    bool found = false;
+    for (size_t i = begin; i < end; i++) {
+        float t;
+        if (blockScalar(tris, i, 1, origin, dir, &t) && (found ? t < best : t <= best)) {
+            best = t;
+            outIndex = i;
+            found = true;
+        }
+    }
+    if (found) outT = best;
+    return found;
+}
+
+bool soaAnyHit(const TriangleSoA& tris, size_t begin, size_t end,
+               const Vec3& origin, const Vec3& dir, float maxT) {
+#ifdef FALLAGA_X86
+    switch (currentLevel()) {
+        case SimdLevel::Avx2: return anyAvx2(tris, begin, end, origin, dir, maxT);
+        case SimdLevel::Sse: return anySse(tris, begin, end, origin, dir, maxT);
+        default: break;
+    }
+#endif
+    for (size_t i = begin; i < end; i++) {
+        float t;
+        if (blockScalar(tris, i, 1, origin, dir, &t) && t <= maxT) return true;
+    }
+    return false;
+}
+
+uint32_t soaIntersectMask(const TriangleSoA& tris, size_t begin, size_t count,
+                          const Vec3& origin, const Vec3& dir, SimdLevel level, float outT[8]) {
+    if (count > 8) count = 8;
+    const uint32_t laneMask = (count == 8) ? 0xFFu : ((1u << count) - 1);
+    for (int k = 0; k < 8; k++) outT[k] = 0.0f;
+
+    float t[8];
+#ifdef FALLAGA_X86
+    if (level > cpuSimdLevel()) level = cpuSimdLevel();
+    if (level == SimdLevel::Avx2) {
+        uint32_t mask = maskAvx2(tris, begin, origin, dir, t) & laneMask;
+        for (size_t k = 0; k < count; k++) if (mask & (1u << k)) outT[k] = t[k];
+        return mask;
+    }
+    if (level == SimdLevel::Sse) {
+        const RaySse r(origin, dir);
+        uint32_t mask = blockSse(tris, begin, r, t) | (blockSse(tris, begin + 4, r, t + 4) << 4);
+        mask &= laneMask;
+        for (size_t k = 0; k < count; k++) if (mask & (1u << k)) outT[k] = t[k];
+        return mask;
+    }
+#else
+    (void)level;
+#endif
+    uint32_t mask = blockScalar(tris, begin, count, origin, dir, t) & laneMask;
+    for (size_t k = 0; k < count; k++) if (mask & (1u << k)) outT[k] = t[k];
+    return mask;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Vec3.h"
+
+// Instruction set used by the triangle kernels. Picked once at startup from
+// CPUID; FALLAGA_SIMD=scalar|sse|avx2 or setSimdLevel() override it.
+enum class SimdLevel { Scalar, Sse, Avx2 };
+
+SimdLevel detectSimdLevel();
+SimdLevel activeSimdLevel();
+void setSimdLevel(SimdLevel level); // clamped to what the CPU supports
+const char* simdLevelName(SimdLevel level);
+
+// Triangles in structure-of-arrays form: the first corner and both edges,
+// one float array per component. Arrays carry 8 zeroed floats of padding
+// past the end so kernels can always load full 4- or 8-wide lanes.
+struct TriangleSoA {
+    static const size_t PADDING = 8;
+
+    std::vector<float> v0x, v0y, v0z;
+    std::vector<float> e1x, e1y, e1z;
+    std::vector<float> e2x, e2y, e2z;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    void resize(size_t n);
+    void clear() { resize(0); }
+    void set(size_t i, const Vec3& a, const Vec3& b, const Vec3& c);
+
+private:
+    size_t count = 0;
+};
+
+// Möller–Trumbore over triangles [begin, end) with the active kernel.
+// Gives bit-identical hits and distances to intersectRayTriangle.
+
+// Nearest hit with t <= maxT (lowest index wins a tie)
+bool soaClosestHit(const TriangleSoA& tris, size_t begin, size_t end,
+                   const Vec3& origin, const Vec3& dir, float maxT,
+                   float& outT, size_t& outIndex);
+
+// Stops at the first hit with t <= maxT
+bool soaAnyHit(const TriangleSoA& tris, size_t begin, size_t end,
+               const Vec3& origin, const Vec3& dir, float maxT);
+
+// Raw results for up to 8 triangles starting at `begin` with an explicit
+// kernel: bit i is set when triangle begin + i is hit and outT[i] holds its t.
+// Used to check the vector kernels against the scalar one.
+uint32_t soaIntersectMask(const TriangleSoA& tris, size_t begin, size_t count,
+                          const Vec3& origin, const Vec3& dir, SimdLevel level, float outT[8]);
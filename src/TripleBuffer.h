@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single-writer / single-reader triple buffer. The writer fills
+// back() and publishes it; the reader always gets the newest published
+// value without waiting, and the writer never waits for the reader.
+// Three slots: one being written, one being read, one handed over.
+template <typename T>
+class TripleBuffer {
+public:
+    // Writer side
+    T& back() { return slots[backIndex].value; }
+    void publish() {
+        const uint8_t previous = middle.exchange(static_cast<uint8_t>(backIndex | FRESH), std::memory_order_acq_rel);
+        backIndex = previous & INDEX_MASK;
+    }
+
+    // Reader side: the newest published value (the same one again when
+    // nothing new was published since the last call)
+    const T& read() {
+        if (middle.load(std::memory_order_relaxed) & FRESH) {
+            const uint8_t previous = middle.exchange(frontIndex, std::memory_order_acq_rel);
+            frontIndex = previous & INDEX_MASK;
+        }
+        return slots[frontIndex].value;
+    }
+
+private:
+    static const uint8_t INDEX_MASK = 3;
+    static const uint8_t FRESH = 4; // set while the middle slot holds an unread value
+
+    // Separate cache lines, so the two threads don't share one
+    struct alignas(64) Slot {
+        T value;
+    };
+    Slot slots[3];
+    std::atomic<uint8_t> middle{1};
+    uint8_t backIndex = 0;  // writer only
+    uint8_t frontIndex = 2; // reader only
+};
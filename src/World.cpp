@@ -0,0 +1,135 @@
+#include "World.h"
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+
+namespace {
+
+// Sizes of the registered component types, by id
+std::mutex registryMutex;
+std::vector<size_t> registrySizes;
+
+// Past a fixed limit the masks and entity ids would silently alias, in
+// release builds too. A component id is registered the first time
+// componentId<T>() runs for its type, which may be before the log is set
+// up (a static initialiser), so this goes straight to stderr.
+[[noreturn]] void fatal(const char* message) {
+    std::fprintf(stderr, "World: %s\n", message);
+    std::fflush(stderr);
+    std::abort();
+}
+
+} // namespace
+
+uint32_t World::registerComponent(size_t size) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (registrySizes.size() >= MAX_COMPONENTS) fatal("more component types than MAX_COMPONENTS");
+    registrySizes.push_back(size);
+    return static_cast<uint32_t>(registrySizes.size() - 1);
+}
+
+size_t World::componentSize(uint32_t id) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return registrySizes[id];
+}
+
+// ===============================
+// Entities
+// ===============================
+Entity World::allocate() {
+    uint32_t index;
+    if (!freeSlots.empty()) {
+        index = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        index = static_cast<uint32_t>(slots.size());
+        if (index > ENTITY_INDEX_MASK) fatal("more living entities than ENTITY_INDEX_MASK allows");
+        slots.push_back(Slot{ 0, 0, 0, false });
+    }
+    slots[index].alive = true;
+    livingCount++;
+    return index | (static_cast<Entity>(slots[index].generation) << 24);
+}
+
+bool World::alive(Entity entity) const {
+    if (entity == NULL_ENTITY) return false;
+    const uint32_t index = entity & ENTITY_INDEX_MASK;
+    return index < slots.size() && slots[index].alive && slots[index].generation == (entity >> 24);
+}
+
+void World::destroy(Entity entity) {
+    if (!alive(entity)) return;
+    Slot& slot = slots[entity & ENTITY_INDEX_MASK];
+    eraseRow(*archetypes[slot.archetype], slot.row);
+    slot.alive = false;
+    slot.generation++;
+    freeSlots.push_back(entity & ENTITY_INDEX_MASK);
+    livingCount--;
+}
+
+void World::clear() {
+    archetypes.clear();
+    slots.clear();
+    freeSlots.clear();
+    livingCount = 0;
+}
+
+// ===============================
+// Archetypes
+// ===============================
+uint32_t World::archetypeFor(ComponentMask mask) {
+    for (uint32_t i = 0; i < archetypes.size(); i++)
+        if (archetypes[i]->mask == mask) return i;
+
+    auto archetype = std::make_unique<Archetype>();
+    archetype->mask = mask;
+    for (uint32_t id = 0; id < MAX_COMPONENTS; id++) {
+        archetype->columnOf[id] = -1;
+        if (!((mask >> id) & 1)) continue;
+        const size_t size = componentSize(id);
+        if (size == 0) continue;
+        archetype->columnOf[id] = static_cast<int8_t>(archetype->columns.size());
+        archetype->columns.push_back(Column{ id, size, {} });
+    }
+    archetypes.push_back(std::move(archetype));
+    return static_cast<uint32_t>(archetypes.size() - 1);
+}
+
+uint32_t World::appendRow(Archetype& archetype, Entity entity) {
+    const uint32_t row = static_cast<uint32_t>(archetype.entities.size());
+    archetype.entities.push_back(entity);
+    for (Column& column : archetype.columns) column.data.resize(column.data.size() + column.elementSize);
+    return row;
+}
+
+void World::eraseRow(Archetype& archetype, uint32_t row) {
+    const uint32_t last = static_cast<uint32_t>(archetype.entities.size() - 1);
+    if (row != last) {
+        for (Column& column : archetype.columns)
+            std::memcpy(column.data.data() + row * column.elementSize, column.data.data() + last * column.elementSize,
+                        column.elementSize);
+        const Entity moved = archetype.entities[last];
+        archetype.entities[row] = moved;
+        slots[moved & ENTITY_INDEX_MASK].row = row;
+    }
+    archetype.entities.pop_back();
+    for (Column& column : archetype.columns) column.data.resize(column.data.size() - column.elementSize);
+}
+
+void World::changeArchetype(Entity entity, ComponentMask mask) {
+    Slot& slot = slots[entity & ENTITY_INDEX_MASK];
+    if (archetypes[slot.archetype]->mask == mask) return;
+
+    // archetypeFor may grow `archetypes`, so look both up by index after it
+    const uint32_t to = archetypeFor(mask);
+    Archetype& source = *archetypes[slot.archetype];
+    Archetype& target = *archetypes[to];
+    const uint32_t row = appendRow(target, entity);
+    for (const Column& column : source.columns) {
+        const int c = target.columnOf[column.component];
+        if (c >= 0) std::memcpy(target.row(c, row), column.data.data() + slot.row * column.elementSize, column.elementSize);
+    }
+    eraseRow(source, slot.row);
+    slot.archetype = to;
+    slot.row = row;
+}
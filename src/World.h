@@ -0,0 +1,231 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Entity-component storage. Entities with the same set of component types
+// share an archetype, which keeps one tightly packed array per component
+// type (structure of arrays) plus the entity of each row. Queries visit
+// every archetype that has the asked-for components and hand out those
+// arrays, so a system streams through contiguous memory instead of
+// chasing one heap object per thing in the world.
+//
+// Components are plain data: trivially copyable, since rows move around by
+// memcpy when an entity is destroyed or changes archetype. Empty structs
+// work as tags and take no storage. Not thread-safe; the GL thread owns
+// the world.
+//
+//     World world;
+//     Entity e = world.create(Transform{ ... }, Bounds{ ... }, TreeTag{});
+//     world.each<Transform, Velocity>([dt](Transform& t, Velocity& v) { ... });
+//     world.eachChunk<Bounds>([](size_t count, const Entity* entities, Bounds* bounds) { ... });
+
+// Index in the low 24 bits, generation in the high 8, so a handle to a
+// destroyed entity stops resolving once its slot is reused
+typedef uint32_t Entity;
+const Entity NULL_ENTITY = 0xffffffffu;
+const uint32_t ENTITY_INDEX_MASK = 0xffffff;
+
+typedef uint64_t ComponentMask;
+
+class World {
+public:
+    // At most this many component types per program
+    static const uint32_t MAX_COMPONENTS = 64;
+
+    World() = default;
+    World(const World&) = delete;
+    World& operator=(const World&) = delete;
+
+    template <class... Ts>
+    Entity create(const Ts&... components);
+    void destroy(Entity entity);
+    bool alive(Entity entity) const;
+    // Destroys every entity with all of Ts
+    template <class... Ts>
+    void destroyAll();
+    void clear();
+
+    // Null when the entity is dead or has no T (or T is a tag). Valid until
+    // the next create, destroy, add or remove.
+    template <class T>
+    T* get(Entity entity);
+    template <class T>
+    bool has(Entity entity) const;
+    // Moves the entity to the archetype with T added (or overwritten) / removed
+    template <class T>
+    void add(Entity entity, const T& component);
+    template <class T>
+    void remove(Entity entity);
+
+    // f(Ts&...) for every entity that has all of Ts
+    template <class... Ts, class F>
+    void each(F&& f);
+    // f(count, entities, Ts*...) once per archetype that has all of Ts, with
+    // its arrays; tags come through as null pointers. For tight loops.
+    template <class... Ts, class F>
+    void eachChunk(F&& f);
+    // Entities that have all of Ts
+    template <class... Ts>
+    size_t count() const;
+
+    size_t size() const { return livingCount; }
+    size_t archetypeCount() const { return archetypes.size(); }
+
+    template <class T>
+    static uint32_t componentId();
+
+private:
+    struct Column {
+        uint32_t component;
+        size_t elementSize;
+        std::vector<unsigned char> data;
+    };
+
+    struct Archetype {
+        ComponentMask mask;
+        std::vector<Column> columns; // non-tag components, by id
+        std::vector<Entity> entities;
+        // Column of a component, or -1 (absent or a tag)
+        int8_t columnOf[MAX_COMPONENTS];
+
+        unsigned char* row(int column, size_t index) {
+            return columns[column].data.data() + index * columns[column].elementSize;
+        }
+    };
+
+    struct Slot {
+        uint32_t archetype;
+        uint32_t row;
+        uint8_t generation;
+        bool alive;
+    };
+
+    static uint32_t registerComponent(size_t size);
+    static size_t componentSize(uint32_t id);
+
+    template <class... Ts>
+    static ComponentMask maskOf() {
+        return (ComponentMask(0) | ... | (ComponentMask(1) << componentId<Ts>()));
+    }
+
+    // Index of the archetype with exactly `mask`, created on first use
+    uint32_t archetypeFor(ComponentMask mask);
+    // Appends a zeroed row for `entity`, returns its index
+    uint32_t appendRow(Archetype& archetype, Entity entity);
+    // Removes a row by moving the last one into it
+    void eraseRow(Archetype& archetype, uint32_t row);
+    // Moves an entity to the archetype with `mask`, keeping shared components
+    void changeArchetype(Entity entity, ComponentMask mask);
+    Entity allocate();
+
+    std::vector<std::unique_ptr<Archetype>> archetypes;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+    size_t livingCount = 0;
+};
+
+// ===============================
+// Template Definitions
+// ===============================
+template <class T>
+uint32_t World::componentId() {
+    static_assert(std::is_trivially_copyable<T>::value, "components are moved with memcpy");
+    static const uint32_t id = registerComponent(std::is_empty<T>::value ? 0 : sizeof(T));
+    return id;
+}
+
+template <class... Ts>
+Entity World::create(const Ts&... components) {
+    const Entity entity = allocate();
+    const uint32_t index = archetypeFor(maskOf<Ts...>());
+    Archetype& archetype = *archetypes[index];
+    const uint32_t row = appendRow(archetype, entity);
+    Slot& slot = slots[entity & ENTITY_INDEX_MASK];
+    slot.archetype = index;
+    slot.row = row;
+    auto store = [&](uint32_t id, const void* value, size_t size) {
+        if (size) std::memcpy(archetype.row(archetype.columnOf[id], row), value, size);
+    };
+    (store(componentId<Ts>(), &components, std::is_empty<Ts>::value ? 0 : sizeof(Ts)), ...);
+    return entity;
+}
+
+template <class... Ts>
+void World::destroyAll() {
+    const ComponentMask mask = maskOf<Ts...>();
+    for (auto& archetype : archetypes) {
+        if ((archetype->mask & mask) != mask) continue;
+        // Back to front: destroy() fills a hole from the end
+        while (!archetype->entities.empty()) destroy(archetype->entities.back());
+    }
+}
+
+template <class T>
+T* World::get(Entity entity) {
+    if (!alive(entity) || std::is_empty<T>::value) return nullptr;
+    const Slot& slot = slots[entity & ENTITY_INDEX_MASK];
+    Archetype& archetype = *archetypes[slot.archetype];
+    const int column = archetype.columnOf[componentId<T>()];
+    return column < 0 ? nullptr : reinterpret_cast<T*>(archetype.row(column, slot.row));
+}
+
+template <class T>
+bool World::has(Entity entity) const {
+    if (!alive(entity)) return false;
+    return (archetypes[slots[entity & ENTITY_INDEX_MASK].archetype]->mask >> componentId<T>()) & 1;
+}
+
+template <class T>
+void World::add(Entity entity, const T& component) {
+    if (!alive(entity)) return;
+    const Slot& slot = slots[entity & ENTITY_INDEX_MASK];
+    changeArchetype(entity, archetypes[slot.archetype]->mask | maskOf<T>());
+    if (T* stored = get<T>(entity)) std::memcpy(stored, &component, sizeof(T));
+}
+
+template <class T>
+void World::remove(Entity entity) {
+    if (!alive(entity)) return;
+    const Slot& slot = slots[entity & ENTITY_INDEX_MASK];
+    changeArchetype(entity, archetypes[slot.archetype]->mask & ~maskOf<T>());
+}
+
+template <class... Ts, class F>
+void World::eachChunk(F&& f) {
+    const ComponentMask mask = maskOf<Ts...>();
+    for (auto& archetype : archetypes) {
+        if ((archetype->mask & mask) != mask || archetype->entities.empty()) continue;
+        Archetype& a = *archetype;
+        auto column = [&a](uint32_t id) -> unsigned char* {
+            const int c = a.columnOf[id];
+            return c < 0 ? nullptr : a.columns[c].data.data();
+        };
+        f(a.entities.size(), a.entities.data(), reinterpret_cast<Ts*>(column(componentId<Ts>()))...);
+    }
+}
+
+template <class... Ts, class F>
+void World::each(F&& f) {
+    eachChunk<Ts...>([&f](size_t count, const Entity*, Ts*... columns) {
+        // Tags have no array; every row gets the same empty instance
+        auto at = [](auto* column, size_t i) -> auto& {
+            typedef typename std::remove_pointer<decltype(column)>::type T;
+            static T tag;
+            return column ? column[i] : tag;
+        };
+        for (size_t i = 0; i < count; i++) f(at(columns, i)...);
+    });
+}
+
+template <class... Ts>
+size_t World::count() const {
+    const ComponentMask mask = maskOf<Ts...>();
+    size_t total = 0;
+    for (const auto& archetype : archetypes)
+        if ((archetype->mask & mask) == mask) total += archetype->entities.size();
+    return total;
+}
@@ -0,0 +1,106 @@
+// Offline mesh baker: builds the .fmesh cache next to each OBJ so the game
+// can skip OBJ/MTL parsing and normal generation on startup.
+//
+// Usage: bake <model.obj> [more.obj ...]
+//        bake --tiles <ground.obj> <out.ftiles> [--tile-cells N]
+//
+// --tiles resamples a ground mesh at its own density and writes it as
+// paged terrain tiles (see TileFile.h); the game picks up
+// assets/terrain/untitled.ftiles, or FALLAGA_TERRAIN_TILES.
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "HeightField.h"
+#include "HeightGrid.h"
+#include "MeshCache.h"
+#include "MeshLoader.h"
+#include "TileFile.h"
+#include "Log.h"
+
+namespace {
+
+// Finest grid --tiles resamples onto, per side
+const int MAX_TILE_FIELD_CELLS = 16384;
+
+int bakeTiles(const std::string& objFilename, const std::string& outFilename, uint32_t tileCells) {
+    auto start = std::chrono::steady_clock::now();
+    MeshData mesh;
+    if (!loadMesh(objFilename, mesh)) {
+        LOG_ERROR("Failed to load OBJ: " << objFilename);
+        return 1;
+    }
+    std::vector<Face> faces;
+    for (const auto& group : mesh.materialFaces) faces.insert(faces.end(), group.second.begin(), group.second.end());
+    HeightGrid grid;
+    grid.build(mesh.vertices, faces);
+
+    HeightField field;
+    const float rayStart = mesh.boundsMax.y + 1.0f;
+    const float spacing = meshSampleSpacing(mesh.boundsMin, mesh.boundsMax, faces.size());
+    const bool resampled = resampleHeightField(
+        mesh.boundsMin, mesh.boundsMax, spacing, static_cast<int>(tileCells), MAX_TILE_FIELD_CELLS,
+        [&](const std::vector<Vec3>& points, std::vector<float>& heights) {
+            grid.heightsAt(points, rayStart, mesh.boundsMin.y, heights);
+        },
+        field);
+    if (!resampled || !writeTileFile(outFilename, field, tileCells)) {
+        LOG_ERROR("Failed to write terrain tiles: " << outFilename);
+        return 1;
+    }
+
+    const int tiles = (field.cells + tileCells - 1) / tileCells;
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOG_INFO(outFilename << ": " << field.resolution() << "^2 samples, spacing " << field.spacing << ", " << tiles
+             << "x" << tiles << " tiles of " << tileCells << " cells (" << ms << " ms)");
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc >= 2 && std::strcmp(argv[1], "--tiles") == 0) {
+        if (argc != 4 && !(argc == 6 && std::strcmp(argv[4], "--tile-cells") == 0)) {
+            std::cerr << "Usage: " << argv[0] << " --tiles <ground.obj> <out.ftiles> [--tile-cells N]\n";
+            return 1;
+        }
+        const int tileCells = argc == 6 ? std::atoi(argv[5]) : static_cast<int>(TILE_CELLS_DEFAULT);
+        if (tileCells <= 0) {
+            std::cerr << "--tile-cells must be positive\n";
+            return 1;
+        }
+        return bakeTiles(argv[2], argv[3], static_cast<uint32_t>(tileCells));
+    }
+
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <model.obj> [more.obj ...]\n"
+                  << "       " << argv[0] << " --tiles <ground.obj> <out.ftiles> [--tile-cells N]\n";
+        return 1;
+    }
+
+    int failures = 0;
+    for (int i = 1; i < argc; i++) {
+        const std::string filename = argv[i];
+        auto start = std::chrono::steady_clock::now();
+
+        MeshData mesh;
+        if (!loadMeshFromObj(filename, mesh)) {
+            LOG_ERROR("Failed to load OBJ: " << filename);
+            failures++;
+            continue;
+        }
+        if (!writeMeshCache(filename, mesh)) {
+            LOG_ERROR("Failed to write mesh cache: " << meshCachePath(filename));
+            failures++;
+            continue;
+        }
+
+        size_t faceCount = 0;
+        for (const auto& group : mesh.materialFaces) faceCount += group.second.size();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        LOG_INFO(meshCachePath(filename) << ": " << mesh.vertices.size() << " vertices, "
+                 << faceCount << " faces, " << mesh.materials.size() << " materials ("
+                 << ms << " ms)");
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,1551 @@
+// Micro-benchmarks for the engine's core kernels on generated meshes, so
+// they run anywhere (no display, no assets) and compare between commits.
+// Each kernel is warmed up, then timed over several repetitions; the JSON
+// report has the median, the median absolute deviation and ops/s. Checks
+// (kernels that must agree with a reference) are listed with their
+// mismatches, and any mismatch makes the exit status 1.
+//
+// Usage: fallaga_bench [--size N] [--reps N] [--warmup N] [--min-rep-ms MS]
+//                      [--filter TEXT] [--max-threads N] [--no-gl] [--out FILE]
+//
+//   --size         grid of N x N quads (2 N^2 triangles), default 256
+//   --filter       only kernels whose name contains TEXT
+//   --max-threads  most threads the job system kernels (ray casts included)
+//                  scale to, default one per core
+//   --no-gl        skip the kernels that need an OpenGL context
+//
+// The display-list/VBO setup and terrain draw (whole mesh against CDLOD)
+// kernels run in an offscreen context (surfaceless EGL or a hidden
+// window) and are skipped when none can be created. The animation kernels
+// read the rider rig from assets/ and are skipped when run from elsewhere.
+#include <GL/glew.h>
+#include <GL/glut.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Bvh.h"
+#include "Camera.h"
+#include "CdlodTerrain.h"
+#include "Collision.h"
+#include "Components.h"
+#include "EntitySystems.h"
+#include "GlState.h"
+#include "HeightGrid.h"
+#include "Herd.h"
+#include "Horse.h"
+#include "IndexedMesh.h"
+#include "JobSystem.h"
+#include "Mat4.h"
+#include "MeshLoader.h"
+#include "ObjectModel.h"
+#include "ObjParser.h"
+#include "OffscreenContext.h"
+#include "RenderQueue.h"
+#include "Rider.h"
+#include "Simd.h"
+#include "TilePager.h"
+#include "TriangleSoA.h"
+#include "World.h"
+#include "Vec3.h"
+#include "Log.h"
+
+namespace {
+
+struct Options {
+    int size = 256;
+    int reps = 15;
+    int warmup = 3;
+    double minRepMs = 10.0;
+    std::string filter;
+    bool gl = true;
+    std::string outPath;
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+};
+
+// Results are folded in here so the compiler can't drop the work
+volatile float sink = 0.0f;
+
+// ===============================
+// Harness
+// ===============================
+struct KernelResult {
+    std::string name;
+    size_t opsPerCall;
+    int callsPerRep;
+    double medianNs, madNs, opsPerSecond;
+};
+
+struct CheckResult {
+    std::string name;
+    size_t cases, mismatches;
+    std::string detail;
+};
+
+double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    const size_t mid = values.size() / 2;
+    return values.size() % 2 ? values[mid] : 0.5 * (values[mid - 1] + values[mid]);
+}
+
+class Harness {
+public:
+    explicit Harness(const Options& options) : options(options) {}
+
+    bool wants(const std::string& name) const {
+        return options.filter.empty() || name.find(options.filter) != std::string::npos;
+    }
+
+    // `call` does `ops` units of work (triangles, rays, ...) and is run
+    // enough times per repetition to fill minRepMs, so short kernels are
+    // not lost in timer resolution
+    void run(const std::string& name, size_t ops, const std::function<void()>& call) {
+        if (!wants(name)) return;
+
+        double slowestNs = 1.0;
+        for (int i = 0; i < std::max(options.warmup, 1); i++) slowestNs = std::max(slowestNs, timeCalls(call, 1));
+        const int calls = std::max(1, static_cast<int>(std::ceil(options.minRepMs * 1e6 / slowestNs)));
+
+        std::vector<double> perCall;
+        for (int rep = 0; rep < options.reps; rep++) perCall.push_back(timeCalls(call, calls) / calls);
+
+        KernelResult result;
+        result.name = name;
+        result.opsPerCall = ops;
+        result.callsPerRep = calls;
+        result.medianNs = median(perCall);
+        std::vector<double> deviations;
+        for (double ns : perCall) deviations.push_back(std::abs(ns - result.medianNs));
+        result.madNs = median(deviations);
+        result.opsPerSecond = ops / (result.medianNs * 1e-9);
+        results.push_back(result);
+
+        LOG_INFO(name << ": " << result.medianNs / 1e6 << " ms +- " << result.madNs / 1e6 << " ms, "
+                 << result.opsPerSecond / 1e6 << " Mops/s");
+    }
+
+    void skip(const std::string& name, const std::string& reason) {
+        if (!wants(name)) return;
+        skipped.push_back({name, reason});
+        LOG_WARN(name << ": skipped, " << reason);
+    }
+
+    // Records a check that compared `cases` results against a reference
+    void check(const std::string& name, size_t cases, size_t mismatches, const std::string& detail) {
+        checks.push_back({ name, cases, mismatches, detail });
+        if (mismatches)
+            LOG_ERROR(name << ": " << mismatches << " of " << cases << " mismatched (" << detail << ")");
+        else
+            LOG_INFO(name << ": " << cases << " cases match (" << detail << ")");
+    }
+
+    bool failed() const {
+        return std::any_of(checks.begin(), checks.end(), [](const CheckResult& c) { return c.mismatches > 0; });
+    }
+
+    std::vector<KernelResult> results;
+    std::vector<std::pair<std::string, std::string>> skipped;
+    std::vector<CheckResult> checks;
+
+private:
+    static double timeCalls(const std::function<void()>& call, int calls) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < calls; i++) call();
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const Options& options;
+};
+
+// ===============================
+// Synthetic Mesh
+// ===============================
+
+// Rolling terrain of size x size quads, one unit apart and centred on the
+// origin, each split into two triangles. Faces carry texcoords but no
+// normals, as an OBJ export without "vn" lines would.
+struct SyntheticMesh {
+    std::vector<Vec3> vertices;
+    std::vector<Vec2> texcoords;
+    std::vector<Face> faces;
+};
+
+float terrainHeight(float x, float z) {
+    return 4.0f * std::sin(x * 0.05f) * std::cos(z * 0.07f) + 0.5f * std::sin(x * 0.31f + z * 0.23f);
+}
+
+SyntheticMesh makeGrid(int size) {
+    SyntheticMesh mesh;
+    const int row = size + 1;
+    const float half = size * 0.5f;
+    for (int z = 0; z <= size; z++) {
+        for (int x = 0; x <= size; x++) {
+            const float px = x - half, pz = z - half;
+            mesh.vertices.emplace_back(px, terrainHeight(px, pz), pz);
+            mesh.texcoords.emplace_back(static_cast<float>(x) / size, static_cast<float>(z) / size);
+        }
+    }
+    for (int z = 0; z < size; z++) {
+        for (int x = 0; x < size; x++) {
+            const int i = z * row + x;
+            const int quad[2][3] = { { i, i + row, i + 1 }, { i + 1, i + row, i + row + 1 } };
+            for (const auto& corners : quad) {
+                Face face;
+                for (int c = 0; c < 3; c++) {
+                    face.v[c] = face.vt[c] = corners[c];
+                    face.vn[c] = -1;
+                }
+                mesh.faces.push_back(face);
+            }
+        }
+    }
+    return mesh;
+}
+
+bool writeObj(const SyntheticMesh& mesh, const std::string& path) {
+    std::ofstream out(path);
+    if (!out) return false;
+    for (const auto& v : mesh.vertices) out << "v " << v.x << ' ' << v.y << ' ' << v.z << '\n';
+    for (const auto& t : mesh.texcoords) out << "vt " << t.u << ' ' << t.v << '\n';
+    out << "usemtl terrain\n";
+    for (const auto& f : mesh.faces) {
+        out << 'f';
+        for (int c = 0; c < 3; c++) out << ' ' << f.v[c] + 1 << '/' << f.vt[c] + 1;
+        out << '\n';
+    }
+    return static_cast<bool>(out);
+}
+
+// Deterministic query points inside the mesh footprint
+std::vector<Vec3> queryPoints(int size, size_t count) {
+    std::vector<Vec3> points;
+    uint32_t state = 12345;
+    auto next = [&state] {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) * (1.0f / 16777216.0f);
+    };
+    const float half = size * 0.5f;
+    for (size_t i = 0; i < count; i++) {
+        const float x = (next() - 0.5f) * 2.0f * half;
+        const float z = (next() - 0.5f) * 2.0f * half;
+        points.emplace_back(x, 0.0f, z);
+    }
+    return points;
+}
+
+// ===============================
+// CPU Kernels
+// ===============================
+void benchCpu(Harness& harness, const SyntheticMesh& mesh, const Options& options) {
+    const std::vector<Vec3>& vertices = mesh.vertices;
+    const size_t triangles = mesh.faces.size();
+
+    harness.run("vec3_arith", vertices.size(), [&] {
+        Vec3 sum;
+        const Vec3 up(0.0f, 1.0f, 0.0f);
+        for (size_t i = 1; i < vertices.size(); i++) {
+            Vec3 edge = vertices[i] - vertices[i - 1];
+            Vec3 side = edge.cross(up);
+            side.normalize();
+            sum += side * edge.dot(up) + edge * 0.5f;
+        }
+        sink = sum.x + sum.y + sum.z + sum.length();
+    });
+
+    // A vertical ray down through each triangle's centroid: every test hits
+    harness.run("ray_triangle", triangles, [&] {
+        const Vec3 down(0.0f, -1.0f, 0.0f);
+        float total = 0.0f;
+        for (const Face& face : mesh.faces) {
+            const Vec3& v0 = vertices[face.v[0]];
+            const Vec3& v1 = vertices[face.v[1]];
+            const Vec3& v2 = vertices[face.v[2]];
+            Vec3 origin = (v0 + v1 + v2) * (1.0f / 3.0f);
+            origin.y = 100.0f;
+            float t;
+            if (ObjModel::rayTriangleIntersect(origin, down, v0, v1, v2, t)) total += t;
+        }
+        sink = total;
+    });
+
+    // Smooth normals on one thread; jobs_vertex_normals is the same through
+    // the job system, as ObjModel and the OBJ loader run it
+    harness.run("vertex_normals", triangles, [&] {
+        std::vector<Face> faces = mesh.faces;
+        std::vector<Vec3> normals(vertices.size(), Vec3(0, 0, 0));
+        accumulateFaceNormals(vertices, faces, normals);
+        finalizeVertexNormals(normals);
+        sink = normals.back().y;
+    });
+
+    // Corner deduplication for the VBO path (on the loader thread in game)
+    if (harness.wants("indexed_mesh_build")) {
+        std::map<std::string, std::vector<Face>> materialFaces;
+        materialFaces["terrain"] = mesh.faces;
+        std::vector<Vec3> normals(vertices.size(), Vec3(0, 0, 0));
+        accumulateFaceNormals(vertices, materialFaces["terrain"], normals);
+        finalizeVertexNormals(normals);
+        harness.run("indexed_mesh_build", triangles, [&] {
+            IndexedMesh indexed;
+            buildIndexedMesh(vertices, normals, mesh.texcoords, materialFaces, indexed);
+            sink = static_cast<float>(indexed.vertices.size());
+        });
+    }
+
+    if (harness.wants("obj_parse")) {
+        const std::string path =
+            (std::filesystem::temp_directory_path() / ("fallaga_bench_" + std::to_string(options.size) + ".obj")).string();
+        if (writeObj(mesh, path)) {
+            harness.run("obj_parse", triangles, [&] {
+                ObjData data;
+                parseObjFile(path, data);
+                sink = static_cast<float>(data.vertices.size());
+            });
+            harness.run("obj_parse_legacy", triangles, [&] {
+                ObjData data;
+                parseObjFileLegacy(path, data);
+                sink = static_cast<float>(data.vertices.size());
+            });
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+        } else {
+            harness.skip("obj_parse", "could not write " + path);
+        }
+    }
+
+    // The grid behind ObjModel::getHeightAt, i.e. the terrain's ground queries
+    HeightGrid grid;
+    grid.build(vertices, mesh.faces);
+    const std::vector<Vec3> points = queryPoints(options.size, 65536);
+    harness.run("terrain_height", points.size(), [&] {
+        float total = 0.0f;
+        for (const Vec3& p : points) {
+            float height;
+            if (grid.heightAt(p.x, p.z, 100.0f, height)) total += height;
+        }
+        sink = total;
+    });
+    std::vector<float> heights;
+    harness.run("terrain_heights_batched", points.size(), [&] {
+        grid.heightsAt(points, 100.0f, 0.0f, heights);
+        sink = heights.back();
+    });
+
+    // The same queries against paged tiles: paging in the working set around
+    // the centre from a fresh mapping, then batched lookups in it (points on
+    // tiles outside it get the index fallback, as in game)
+    if (harness.wants("tile_page_in") || harness.wants("tile_height_query")) {
+        HeightField field;
+        Vec3 lo(-options.size * 0.5f, 0.0f, -options.size * 0.5f), hi(options.size * 0.5f, 0.0f, options.size * 0.5f);
+        resampleHeightField(lo, hi, 1.0f, TILE_CELLS_DEFAULT, options.size,
+                            [&grid](const std::vector<Vec3>& p, std::vector<float>& h) { grid.heightsAt(p, 100.0f, 0.0f, h); },
+                            field);
+        const std::string path =
+            (std::filesystem::temp_directory_path() / ("fallaga_bench_" + std::to_string(options.size) + ".ftiles")).string();
+        if (writeTileFile(path, field)) {
+            auto pageIn = [&](TilePager& pager) {
+                pager.open(path);
+                pager.update(Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 0.0f, 0.0f));
+                while (!pager.idle()) std::this_thread::yield();
+            };
+            size_t tilesLoaded = 0;
+            {
+                TilePager pager(size_t(256) << 20);
+                pageIn(pager);
+                tilesLoaded = pager.getStats().loads;
+            }
+            harness.run("tile_page_in", tilesLoaded, [&] {
+                TilePager pager(size_t(256) << 20);
+                pageIn(pager);
+                sink = static_cast<float>(pager.getStats().residentBytes);
+            });
+            TilePager pager(size_t(256) << 20);
+            pageIn(pager);
+            std::vector<TilePager::Sample> samples;
+            harness.run("tile_height_query", points.size(), [&] {
+                pager.heightsAt(points, heights, samples);
+                sink = heights.back();
+            });
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+        } else {
+            harness.skip("tile_page_in", "could not write " + path);
+            harness.skip("tile_height_query", "could not write " + path);
+        }
+    }
+}
+
+// ===============================
+// Triangle Kernels
+// ===============================
+const size_t SIMD_CHECK_BLOCKS = 50000;
+
+// How the triangles of the SIMD check relate to the block's ray
+enum class TriangleCase { Random, Degenerate, Grazing, Parallel, NonFinite, Count };
+
+const char* triangleCaseName(TriangleCase c) {
+    switch (c) {
+        case TriangleCase::Random: return "random";
+        case TriangleCase::Degenerate: return "degenerate";
+        case TriangleCase::Grazing: return "grazing";
+        case TriangleCase::Parallel: return "parallel";
+        case TriangleCase::NonFinite: return "nonfinite";
+        default: return "?";
+    }
+}
+
+// The scalar, SSE and AVX2 Moller-Trumbore kernels over blocks of eight
+// triangles built around one ray each: random ones near the ray, zero-area
+// ones (coincident or collinear corners), ones the ray meets exactly on a
+// corner or an edge, ones lying in a plane along the ray, and ones with a
+// NaN or infinite coordinate. Every kernel the CPU has must give the same
+// hit mask and bit-identical distances as the scalar one, lane for lane.
+// The linear scans after it are the kernels' throughput over the mesh.
+void benchTriangleKernels(Harness& harness, const SyntheticMesh& mesh) {
+    const SimdLevel cpu = detectSimdLevel();
+    std::vector<SimdLevel> levels = { SimdLevel::Scalar };
+    if (cpu >= SimdLevel::Sse) levels.push_back(SimdLevel::Sse);
+    if (cpu >= SimdLevel::Avx2) levels.push_back(SimdLevel::Avx2);
+
+    if (harness.wants("simd_equivalence")) {
+        uint32_t state = 987654321u;
+        auto next = [&state] {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return (state >> 8) * (1.0f / 16777216.0f);
+        };
+        auto inBox = [&](float extent) {
+            return Vec3((next() * 2.0f - 1.0f) * extent, (next() * 2.0f - 1.0f) * extent, (next() * 2.0f - 1.0f) * extent);
+        };
+
+        const size_t caseCount = static_cast<size_t>(TriangleCase::Count);
+        std::vector<size_t> lanes(caseCount, 0), hits(caseCount, 0), mismatches(caseCount, 0);
+        TriangleSoA block;
+        block.resize(8);
+        for (size_t b = 0; b < SIMD_CHECK_BLOCKS; b++) {
+            const Vec3 origin = inBox(4.0f);
+            const Vec3 target = inBox(1.0f);
+            const Vec3 dir = target - origin;
+            TriangleCase cases[8];
+            for (int k = 0; k < 8; k++) {
+                const TriangleCase c = static_cast<TriangleCase>(static_cast<size_t>(next() * caseCount) % caseCount);
+                cases[k] = c;
+                Vec3 a = target + inBox(1.0f), bCorner = target + inBox(1.0f), cCorner = target + inBox(1.0f);
+                switch (c) {
+                    case TriangleCase::Random:
+                        break;
+                    case TriangleCase::Degenerate:
+                        if (next() < 0.5f) bCorner = a;
+                        else cCorner = a + (bCorner - a) * (next() * 3.0f - 1.0f);
+                        break;
+                    case TriangleCase::Grazing:
+                        // The ray's target on a corner, or on the edge a-b
+                        if (next() < 0.3f) a = target;
+                        else bCorner = target + (target - a) * (0.25f + next());
+                        break;
+                    case TriangleCase::Parallel:
+                        bCorner = a + dir * (next() * 2.0f - 1.0f);
+                        break;
+                    case TriangleCase::NonFinite: {
+                        const float bad = next() < 0.7f ? std::numeric_limits<float>::quiet_NaN()
+                                                        : std::numeric_limits<float>::infinity();
+                        Vec3* corners[3] = { &a, &bCorner, &cCorner };
+                        Vec3& corner = *corners[static_cast<int>(next() * 3.0f) % 3];
+                        const int axis = static_cast<int>(next() * 3.0f) % 3;
+                        (axis == 0 ? corner.x : axis == 1 ? corner.y : corner.z) = bad;
+                        break;
+                    }
+                    default:
+                        break;
+                }
+                block.set(k, a, bCorner, cCorner);
+            }
+
+            // Mostly full blocks, some partial ones as at the end of a leaf
+            const size_t count = (b % 7 == 6) ? 1 + b % 8 : 8;
+            float reference[8];
+            const uint32_t expected = soaIntersectMask(block, 0, count, origin, dir, SimdLevel::Scalar, reference);
+            for (size_t k = 0; k < count; k++) {
+                const size_t c = static_cast<size_t>(cases[k]);
+                lanes[c]++;
+                if (expected & (1u << k)) hits[c]++;
+            }
+            for (size_t l = 1; l < levels.size(); l++) {
+                float t[8];
+                const uint32_t mask = soaIntersectMask(block, 0, count, origin, dir, levels[l], t);
+                for (size_t k = 0; k < count; k++) {
+                    const uint32_t bit = 1u << k;
+                    const bool same = (mask & bit) == (expected & bit) &&
+                                      (!(mask & bit) || std::memcmp(&t[k], &reference[k], sizeof(float)) == 0);
+                    if (!same) mismatches[static_cast<size_t>(cases[k])]++;
+                }
+            }
+        }
+
+        std::string detail;
+        for (SimdLevel level : levels) detail += std::string(detail.empty() ? "" : ",") + simdLevelName(level);
+        if (levels.size() == 1) detail += " only, no vector kernel on this CPU";
+        size_t totalLanes = 0, totalMismatches = 0;
+        for (size_t c = 0; c < caseCount; c++) {
+            detail += std::string("; ") + triangleCaseName(static_cast<TriangleCase>(c)) + " " +
+                      std::to_string(hits[c]) + "/" + std::to_string(lanes[c]) + " hit";
+            totalLanes += lanes[c] * (levels.size() - 1);
+            totalMismatches += mismatches[c];
+        }
+        harness.check("simd_equivalence", totalLanes, totalMismatches, detail);
+    }
+
+    // One downward ray through the middle, tested against every triangle
+    TriangleSoA triangles;
+    triangles.resize(mesh.faces.size());
+    for (size_t i = 0; i < mesh.faces.size(); i++) {
+        const Face& f = mesh.faces[i];
+        triangles.set(i, mesh.vertices[f.v[0]], mesh.vertices[f.v[1]], mesh.vertices[f.v[2]]);
+    }
+    const SimdLevel active = activeSimdLevel();
+    for (SimdLevel level : levels) {
+        setSimdLevel(level);
+        harness.run(std::string("soa_scan_") + simdLevelName(level), triangles.size(), [&] {
+            float t = 0.0f;
+            size_t index = 0;
+            soaClosestHit(triangles, 0, triangles.size(), Vec3(0.3f, 100.0f, 0.3f), Vec3(0.0f, -1.0f, 0.0f),
+                          std::numeric_limits<float>::max(), t, index);
+            sink = t;
+        });
+    }
+    setSimdLevel(active);
+}
+
+// ===============================
+// Height Query Scaling
+// ===============================
+const int HEIGHT_SCALING_SIZES[] = { 16, 32, 64, 128, 256, 512 };
+const size_t HEIGHT_SCALING_QUERIES = 256;
+
+// Ground height from the grid against scanning every triangle, as
+// ObjModel::getHeightAtBruteForce does, on grids of 16^2 up to --size^2
+// quads: terrain_height_grid_<triangles> and terrain_height_brute_<triangles>,
+// ops being queries. terrain_height_matches_brute checks both return the
+// same heights, bit for bit, at every size.
+void benchHeightScaling(Harness& harness, const Options& options) {
+    const bool check = harness.wants("terrain_height_matches_brute");
+    if (!check && !harness.wants("terrain_height_grid") && !harness.wants("terrain_height_brute")) return;
+
+    const float RAY_START = 100.0f;
+    size_t cases = 0, mismatches = 0;
+    std::string detail;
+    for (int size : HEIGHT_SCALING_SIZES) {
+        if (size > options.size) break;
+        const SyntheticMesh grid = makeGrid(size);
+        HeightGrid index;
+        index.build(grid.vertices, grid.faces);
+        TriangleSoA triangles;
+        triangles.resize(grid.faces.size());
+        for (size_t i = 0; i < grid.faces.size(); i++) {
+            const Face& f = grid.faces[i];
+            triangles.set(i, grid.vertices[f.v[0]], grid.vertices[f.v[1]], grid.vertices[f.v[2]]);
+        }
+        const std::vector<Vec3> points = queryPoints(size, HEIGHT_SCALING_QUERIES);
+
+        auto brute = [&](const Vec3& p, float& height) {
+            float t = 0.0f;
+            size_t hit = 0;
+            if (!soaClosestHit(triangles, 0, triangles.size(), Vec3(p.x, RAY_START, p.z), Vec3(0.0f, -1.0f, 0.0f),
+                               std::numeric_limits<float>::max(), t, hit))
+                return false;
+            height = RAY_START + t * -1.0f;
+            return true;
+        };
+
+        if (check) {
+            for (const Vec3& p : points) {
+                float fromGrid = 0.0f, fromScan = 0.0f;
+                const bool gridHit = index.heightAt(p.x, p.z, RAY_START, fromGrid);
+                const bool scanHit = brute(p, fromScan);
+                if (gridHit != scanHit || (gridHit && std::memcmp(&fromGrid, &fromScan, sizeof(float)) != 0))
+                    mismatches++;
+                cases++;
+            }
+            detail += std::string(detail.empty() ? "" : ", ") + std::to_string(grid.faces.size());
+        }
+
+        const std::string suffix = "_" + std::to_string(grid.faces.size());
+        harness.run("terrain_height_grid" + suffix, points.size(), [&] {
+            float total = 0.0f;
+            for (const Vec3& p : points) {
+                float height;
+                if (index.heightAt(p.x, p.z, RAY_START, height)) total += height;
+            }
+            sink = total;
+        });
+        harness.run("terrain_height_brute" + suffix, points.size(), [&] {
+            float total = 0.0f;
+            for (const Vec3& p : points) {
+                float height;
+                if (brute(p, height)) total += height;
+            }
+            sink = total;
+        });
+    }
+    if (check) harness.check("terrain_height_matches_brute", cases, mismatches, detail + " triangles");
+}
+
+// Offscreen view of the GL kernels, and the aspect the culling kernels use
+const int VIEW_WIDTH = 640, VIEW_HEIGHT = 360;
+
+// ===============================
+// Entities
+// ===============================
+const size_t ENTITY_COUNT = 100000;
+
+// The per-frame entity systems over 100k moving entities scattered on a
+// 1 km square, in two archetypes: moving them (Transform, Velocity and
+// Bounds streamed once) and culling them against a walker's view
+void makeEntities(World& world) {
+    const std::vector<Vec3> points = queryPoints(1000, ENTITY_COUNT);
+    for (size_t i = 0; i < points.size(); i++) {
+        const Vec3& p = points[i];
+        const Transform t = { p.x, 0.0f, p.z, 1.0f, 0.0f };
+        const Bounds b = { Vec3(p.x - 0.5f, 0.0f, p.z - 0.5f), Vec3(p.x + 0.5f, 2.0f, p.z + 0.5f) };
+        const Velocity v = { Vec3(std::sin(p.z), 0.0f, std::cos(p.x)) };
+        if (i % 2)
+            world.create(t, v, b, Visibility{ 0 }, HorseTag());
+        else
+            world.create(t, v, b, Visibility{ 0 }, TreeTag());
+    }
+}
+
+Frustum walkerFrustum() {
+    Frustum frustum;
+    frustum.fromCamera(Vec3(0.0f, 2.0f, 0.0f), Vec3(10.0f, 2.0f, 10.0f), Vec3(0.0f, 1.0f, 0.0f), 45.0f,
+                       static_cast<float>(VIEW_WIDTH) / VIEW_HEIGHT, 0.1f, 1000.0f);
+    return frustum;
+}
+
+void benchEntities(Harness& harness) {
+    World world;
+    makeEntities(world);
+
+    harness.run("entity_integrate", ENTITY_COUNT, [&] {
+        integrateMotion(world, 1.0f / 60.0f);
+        sink = world.get<Transform>(0)->x;
+    });
+
+    const Frustum frustum = walkerFrustum();
+    harness.run("entity_cull", ENTITY_COUNT, [&] {
+        CullStats stats;
+        cullEntities(world, frustum, stats);
+        sink = static_cast<float>(stats.drawn);
+    });
+}
+
+// ===============================
+// Herd
+// ===============================
+const size_t HERD_SIZES[] = { 1000, 10000, 50000 };
+
+// One simulation tick of a grazing herd (steering, moving, terrain
+// following) at each size, the horses 1.5 m apart on a square with the
+// player at its centre. Tick time should grow with the herd and not with
+// its square. The 10k herd's steering is also timed alone, with SSE and
+// on the scalar path.
+void benchHerd(Harness& harness, const SyntheticMesh& mesh) {
+    HeightGrid grid;
+    grid.build(mesh.vertices, mesh.faces);
+    const HeightQuery heightsAt = [&grid](const std::vector<Vec3>& points, std::vector<float>& heights) {
+        grid.heightsAt(points, 100.0f, 0.0f, heights);
+    };
+    const float dt = 1.0f / 60.0f;
+
+    for (size_t count : HERD_SIZES) {
+        const std::string tick = "herd_tick_" + std::to_string(count);
+        const std::string steer = "herd_steer_" + std::to_string(count);
+        const std::string scalar = "herd_steer_scalar_" + std::to_string(count);
+        const bool compareScalar = count == 10000;
+        if (!harness.wants(tick) && !(compareScalar && (harness.wants(steer) || harness.wants(scalar)))) continue;
+
+        World world;
+        Herd herd;
+        const int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(count))));
+        for (size_t i = 0; i < count; i++) {
+            const float heading = i * 2.4f;
+            spawnHorse(world, Vec3((i % side - 0.5f * side) * 1.5f, 0.0f, (i / side - 0.5f * side) * 1.5f),
+                       Vec3(std::sin(heading), 0.0f, std::cos(heading)) * herd.getParams().grazeSpeed);
+        }
+        const Vec3 threat(0.0f, 0.0f, 0.0f);
+
+        harness.run(tick, count, [&] {
+            herd.update(world, threat, dt);
+            integrateMotion(world, dt);
+            updateHorses(world, heightsAt);
+            sink = static_cast<float>(herd.getStats().neighbours);
+        });
+        if (compareScalar) {
+            harness.run(steer, count, [&] {
+                herd.update(world, threat, dt);
+                sink = static_cast<float>(herd.getStats().neighbours);
+            });
+            herd.setVectorized(false);
+            harness.run(scalar, count, [&] {
+                herd.update(world, threat, dt);
+                sink = static_cast<float>(herd.getStats().neighbours);
+            });
+        }
+        LOG_INFO("Herd of " << count << ": " << herd.getStats().neighbours / static_cast<double>(count)
+                 << " neighbours each, " << herd.getStats().candidates / static_cast<double>(count)
+                 << " looked at");
+    }
+}
+
+// ===============================
+// Collision
+// ===============================
+const size_t PROP_COUNTS[] = { 1000, 10000, 50000 };
+const size_t WALKERS = 1000;
+// Metres of ground per prop, so bigger worlds are bigger, not denser
+const float PROP_SPACING = 4.0f;
+
+// A tree trunk's worth of triangles: a 16-sided cylinder in 4 bands
+CollisionMesh makeTrunk() {
+    const int SIDES = 16, BANDS = 4;
+    const float RADIUS = 0.3f, HEIGHT = 3.0f;
+    TriangleSoA triangles;
+    triangles.resize(SIDES * BANDS * 2);
+    size_t t = 0;
+    for (int band = 0; band < BANDS; band++) {
+        const float y0 = HEIGHT * band / BANDS, y1 = HEIGHT * (band + 1) / BANDS;
+        for (int side = 0; side < SIDES; side++) {
+            const float a0 = 6.2831853f * side / SIDES, a1 = 6.2831853f * (side + 1) / SIDES;
+            const Vec3 p00(RADIUS * std::cos(a0), y0, RADIUS * std::sin(a0));
+            const Vec3 p01(RADIUS * std::cos(a1), y0, RADIUS * std::sin(a1));
+            const Vec3 p10(p00.x, y1, p00.z), p11(p01.x, y1, p01.z);
+            triangles.set(t++, p00, p01, p11);
+            triangles.set(t++, p00, p11, p10);
+        }
+    }
+    return CollisionMesh::fromTriangles(triangles);
+}
+
+// The player's collision on worlds of 1k to 50k props at the same
+// density: the one-pass build of the static tree, then 1000 walkers each
+// taking a character-controller step (lift, slide, settle: three capsule
+// sweeps). The step should cost the same whatever the prop count, as
+// only the tree's depth grows. At 10k the props also go in as moving
+// bodies, each nudged every tick, for the incremental tree.
+void benchCollision(Harness& harness) {
+    const CollisionMesh trunk = makeTrunk();
+    const Capsule body = { 0.3f, 1.8f };
+    const GroundHeight flat = [](float, float) { return 0.0f; };
+
+    for (size_t count : PROP_COUNTS) {
+        const std::string build = "collide_build_" + std::to_string(count);
+        const std::string step = "collide_step_" + std::to_string(count);
+        const std::string bodies = "collide_bodies_" + std::to_string(count);
+        const bool moving = count == 10000;
+        if (!harness.wants(build) && !harness.wants(step) && !(moving && harness.wants(bodies))) continue;
+
+        // The first `count` points are props, the rest walkers among them
+        const int side = static_cast<int>(std::sqrt(static_cast<float>(count)) * PROP_SPACING);
+        const std::vector<Vec3> points = queryPoints(side, count + WALKERS);
+        std::vector<CollisionInstance> props(count);
+        for (size_t i = 0; i < count; i++)
+            props[i] = { 0, { points[i].x, 0.0f, points[i].z, 0.5f + (i % 5) * 0.25f, 0.7f * i } };
+
+        CollisionWorld world;
+        world.addMesh("trunk", trunk);
+        harness.run(build, count, [&] {
+            world.setStatics(props);
+            sink = static_cast<float>(world.staticCount());
+        });
+        world.setStatics(props);
+
+        std::vector<Vec3> walkers(points.begin() + count, points.end());
+        size_t tick = 0;
+        harness.run(step, WALKERS, [&] {
+            // Each walker heads its own way and turns a little every tick
+            for (size_t i = 0; i < walkers.size(); i++) {
+                const float heading = 2.4f * i + 0.01f * tick;
+                const Vec3 motion(0.05f * std::sin(heading), 0.0f, 0.05f * std::cos(heading));
+                walkers[i] = world.moveCharacter(body, walkers[i], motion, flat, 0.35f);
+            }
+            tick++;
+            sink = walkers[0].x;
+        });
+
+        if (!moving) continue;
+        std::vector<int> ids(count);
+        std::vector<Transform> transforms(count);
+        for (size_t i = 0; i < count; i++) {
+            transforms[i] = props[i].transform;
+            ids[i] = world.addBody(0, transforms[i]);
+        }
+        tick = 0;
+        harness.run(bodies, count, [&] {
+            for (size_t i = 0; i < count; i++) {
+                const float heading = 2.4f * i + 0.01f * tick;
+                transforms[i].x += 0.02f * std::sin(heading);
+                transforms[i].z += 0.02f * std::cos(heading);
+            }
+            world.moveBodies(ids.data(), transforms.data(), count);
+            tick++;
+            sink = transforms[0].x;
+        });
+    }
+}
+
+// ===============================
+// Animation
+// ===============================
+const size_t RIDER_COUNT = 500;
+const char* RIDER_RIG = "assets/rider/rider.rig";
+
+// Posing RIDER_COUNT riders (sampling both gaits, blending and building
+// world-space palettes, over the job system) and skinning them on the
+// CPU, with SSE and without. The one asset-backed kernel: run from the
+// repository root, or it is skipped.
+void benchAnimation(Harness& harness) {
+    const char* kernels[] = { "anim_palettes", "anim_skin_cpu", "anim_skin_scalar" };
+    if (std::none_of(std::begin(kernels), std::end(kernels), [&](const char* name) { return harness.wants(name); }))
+        return;
+    RiderAnimation animation;
+    if (!std::filesystem::exists(RIDER_RIG) || !animation.load(RIDER_RIG)) {
+        for (const char* name : kernels) harness.skip(name, std::string("no ") + RIDER_RIG);
+        return;
+    }
+    const SkinnedMesh& mesh = animation.getMesh();
+    LOG_INFO("Rider clips: " << animation.getTrot().getKeyCount() + animation.getGallop().getKeyCount()
+             << " keys, " << animation.getTrot().getMemoryBytes() + animation.getGallop().getMemoryBytes()
+             << " bytes (raw " << (animation.getRawTrot().frames.size() + animation.getRawGallop().frames.size())
+                                      * sizeof(JointPose)
+             << ")");
+
+    std::vector<RiderPose> riders(RIDER_COUNT);
+    for (size_t i = 0; i < RIDER_COUNT; i++) {
+        const float phase = 0.618034f * i;
+        riders[i].placement = { (i % 25) * 2.0f, 0.0f, (i / 25) * 2.0f, 1.0f, 0.1f * i };
+        riders[i].phase = phase - std::floor(phase);
+        riders[i].gallop = (i % 5) / 4.0f;
+    }
+    std::vector<Mat34> palettes;
+    harness.run("anim_palettes_" + std::to_string(RIDER_COUNT), RIDER_COUNT, [&] {
+        animation.computePalettes(riders, palettes);
+        sink = palettes.back().m[0][3];
+    });
+
+    animation.computePalettes(riders, palettes);
+    std::vector<float> positions(3 * mesh.vertices.size()), normals(positions.size());
+    const size_t vertices = RIDER_COUNT * mesh.vertices.size();
+    harness.run("anim_skin_cpu_" + std::to_string(RIDER_COUNT), vertices, [&] {
+        for (size_t i = 0; i < RIDER_COUNT; i++) {
+            skinVertices(mesh, &palettes[i * mesh.paletteSize], positions.data(), normals.data());
+        }
+        sink = positions[0];
+    });
+    harness.run("anim_skin_scalar_" + std::to_string(RIDER_COUNT), vertices, [&] {
+        for (size_t i = 0; i < RIDER_COUNT; i++) {
+            skinVerticesScalar(mesh, &palettes[i * mesh.paletteSize], positions.data(), normals.data());
+        }
+        sink = positions[0];
+    });
+}
+
+// ===============================
+// Transforms
+// ===============================
+const size_t MATRIX_COUNT = 10000;
+
+const size_t MATRIX_CHECK_CASES = 20000;
+
+// Element (row, col) of a matrix kept in doubles, column-major like Mat4
+struct RefMat4 {
+    double m[16] = {};
+    double& at(int row, int col) { return m[col * 4 + row]; }
+};
+
+// How many of `count` elements of `value` are off `reference` by more than
+// float rounding, each against itself or the size of the terms that summed
+// to it, whichever is larger
+size_t countOff(const float* value, const double* reference, const double* scale, size_t count) {
+    size_t off = 0;
+    for (size_t i = 0; i < count; i++) {
+        const double size = std::max({ 1.0, scale[i], std::abs(reference[i]) });
+        if (!(std::abs(value[i] - reference[i]) <= 1e-5 * size)) off++;
+    }
+    return off;
+}
+
+// Checks on the hand-written matrix math:
+//   mat4_simd_equivalence   multiplyMatrices and transformBounds against
+//                           their *Scalar versions, on random matrices
+//   mat4_inverse            M * M.inverse() against the identity, for
+//                           random well-conditioned and camera-times-model
+//                           matrices
+//   mat4_camera_matrices    lookAt, perspective and orthographic against
+//                           the gluLookAt/gluPerspective/glOrtho formulas
+//                           worked out in double precision
+void checkTransforms(Harness& harness) {
+    uint32_t state = 24681357u;
+    auto next = [&state] {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return (state >> 8) * (1.0f / 16777216.0f);
+    };
+    auto between = [&](float lo, float hi) { return lo + (hi - lo) * next(); };
+    auto randomVec = [&](float extent) {
+        return Vec3(between(-extent, extent), between(-extent, extent), between(-extent, extent));
+    };
+    auto randomMatrix = [&](float extent) {
+        Mat4 r;
+        for (float& v : r.m) v = between(-extent, extent);
+        return r;
+    };
+
+    if (harness.wants("mat4_simd_equivalence")) {
+        std::vector<Mat4> b(MATRIX_CHECK_CASES), fast(MATRIX_CHECK_CASES), scalar(MATRIX_CHECK_CASES);
+        std::vector<ObjectBounds> fastBounds(MATRIX_CHECK_CASES), scalarBounds(MATRIX_CHECK_CASES);
+        for (Mat4& matrix : b) matrix = randomMatrix(100.0f);
+        const Mat4 a = randomMatrix(10.0f);
+        multiplyMatrices(a, b.data(), MATRIX_CHECK_CASES, fast.data());
+        multiplyMatricesScalar(a, b.data(), MATRIX_CHECK_CASES, scalar.data());
+        const ObjectBounds local = { Vec3(-1.5f, -0.25f, -3.0f), Vec3(2.0f, 4.0f, 0.5f) };
+        transformBounds(local, b.data(), MATRIX_CHECK_CASES, fastBounds.data());
+        transformBoundsScalar(local, b.data(), MATRIX_CHECK_CASES, scalarBounds.data());
+
+        // Both sum in the same order, so they agree exactly unless the
+        // compiler fused a multiply and add in one of them
+        size_t cases = 0, mismatches = 0, identical = 0;
+        for (size_t i = 0; i < MATRIX_CHECK_CASES; i++) {
+            double reference[16], scale[16];
+            for (int c = 0; c < 4; c++)
+                for (int r = 0; r < 4; r++) {
+                    scale[c * 4 + r] = 0.0;
+                    for (int k = 0; k < 4; k++) scale[c * 4 + r] += std::abs(a.m[k * 4 + r] * b[i].m[c * 4 + k]);
+                    reference[c * 4 + r] = scalar[i].m[c * 4 + r];
+                }
+            mismatches += countOff(fast[i].m, reference, scale, 16) ? 1 : 0;
+            identical += std::memcmp(fast[i].m, scalar[i].m, sizeof(fast[i].m)) == 0 ? 1 : 0;
+
+            const float got[6] = { fastBounds[i].min.x, fastBounds[i].min.y, fastBounds[i].min.z,
+                                   fastBounds[i].max.x, fastBounds[i].max.y, fastBounds[i].max.z };
+            const double want[6] = { scalarBounds[i].min.x, scalarBounds[i].min.y, scalarBounds[i].min.z,
+                                     scalarBounds[i].max.x, scalarBounds[i].max.y, scalarBounds[i].max.z };
+            double boundsScale[6];
+            for (int axis = 0; axis < 3; axis++) {
+                double sum = std::abs(b[i].m[12 + axis]);
+                for (int k = 0; k < 3; k++) sum += std::abs(b[i].m[k * 4 + axis]) * 4.0;
+                boundsScale[axis] = boundsScale[axis + 3] = sum;
+            }
+            mismatches += countOff(got, want, boundsScale, 6) ? 1 : 0;
+            identical += std::memcmp(&fastBounds[i], &scalarBounds[i], sizeof(ObjectBounds)) == 0 ? 1 : 0;
+            cases += 2;
+        }
+#ifdef FALLAGA_SSE
+        const std::string levels = "sse against scalar";
+#else
+        const std::string levels = "scalar only, no SSE on this target";
+#endif
+        harness.check("mat4_simd_equivalence", cases, mismatches,
+                      levels + "; multiply and bounds, " + std::to_string(identical) + " bit-identical");
+    }
+
+    if (harness.wants("mat4_inverse")) {
+        size_t cases = 0, mismatches = 0;
+        for (size_t i = 0; i < MATRIX_CHECK_CASES; i++) {
+            Mat4 matrix;
+            if (i % 2 == 0) {
+                // Diagonally dominant, so far from singular
+                matrix = randomMatrix(1.0f);
+                for (int d = 0; d < 4; d++) matrix.m[d * 5] += (next() < 0.5f ? -5.0f : 5.0f);
+            } else {
+                const Transform t = { between(-500.0f, 500.0f), between(-20.0f, 20.0f), between(-500.0f, 500.0f),
+                                      between(0.25f, 4.0f), between(-6.3f, 6.3f) };
+                const Vec3 eye = randomVec(200.0f);
+                matrix = Mat4::lookAt(eye, eye + randomVec(1.0f) + Vec3(0.0f, 0.0f, 2.0f), Vec3(0.0f, 1.0f, 0.0f)) *
+                         Mat4::fromTransform(t);
+            }
+            // The product in doubles, so only the inverse's own error shows
+            const Mat4 inverse = matrix.inverse();
+            float product[16];
+            double identity[16], scale[16];
+            for (int c = 0; c < 4; c++)
+                for (int r = 0; r < 4; r++) {
+                    double sum = 0.0, size = 0.0;
+                    for (int k = 0; k < 4; k++) {
+                        sum += double(matrix.m[k * 4 + r]) * inverse.m[c * 4 + k];
+                        size += std::abs(double(matrix.m[k * 4 + r]) * inverse.m[c * 4 + k]);
+                    }
+                    product[c * 4 + r] = static_cast<float>(sum);
+                    identity[c * 4 + r] = r == c ? 1.0 : 0.0;
+                    scale[c * 4 + r] = size;
+                }
+            mismatches += countOff(product, identity, scale, 16) ? 1 : 0;
+            cases++;
+        }
+        harness.check("mat4_inverse", cases, mismatches, "well-conditioned and view times model");
+    }
+
+    if (harness.wants("mat4_camera_matrices")) {
+        const double PI = 3.14159265358979323846;
+        size_t cases = 0, mismatches = 0;
+        const double ones[16] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+        for (size_t i = 0; i < MATRIX_CHECK_CASES / 10; i++) {
+            // gluLookAt: rows s, u, -f, then translated by -eye
+            const Vec3 eye = randomVec(300.0f);
+            const Vec3 target = eye + randomVec(50.0f) + Vec3(60.0f, 0.0f, 0.0f);
+            const Vec3 up = Vec3(0.0f, 1.0f, 0.0f) + randomVec(0.3f);
+            double f[3] = { target.x - eye.x, target.y - eye.y, target.z - eye.z };
+            const double fLength = std::sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+            for (double& v : f) v /= fLength;
+            double s[3] = { f[1] * up.z - f[2] * up.y, f[2] * up.x - f[0] * up.z, f[0] * up.y - f[1] * up.x };
+            const double sLength = std::sqrt(s[0] * s[0] + s[1] * s[1] + s[2] * s[2]);
+            for (double& v : s) v /= sLength;
+            const double u[3] = { s[1] * f[2] - s[2] * f[1], s[2] * f[0] - s[0] * f[2], s[0] * f[1] - s[1] * f[0] };
+            const double e[3] = { eye.x, eye.y, eye.z };
+            RefMat4 look;
+            for (int c = 0; c < 3; c++) {
+                look.at(0, c) = s[c];
+                look.at(1, c) = u[c];
+                look.at(2, c) = -f[c];
+            }
+            look.at(3, 3) = 1.0;
+            for (int r = 0; r < 3; r++)
+                for (int c = 0; c < 3; c++) look.at(r, 3) -= look.at(r, c) * e[c];
+            // The translation is a sum of products up to |eye| in size
+            double lookScale[16];
+            const double eyeDistance = std::sqrt(e[0] * e[0] + e[1] * e[1] + e[2] * e[2]);
+            for (int k = 0; k < 16; k++) lookScale[k] = k >= 12 ? 2.0 * eyeDistance : 1.0;
+            mismatches += countOff(Mat4::lookAt(eye, target, up).m, look.m, lookScale, 16) ? 1 : 0;
+
+            // gluPerspective
+            const float fovY = between(20.0f, 120.0f), aspect = between(0.5f, 3.0f);
+            const float zNear = between(0.05f, 2.0f), zFar = between(50.0f, 5000.0f);
+            const double cot = 1.0 / std::tan(0.5 * fovY * PI / 180.0);
+            RefMat4 perspective;
+            perspective.at(0, 0) = cot / aspect;
+            perspective.at(1, 1) = cot;
+            perspective.at(2, 2) = (double(zFar) + zNear) / (double(zNear) - zFar);
+            perspective.at(2, 3) = 2.0 * zFar * zNear / (double(zNear) - zFar);
+            perspective.at(3, 2) = -1.0;
+            mismatches += countOff(Mat4::perspective(fovY, aspect, zNear, zFar).m, perspective.m, ones, 16) ? 1 : 0;
+
+            // glOrtho
+            const float left = between(-500.0f, 0.0f), right = left + between(1.0f, 500.0f);
+            const float bottom = between(-500.0f, 0.0f), top = bottom + between(1.0f, 500.0f);
+            RefMat4 ortho;
+            ortho.at(0, 0) = 2.0 / (double(right) - left);
+            ortho.at(1, 1) = 2.0 / (double(top) - bottom);
+            ortho.at(2, 2) = -2.0 / (double(zFar) - zNear);
+            ortho.at(0, 3) = -(double(right) + left) / (double(right) - left);
+            ortho.at(1, 3) = -(double(top) + bottom) / (double(top) - bottom);
+            ortho.at(2, 3) = -(double(zFar) + zNear) / (double(zFar) - zNear);
+            ortho.at(3, 3) = 1.0;
+            mismatches +=
+                countOff(Mat4::orthographic(left, right, bottom, top, zNear, zFar).m, ortho.m, ones, 16) ? 1 : 0;
+            cases += 3;
+        }
+        harness.check("mat4_camera_matrices", cases, mismatches, "lookAt, perspective and orthographic");
+    }
+}
+
+// The batched math kernels over MATRIX_COUNT instances: model matrices
+// from transforms, the view times each of them, and each instance's world
+// box from one model box, the last two with SSE and without
+void benchTransforms(Harness& harness) {
+    const char* kernels[] = { "mat4_compose", "mat4_multiply", "mat4_bounds" };
+    if (std::none_of(std::begin(kernels), std::end(kernels), [&](const char* name) { return harness.wants(name); }))
+        return;
+    const std::string suffix = "_" + std::to_string(MATRIX_COUNT);
+    std::vector<Transform> transforms(MATRIX_COUNT);
+    for (size_t i = 0; i < MATRIX_COUNT; i++)
+        transforms[i] = { (i % 100) * 2.0f, 0.1f * (i % 7), (i / 100) * 2.0f, 0.5f + (i % 5) * 0.25f, 0.7f * i };
+    std::vector<Mat4> models(MATRIX_COUNT), out(MATRIX_COUNT);
+    std::vector<ObjectBounds> bounds(MATRIX_COUNT);
+    const Mat4 view = Mat4::lookAt(Vec3(0.0f, 5.0f, -10.0f), Vec3(100.0f, 0.0f, 100.0f), Vec3(0.0f, 1.0f, 0.0f));
+    const ObjectBounds local = { Vec3(-0.5f, 0.0f, -0.5f), Vec3(0.5f, 4.0f, 0.5f) };
+
+    harness.run("mat4_compose" + suffix, MATRIX_COUNT, [&] {
+        composeTransforms(transforms.data(), MATRIX_COUNT, models.data());
+        sink = models.back().m[12];
+    });
+    composeTransforms(transforms.data(), MATRIX_COUNT, models.data());
+    harness.run("mat4_multiply" + suffix, MATRIX_COUNT, [&] {
+        multiplyMatrices(view, models.data(), MATRIX_COUNT, out.data());
+        sink = out.back().m[12];
+    });
+    harness.run("mat4_multiply_scalar" + suffix, MATRIX_COUNT, [&] {
+        multiplyMatricesScalar(view, models.data(), MATRIX_COUNT, out.data());
+        sink = out.back().m[12];
+    });
+    harness.run("mat4_bounds" + suffix, MATRIX_COUNT, [&] {
+        transformBounds(local, models.data(), MATRIX_COUNT, bounds.data());
+        sink = bounds.back().max.x;
+    });
+    harness.run("mat4_bounds_scalar" + suffix, MATRIX_COUNT, [&] {
+        transformBoundsScalar(local, models.data(), MATRIX_COUNT, bounds.data());
+        sink = bounds.back().max.x;
+    });
+}
+
+// ===============================
+// Render queue
+// ===============================
+const size_t QUEUE_ITEMS = 10000;
+
+// Sorting a frame's worth of QUEUE_ITEMS draw items, keyed as the
+// renderers key them (a few programs, tens of textures, hundreds of
+// meshes, any depth), with RenderQueue's radix sort and with std::sort.
+// Both sort a fresh copy of the same shuffled queue each run.
+void benchRenderQueue(Harness& harness) {
+    const std::string radix = "render_queue_radix_" + std::to_string(QUEUE_ITEMS);
+    const std::string stdsort = "render_queue_stdsort_" + std::to_string(QUEUE_ITEMS);
+    if (!harness.wants(radix) && !harness.wants(stdsort)) return;
+
+    RenderQueue queue;
+    uint32_t state = 12345;
+    auto next = [&state] {
+        state = state * 1664525u + 1013904223u;
+        return state >> 8;
+    };
+    std::vector<DrawItem> items(QUEUE_ITEMS);
+    for (DrawItem& item : items) {
+        const RenderPass pass = next() % 8 == 0 ? RenderPass::FixedFunction : RenderPass::Opaque;
+        const float depth = (next() % 100000) * 0.01f;
+        item = { queue.makeKey(pass, 1 + next() % 4, 1 + next() % 64, 1 + next() % 512, depth), nullptr, nullptr, 0 };
+    }
+
+    std::vector<DrawItem> sorted, scratch;
+    harness.run(radix, QUEUE_ITEMS, [&] {
+        sorted = items;
+        RenderQueue::radixSort(sorted, scratch);
+        sink = static_cast<float>(sorted[0].key);
+    });
+    harness.run(stdsort, QUEUE_ITEMS, [&] {
+        sorted = items;
+        std::stable_sort(sorted.begin(), sorted.end(),
+                         [](const DrawItem& a, const DrawItem& b) { return a.key < b.key; });
+        sink = static_cast<float>(sorted[0].key);
+    });
+}
+
+// ===============================
+// Job System
+// ===============================
+const size_t EMPTY_JOBS = 1024;
+
+// The users of the job system at 1, 2, 4, ... threads up to --max-threads
+// (default one per core), named <kernel>_t<threads>: scheduling alone
+// (EMPTY_JOBS jobs that do nothing, queued and waited for), normals,
+// batched height queries and entity culling. On one core the t1 numbers
+// against the serial kernels are the cost of going through the scheduler.
+void benchJobs(Harness& harness, const SyntheticMesh& mesh, const Options& options) {
+    const char* kernels[] = { "jobs_empty", "jobs_vertex_normals", "jobs_terrain_heights", "jobs_entity_cull" };
+    if (std::none_of(std::begin(kernels), std::end(kernels), [&](const char* name) { return harness.wants(name); }))
+        return;
+
+    HeightGrid grid;
+    grid.build(mesh.vertices, mesh.faces);
+    const std::vector<Vec3> points = queryPoints(options.size, 65536);
+    std::vector<float> heights;
+    World world;
+    makeEntities(world);
+    const Frustum frustum = walkerFrustum();
+
+    JobSystem& jobs = JobSystem::get();
+    const unsigned defaultThreads = jobs.getThreadCount();
+    std::vector<unsigned> threadCounts;
+    for (unsigned t = 1; t < options.maxThreads; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(options.maxThreads);
+
+    for (unsigned threads : threadCounts) {
+        jobs.resize(threads);
+        const std::string suffix = "_t" + std::to_string(threads);
+
+        harness.run("jobs_empty" + suffix, EMPTY_JOBS, [&] {
+            std::atomic<int> ran{0};
+            JobCounter counter;
+            Job job;
+            job.function = [](void* data, size_t, size_t) { static_cast<std::atomic<int>*>(data)->fetch_add(1); };
+            job.data = &ran;
+            job.counter = &counter;
+            for (size_t i = 0; i < EMPTY_JOBS; i++) jobs.run(job);
+            jobs.wait(counter);
+            sink = static_cast<float>(ran.load());
+        });
+
+        harness.run("jobs_vertex_normals" + suffix, mesh.faces.size(), [&] {
+            std::vector<Face> faces = mesh.faces;
+            std::vector<Vec3> normals;
+            computeVertexNormals(mesh.vertices, { &faces }, normals);
+            sink = normals.back().y;
+        });
+
+        harness.run("jobs_terrain_heights" + suffix, points.size(), [&] {
+            grid.heightsAt(points, 100.0f, 0.0f, heights);
+            sink = heights.back();
+        });
+
+        harness.run("jobs_entity_cull" + suffix, ENTITY_COUNT, [&] {
+            CullStats stats;
+            cullEntities(world, frustum, stats);
+            sink = static_cast<float>(stats.drawn);
+        });
+    }
+    jobs.resize(defaultThreads);
+}
+
+// ===============================
+// Ray Casts
+// ===============================
+const size_t RAY_COUNT = 16384;
+
+// Batched BVH queries over the synthetic ground at 1, 2, 4, ... threads
+// up to --max-threads, as bvh_closest_t<threads> and bvh_any_t<threads>;
+// ops are rays. Closest hits are picking rays from a raised viewpoint to
+// points on the ground; any hits are line of sight between two walkers'
+// eyes, which the hills block for some of them.
+void benchRays(Harness& harness, const SyntheticMesh& mesh, const Options& options) {
+    if (!harness.wants("bvh_closest") && !harness.wants("bvh_any")) return;
+
+    Bvh bvh;
+    bvh.build(mesh.vertices, mesh.faces);
+    HeightGrid grid;
+    grid.build(mesh.vertices, mesh.faces);
+    const std::vector<Vec3> points = queryPoints(options.size, 2 * RAY_COUNT);
+    std::vector<float> heights;
+    grid.heightsAt(points, 100.0f, 0.0f, heights);
+
+    const float half = options.size * 0.5f;
+    const Vec3 eye(-half, 20.0f, -half);
+    std::vector<Ray> picks, sights;
+    for (size_t i = 0; i < RAY_COUNT; i++) {
+        const Vec3 ground(points[i].x, heights[i], points[i].z);
+        Vec3 dir = ground - eye;
+        dir.normalize();
+        picks.emplace_back(eye, dir);
+
+        const Vec3 from(points[i].x, heights[i] + 1.7f, points[i].z);
+        const Vec3 to(points[RAY_COUNT + i].x, heights[RAY_COUNT + i] + 1.7f, points[RAY_COUNT + i].z);
+        const Vec3 along = to - from;
+        const float length = along.length();
+        if (length > 0.0f) sights.emplace_back(from, along * (1.0f / length), length);
+    }
+
+    JobSystem& jobs = JobSystem::get();
+    const unsigned defaultThreads = jobs.getThreadCount();
+    std::vector<unsigned> threadCounts;
+    for (unsigned t = 1; t < options.maxThreads; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(options.maxThreads);
+
+    std::vector<RayHit> hits;
+    std::vector<uint8_t> blocked;
+    for (unsigned threads : threadCounts) {
+        jobs.resize(threads);
+        const std::string suffix = "_t" + std::to_string(threads);
+        harness.run("bvh_closest" + suffix, picks.size(), [&] {
+            bvh.closestHits(picks, hits);
+            sink = hits.back().t;
+        });
+        harness.run("bvh_any" + suffix, sights.size(), [&] {
+            bvh.anyHits(sights, blocked);
+            sink = static_cast<float>(blocked.back());
+        });
+    }
+    jobs.resize(defaultThreads);
+}
+
+// ===============================
+// Terrain Draw
+// ===============================
+
+// The synthetic ground from a walker's view, once as the whole mesh (what
+// Terrain draws with FALLAGA_TERRAIN_MESH=1) and once through CDLOD. `ops`
+// is the triangles each submits: the mesh's grow with --size, CDLOD's
+// stay about the same.
+void benchTerrainDraw(Harness& harness, const SyntheticMesh& mesh, const IndexedMesh& indexed, const Options& options) {
+    const float aspect = static_cast<float>(VIEW_WIDTH) / VIEW_HEIGHT;
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    glEnable(GL_LIGHTING);
+    glEnable(GL_LIGHT0);
+    glEnable(GL_COLOR_MATERIAL);
+    glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
+    GLfloat lightPosition[] = { 1.0f, 1.0f, 1.0f, 0.0f };
+    glLightfv(GL_LIGHT0, GL_POSITION, lightPosition);
+
+    Camera camera(nullptr);
+    camera.setProjection(45.0f, aspect, 0.1f, 1000.0f);
+    const float eyeY = terrainHeight(0.0f, 0.0f) + 2.0f;
+    camera.setView(Vec3(0.0f, eyeY, 0.0f), Vec3(0.0f, eyeY - 1.0f, 10.0f));
+    camera.apply();
+
+    GLuint buffers[2], vao;
+    glGenBuffers(2, buffers);
+    glGenVertexArrays(1, &vao);
+    GlState::get().bindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, indexed.vertices.size() * sizeof(MeshVertex), indexed.vertices.data(), GL_STATIC_DRAW);
+    const GLsizei stride = sizeof(MeshVertex);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, stride, reinterpret_cast<const void*>(offsetof(MeshVertex, px)));
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glNormalPointer(GL_FLOAT, stride, reinterpret_cast<const void*>(offsetof(MeshVertex, nx)));
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexed.indices.size() * sizeof(uint32_t), indexed.indices.data(), GL_STATIC_DRAW);
+    GlState::get().bindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    harness.run("terrain_draw_mesh", indexed.indices.size() / 3, [&] {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        GlState::get().bindVertexArray(vao);
+        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indexed.indices.size()), GL_UNSIGNED_INT, nullptr);
+        GlState::get().bindVertexArray(0);
+        glFinish();
+    });
+    GlState::get().deleteVertexArrays(1, &vao);
+    glDeleteBuffers(2, buffers);
+
+    CdlodTerrain cdlod;
+    if (!cdlod.isSupported()) {
+        harness.skip("terrain_draw_cdlod", "CDLOD needs GL 3.0 shaders");
+        return;
+    }
+    // Heights straight from the generating function, on the same grid
+    // spacing as the mesh when --size is a power of two
+    HeightField field;
+    field.cells = CdlodTerrain::PATCH_QUADS;
+    while (field.cells < options.size) field.cells *= 2;
+    field.spacing = static_cast<float>(options.size) / field.cells;
+    field.originX = field.originZ = -options.size * 0.5f;
+    for (int z = 0; z < field.resolution(); z++)
+        for (int x = 0; x < field.resolution(); x++)
+            field.heights.push_back(terrainHeight(field.originX + x * field.spacing, field.originZ + z * field.spacing));
+    const Vec3 groundMin = mesh.vertices.front(), groundMax = mesh.vertices.back();
+    cdlod.setHeightField(std::move(field), groundMin, groundMax);
+
+    cdlod.render(camera, 0);
+    harness.run("terrain_draw_cdlod", cdlod.getTrianglesDrawn(), [&] {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        cdlod.render(camera, 0);
+        glFinish();
+    });
+}
+
+// ===============================
+// GL Kernels
+// ===============================
+
+// Upload and setup only: the calls ObjModel makes for each path, then
+// glFinish so the driver's copy is part of the time
+void benchGl(Harness& harness, const SyntheticMesh& mesh, const Options& options) {
+    std::vector<Face> faces = mesh.faces;
+    std::vector<Vec3> normals(mesh.vertices.size(), Vec3(0, 0, 0));
+    accumulateFaceNormals(mesh.vertices, faces, normals);
+    finalizeVertexNormals(normals);
+    std::map<std::string, std::vector<Face>> materialFaces;
+    materialFaces["terrain"] = faces;
+    const size_t triangles = faces.size();
+
+    harness.run("display_list_setup", triangles, [&] {
+        GLuint list = glGenLists(1);
+        glNewList(list, GL_COMPILE);
+        glBegin(GL_TRIANGLES);
+        for (const Face& face : faces) {
+            for (int i = 0; i < 3; i++) {
+                const Vec3& n = normals[face.vn[i]];
+                const Vec2& t = mesh.texcoords[face.vt[i]];
+                const Vec3& v = mesh.vertices[face.v[i]];
+                glNormal3f(n.x, n.y, n.z);
+                glTexCoord2f(t.u, t.v);
+                glVertex3f(v.x, v.y, v.z);
+            }
+        }
+        glEnd();
+        glEndList();
+        glFinish();
+        glDeleteLists(list, 1);
+    });
+
+    if (!GLEW_VERSION_3_0 && !GLEW_ARB_vertex_array_object) {
+        for (const char* name : { "vbo_setup", "terrain_draw_mesh", "terrain_draw_cdlod" })
+            harness.skip(name, "no vertex array objects");
+        return;
+    }
+
+    IndexedMesh indexed;
+    buildIndexedMesh(mesh.vertices, normals, mesh.texcoords, materialFaces, indexed);
+
+    harness.run("vbo_setup", triangles, [&] {
+        GLuint buffers[2], vao;
+        glGenBuffers(2, buffers);
+        glGenVertexArrays(1, &vao);
+        GlState::get().bindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+        glBufferData(GL_ARRAY_BUFFER, indexed.vertices.size() * sizeof(MeshVertex), indexed.vertices.data(), GL_STATIC_DRAW);
+        const GLsizei stride = sizeof(MeshVertex);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(3, GL_FLOAT, stride, reinterpret_cast<const void*>(offsetof(MeshVertex, px)));
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glNormalPointer(GL_FLOAT, stride, reinterpret_cast<const void*>(offsetof(MeshVertex, nx)));
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glTexCoordPointer(2, GL_FLOAT, stride, reinterpret_cast<const void*>(offsetof(MeshVertex, u)));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexed.indices.size() * sizeof(uint32_t), indexed.indices.data(), GL_STATIC_DRAW);
+        GlState::get().bindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        glFinish();
+        GlState::get().deleteVertexArrays(1, &vao);
+        glDeleteBuffers(2, buffers);
+    });
+
+    if (harness.wants("terrain_draw")) benchTerrainDraw(harness, mesh, indexed, options);
+}
+
+// ===============================
+// Report
+// ===============================
+std::string quoted(const std::string& s) {
+    std::string q = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') q += '\\';
+        q += c;
+    }
+    return q + '"';
+}
+
+std::string toJson(const Harness& harness, const Options& options, const SyntheticMesh& mesh,
+                   const std::string& renderer) {
+    std::ostringstream out;
+    out << "{\n";
+    out << "  \"size\": " << options.size << ",\n";
+    out << "  \"vertices\": " << mesh.vertices.size() << ",\n";
+    out << "  \"triangles\": " << mesh.faces.size() << ",\n";
+    out << "  \"reps\": " << options.reps << ",\n";
+    out << "  \"cores\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "  \"renderer\": " << quoted(renderer) << ",\n";
+    out << "  \"kernels\": [";
+    for (size_t i = 0; i < harness.results.size(); i++) {
+        const KernelResult& r = harness.results[i];
+        out << (i ? "," : "") << "\n    {\"name\": " << quoted(r.name) << ", \"ops\": " << r.opsPerCall
+            << ", \"calls_per_rep\": " << r.callsPerRep << ", \"median_ns\": " << r.medianNs
+            << ", \"mad_ns\": " << r.madNs << ", \"ops_per_sec\": " << r.opsPerSecond << "}";
+    }
+    out << "\n  ],\n";
+    out << "  \"skipped\": [";
+    for (size_t i = 0; i < harness.skipped.size(); i++) {
+        out << (i ? "," : "") << "\n    {\"name\": " << quoted(harness.skipped[i].first)
+            << ", \"reason\": " << quoted(harness.skipped[i].second) << "}";
+    }
+    out << (harness.skipped.empty() ? "],\n" : "\n  ],\n");
+    out << "  \"checks\": [";
+    for (size_t i = 0; i < harness.checks.size(); i++) {
+        const CheckResult& c = harness.checks[i];
+        out << (i ? "," : "") << "\n    {\"name\": " << quoted(c.name) << ", \"cases\": " << c.cases
+            << ", \"mismatches\": " << c.mismatches << ", \"detail\": " << quoted(c.detail) << "}";
+    }
+    out << (harness.checks.empty() ? "]\n" : "\n  ]\n");
+    out << "}\n";
+    return out.str();
+}
+
+bool parseArguments(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--size" && hasValue) {
+            options.size = std::atoi(argv[++i]);
+        } else if (arg == "--reps" && hasValue) {
+            options.reps = std::atoi(argv[++i]);
+        } else if (arg == "--warmup" && hasValue) {
+            options.warmup = std::atoi(argv[++i]);
+        } else if (arg == "--min-rep-ms" && hasValue) {
+            options.minRepMs = std::atof(argv[++i]);
+        } else if (arg == "--filter" && hasValue) {
+            options.filter = argv[++i];
+        } else if (arg == "--out" && hasValue) {
+            options.outPath = argv[++i];
+        } else if (arg == "--max-threads" && hasValue) {
+            options.maxThreads = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--no-gl") {
+            options.gl = false;
+        } else {
+            return false;
+        }
+    }
+    return options.size > 0 && options.reps > 0 && options.warmup >= 0 && options.minRepMs >= 0.0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [--size N] [--reps N] [--warmup N] [--min-rep-ms MS]"
+                  << " [--filter TEXT] [--max-threads N] [--no-gl] [--out FILE]\n";
+        return 1;
+    }
+
+    const SyntheticMesh mesh = makeGrid(options.size);
+    LOG_INFO("Synthetic grid " << options.size << "x" << options.size << ": " << mesh.vertices.size()
+             << " vertices, " << mesh.faces.size() << " triangles");
+
+    Harness harness(options);
+    benchCpu(harness, mesh, options);
+    benchTriangleKernels(harness, mesh);
+    benchHeightScaling(harness, options);
+    benchEntities(harness);
+    benchHerd(harness, mesh);
+    benchCollision(harness);
+    benchAnimation(harness);
+    checkTransforms(harness);
+    benchTransforms(harness);
+    benchRenderQueue(harness);
+    benchJobs(harness, mesh, options);
+    benchRays(harness, mesh, options);
+
+    std::string renderer = "none";
+    const char* glKernels[] = { "display_list_setup", "vbo_setup", "terrain_draw_mesh", "terrain_draw_cdlod" };
+    if (!options.gl) {
+        for (const char* name : glKernels) harness.skip(name, "--no-gl");
+    } else {
+        OffscreenContext gl;
+        if (gl.create(VIEW_WIDTH, VIEW_HEIGHT)) {
+            renderer = std::string(reinterpret_cast<const char*>(glGetString(GL_RENDERER))) + " (" + gl.getApi() + ")";
+            benchGl(harness, mesh, options);
+        } else {
+            for (const char* name : glKernels) harness.skip(name, "no OpenGL context");
+        }
+    }
+
+    const std::string json = toJson(harness, options, mesh, renderer);
+    Log::flush();
+    const int status = harness.failed() ? 1 : 0;
+    if (options.outPath.empty()) {
+        std::cout << json;
+        return status;
+    }
+    std::ofstream out(options.outPath);
+    if (!(out << json)) {
+        LOG_ERROR("Could not write " << options.outPath);
+        return 1;
+    }
+    LOG_INFO("Wrote " << options.outPath);
+    return status;
+}
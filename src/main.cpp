@@ -2,11 +2,14 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <GL/glut.h>
-#include <iostream>
+#include <cstring>
+#include <string>
 
 #include "Game.h"
+#include "Benchmark.h"
 #include "Camera.h"
 #include "Character.h"
+#include "Log.h"
 
 // --- Function Prototypes ---
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
@@ -19,17 +22,25 @@ const int WINDOW_WIDTH = 800;
 const int WINDOW_HEIGHT = 600;
 Game* game; // Global game object
 
-int main() {
+int main(int argc, char** argv) {
+    // --bench <script> [--out <file>]: offscreen run of a scripted path
+    // that prints frame time statistics, see Benchmark.h
+    if (argc >= 3 && std::strcmp(argv[1], "--bench") == 0) {
+        std::string out;
+        if (argc >= 5 && std::strcmp(argv[3], "--out") == 0) out = argv[4];
+        return runBenchmark(argv[2], out);
+    }
+
     // 1. Initialize GLFW
     if (!glfwInit()) {
-        std::cerr << "Failed to initialize GLFW\n";
+        LOG_ERROR("Failed to initialize GLFW");
         return -1;
     }
 
     // 2. Create a Window and OpenGL context
     GLFWwindow* window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "RDR2 Prototype", nullptr, nullptr);
     if (!window) {
-        std::cerr << "Failed to create GLFW window\n";
+        LOG_ERROR("Failed to create GLFW window");
         glfwTerminate();
         return -1;
     }
@@ -38,13 +49,12 @@ int main() {
     // 3. Initialize GLEW (must be done after creating a context)
     glewExperimental = GL_TRUE; // Enable modern OpenGL features
     if (glewInit() != GLEW_OK) {
-        std::cerr << "Failed to initialize GLEW\n";
+        LOG_ERROR("Failed to initialize GLEW");
         return -1;
     }
 
-    int argc = 0;
-    char** argv = nullptr;
-    glutInit(&argc, argv);
+    int glutArgc = 0;
+    glutInit(&glutArgc, nullptr);
     
     // Set callbacks
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
@@ -63,7 +73,7 @@ int main() {
     // Get initial mouse position
     double xpos, ypos;
     glfwGetCursorPos(window, &xpos, &ypos);
-    game->getCamera().handleMouse(xpos, ypos);
+    game->mouseMove(xpos, ypos);
 
     // The Game Loop
     while (!glfwWindowShouldClose(window)) {
@@ -95,18 +105,18 @@ void setup_opengl() {
     GLfloat light_position[] = { 1.0f, 1.0f, 1.0f, 0.0f };
     glLightfv(GL_LIGHT0, GL_POSITION, light_position);
 
-    // Set projection matrix once at the start
+    // Viewport and projection for the initial size
     framebuffer_size_callback(nullptr, WINDOW_WIDTH, WINDOW_HEIGHT);
 }
 
 // Called when the window is resized
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
+    if (height <= 0) return; // minimized
     glViewport(0, 0, width, height);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    // Using legacy gluPerspective for projection
-    gluPerspective(45.0, (double)width / (double)height, 0.1, 1000.0);
-    glMatrixMode(GL_MODELVIEW);
+
+    // The camera loads its projection with the view each frame, and culls
+    // with the same one
+    if (game) game->getCamera().setProjection(45.0f, (float)width / (float)height, 0.1f, 1000.0f);
 }
 
 // Called when a keyboard key is pressed/released
@@ -120,5 +130,5 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 
 // Called when the mouse moves
 void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
-    game->getCamera().handleMouse(xpos, ypos);
+    game->mouseMove(xpos, ypos);
 }